@@ -18,3 +18,32 @@ function(create_resources dir output)
         file(APPEND ${output} "const uint8_t  ${filename}[] = {${filedata}};\nconst uint32_t ${filename}_size = sizeof(${filename});\n")
     endforeach()
 endfunction()
+
+set(BIN2ARRAY_DIR ${CMAKE_CURRENT_LIST_DIR})
+
+# Same as create_resources, except that the data arrays hold zlib streams to be passed to
+# esp_loader_flash_precompressed_write(). Each file additionally gets ${name}_compressed_size
+# and ${name}_md5, while ${name}_size holds the uncompressed size padded to 4 bytes.
+function(create_compressed_resources dir output)
+    find_package(Python3 REQUIRED COMPONENTS Interpreter)
+    # Create empty output file
+    file(WRITE ${output} "#include <stdint.h>\n\n")
+    # Collect input files
+    file(GLOB bin_paths ${dir}/ESP*/*)
+    # Iterate through input files
+    foreach(bin ${bin_paths})
+        # Get short filenames, by discarding relative path
+        file(GLOB name RELATIVE ${dir} ${bin})
+        # Replace filename spaces & extension separator for C compatibility
+        string(REGEX REPLACE "[\\./-]" "_" filename ${name})
+        # Compress the file and print it as C definitions
+        execute_process(COMMAND ${Python3_EXECUTABLE} ${BIN2ARRAY_DIR}/bin2zlib.py ${bin} ${filename}
+                        OUTPUT_VARIABLE definitions
+                        RESULT_VARIABLE result)
+        if (NOT result EQUAL 0)
+            message(FATAL_ERROR "Compressing ${bin} failed")
+        endif()
+        # Append data to output file
+        file(APPEND ${output} "${definitions}")
+    endforeach()
+endfunction()
@@ -0,0 +1,35 @@
+#!/usr/bin/env python3
+"""Prints a binary as a zlib compressed C array, for esp_loader_flash_precompressed_*.
+
+The image is padded with 0xff to a multiple of 4 bytes, the same way the
+library pads uncompressed images, and the MD5 digest of the padded image
+is emitted alongside it.
+"""
+
+import hashlib
+import sys
+import zlib
+
+
+def c_array(data: bytes) -> str:
+    return ",".join(f"0x{byte:02x}" for byte in data)
+
+
+def main() -> None:
+    path, name = sys.argv[1], sys.argv[2]
+
+    with open(path, "rb") as f:
+        image = f.read()
+    image += b"\xff" * (-len(image) % 4)
+
+    compressed = zlib.compress(image, 9)
+    md5 = hashlib.md5(image).digest()
+
+    print(f"const uint8_t  {name}[] = {{{c_array(compressed)}}};")
+    print(f"const uint32_t {name}_size = {len(image)};")
+    print(f"const uint32_t {name}_compressed_size = sizeof({name});")
+    print(f"const uint8_t  {name}_md5[16] = {{{c_array(md5)}}};")
+
+
+if __name__ == "__main__":
+    main()
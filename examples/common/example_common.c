@@ -98,89 +98,85 @@ extern const uint32_t ESP32_C6_hello_world_bin_size;
 extern const uint8_t  ESP32_C6_partition_table_bin[];
 extern const uint32_t ESP32_C6_partition_table_bin_size;
 
+#ifdef EXAMPLE_COMPRESSED_BINARIES
+#define DECLARE_COMPRESSED(name) \
+    extern const uint32_t name##_compressed_size; \
+    extern const uint8_t  name##_md5[16];
+
+DECLARE_COMPRESSED(ESP32_bootloader_bin)
+DECLARE_COMPRESSED(ESP32_hello_world_bin)
+DECLARE_COMPRESSED(ESP32_partition_table_bin)
+DECLARE_COMPRESSED(ESP32_S2_bootloader_bin)
+DECLARE_COMPRESSED(ESP32_S2_hello_world_bin)
+DECLARE_COMPRESSED(ESP32_S2_partition_table_bin)
+DECLARE_COMPRESSED(ESP32_S3_bootloader_bin)
+DECLARE_COMPRESSED(ESP32_S3_hello_world_bin)
+DECLARE_COMPRESSED(ESP32_S3_partition_table_bin)
+DECLARE_COMPRESSED(ESP8266_bootloader_bin)
+DECLARE_COMPRESSED(ESP8266_hello_world_bin)
+DECLARE_COMPRESSED(ESP8266_partition_table_bin)
+DECLARE_COMPRESSED(ESP32_H4_bootloader_bin)
+DECLARE_COMPRESSED(ESP32_H4_hello_world_bin)
+DECLARE_COMPRESSED(ESP32_H4_partition_table_bin)
+DECLARE_COMPRESSED(ESP32_H2_bootloader_bin)
+DECLARE_COMPRESSED(ESP32_H2_hello_world_bin)
+DECLARE_COMPRESSED(ESP32_H2_partition_table_bin)
+DECLARE_COMPRESSED(ESP32_C2_bootloader_bin)
+DECLARE_COMPRESSED(ESP32_C2_hello_world_bin)
+DECLARE_COMPRESSED(ESP32_C2_partition_table_bin)
+DECLARE_COMPRESSED(ESP32_C3_bootloader_bin)
+DECLARE_COMPRESSED(ESP32_C3_hello_world_bin)
+DECLARE_COMPRESSED(ESP32_C3_partition_table_bin)
+DECLARE_COMPRESSED(ESP32_C6_bootloader_bin)
+DECLARE_COMPRESSED(ESP32_C6_hello_world_bin)
+DECLARE_COMPRESSED(ESP32_C6_partition_table_bin)
+#endif
+
+/* The arrays made by create_compressed_resources() hold zlib streams, the sizes are those of
+   the uncompressed images */
+#ifdef EXAMPLE_COMPRESSED_BINARIES
+#define BINARY(name, address) (partition_attr_t) { \
+    .data = name, .size = name##_size, .addr = address, \
+    .compressed_size = name##_compressed_size, .md5 = name##_md5 }
+#else
+#define BINARY(name, address) (partition_attr_t) { .data = name, .size = name##_size, .addr = address }
+#endif
+
 void get_example_binaries(target_chip_t target, example_binaries_t *bins)
 {
     if (target == ESP8266_CHIP) {
-        bins->boot.data = ESP8266_bootloader_bin;
-        bins->boot.size = ESP8266_bootloader_bin_size;
-        bins->boot.addr = BOOTLOADER_ADDRESS_V0;
-        bins->part.data = ESP8266_partition_table_bin;
-        bins->part.size = ESP8266_partition_table_bin_size;
-        bins->part.addr = PARTITION_ADDRESS;
-        bins->app.data  = ESP8266_hello_world_bin;
-        bins->app.size  = ESP8266_hello_world_bin_size;
-        bins->app.addr  = APPLICATION_ADDRESS;
+        bins->boot = BINARY(ESP8266_bootloader_bin, BOOTLOADER_ADDRESS_V0);
+        bins->part = BINARY(ESP8266_partition_table_bin, PARTITION_ADDRESS);
+        bins->app  = BINARY(ESP8266_hello_world_bin, APPLICATION_ADDRESS);
     } else if (target == ESP32_CHIP) {
-        bins->boot.data = ESP32_bootloader_bin;
-        bins->boot.size = ESP32_bootloader_bin_size;
-        bins->boot.addr = BOOTLOADER_ADDRESS_V0;
-        bins->part.data = ESP32_partition_table_bin;
-        bins->part.size = ESP32_partition_table_bin_size;
-        bins->part.addr = PARTITION_ADDRESS;
-        bins->app.data  = ESP32_hello_world_bin;
-        bins->app.size  = ESP32_hello_world_bin_size;
-        bins->app.addr  = APPLICATION_ADDRESS;
+        bins->boot = BINARY(ESP32_bootloader_bin, BOOTLOADER_ADDRESS_V0);
+        bins->part = BINARY(ESP32_partition_table_bin, PARTITION_ADDRESS);
+        bins->app  = BINARY(ESP32_hello_world_bin, APPLICATION_ADDRESS);
     } else if (target == ESP32S2_CHIP) {
-        bins->boot.data = ESP32_S2_bootloader_bin;
-        bins->boot.size = ESP32_S2_bootloader_bin_size;
-        bins->boot.addr = BOOTLOADER_ADDRESS_V0;
-        bins->part.data = ESP32_S2_partition_table_bin;
-        bins->part.size = ESP32_S2_partition_table_bin_size;
-        bins->part.addr = PARTITION_ADDRESS;
-        bins->app.data  = ESP32_S2_hello_world_bin;
-        bins->app.size  = ESP32_S2_hello_world_bin_size;
-        bins->app.addr  = APPLICATION_ADDRESS;
+        bins->boot = BINARY(ESP32_S2_bootloader_bin, BOOTLOADER_ADDRESS_V0);
+        bins->part = BINARY(ESP32_S2_partition_table_bin, PARTITION_ADDRESS);
+        bins->app  = BINARY(ESP32_S2_hello_world_bin, APPLICATION_ADDRESS);
     } else if (target == ESP32H2_CHIP) {
-        bins->boot.data = ESP32_H2_bootloader_bin;
-        bins->boot.size = ESP32_H2_bootloader_bin_size;
-        bins->boot.addr = BOOTLOADER_ADDRESS_V1;
-        bins->part.data = ESP32_H2_partition_table_bin;
-        bins->part.size = ESP32_H2_partition_table_bin_size;
-        bins->part.addr = PARTITION_ADDRESS;
-        bins->app.data  = ESP32_H2_hello_world_bin;
-        bins->app.size  = ESP32_H2_hello_world_bin_size;
-        bins->app.addr  = APPLICATION_ADDRESS;
+        bins->boot = BINARY(ESP32_H2_bootloader_bin, BOOTLOADER_ADDRESS_V1);
+        bins->part = BINARY(ESP32_H2_partition_table_bin, PARTITION_ADDRESS);
+        bins->app  = BINARY(ESP32_H2_hello_world_bin, APPLICATION_ADDRESS);
     } else if (target == ESP32C2_CHIP) {
-        bins->boot.data = ESP32_C2_bootloader_bin;
-        bins->boot.size = ESP32_C2_bootloader_bin_size;
-        bins->boot.addr = BOOTLOADER_ADDRESS_V1;
-        bins->part.data = ESP32_C2_partition_table_bin;
-        bins->part.size = ESP32_C2_partition_table_bin_size;
-        bins->part.addr = PARTITION_ADDRESS;
-        bins->app.data  = ESP32_C2_hello_world_bin;
-        bins->app.size  = ESP32_C2_hello_world_bin_size;
-        bins->app.addr  = APPLICATION_ADDRESS;
+        bins->boot = BINARY(ESP32_C2_bootloader_bin, BOOTLOADER_ADDRESS_V1);
+        bins->part = BINARY(ESP32_C2_partition_table_bin, PARTITION_ADDRESS);
+        bins->app  = BINARY(ESP32_C2_hello_world_bin, APPLICATION_ADDRESS);
     } else if (target == ESP32C3_CHIP) {
-        bins->boot.data = ESP32_C3_bootloader_bin;
-        bins->boot.size = ESP32_C3_bootloader_bin_size;
-        bins->boot.addr = BOOTLOADER_ADDRESS_V1;
-        bins->part.data = ESP32_C3_partition_table_bin;
-        bins->part.size = ESP32_C3_partition_table_bin_size;
-        bins->part.addr = PARTITION_ADDRESS;
-        bins->app.data  = ESP32_C3_hello_world_bin;
-        bins->app.size  = ESP32_C3_hello_world_bin_size;
-        bins->app.addr  = APPLICATION_ADDRESS;
+        bins->boot = BINARY(ESP32_C3_bootloader_bin, BOOTLOADER_ADDRESS_V1);
+        bins->part = BINARY(ESP32_C3_partition_table_bin, PARTITION_ADDRESS);
+        bins->app  = BINARY(ESP32_C3_hello_world_bin, APPLICATION_ADDRESS);
     } else if (target == ESP32C6_CHIP) {
-        bins->boot.data = ESP32_C6_bootloader_bin;
-        bins->boot.size = ESP32_C6_bootloader_bin_size;
-        bins->boot.addr = BOOTLOADER_ADDRESS_V1;
-        bins->part.data = ESP32_C6_partition_table_bin;
-        bins->part.size = ESP32_C6_partition_table_bin_size;
-        bins->part.addr = PARTITION_ADDRESS;
-        bins->app.data  = ESP32_C6_hello_world_bin;
-        bins->app.size  = ESP32_C6_hello_world_bin_size;
-        bins->app.addr  = APPLICATION_ADDRESS;
+        bins->boot = BINARY(ESP32_C6_bootloader_bin, BOOTLOADER_ADDRESS_V1);
+        bins->part = BINARY(ESP32_C6_partition_table_bin, PARTITION_ADDRESS);
+        bins->app  = BINARY(ESP32_C6_hello_world_bin, APPLICATION_ADDRESS);
 
     } else if (target == ESP32S3_CHIP) {
-        bins->boot.data = ESP32_S3_bootloader_bin;
-        bins->boot.size = ESP32_S3_bootloader_bin_size;
-        bins->boot.addr = BOOTLOADER_ADDRESS_V1;
-        bins->part.data = ESP32_S3_partition_table_bin;
-        bins->part.size = ESP32_S3_partition_table_bin_size;
-        bins->part.addr = PARTITION_ADDRESS;
-        bins->app.data  = ESP32_S3_hello_world_bin;
-        bins->app.size  = ESP32_S3_hello_world_bin_size;
-        bins->app.addr  = APPLICATION_ADDRESS;
+        bins->boot = BINARY(ESP32_S3_bootloader_bin, BOOTLOADER_ADDRESS_V1);
+        bins->part = BINARY(ESP32_S3_partition_table_bin, PARTITION_ADDRESS);
+        bins->app  = BINARY(ESP32_S3_hello_world_bin, APPLICATION_ADDRESS);
     } else {
         abort();
     }
@@ -256,6 +252,42 @@ static const char *get_error_string(const esp_loader_error_t error)
     return mapping[error];
 }
 
+#if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
+// The examples open the link to the ROM loader at this rate
+#define INITIAL_TRANSMISSION_RATE 115200
+
+/* Raises the transmission rate step by step up to the highest one given, and stays at the
+   fastest rate that works reliably on the wiring at hand */
+static esp_loader_error_t autotune_transmission_rate(uint32_t current_transmission_rate,
+        uint32_t highest_transmission_rate)
+{
+    static const uint32_t steps[] = { 230400, 460800, 921600, 1500000, 2000000 };
+    uint32_t rates[sizeof(steps) / sizeof(steps[0]) + 1];
+    uint32_t rate_count = 0;
+
+    // esp_loader_autotune_link() takes the candidates in increasing order
+    for (size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        if (steps[i] > current_transmission_rate && steps[i] < highest_transmission_rate) {
+            rates[rate_count++] = steps[i];
+        }
+    }
+    rates[rate_count++] = highest_transmission_rate;
+
+    esp_loader_autotune_result_t result;
+    esp_loader_error_t err = esp_loader_autotune_link(current_transmission_rate, rates, rate_count, &result);
+    if (err == ESP_LOADER_ERROR_UNSUPPORTED_FUNC) {
+        printf("ESP8266 does not support change transmission rate command.");
+        return err;
+    } else if (err != ESP_LOADER_SUCCESS) {
+        printf("Unable to change transmission rate.");
+        return err;
+    }
+    printf("Transmission rate changed to %" PRIu32 ".\n", result.transmission_rate);
+
+    return ESP_LOADER_SUCCESS;
+}
+#endif /* SERIAL_FLASHER_INTERFACE_UART || SERIAL_FLASHER_INTERFACE_USB */
+
 esp_loader_error_t connect_to_target(uint32_t higher_transmission_rate)
 {
     esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
@@ -277,22 +309,8 @@ esp_loader_error_t connect_to_target(uint32_t higher_transmission_rate)
     printf("Connected to target\n");
 
 #if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
-    if (higher_transmission_rate && esp_loader_get_target() != ESP8266_CHIP) {
-        err = esp_loader_change_transmission_rate(higher_transmission_rate);
-        if (err == ESP_LOADER_ERROR_UNSUPPORTED_FUNC) {
-            printf("ESP8266 does not support change transmission rate command.");
-            return err;
-        } else if (err != ESP_LOADER_SUCCESS) {
-            printf("Unable to change transmission rate on target.");
-            return err;
-        } else {
-            err = loader_port_change_transmission_rate(higher_transmission_rate);
-            if (err != ESP_LOADER_SUCCESS) {
-                printf("Unable to change transmission rate.");
-                return err;
-            }
-            printf("Transmission rate changed.\n");
-        }
+    if (higher_transmission_rate > INITIAL_TRANSMISSION_RATE && esp_loader_get_target() != ESP8266_CHIP) {
+        return autotune_transmission_rate(INITIAL_TRANSMISSION_RATE, higher_transmission_rate);
     }
 #endif /* SERIAL_FLASHER_INTERFACE_UART || SERIAL_FLASHER_INTERFACE_USB */
 
@@ -321,24 +339,8 @@ esp_loader_error_t connect_to_target_with_stub(const uint32_t current_transmissi
     }
     printf("Connected to target\n");
 
-    if (higher_transmission_rate != current_transmission_rate) {
-        err = esp_loader_change_transmission_rate_stub(current_transmission_rate,
-                higher_transmission_rate);
-
-        if (err == ESP_LOADER_ERROR_UNSUPPORTED_FUNC) {
-            printf("ESP8266 does not support change transmission rate command.");
-            return err;
-        } else if (err != ESP_LOADER_SUCCESS) {
-            printf("Unable to change transmission rate on target.");
-            return err;
-        } else {
-            err = loader_port_change_transmission_rate(higher_transmission_rate);
-            if (err != ESP_LOADER_SUCCESS) {
-                printf("Unable to change transmission rate.");
-                return err;
-            }
-            printf("Transmission rate changed.\n");
-        }
+    if (higher_transmission_rate > current_transmission_rate) {
+        return autotune_transmission_rate(current_transmission_rate, higher_transmission_rate);
     }
 
     return ESP_LOADER_SUCCESS;
@@ -347,11 +349,11 @@ esp_loader_error_t connect_to_target_with_stub(const uint32_t current_transmissi
 esp_loader_error_t flash_binary(const uint8_t *bin, size_t size, size_t address)
 {
     esp_loader_error_t err;
-    static uint8_t payload[1024];
+    const size_t block_size = 1024;
     const uint8_t *bin_addr = bin;
 
     printf("Erasing flash (this may take a while)...\n");
-    err = esp_loader_flash_start(address, size, sizeof(payload));
+    err = esp_loader_flash_start(address, size, block_size);
     if (err != ESP_LOADER_SUCCESS) {
         printf("Erasing flash failed with error: %s.\n", get_error_string(err));
 
@@ -367,10 +369,10 @@ esp_loader_error_t flash_binary(const uint8_t *bin, size_t size, size_t address)
     size_t written = 0;
 
     while (size > 0) {
-        size_t to_read = MIN(size, sizeof(payload));
-        memcpy(payload, bin_addr, to_read);
+        // The binary is sent straight from where it is stored, without a copy
+        size_t to_read = MIN(size, block_size);
 
-        err = esp_loader_flash_write(payload, to_read);
+        err = esp_loader_flash_write(bin_addr, to_read);
         if (err != ESP_LOADER_SUCCESS) {
             printf("\nPacket could not be written! Error %s.\n", get_error_string(err));
             return err;
@@ -400,6 +402,88 @@ esp_loader_error_t flash_binary(const uint8_t *bin, size_t size, size_t address)
 
     return ESP_LOADER_SUCCESS;
 }
+
+esp_loader_error_t flash_binary_precompressed(const uint8_t *bin, size_t compressed_size,
+        size_t size, const uint8_t *md5, size_t address)
+{
+    esp_loader_error_t err;
+    const size_t chunk_size = 1024;
+
+    printf("Erasing flash (this may take a while)...\n");
+    err = esp_loader_flash_precompressed_start(address, size, compressed_size, md5);
+    if (err != ESP_LOADER_SUCCESS) {
+        printf("Erasing flash failed with error: %s.\n", get_error_string(err));
+        return err;
+    }
+    printf("Start programming\n");
+
+    size_t written = 0;
+
+    // The compressed data is passed on without being copied into an intermediate buffer
+    while (written < compressed_size) {
+        size_t to_write = MIN(compressed_size - written, chunk_size);
+
+        err = esp_loader_flash_precompressed_write(&bin[written], to_write);
+        if (err != ESP_LOADER_SUCCESS) {
+            printf("\nPacket could not be written! Error %s.\n", get_error_string(err));
+            return err;
+        }
+
+        written += to_write;
+
+        int progress = (int)(((float)written / compressed_size) * 100);
+        printf("\rProgress: %d %%", progress);
+    };
+
+    printf("\nFinished programming\n");
+
+#if MD5_ENABLED
+    err = esp_loader_flash_verify();
+    if (err != ESP_LOADER_SUCCESS) {
+        printf("MD5 does not match. Error: %s\n", get_error_string(err));
+        return err;
+    }
+    printf("Flash verified\n");
+#endif
+
+    return ESP_LOADER_SUCCESS;
+}
+
+static esp_loader_error_t read_file(void *context, uint32_t offset, void *buffer, uint32_t size)
+{
+    FILE *file = (FILE *)context;
+
+    if (fseek(file, offset, SEEK_SET) != 0) {
+        return ESP_LOADER_ERROR_FAIL;
+    }
+
+    return fread(buffer, 1, size, file) == size ? ESP_LOADER_SUCCESS : ESP_LOADER_ERROR_FAIL;
+}
+
+esp_loader_error_t flash_binary_from_file(FILE *file, size_t address)
+{
+    if (fseek(file, 0, SEEK_END) != 0) {
+        return ESP_LOADER_ERROR_FAIL;
+    }
+    const long size = ftell(file);
+    if (size < 0) {
+        return ESP_LOADER_ERROR_FAIL;
+    }
+    rewind(file);
+
+    printf("Programming %ld bytes from file...\n", size);
+
+    // Only one block of the file is held in memory at a time
+    esp_loader_error_t err = esp_loader_flash_source(address, size, true, read_file, file);
+    if (err != ESP_LOADER_SUCCESS) {
+        printf("Programming failed with error: %s.\n", get_error_string(err));
+        return err;
+    }
+
+    printf("Finished programming\n");
+
+    return ESP_LOADER_SUCCESS;
+}
 #endif /* SERIAL_FLASHER_INTERFACE_UART || SERIAL_FLASHER_INTERFACE_USB */
 
 esp_loader_error_t load_ram_binary(const uint8_t *bin)
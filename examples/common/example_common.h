@@ -15,6 +15,8 @@
 
 #pragma once
 
+#include <stdio.h>
+
 #define BIN_FIRST_SEGMENT_OFFSET    0x18
 // Maximum block sized for RAM and Flash writes, respectively.
 #define ESP_RAM_BLOCK               0x1800
@@ -23,6 +25,11 @@ typedef struct {
     const uint8_t *data;
     uint32_t size;
     uint32_t addr;
+#ifdef EXAMPLE_COMPRESSED_BINARIES
+    // Set when the binaries are generated by create_compressed_resources()
+    uint32_t compressed_size;
+    const uint8_t *md5;
+#endif
 } partition_attr_t;
 
 typedef struct {
@@ -62,4 +69,7 @@ esp_loader_error_t connect_to_target(uint32_t higher_transmission_rate);
 esp_loader_error_t connect_to_target_with_stub(uint32_t current_transmission_rate,
         uint32_t higher_transmission_rate);
 esp_loader_error_t flash_binary(const uint8_t *bin, size_t size, size_t address);
+esp_loader_error_t flash_binary_precompressed(const uint8_t *bin, size_t compressed_size,
+        size_t size, const uint8_t *md5, size_t address);
+esp_loader_error_t flash_binary_from_file(FILE *file, size_t address);
 esp_loader_error_t load_ram_binary(const uint8_t *bin);
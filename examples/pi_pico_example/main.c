@@ -41,14 +41,23 @@ int main(void)
 
     if (connect_to_target(HIGHER_BAUDRATE) == ESP_LOADER_SUCCESS) {
 
+        // The binaries are compressed at build time, which the ESP8266 ROM cannot inflate
+        if (esp_loader_get_target() == ESP8266_CHIP) {
+            printf("ESP8266 does not support compressed flashing\n");
+            return 0;
+        }
+
         get_example_binaries(esp_loader_get_target(), &bin);
 
         printf("Loading bootloader...");
-        flash_binary(bin.boot.data, bin.boot.size, bin.boot.addr);
+        flash_binary_precompressed(bin.boot.data, bin.boot.compressed_size, bin.boot.size, bin.boot.md5,
+                                   bin.boot.addr);
         printf("Loading partition table...");
-        flash_binary(bin.part.data, bin.part.size, bin.part.addr);
+        flash_binary_precompressed(bin.part.data, bin.part.compressed_size, bin.part.size, bin.part.md5,
+                                   bin.part.addr);
         printf("Loading app...");
-        flash_binary(bin.app.data,  bin.app.size,  bin.app.addr);
+        flash_binary_precompressed(bin.app.data, bin.app.compressed_size, bin.app.size, bin.app.md5,
+                                   bin.app.addr);
         printf("Done!");
 
         esp_loader_reset_target();
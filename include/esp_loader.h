@@ -118,6 +118,51 @@ typedef struct {
   .trials = 10, \
 }
 
+/**
+ * @brief Loader of one target, holding the state of the connection to it and its port
+ */
+typedef struct esp_loader esp_loader_t;
+
+/**
+ * @brief Port functions bound to a loader, declared in esp_loader_io.h
+ */
+typedef struct esp_loader_port esp_loader_port_t;
+
+/**
+  * @brief Creates a loader for another target. Up to SERIAL_FLASHER_MAX_LOADERS targets can be
+  *        driven from one program, including the one of the default loader.
+  *
+  * The functions of this API act on the loader selected by the calling thread, see
+  * esp_loader_select(). The default loader is used until another one is selected.
+  *
+  * @param port[in]         Port functions of the target, NULL to use the loader_port_*() functions.
+  *                         Has to stay valid until the loader is destroyed.
+  * @param port_context[in] Passed to the port functions.
+  *
+  * @return  The new loader, NULL if SERIAL_FLASHER_MAX_LOADERS are in use
+  */
+esp_loader_t *esp_loader_create(const esp_loader_port_t *port, void *port_context);
+
+/**
+  * @brief Destroys a loader created by esp_loader_create().
+  *
+  * @note  The loader must not be selected by any thread.
+  *
+  * @param loader[in] Loader to destroy
+  */
+void esp_loader_destroy(esp_loader_t *loader);
+
+/**
+  * @brief Selects the loader the functions of this API act on when called from this thread.
+  *
+  * With SERIAL_FLASHER_MAX_LOADERS above 1 the selection is kept per thread, so each target
+  * can be flashed from a thread of its own. A loader must only be selected by one thread at
+  * a time.
+  *
+  * @param loader[in] Loader to select, NULL for the default loader
+  */
+void esp_loader_select(esp_loader_t *loader);
+
 /**
   * @brief Connects to the target
   *
@@ -202,16 +247,16 @@ esp_loader_error_t esp_loader_flash_start(uint32_t offset, uint32_t image_size,
   * @param size[in]         Size of payload in bytes.
   *
   * @note  size must not be greater that block_size supplied to previously called
-  *        esp_loader_flash_start function. If size is less than block_size,
-  *        remaining bytes of payload buffer will be padded with 0xff.
-  *        Therefore, size of payload buffer has to be equal or greater than block_size.
+  *        esp_loader_flash_start function. If size is less than block_size, the block
+  *        is padded with 0xff as it is sent. The payload is not modified, so it can be
+  *        read straight from read-only memory and only has to hold size bytes.
   *
   * @return
   *     - ESP_LOADER_SUCCESS Success
   *     - ESP_LOADER_ERROR_TIMEOUT Timeout
   *     - ESP_LOADER_ERROR_INVALID_RESPONSE Internal error
   */
-esp_loader_error_t esp_loader_flash_write(void *payload, uint32_t size);
+esp_loader_error_t esp_loader_flash_write(const void *payload, uint32_t size);
 
 /**
   * @brief Ends flash operation.
@@ -225,6 +270,364 @@ esp_loader_error_t esp_loader_flash_write(void *payload, uint32_t size);
   */
 esp_loader_error_t esp_loader_flash_finish(bool reboot);
 
+/**
+ * @brief Buffered flash writer state, to be treated as opaque apart from block_size
+ */
+typedef struct {
+    uint8_t *buffer;     /*!< Buffer passed to esp_loader_flash_writer_start() */
+    uint32_t block_size; /*!< Size of the blocks sent to the target */
+    uint32_t buffered;   /*!< Bytes waiting in the buffer for the block to fill up */
+    uint32_t remaining;  /*!< Image bytes still to be appended */
+} esp_loader_flash_writer_t;
+
+/**
+  * @brief Initiates a flash operation fed by esp_loader_flash_writer_append()
+  *
+  * The block size is chosen for the loader running on the target, 16 KB for the stub
+  * and 1 KB for the ROM, limited by the size of the buffer.
+  *
+  * @param writer[out]     Writer state.
+  * @param offset[in]      Address of the image in flash. Must be 4 byte aligned.
+  * @param image_size[in]  Size of the whole image. It is padded with 0xff to a multiple of 4 bytes.
+  * @param buffer[in]      Buffer for data that does not make up a whole block yet. It has to
+  *                        stay valid until the whole image has been appended.
+  * @param buffer_size[in] Size of the buffer, at least 4 bytes.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_TIMEOUT Timeout
+  *     - ESP_LOADER_ERROR_INVALID_PARAM Invalid offset, size or buffer
+  *     - ESP_LOADER_ERROR_INVALID_RESPONSE Internal error
+  */
+esp_loader_error_t esp_loader_flash_writer_start(esp_loader_flash_writer_t *writer, uint32_t offset,
+        uint32_t image_size, void *buffer, uint32_t buffer_size);
+
+/**
+  * @brief Appends data of any size to the image being written
+  *
+  * Data is sent in whole blocks, straight from the caller where a whole block is appended at
+  * once and through the writer's buffer otherwise. Only the last block of the image is padded,
+  * it is sent as soon as the last byte of the image has been appended. The image can then be
+  * checked with esp_loader_flash_verify() and the operation ended with esp_loader_flash_finish().
+  *
+  * @param writer[inout] Writer state.
+  * @param data[in]      Data to append.
+  * @param size[in]      Size of the data, any size up to the rest of the image.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_TIMEOUT Timeout
+  *     - ESP_LOADER_ERROR_INVALID_PARAM More data than the rest of the image
+  *     - ESP_LOADER_ERROR_INVALID_RESPONSE Internal error
+  */
+esp_loader_error_t esp_loader_flash_writer_append(esp_loader_flash_writer_t *writer, const void *data,
+        uint32_t size);
+
+/**
+ * @brief Selects the compression level based on the measured link and host speed
+ */
+#define ESP_LOADER_DEFLATE_LEVEL_AUTO (-1)
+
+/**
+ * @brief Compressed flashing statistics
+ */
+typedef struct {
+    uint32_t uncompressed_size;    /*!< Image bytes passed to the encoder, including padding */
+    uint32_t compressed_size;      /*!< Compressed bytes sent to the target */
+    uint32_t compress_time_ms;     /*!< Time spent compressing on the host */
+    uint32_t transfer_time_ms;     /*!< Time spent sending packets and waiting for the target */
+    uint32_t total_time_ms;        /*!< Time elapsed since esp_loader_flash_deflate_start() */
+    uint32_t effective_throughput; /*!< Uncompressed bytes flashed per second */
+    float compression_ratio;       /*!< Compressed size divided by uncompressed size */
+    int32_t level;                 /*!< Compression level currently in use, -1 for pre-compressed images */
+} esp_loader_flash_deflate_stats_t;
+
+/**
+ * @brief Region size suggested for esp_loader_flash_delta(), one flash block
+ */
+#define ESP_LOADER_FLASH_DELTA_REGION_SIZE (64 * 1024)
+
+/**
+ * @brief Delta flashing statistics
+ */
+typedef struct {
+    uint32_t regions;         /*!< Regions the image was split into */
+    uint32_t regions_written; /*!< Regions that differed from the flash contents and were written */
+    uint32_t bytes_skipped;   /*!< Image bytes that were already on the target */
+    uint32_t bytes_written;   /*!< Image bytes that were written */
+    uint32_t compare_time_ms; /*!< Time spent comparing the digests of regions */
+    uint32_t write_time_ms;   /*!< Time spent writing regions and checking them afterwards */
+    uint32_t total_time_ms;   /*!< Time taken by esp_loader_flash_delta() */
+    uint32_t time_saved_ms;   /*!< Estimated time writing the skipped regions would have taken,
+                                   at the rate the written ones took. 0 if none was written. */
+} esp_loader_flash_delta_stats_t;
+
+/**
+ * @brief Reads a part of an image written with esp_loader_flash_source()
+ *
+ * @param context[in] Context passed to esp_loader_flash_source()
+ * @param offset[in]  Offset of the data within the image
+ * @param buffer[out] Buffer to fill
+ * @param size[in]    Number of bytes to read, all of them have to be read
+ *
+ * @return ESP_LOADER_SUCCESS, or an error to abort the write with
+ */
+typedef esp_loader_error_t (*esp_loader_read_cb_t)(void *context, uint32_t offset, void *buffer, uint32_t size);
+
+/**
+ * @brief Image written by esp_loader_flash_images()
+ */
+typedef struct {
+    uint32_t offset;          /*!< Address of the image in flash, 4 byte aligned */
+    const void *data;         /*!< The whole image */
+    uint32_t size;            /*!< Size of the image. It is padded with 0xff to a multiple of 4 bytes. */
+    uint32_t write_time_ms;   /*!< Set to the time taken to write the image */
+    uint32_t verify_time_ms;  /*!< Set to the time taken to verify the image */
+} esp_loader_flash_image_t;
+
+/**
+ * @brief Statistics of a esp_loader_flash_images() session
+ */
+typedef struct {
+    uint32_t erase_ranges;    /*!< Erase commands sent, 0 if each image was erased as it was written */
+    uint32_t bytes_erased;    /*!< Flash erased by those commands */
+    uint32_t bytes_written;   /*!< Image bytes written */
+    uint32_t erase_time_ms;   /*!< Time spent erasing ahead of writing */
+    uint32_t write_time_ms;   /*!< Time spent writing all of the images */
+    uint32_t verify_time_ms;  /*!< Time spent verifying all of the images */
+    uint32_t total_time_ms;   /*!< Time taken by esp_loader_flash_images() */
+} esp_loader_flash_images_stats_t;
+
+/**
+  * @brief Initiates compressed flash operation
+  *
+  * Data passed to esp_loader_flash_deflate_write() is compressed on the fly and decompressed
+  * by the target, which considerably reduces the amount of data transferred for typical
+  * application images.
+  *
+  * @param offset[in]     Address from which flash operation will be performed. Must be 4 byte aligned.
+  * @param image_size[in] Uncompressed size of the whole binary to be loaded into flash.
+  *                       It is padded with 0xff to a multiple of 4 bytes.
+  * @param level[in]      Compression level from 0 (no compression) to 9 (best compression),
+  *                       or ESP_LOADER_DEFLATE_LEVEL_AUTO to adjust it while flashing.
+  *
+  * @note  Memory used by the encoder is set by SERIAL_FLASHER_DEFLATE_WINDOW_BITS.
+  *        Automatic level selection requires loader_port_get_time_ms() to be implemented.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_TIMEOUT Timeout
+  *     - ESP_LOADER_ERROR_INVALID_PARAM Invalid offset, size or level
+  *     - ESP_LOADER_ERROR_INVALID_RESPONSE Internal error
+  *     - ESP_LOADER_ERROR_UNSUPPORTED_FUNC The ESP8266 ROM does not support compressed flashing
+  */
+esp_loader_error_t esp_loader_flash_deflate_start(uint32_t offset, uint32_t image_size, int32_t level);
+
+/**
+  * @brief Compresses supplied data and writes it to target's flash memory.
+  *
+  * @param payload[in]      Uncompressed data to be flashed into target's memory.
+  * @param size[in]         Size of payload in bytes, can be arbitrary.
+  *
+  * @note  Compressed data is sent whenever a packet fills up, so a call may not send anything.
+  *        The stream is completed by the call supplying the last byte of the image.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_TIMEOUT Timeout
+  *     - ESP_LOADER_ERROR_INVALID_PARAM More data than image_size supplied
+  *     - ESP_LOADER_ERROR_INVALID_RESPONSE Internal error
+  */
+esp_loader_error_t esp_loader_flash_deflate_write(const void *payload, uint32_t size);
+
+/**
+  * @brief Initiates flash operation of an image compressed at build time
+  *
+  * The compressed data passed to esp_loader_flash_precompressed_write() is forwarded to the
+  * target as is, the host neither inflates nor recompresses it.
+  *
+  * @param offset[in]          Address from which flash operation will be performed. Must be 4 byte aligned.
+  * @param image_size[in]      Uncompressed size of the image. Must be 4 byte aligned.
+  * @param compressed_size[in] Size of the zlib stream holding the image.
+  * @param image_md5[in]       16 byte MD5 digest of the uncompressed image, used by
+  *                            esp_loader_flash_verify(). Can be NULL if MD5_ENABLED is not set.
+  *
+  * @note  examples/common/bin2array.cmake provides create_compressed_resources(), which
+  *        generates all of the parameters from binary files at build time.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_TIMEOUT Timeout
+  *     - ESP_LOADER_ERROR_INVALID_PARAM Invalid offset, size or digest
+  *     - ESP_LOADER_ERROR_INVALID_RESPONSE Internal error
+  *     - ESP_LOADER_ERROR_UNSUPPORTED_FUNC The ESP8266 ROM does not support compressed flashing
+  */
+esp_loader_error_t esp_loader_flash_precompressed_start(uint32_t offset, uint32_t image_size,
+        uint32_t compressed_size, const uint8_t *image_md5);
+
+/**
+  * @brief Writes a part of the pre-compressed image to target's flash memory.
+  *
+  * @param payload[in]      zlib stream data, does not need to stay valid after the call.
+  * @param size[in]         Size of payload in bytes, can be arbitrary.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_TIMEOUT Timeout
+  *     - ESP_LOADER_ERROR_INVALID_PARAM More data than compressed_size supplied
+  *     - ESP_LOADER_ERROR_INVALID_RESPONSE Internal error
+  */
+esp_loader_error_t esp_loader_flash_precompressed_write(const void *payload, uint32_t size);
+
+/**
+  * @brief Ends compressed flash operation.
+  *
+  * @note  Also ends flash operations started by esp_loader_flash_precompressed_start().
+  *
+  * @param reboot[in]       reboot the target if true.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_TIMEOUT Timeout
+  *     - ESP_LOADER_ERROR_INVALID_PARAM Not all image data has been written yet
+  *     - ESP_LOADER_ERROR_INVALID_RESPONSE Internal error
+  */
+esp_loader_error_t esp_loader_flash_deflate_finish(bool reboot);
+
+/**
+  * @brief Returns statistics of the last compressed flash operation.
+  *
+  * @param stats[out] Achieved compression ratio, throughput and timings.
+  */
+void esp_loader_flash_deflate_get_stats(esp_loader_flash_deflate_stats_t *stats);
+
+/**
+  * @brief Writes an image pulled block by block from a source
+  *
+  * The image is read into a 1 KB buffer owned by the library, one block at a time, so that
+  * it does not have to be held in memory. Compressed, blocks are passed through the encoder
+  * like with esp_loader_flash_deflate_write(). Uncompressed, each block is sent as it is from
+  * the buffer the callback filled, like with esp_loader_flash_write(), which saves the copy
+  * into the encoder window and its CPU time where the link is fast or the image does not
+  * compress. The ESP8266 ROM only takes uncompressed blocks.
+  * With MD5_ENABLED the image is verified once written either way, apart from on the
+  * ESP8266 ROM, which does not support the command.
+  *
+  * @param offset[in]     Address of the image in flash. Must be 4 byte aligned.
+  * @param image_size[in] Size of the image. It is padded with 0xff to a multiple of 4 bytes.
+  * @param compress[in]   Whether to compress the blocks. Ignored by the ESP8266 ROM.
+  * @param read[in]       Called in order for every block of the image.
+  * @param context[in]    Passed to the read callback.
+  *
+  * @note  No separate flash operation has to be started or ended. With the flasher stub the
+  *        flash operation is ended once the image is written, the ROM loaders are left in it
+  *        as ending it would make them run the application. The target stays in the loader
+  *        until it is reset with esp_loader_reset_target().
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_TIMEOUT Timeout
+  *     - ESP_LOADER_ERROR_INVALID_PARAM Invalid offset, size or callback
+  *     - ESP_LOADER_ERROR_INVALID_MD5 The written image does not match
+  *     - ESP_LOADER_ERROR_INVALID_RESPONSE Internal error
+  *     - Any error returned by the read callback, which stops the write
+  */
+esp_loader_error_t esp_loader_flash_source(uint32_t offset, uint32_t image_size, bool compress,
+        esp_loader_read_cb_t read, void *context);
+
+/**
+  * @brief Writes only the parts of an image that differ from the target's flash contents
+  *
+  * The image is split into regions. The target hashes each region of its flash and only the
+  * regions whose MD5 differs from that of the image are erased and written, compressed like
+  * with esp_loader_flash_deflate_write(). Written regions are hashed again to verify them.
+  *
+  * @param offset[in]      Address of the image in flash. Must be 4096 byte aligned.
+  * @param image[in]       The whole image.
+  * @param image_size[in]  Size of the image. It is padded with 0xff to a multiple of 4 bytes.
+  * @param region_size[in] Size of the regions compared, a multiple of 4096 bytes, for example
+  *                        ESP_LOADER_FLASH_DELTA_REGION_SIZE. Smaller regions skip more data,
+  *                        but cost a round trip each.
+  * @param stats[out]      Regions and bytes skipped, timings and the estimated time saved.
+  *
+  * @note  No separate flash operation has to be started or ended. The target stays in the
+  *        loader until it is reset with esp_loader_reset_target().
+  *        Timings require loader_port_get_time_ms() to be implemented.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_TIMEOUT Timeout
+  *     - ESP_LOADER_ERROR_INVALID_PARAM Invalid offset, size or region size
+  *     - ESP_LOADER_ERROR_INVALID_MD5 A written region does not match the image
+  *     - ESP_LOADER_ERROR_INVALID_RESPONSE Internal error
+  *     - ESP_LOADER_ERROR_UNSUPPORTED_FUNC The ESP8266 ROM supports neither MD5 nor compressed flashing
+  */
+esp_loader_error_t esp_loader_flash_delta(uint32_t offset, const void *image, uint32_t image_size,
+        uint32_t region_size, esp_loader_flash_delta_stats_t *stats);
+
+/**
+  * @brief Writes several images in one session
+  *
+  * All images are validated before anything is written. With the stub running, or on the ESP32,
+  * the sectors they cover are erased up front, with one command for each run of adjacent sectors.
+  * The images are then written in address order, compressed like with
+  * esp_loader_flash_deflate_write(), and finally all of them are verified by their MD5.
+  *
+  * @param images[inout] Images to write, in any order. They must not overlap. Where the
+  *                      target erases each image as it is written, they must not share
+  *                      a 4096 byte sector either. Write and verify times are set on return.
+  * @param count[in]     Number of images.
+  * @param stats[out]    Erase ranges, bytes and timings of the whole session.
+  *
+  * @note  Flash between the images is not erased. No separate flash operation has to be started
+  *        or ended. Timings require loader_port_get_time_ms() to be implemented.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_TIMEOUT Timeout
+  *     - ESP_LOADER_ERROR_INVALID_PARAM Invalid, overlapping or sector sharing images
+  *     - ESP_LOADER_ERROR_IMAGE_SIZE An image does not fit into the detected flash
+  *     - ESP_LOADER_ERROR_INVALID_MD5 A written image does not match
+  *     - ESP_LOADER_ERROR_INVALID_RESPONSE Internal error
+  *     - ESP_LOADER_ERROR_UNSUPPORTED_FUNC The ESP8266 ROM supports neither MD5 nor compressed flashing
+  */
+esp_loader_error_t esp_loader_flash_images(esp_loader_flash_image_t *images, uint32_t count,
+        esp_loader_flash_images_stats_t *stats);
+
+/**
+  * @brief Erases the whole flash chip of the target
+  *
+  * Erasing the chip at once is much faster than erasing it sector by sector. Images flashed
+  * afterwards into flash that has not been written since are not erased again.
+  *
+  * @note  Requires the flasher stub, or the ESP32 ROM loader. The timeout is derived from the
+  *        flash size, assuming 16 MB if it has not been detected.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_TIMEOUT Timeout
+  *     - ESP_LOADER_ERROR_INVALID_RESPONSE Internal error
+  *     - ESP_LOADER_ERROR_UNSUPPORTED_FUNC Unsupported by the ROM loader of the target
+  */
+esp_loader_error_t esp_loader_erase_chip(void);
+
+/**
+  * @brief Erases a region of the target flash
+  *
+  * @param offset[in] Start address of the region. Must be 4096 byte aligned.
+  * @param size[in]   Size of the region. Must be a multiple of 4096 bytes.
+  *
+  * @note  Requires the flasher stub, or the ESP32 ROM loader.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_TIMEOUT Timeout
+  *     - ESP_LOADER_ERROR_INVALID_PARAM Unaligned offset or size
+  *     - ESP_LOADER_ERROR_INVALID_RESPONSE Internal error
+  *     - ESP_LOADER_ERROR_UNSUPPORTED_FUNC Unsupported by the ROM loader of the target
+  */
+esp_loader_error_t esp_loader_erase_region(uint32_t offset, uint32_t size);
+
 /**
   * @brief Detects the size of the flash chip used by target
   *
@@ -253,6 +656,22 @@ esp_loader_error_t esp_loader_flash_detect_size(uint32_t *flash_size);
   */
 esp_loader_error_t esp_loader_flash_read(uint8_t *buf, uint32_t address, uint32_t length);
 
+/**
+  * @brief Configures the packet size and window used by esp_loader_flash_read() with the stub.
+  *
+  * @param packet_size[in] Packet size in bytes, a multiple of 4 no larger than
+  *                        SERIAL_FLASHER_READ_PACKET_SIZE.
+  * @param max_inflight[in] Number of packets the stub may send before waiting for an acknowledgement.
+  *
+  * @note The defaults are SERIAL_FLASHER_READ_PACKET_SIZE and SERIAL_FLASHER_READ_MAX_INFLIGHT.
+  *       The receive buffer of the port should be able to hold packet_size * max_inflight bytes.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_INVALID_PARAM Invalid packet size or window
+  */
+esp_loader_error_t esp_loader_flash_read_set_window(uint32_t packet_size, uint32_t max_inflight);
+
 /**
   * @brief Change baud rate of the stub running on the target
   *
@@ -286,6 +705,30 @@ esp_loader_error_t esp_loader_change_transmission_rate_stub(uint32_t old_transmi
   *     - ESP_LOADER_ERROR_UNSUPPORTED_FUNC The target chip does not support this command.
   */
 esp_loader_error_t esp_loader_get_security_info(esp_loader_target_security_info_t *security_info);
+
+/**
+ * @brief Transfer counters of the serial transport
+ */
+typedef struct {
+    uint32_t frames_sent;     /*!< SLIP frames sent to the target */
+    uint32_t port_writes;     /*!< loader_port_write() calls */
+    uint32_t bytes_written;   /*!< Bytes written to the port, including framing and escaping */
+    uint32_t frames_received; /*!< SLIP frames received from the target */
+    uint32_t port_reads;      /*!< loader_port_read_some() calls */
+    uint32_t bytes_read;      /*!< Bytes read from the port */
+} esp_loader_transfer_stats_t;
+
+/**
+  * @brief Returns the transfer counters accumulated since the last reset.
+  *
+  * @param stats[out] Transfer counters
+  */
+void esp_loader_get_transfer_stats(esp_loader_transfer_stats_t *stats);
+
+/**
+  * @brief Resets the transfer counters.
+  */
+void esp_loader_reset_transfer_stats(void);
 #endif /* SERIAL_FLASHER_INTERFACE_UART || SERIAL_FLASHER_INTERFACE_USB */
 
 
@@ -399,12 +842,84 @@ esp_loader_error_t esp_loader_read_register(uint32_t address, uint32_t *reg_valu
   *       mode or the stub is running on the target.
   */
 esp_loader_error_t esp_loader_change_transmission_rate(uint32_t transmission_rate);
+
+/**
+ * @brief Link autotuning result
+ */
+typedef struct {
+    uint32_t transmission_rate;    /*!< Rate the link was left at */
+    uint32_t effective_throughput; /*!< Payload bytes per second of the probe at that rate,
+                                        0 if loader_port_get_time_ms() is not implemented */
+    uint32_t rates_tried;          /*!< Candidate rates the link was switched to */
+    uint32_t rates_failed;         /*!< Candidate rates that failed and were fallen back from */
+} esp_loader_autotune_result_t;
+
+/**
+  * @brief Switches the link to the fastest of the candidate rates that works reliably
+  *
+  * Starting from the current rate, the link is switched to each higher candidate in turn and
+  * probed with timed round trips whose responses have to match those received at the rate
+  * before. With the UART and USB interfaces the probe reads the first kilobyte of flash
+  * and the rate is changed on the target too, with the stub if it is running. With SPI only
+  * the host side clock is changed. On the first failure the link falls back to the last rate
+  * that worked, it also stays there if a higher rate does not raise the measured throughput.
+  *
+  * @param current_rate[in] Rate the link currently runs at.
+  * @param rates[in]        Candidate rates in strictly increasing order, as the search stops at
+  *                         the first one that fails. Those not above current_rate are skipped.
+  * @param rate_count[in]   Number of candidate rates, at least one.
+  * @param result[out]      The rate chosen and the throughput measured at it.
+  *
+  * @note  The throughput comparison requires loader_port_get_time_ms() to be implemented.
+  *        Probing reads the flash, which is not possible in secure download mode.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success, the link runs at result->transmission_rate
+  *     - ESP_LOADER_ERROR_TIMEOUT Timeout, the link could not be restored after a failed rate
+  *     - ESP_LOADER_ERROR_INVALID_PARAM No candidates, or not in strictly increasing order
+  *     - ESP_LOADER_ERROR_INVALID_RESPONSE Internal error
+  *     - ESP_LOADER_ERROR_UNSUPPORTED_FUNC The ESP8266 cannot change the rate
+  */
+esp_loader_error_t esp_loader_autotune_link(uint32_t current_rate, const uint32_t *rates,
+        uint32_t rate_count, esp_loader_autotune_result_t *result);
+
+/**
+ * @brief Service times measured during the session, from which timeouts are derived
+ */
+typedef struct {
+    uint32_t round_trip_ms;    /*!< Time register reads and writes take, 0 until measured */
+    uint32_t erase_ms_per_mb;  /*!< Time erasing takes on top of the round trip, 0 until measured */
+    uint32_t md5_ms_per_mb;    /*!< Time hashing flash takes on top of the round trip, 0 until measured */
+    uint32_t write_ms_per_mb;  /*!< Time sending and writing flash data takes on top of the round trip,
+                                    per MB of the image, 0 until measured */
+    uint32_t write_throughput; /*!< Image bytes written per second, derived from write_ms_per_mb */
+    uint32_t samples;          /*!< Commands measured */
+} esp_loader_timeout_model_t;
+
+/**
+  * @brief Returns the service times measured since connecting or changing the transmission rate.
+  *
+  * With SERIAL_FLASHER_TIMEOUT_MARGIN set, register accesses, erases, flash writes and MD5
+  * checks time out after the expected time multiplied by the margin, instead of after fixed
+  * timeouts. Measurements require loader_port_get_time_ms() to be implemented.
+  *
+  * @param model[out] Service times
+  */
+void esp_loader_get_timeout_model(esp_loader_timeout_model_t *model);
+
+/**
+  * @brief Forgets the measured service times, fixed timeouts apply until they are measured again.
+  *
+  * @note  Done automatically on connecting and on changing the transmission rate.
+  */
+void esp_loader_reset_timeout_model(void);
 #endif /* SERIAL_FLASHER_INTERFACE_SDIO */
 
 /**
   * @brief Verify target's flash integrity by checking MD5.
   *        MD5 checksum is computed from data pushed to target's memory by calling
-  *        esp_loader_flash_write() function and compared against target's MD5.
+  *        esp_loader_flash_write() or esp_loader_flash_deflate_write() function
+  *        and compared against target's MD5.
   *        Target computes checksum based on offset and image_size passed to
   *        esp_loader_flash_start() function.
   *
@@ -0,0 +1,117 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_loader.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Session capture, for the UART and USB interfaces.
+ *
+ * With SERIAL_FLASHER_CAPTURE_BUFFER_SIZE set, the bytes a loader writes to and reads from its
+ * port, the SLIP frames they make up and the port events are recorded into a ring buffer of that
+ * size per loader. The buffer is lock-free with a single writer and a single reader, so another
+ * thread can drain it with esp_loader_capture_read() while the loader is in use, for example to
+ * a file or a debug UART. Records that do not fit are dropped and counted.
+ *
+ * The capture is a stream of little endian fields. It starts with a header:
+ *
+ *     'E' 'S' 'F' 'C'   magic
+ *     uint8_t           ESP_LOADER_CAPTURE_VERSION
+ *     uint8_t           slot of the loader, 0 for the default one
+ *     uint16_t          0
+ *
+ * followed by records of an 8 byte header and size bytes of payload:
+ *
+ *     uint8_t           esp_loader_capture_record_t
+ *     uint8_t           status, depending on the type
+ *     uint16_t          size of the payload
+ *     uint32_t          time of loader_port_get_time_ms() when the record was made
+ */
+
+#define ESP_LOADER_CAPTURE_VERSION      1
+#define ESP_LOADER_CAPTURE_HEADER_SIZE  8
+#define ESP_LOADER_CAPTURE_RECORD_SIZE  8   /*!< Size of a record header */
+#define ESP_LOADER_CAPTURE_FRAME_HEAD   32  /*!< Decoded bytes kept of a frame */
+
+/**
+ * @brief Types of capture records
+ */
+typedef enum {
+    /** Bytes written to the port, the status is the result of the write */
+    ESP_LOADER_CAPTURE_TX = 1,
+    /** Bytes read from the port, the status is the result of the read. A read that failed has
+        the bytes received before the failure, which are none for loader_port_read(). */
+    ESP_LOADER_CAPTURE_RX = 2,
+    /** SLIP frame completed by the bytes written before. The payload is the uint32_t size of
+        the decoded frame followed by up to ESP_LOADER_CAPTURE_FRAME_HEAD of its first bytes.
+        The status is ESP_LOADER_ERROR_INVALID_RESPONSE if the frame has an invalid escape. */
+    ESP_LOADER_CAPTURE_TX_FRAME = 3,
+    /** SLIP frame completed by the bytes read before, like ESP_LOADER_CAPTURE_TX_FRAME */
+    ESP_LOADER_CAPTURE_RX_FRAME = 4,
+    /** Port event, the status is an esp_loader_capture_event_t and the payload a uint32_t */
+    ESP_LOADER_CAPTURE_EVENT = 5,
+    /** Records were dropped before this one, the payload is their uint32_t count */
+    ESP_LOADER_CAPTURE_LOST = 6,
+} esp_loader_capture_record_t;
+
+/**
+ * @brief Port events, recorded as ESP_LOADER_CAPTURE_EVENT
+ */
+typedef enum {
+    ESP_LOADER_CAPTURE_RATE = 1,             /*!< Transmission rate changed to the value */
+    ESP_LOADER_CAPTURE_ENTER_BOOTLOADER = 2, /*!< Target reset into the bootloader */
+    ESP_LOADER_CAPTURE_RESET = 3,            /*!< Target reset into its application */
+} esp_loader_capture_event_t;
+
+/**
+  * @brief Clears the capture buffer of a loader, writes the capture header to it and starts
+  *        recording. Must not be called while the loader is in use by another thread.
+  *
+  * @param loader[in] Loader to capture, NULL for the default loader
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_UNSUPPORTED_FUNC SERIAL_FLASHER_CAPTURE_BUFFER_SIZE is not set
+  */
+esp_loader_error_t esp_loader_capture_start(const esp_loader_t *loader);
+
+/**
+  * @brief Stops recording, what has been recorded can still be read.
+  *
+  * @param loader[in] Loader to stop capturing, NULL for the default loader
+  */
+void esp_loader_capture_stop(const esp_loader_t *loader);
+
+/**
+  * @brief Takes recorded bytes out of the capture buffer of a loader. Can be called from one
+  *        thread while another one uses the loader.
+  *
+  * @param loader[in] Loader whose capture is read, NULL for the default loader
+  * @param buffer[out] Buffer for the capture stream
+  * @param size[in] Size of the buffer
+  *
+  * @return Number of bytes taken, 0 if nothing has been recorded since the last call
+  */
+size_t esp_loader_capture_read(const esp_loader_t *loader, void *buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,137 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_loader.h"
+#include "esp_loader_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESP_LOADER_GANG_MAX_IMAGES  8
+#define ESP_LOADER_GANG_MAX_DEVICES 256
+
+/**
+ * @brief Steps every device goes through, in this order
+ */
+typedef enum {
+    ESP_LOADER_GANG_CONNECT,   /*!< Entering the bootloader, syncing and running the stub */
+    ESP_LOADER_GANG_AUTOTUNE,  /*!< Switching the link to the fastest candidate rate */
+    ESP_LOADER_GANG_WRITE,     /*!< Erasing and writing the images */
+    ESP_LOADER_GANG_VERIFY,    /*!< Checking the MD5 of the written images */
+    ESP_LOADER_GANG_RESET,     /*!< Resetting the target into the new application */
+    ESP_LOADER_GANG_DONE,      /*!< All steps succeeded */
+} esp_loader_gang_step_t;
+
+/**
+ * @brief Images and steps applied to every device of a gang
+ */
+typedef struct {
+    const esp_loader_flash_image_t *images; /*!< Images to write, shared read only by all devices */
+    uint32_t image_count;                   /*!< Number of images, up to ESP_LOADER_GANG_MAX_IMAGES */
+    esp_loader_connect_args_t connect;      /*!< Arguments of the connect step */
+    bool use_stub;                          /*!< Run the flasher stub after connecting */
+    uint32_t transmission_rate;             /*!< Rate the ports are opened at */
+    const uint32_t *rates;                  /*!< Autotune candidates in increasing order, NULL to skip */
+    uint32_t rate_count;                    /*!< Number of autotune candidates */
+    uint32_t attempts;                      /*!< Attempts per device, each one starting over from connecting */
+    uint32_t workers;                       /*!< Devices flashed at the same time, 0 for all of them */
+    bool reset;                             /*!< Reset the devices once they are flashed */
+} esp_loader_gang_config_t;
+
+#define ESP_LOADER_GANG_CONFIG_DEFAULT() { \
+  .connect = ESP_LOADER_CONNECT_DEFAULT(), \
+  .use_stub = true, \
+  .transmission_rate = 115200, \
+  .attempts = 3, \
+  .reset = true, \
+}
+
+/**
+ * @brief Outcome of flashing one device
+ */
+typedef struct {
+    esp_loader_error_t error;       /*!< Error of the last attempt, ESP_LOADER_SUCCESS if it succeeded */
+    esp_loader_gang_step_t step;    /*!< Step the last attempt failed in, ESP_LOADER_GANG_DONE on success */
+    uint32_t attempts;              /*!< Attempts made */
+    uint32_t transmission_rate;     /*!< Rate the images were written at */
+    uint32_t erase_time_ms;         /*!< Erase, write and verify times of the last attempt */
+    uint32_t write_time_ms;
+    uint32_t verify_time_ms;
+    uint32_t total_time_ms;         /*!< Time spent on the device over all attempts */
+} esp_loader_gang_result_t;
+
+/**
+ * @brief Device of a gang, the serial port of one target
+ */
+typedef struct {
+    const char *name;                   /*!< Name for the report, for example the device path */
+    const esp_loader_port_t *port;      /*!< Port functions of the target */
+    void *port_context;                 /*!< Context passed to them */
+    esp_loader_gang_result_t result;    /*!< Set by esp_loader_gang_run() */
+} esp_loader_gang_device_t;
+
+/**
+ * @brief Consolidated report of a gang run
+ */
+typedef struct {
+    uint32_t devices;           /*!< Devices in the gang */
+    uint32_t succeeded;         /*!< Devices flashed and verified */
+    uint32_t failed;            /*!< Devices that failed all of their attempts */
+    uint32_t retries;           /*!< Attempts made after a failed one */
+    uint32_t wall_time_ms;      /*!< Time taken by esp_loader_gang_run() */
+    uint32_t device_time_ms;    /*!< Sum of the device times, what flashing one after another would take */
+} esp_loader_gang_report_t;
+
+/**
+  * @brief Flashes the same images onto many devices at the same time
+  *
+  * The devices form a queue served by worker threads, each of which flashes one device at a time
+  * through a loader of its own, see esp_loader_create(). A device goes through the steps of
+  * esp_loader_gang_step_t. When a step fails, the device goes back to the end of the queue and is
+  * started over from connecting, until it has used up its attempts. A slow or failing device
+  * therefore never holds up the others.
+  *
+  * @param config[in]     Images and steps, the same for every device.
+  * @param devices[inout] Devices to flash, their results are set on return.
+  * @param count[in]      Number of devices, up to ESP_LOADER_GANG_MAX_DEVICES.
+  * @param report[out]    Totals of the run.
+  *
+  * @note  Every worker needs a loader besides the default one, SERIAL_FLASHER_MAX_LOADERS has to
+  *        exceed the number of workers. The ports need get_time_ms for the timings and autotuning.
+  *        Requires POSIX threads.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS All devices were flashed
+  *     - ESP_LOADER_ERROR_FAIL Some devices failed, see their results
+  *     - ESP_LOADER_ERROR_INVALID_PARAM Invalid configuration or device count
+  *     - ESP_LOADER_ERROR_UNSUPPORTED_FUNC The library was built without additional loaders
+  */
+esp_loader_error_t esp_loader_gang_run(const esp_loader_gang_config_t *config,
+                                       esp_loader_gang_device_t *devices, uint32_t count,
+                                       esp_loader_gang_report_t *report);
+
+/**
+  * @brief Returns a printable name of a gang step
+  */
+const char *esp_loader_gang_step_name(esp_loader_gang_step_t step);
+
+#ifdef __cplusplus
+}
+#endif
@@ -25,6 +25,8 @@ extern "C" {
 #ifndef SERIAL_FLASHER_INTERFACE_SDIO
 /**
   * @brief Changes the transmission rate of the used peripheral.
+  *
+  * @note  Weak function returning ESP_LOADER_ERROR_UNSUPPORTED_FUNC is used, otherwise.
   */
 esp_loader_error_t loader_port_change_transmission_rate(uint32_t transmission_rate);
 #endif
@@ -65,6 +67,27 @@ esp_loader_error_t loader_port_read(uint32_t function, uint32_t addr, uint8_t *d
                                     uint16_t size, uint32_t timeout);
 #endif
 
+#if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
+/**
+  * @brief Reads the data that is available from the io interface, waiting for at least one byte.
+  *
+  * @param data[out]     Buffer into which received data will be written.
+  * @param size[in]      Maximum number of bytes to read.
+  * @param timeout[in]   Timeout in milliseconds for the first byte to arrive.
+  * @param received[out] Number of bytes read.
+  *
+  * @note  Weak function reading a single byte with loader_port_read() is used, otherwise.
+  *        Ports with receive buffers or DMA should return everything already received,
+  *        which saves a call and a timer query per byte on the receive path.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_TIMEOUT Timeout elapsed
+  */
+esp_loader_error_t loader_port_read_some(uint8_t *data, uint16_t size, uint32_t timeout,
+                                         uint16_t *received);
+#endif
+
 /**
   * @brief Delay in milliseconds.
   *
@@ -112,6 +135,17 @@ void loader_port_reset_target(void);
   */
 void loader_port_debug_print(const char *str);
 
+/**
+  * @brief Returns a monotonic millisecond timestamp, used to measure transfer performance.
+  *
+  * @note  Weak function returning 0 is used, otherwise. Without a real clock the automatic
+  *        compression level selection keeps its default level and no timing statistics are
+  *        reported.
+  *
+  * @return   Milliseconds elapsed since an arbitrary point in time.
+  */
+uint32_t loader_port_get_time_ms(void);
+
 #ifdef SERIAL_FLASHER_INTERFACE_SPI
 /**
   * @brief Sets the chip select to a defined level
@@ -123,6 +157,41 @@ void loader_port_spi_set_cs(uint32_t level);
 esp_loader_error_t loader_port_sdio_card_init(void);
 #endif /* SERIAL_FLASHER_INTERFACE_SDIO */
 
+/**
+  * @brief Port functions of a loader created by esp_loader_create(). Each one behaves like the
+  *        loader_port_*() function of the same name and gets the port context of the loader.
+  *
+  * @note  read_some, debug_print, get_time_ms and change_transmission_rate can be left NULL,
+  *        the behaviour of the respective weak function is used then.
+  */
+struct esp_loader_port {
+#ifndef SERIAL_FLASHER_INTERFACE_SDIO
+    esp_loader_error_t (*write)(void *context, const uint8_t *data, uint16_t size, uint32_t timeout);
+    esp_loader_error_t (*read)(void *context, uint8_t *data, uint16_t size, uint32_t timeout);
+    esp_loader_error_t (*change_transmission_rate)(void *context, uint32_t transmission_rate);
+#else
+    esp_loader_error_t (*write)(void *context, uint32_t function, uint32_t addr, const uint8_t *data,
+                                uint16_t size, uint32_t timeout);
+    esp_loader_error_t (*read)(void *context, uint32_t function, uint32_t addr, uint8_t *data,
+                               uint16_t size, uint32_t timeout);
+    esp_loader_error_t (*sdio_card_init)(void *context);
+#endif
+#if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
+    esp_loader_error_t (*read_some)(void *context, uint8_t *data, uint16_t size, uint32_t timeout,
+                                    uint16_t *received);
+#endif
+#ifdef SERIAL_FLASHER_INTERFACE_SPI
+    void (*spi_set_cs)(void *context, uint32_t level);
+#endif
+    void (*delay_ms)(void *context, uint32_t ms);
+    void (*start_timer)(void *context, uint32_t ms);
+    uint32_t (*remaining_time)(void *context);
+    void (*enter_bootloader)(void *context);
+    void (*reset_target)(void *context);
+    void (*debug_print)(void *context, const char *str);
+    uint32_t (*get_time_ms)(void *context);
+};
+
 #ifdef __cplusplus
 }
 #endif
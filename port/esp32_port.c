@@ -20,6 +20,7 @@
 #include "esp_log.h"
 #include "esp_idf_version.h"
 #include <unistd.h>
+#include <sys/param.h>
 
 #if SERIAL_FLASHER_DEBUG_TRACE
 static void transfer_debug_print(const uint8_t *data, uint16_t size, bool write)
@@ -138,6 +139,36 @@ esp_loader_error_t loader_port_read(uint8_t *data, uint16_t size, uint32_t timeo
 }
 
 
+esp_loader_error_t loader_port_read_some(uint8_t *data, uint16_t size, uint32_t timeout,
+                                         uint16_t *received)
+{
+    // Wait for the first byte, then take whatever the driver has buffered in the meantime
+    int read = uart_read_bytes(s_uart_port, data, 1, pdMS_TO_TICKS(timeout));
+
+    if (read < 0) {
+        return ESP_LOADER_ERROR_FAIL;
+    } else if (read == 0) {
+        return ESP_LOADER_ERROR_TIMEOUT;
+    }
+
+    size_t buffered = 0;
+    uart_get_buffered_data_len(s_uart_port, &buffered);
+    if (buffered > 0) {
+        read = uart_read_bytes(s_uart_port, &data[1], MIN(buffered, size - 1U), 0);
+        if (read < 0) {
+            return ESP_LOADER_ERROR_FAIL;
+        }
+        read++;
+    }
+
+#if SERIAL_FLASHER_DEBUG_TRACE
+    transfer_debug_print(data, read, false);
+#endif
+    *received = read;
+    return ESP_LOADER_SUCCESS;
+}
+
+
 void loader_port_enter_bootloader(void)
 {
     gpio_set_level(s_gpio0_trigger_pin, SERIAL_FLASHER_BOOT_INVERT ? 1 : 0);
@@ -174,6 +205,12 @@ uint32_t loader_port_remaining_time(void)
 }
 
 
+uint32_t loader_port_get_time_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+
 void loader_port_debug_print(const char *str)
 {
     printf("DEBUG: %s\n", str);
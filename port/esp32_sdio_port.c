@@ -211,6 +211,12 @@ uint32_t loader_port_remaining_time(void)
 }
 
 
+uint32_t loader_port_get_time_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+
 void loader_port_debug_print(const char *str)
 {
     printf("DEBUG: %s\n", str);
@@ -163,6 +163,26 @@ esp_loader_error_t loader_port_read(uint8_t *data, const uint16_t size, const ui
 }
 
 
+esp_loader_error_t loader_port_read_some(uint8_t *data, const uint16_t size, const uint32_t timeout,
+                                         uint16_t *received)
+{
+    assert(data != NULL);
+    assert(s_acm_device != NULL && s_rx_stream_buffer != NULL);
+
+    // Returns as soon as the trigger level of one byte is reached
+    *received = xStreamBufferReceive(s_rx_stream_buffer, data, size, pdMS_TO_TICKS(timeout));
+
+    if (*received == 0) {
+        return ESP_LOADER_ERROR_TIMEOUT;
+    }
+
+#if SERIAL_FLASHER_DEBUG_TRACE
+    transfer_debug_print(data, *received, false);
+#endif
+    return ESP_LOADER_SUCCESS;
+}
+
+
 esp_loader_error_t loader_port_esp32_usb_cdc_acm_init(const loader_esp32_usb_cdc_acm_config_t *config)
 {
     s_acm_host_error_callback = config->acm_host_error_callback;
@@ -273,6 +293,12 @@ uint32_t loader_port_remaining_time(void)
 }
 
 
+uint32_t loader_port_get_time_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+
 void loader_port_debug_print(const char *str)
 {
     printf("DEBUG: %s\n", str);
@@ -0,0 +1,396 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "esp_loader_io.h"
+#include "linux_port.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h> // termios2 and BOTHER, <termios.h> cannot be included along with it
+
+#ifndef SERIAL_FLASHER_RESET_INVERT
+#define SERIAL_FLASHER_RESET_INVERT false
+#endif
+#ifndef SERIAL_FLASHER_BOOT_INVERT
+#define SERIAL_FLASHER_BOOT_INVERT false
+#endif
+
+#if SERIAL_FLASHER_DEBUG_TRACE
+static void transfer_debug_print(const uint8_t *data, uint16_t size, bool write)
+{
+    static bool write_prev = false;
+
+    if (write_prev != write) {
+        write_prev = write;
+        printf("\n--- %s ---\n", write ? "WRITE" : "READ");
+    }
+
+    for (uint32_t i = 0; i < size; i++) {
+        printf("%02x ", data[i]);
+    }
+}
+#endif
+
+static loader_linux_port_t s_port = { .fd = -1 };
+
+
+static uint64_t time_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void delay_ms(uint32_t ms)
+{
+    struct timespec delay = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L };
+    while (nanosleep(&delay, &delay) != 0 && errno == EINTR) {
+    }
+}
+
+// Waits until the port is ready for the events or the deadline passes
+static esp_loader_error_t wait_for(int fd, short events, uint64_t deadline)
+{
+    for (;;) {
+        const uint64_t now = time_ms();
+        if (now >= deadline) {
+            return ESP_LOADER_ERROR_TIMEOUT;
+        }
+
+        struct pollfd request = { .fd = fd, .events = events };
+        const int ready = poll(&request, 1, (int)(deadline - now));
+        if (ready > 0) {
+            // Hang up is reported when the adapter has been unplugged
+            return (request.revents & (POLLERR | POLLHUP | POLLNVAL)) == 0 ? ESP_LOADER_SUCCESS :
+                   ESP_LOADER_ERROR_FAIL;
+        } else if (ready < 0 && errno != EINTR) {
+            return ESP_LOADER_ERROR_FAIL;
+        }
+    }
+}
+
+static esp_loader_error_t set_transmission_rate(int fd, uint32_t baudrate)
+{
+    struct termios2 options;
+
+    if (ioctl(fd, TCGETS2, &options) != 0) {
+        return ESP_LOADER_ERROR_FAIL;
+    }
+
+    // Any rate the adapter can generate, not only the ones with a Bxxx constant
+    options.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+    options.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+    options.c_ispeed = baudrate;
+    options.c_ospeed = baudrate;
+
+    if (ioctl(fd, TCSETS2, &options) != 0) {
+        return ESP_LOADER_ERROR_INVALID_PARAM;
+    }
+
+    return ESP_LOADER_SUCCESS;
+}
+
+/* DTR drives IO0 and RTS drives EN, both active low through the auto reset circuit. They are
+   changed together, as asserting both at once does not reset the target on that circuit. */
+static void set_boot_lines(int fd, bool io0_low, bool en_low)
+{
+    int status;
+
+    // Pseudo-terminals and some USB adapters have no modem lines
+    if (ioctl(fd, TIOCMGET, &status) != 0) {
+        return;
+    }
+
+    if (io0_low != SERIAL_FLASHER_BOOT_INVERT) {
+        status |= TIOCM_DTR;
+    } else {
+        status &= ~TIOCM_DTR;
+    }
+    if (en_low != SERIAL_FLASHER_RESET_INVERT) {
+        status |= TIOCM_RTS;
+    } else {
+        status &= ~TIOCM_RTS;
+    }
+
+    ioctl(fd, TIOCMSET, &status);
+}
+
+
+static esp_loader_error_t linux_write(void *context, const uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    const loader_linux_port_t *port = context;
+    const uint64_t deadline = time_ms() + timeout;
+
+#if SERIAL_FLASHER_DEBUG_TRACE
+    transfer_debug_print(data, size, true);
+#endif
+
+    while (size > 0) {
+        const ssize_t written = write(port->fd, data, size);
+        if (written > 0) {
+            data += written;
+            size -= written;
+        } else if (written < 0 && errno != EAGAIN && errno != EINTR) {
+            return ESP_LOADER_ERROR_FAIL;
+        } else {
+            RETURN_ON_ERROR( wait_for(port->fd, POLLOUT, deadline) );
+        }
+    }
+
+    return ESP_LOADER_SUCCESS;
+}
+
+static esp_loader_error_t read_until(const loader_linux_port_t *port, uint8_t *data, uint16_t size,
+                                     uint64_t deadline, uint16_t *received)
+{
+    for (;;) {
+        const ssize_t read_bytes = read(port->fd, data, size);
+        if (read_bytes > 0) {
+#if SERIAL_FLASHER_DEBUG_TRACE
+            transfer_debug_print(data, read_bytes, false);
+#endif
+            *received = read_bytes;
+            return ESP_LOADER_SUCCESS;
+        } else if (read_bytes < 0 && errno != EAGAIN && errno != EINTR) {
+            return ESP_LOADER_ERROR_FAIL;
+        }
+
+        // With VMIN and VTIME at 0, read() does not wait for data, poll() does
+        RETURN_ON_ERROR( wait_for(port->fd, POLLIN, deadline) );
+    }
+}
+
+static esp_loader_error_t linux_read_some(void *context, uint8_t *data, uint16_t size, uint32_t timeout,
+        uint16_t *received)
+{
+    *received = 0;
+    return read_until(context, data, size, time_ms() + timeout, received);
+}
+
+static esp_loader_error_t linux_read(void *context, uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    const uint64_t deadline = time_ms() + timeout;
+
+    while (size > 0) {
+        uint16_t received;
+        RETURN_ON_ERROR( read_until(context, data, size, deadline, &received) );
+        data += received;
+        size -= received;
+    }
+
+    return ESP_LOADER_SUCCESS;
+}
+
+static esp_loader_error_t linux_change_transmission_rate(void *context, uint32_t baudrate)
+{
+    return set_transmission_rate(((loader_linux_port_t *)context)->fd, baudrate);
+}
+
+static void linux_delay_ms(void *context, uint32_t ms)
+{
+    (void)context;
+    delay_ms(ms);
+}
+
+static void linux_start_timer(void *context, uint32_t ms)
+{
+    ((loader_linux_port_t *)context)->timer_end_ms = time_ms() + ms;
+}
+
+static uint32_t linux_remaining_time(void *context)
+{
+    const uint64_t timer_end = ((loader_linux_port_t *)context)->timer_end_ms;
+    const uint64_t now = time_ms();
+    return timer_end > now ? (uint32_t)(timer_end - now) : 0;
+}
+
+static void linux_reset_target(void *context)
+{
+    const loader_linux_port_t *port = context;
+
+    set_boot_lines(port->fd, false, true);
+    delay_ms(SERIAL_FLASHER_RESET_HOLD_TIME_MS);
+    set_boot_lines(port->fd, false, false);
+}
+
+// Releases EN while IO0 is held low, then drops what the target printed while resetting
+static void linux_enter_bootloader(void *context)
+{
+    const loader_linux_port_t *port = context;
+
+    set_boot_lines(port->fd, false, true);
+    delay_ms(SERIAL_FLASHER_RESET_HOLD_TIME_MS);
+    set_boot_lines(port->fd, true, false);
+    delay_ms(SERIAL_FLASHER_BOOT_HOLD_TIME_MS);
+    set_boot_lines(port->fd, false, false);
+    ioctl(port->fd, TCFLSH, TCIFLUSH);
+}
+
+static void linux_debug_print(void *context, const char *str)
+{
+    (void)context;
+    printf("DEBUG: %s\n", str);
+}
+
+static uint32_t linux_get_time_ms(void *context)
+{
+    (void)context;
+    return (uint32_t)time_ms();
+}
+
+const esp_loader_port_t loader_port_linux = {
+    .write = linux_write,
+    .read = linux_read,
+    .change_transmission_rate = linux_change_transmission_rate,
+    .read_some = linux_read_some,
+    .delay_ms = linux_delay_ms,
+    .start_timer = linux_start_timer,
+    .remaining_time = linux_remaining_time,
+    .enter_bootloader = linux_enter_bootloader,
+    .reset_target = linux_reset_target,
+    .debug_print = linux_debug_print,
+    .get_time_ms = linux_get_time_ms,
+};
+
+
+esp_loader_error_t loader_port_linux_open(loader_linux_port_t *port, const loader_linux_config_t *config)
+{
+    port->timer_end_ms = 0;
+    port->fd = open(config->device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (port->fd < 0) {
+        printf("Serial port %s could not be opened!\n", config->device);
+        return ESP_LOADER_ERROR_FAIL;
+    }
+
+    struct termios2 options;
+    if (ioctl(port->fd, TCGETS2, &options) != 0) {
+        printf("%s is not a serial port!\n", config->device);
+        loader_port_linux_close(port);
+        return ESP_LOADER_ERROR_FAIL;
+    }
+
+    // Raw 8N1 without flow control, reads return what is available
+    options.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF | IXANY);
+    options.c_oflag &= ~OPOST;
+    options.c_lflag &= ~(ECHO | ECHOE | ECHONL | ICANON | ISIG | IEXTEN);
+    options.c_cflag &= ~(CSIZE | PARENB | CSTOPB | CRTSCTS);
+    options.c_cflag |= CS8 | CLOCAL | CREAD;
+    options.c_cc[VMIN] = 0;
+    options.c_cc[VTIME] = 0;
+    ioctl(port->fd, TCSETS2, &options);
+
+    if (set_transmission_rate(port->fd, config->baudrate) != ESP_LOADER_SUCCESS) {
+        printf("Invalid baudrate!\n");
+        loader_port_linux_close(port);
+        return ESP_LOADER_ERROR_INVALID_PARAM;
+    }
+
+    // Keep other programs from interfering, and the target out of reset
+    ioctl(port->fd, TIOCEXCL);
+    set_boot_lines(port->fd, false, false);
+    ioctl(port->fd, TCFLSH, TCIOFLUSH);
+
+    return ESP_LOADER_SUCCESS;
+}
+
+void loader_port_linux_close(loader_linux_port_t *port)
+{
+    if (port->fd >= 0) {
+        close(port->fd);
+        port->fd = -1;
+    }
+}
+
+
+esp_loader_error_t loader_port_linux_init(const loader_linux_config_t *config)
+{
+    return loader_port_linux_open(&s_port, config);
+}
+
+void loader_port_deinit(void)
+{
+    loader_port_linux_close(&s_port);
+}
+
+esp_loader_error_t loader_port_write(const uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    return linux_write(&s_port, data, size, timeout);
+}
+
+
+esp_loader_error_t loader_port_read(uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    return linux_read(&s_port, data, size, timeout);
+}
+
+
+esp_loader_error_t loader_port_read_some(uint8_t *data, uint16_t size, uint32_t timeout,
+                                         uint16_t *received)
+{
+    return linux_read_some(&s_port, data, size, timeout, received);
+}
+
+
+void loader_port_enter_bootloader(void)
+{
+    linux_enter_bootloader(&s_port);
+}
+
+
+void loader_port_reset_target(void)
+{
+    linux_reset_target(&s_port);
+}
+
+
+void loader_port_delay_ms(uint32_t ms)
+{
+    delay_ms(ms);
+}
+
+
+void loader_port_start_timer(uint32_t ms)
+{
+    linux_start_timer(&s_port, ms);
+}
+
+
+uint32_t loader_port_remaining_time(void)
+{
+    return linux_remaining_time(&s_port);
+}
+
+
+uint32_t loader_port_get_time_ms(void)
+{
+    return (uint32_t)time_ms();
+}
+
+
+void loader_port_debug_print(const char *str)
+{
+    printf("DEBUG: %s\n", str);
+}
+
+esp_loader_error_t loader_port_change_transmission_rate(uint32_t baudrate)
+{
+    return set_transmission_rate(s_port.fd, baudrate);
+}
@@ -0,0 +1,59 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_loader_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    const char *device;     // Serial device, for example /dev/ttyUSB0
+    uint32_t baudrate;      // Any rate supported by the adapter, not only the standard ones
+} loader_linux_config_t;
+
+/* Serial port of one target, the context of loader_port_linux */
+typedef struct {
+    int fd;
+    uint64_t timer_end_ms;
+} loader_linux_port_t;
+
+/**
+  * @brief Port functions for loaders created by esp_loader_create(), with a loader_linux_port_t
+  *        opened by loader_port_linux_open() as the port context.
+  */
+extern const esp_loader_port_t loader_port_linux;
+
+/**
+  * @brief Opens a serial port in raw mode for a target.
+  *
+  * Boot and reset are done through DTR and RTS, wired to IO0 and EN like on the development
+  * boards with an auto reset circuit.
+  */
+esp_loader_error_t loader_port_linux_open(loader_linux_port_t *port, const loader_linux_config_t *config);
+void loader_port_linux_close(loader_linux_port_t *port);
+
+/**
+  * @brief Opens the serial port used by the loader_port_*() functions, that is, by the default loader.
+  */
+esp_loader_error_t loader_port_linux_init(const loader_linux_config_t *config);
+void loader_port_deinit(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -103,6 +103,28 @@ esp_loader_error_t loader_port_read(uint8_t *data, const uint16_t size, const ui
 }
 
 
+esp_loader_error_t loader_port_read_some(uint8_t *data, const uint16_t size, const uint32_t timeout,
+                                         uint16_t *received)
+{
+    if (!uart_is_readable_within_us(s_uart_inst, timeout * 1000)) {
+        return ESP_LOADER_ERROR_TIMEOUT;
+    }
+
+    size_t pos = 0;
+    while (pos < size && uart_is_readable(s_uart_inst)) {
+        data[pos] = uart_getc(s_uart_inst);
+        pos++;
+    }
+
+#if SERIAL_FLASHER_DEBUG_TRACE
+    transfer_debug_print(data, pos, false);
+#endif
+
+    *received = pos;
+    return ESP_LOADER_SUCCESS;
+}
+
+
 esp_loader_error_t loader_port_pi_pico_init(const loader_pi_pico_config_t *config)
 {
     if (!config->dont_initialize_peripheral) {
@@ -184,6 +206,12 @@ uint32_t loader_port_remaining_time(void)
 }
 
 
+uint32_t loader_port_get_time_ms(void)
+{
+    return to_ms_since_boot(get_absolute_time());
+}
+
+
 void loader_port_debug_print(const char *str)
 {
     printf("DEBUG: %s", str);
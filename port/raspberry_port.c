@@ -50,11 +50,21 @@ static void transfer_debug_print(const uint8_t *data, uint16_t size, bool write)
 #endif
 
 static int serial;
-static int64_t s_time_end;
+static uint32_t s_vtime;
+static uint64_t s_time_end;
 static int32_t s_reset_trigger_pin;
 static int32_t s_gpio0_trigger_pin;
 
 
+// Wall time, clock() would only count the CPU time of the process
+static uint64_t time_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+
 static speed_t convert_baudrate(int baud)
 {
     switch (baud) {
@@ -130,6 +140,7 @@ static int serialOpen (const char *device, uint32_t baudrate)
     options.c_cc [VTIME] = 10 ; // 1 Second
 
     tcsetattr (fd, TCSANOW, &options) ;
+    s_vtime = 10;
 
     ioctl (fd, TIOCMGET, &status);
 
@@ -168,7 +179,13 @@ static void set_timeout(uint32_t timeout)
     struct termios options;
 
     timeout /= 100;
-    timeout = MAX(timeout, 1);
+    timeout = MIN(MAX(timeout, 1), 255);
+
+    // Reconfiguring the terminal is a system call, skip it when nothing changes
+    if (timeout == s_vtime) {
+        return;
+    }
+    s_vtime = timeout;
 
     tcgetattr(serial, &options);
     options.c_cc[VTIME] = timeout;
@@ -259,6 +276,28 @@ esp_loader_error_t loader_port_read(uint8_t *data, uint16_t size, uint32_t timeo
 }
 
 
+esp_loader_error_t loader_port_read_some(uint8_t *data, uint16_t size, uint32_t timeout,
+                                         uint16_t *received)
+{
+    // With VMIN set to 0, read() returns what is available once the first byte arrives
+    set_timeout(timeout);
+    int read_bytes = read(serial, data, size);
+
+    if (read_bytes == 0) {
+        return ESP_LOADER_ERROR_TIMEOUT;
+    } else if (read_bytes < 0) {
+        return ESP_LOADER_ERROR_FAIL;
+    }
+
+#if SERIAL_FLASHER_DEBUG_TRACE
+    transfer_debug_print(data, read_bytes, false);
+#endif
+
+    *received = read_bytes;
+    return ESP_LOADER_SUCCESS;
+}
+
+
 // Set GPIO0 LOW, then assert reset pin for 50 milliseconds.
 void loader_port_enter_bootloader(void)
 {
@@ -285,14 +324,20 @@ void loader_port_delay_ms(uint32_t ms)
 
 void loader_port_start_timer(uint32_t ms)
 {
-    s_time_end = clock() + (ms * (CLOCKS_PER_SEC / 1000));
+    s_time_end = time_ms() + ms;
 }
 
 
 uint32_t loader_port_remaining_time(void)
 {
-    int64_t remaining = (s_time_end - clock()) / 1000;
-    return (remaining > 0) ? (uint32_t)remaining : 0;
+    const uint64_t now = time_ms();
+    return (s_time_end > now) ? (uint32_t)(s_time_end - now) : 0;
+}
+
+
+uint32_t loader_port_get_time_ms(void)
+{
+    return (uint32_t)time_ms();
 }
 
 
@@ -123,6 +123,12 @@ uint32_t loader_port_remaining_time(void)
 }
 
 
+uint32_t loader_port_get_time_ms(void)
+{
+    return HAL_GetTick();
+}
+
+
 void loader_port_debug_print(const char *str)
 {
     printf("DEBUG: %s", str);
@@ -80,6 +80,34 @@ esp_loader_error_t loader_port_read(uint8_t *data, const uint16_t size, const ui
     return ESP_LOADER_SUCCESS;
 }
 
+esp_loader_error_t loader_port_read_some(uint8_t *data, const uint16_t size, const uint32_t timeout,
+                                         uint16_t *received)
+{
+    if (!device_is_ready(uart_dev) || data == NULL || size == 0) {
+        return ESP_LOADER_ERROR_FAIL;
+    }
+
+    // tty_read() waits for every byte, so only the first one is waited for
+    tty_set_rx_timeout(&tty, timeout);
+    if (tty_read(&tty, data, 1) != 1) {
+        return ESP_LOADER_ERROR_TIMEOUT;
+    }
+
+    ssize_t read = 0;
+    if (size > 1) {
+        tty_set_rx_timeout(&tty, 0);
+        read = tty_read(&tty, &data[1], size - 1);
+        read = read < 0 ? 0 : read;
+    }
+    read++;
+
+#if SERIAL_FLASHER_DEBUG_TRACE
+    transfer_debug_print(data, read, false);
+#endif
+    *received = read;
+    return ESP_LOADER_SUCCESS;
+}
+
 esp_loader_error_t loader_port_write(const uint8_t *data, const uint16_t size, const uint32_t timeout)
 {
     if (!device_is_ready(uart_dev) || data == NULL || size == 0) {
@@ -148,6 +176,11 @@ uint32_t loader_port_remaining_time(void)
     return (remaining > 0) ? (uint32_t)remaining : 0;
 }
 
+uint32_t loader_port_get_time_ms(void)
+{
+    return k_uptime_get_32();
+}
+
 esp_loader_error_t loader_port_change_transmission_rate(uint32_t baudrate)
 {
     struct uart_config uart_config;
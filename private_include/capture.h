@@ -0,0 +1,66 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_loader.h"
+#include "esp_loader_capture.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Recording of the port traffic of the selected loader, see esp_loader_capture.h. The port
+   functions of loader_context.h call these once the port has returned. */
+#if (SERIAL_FLASHER_CAPTURE_BUFFER_SIZE > 0) && \
+    ((defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB))
+
+#if SERIAL_FLASHER_CAPTURE_BUFFER_SIZE & (SERIAL_FLASHER_CAPTURE_BUFFER_SIZE - 1)
+#error "SERIAL_FLASHER_CAPTURE_BUFFER_SIZE has to be a power of two"
+#endif
+
+#define CAPTURE_ENABLED 1
+
+void capture_bytes(esp_loader_capture_record_t type, const uint8_t *data, size_t size,
+                   esp_loader_error_t status);
+
+void capture_event(esp_loader_capture_event_t event, uint32_t value);
+
+#else
+
+#define CAPTURE_ENABLED 0
+
+static inline void capture_bytes(esp_loader_capture_record_t type, const uint8_t *data, size_t size,
+                                 esp_loader_error_t status)
+{
+    (void)type;
+    (void)data;
+    (void)size;
+    (void)status;
+}
+
+static inline void capture_event(esp_loader_capture_event_t event, uint32_t value)
+{
+    (void)event;
+    (void)value;
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
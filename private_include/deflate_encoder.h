@@ -0,0 +1,104 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_loader.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The window size bounds both the memory used by the encoder and the size of the
+   compressed packets it produces. The encoder state takes roughly 6 * window size bytes. */
+#define DEFLATE_WINDOW_SIZE (1U << SERIAL_FLASHER_DEFLATE_WINDOW_BITS)
+#define DEFLATE_HASH_SIZE DEFLATE_WINDOW_SIZE
+
+#define DEFLATE_LEVEL_MIN 0
+#define DEFLATE_LEVEL_MAX 9
+
+#if SERIAL_FLASHER_DEFLATE_WINDOW_BITS < 10 || SERIAL_FLASHER_DEFLATE_WINDOW_BITS > 15
+#error "SERIAL_FLASHER_DEFLATE_WINDOW_BITS must be between 10 and 15"
+#endif
+
+/**
+  * @brief Called each time the output buffer fills up and once more for the remainder
+  *        of the stream when it is finished.
+  */
+typedef esp_loader_error_t (*deflate_sink_t)(void *ctx, const uint8_t *data, size_t size);
+
+typedef struct {
+    uint8_t window[2 * DEFLATE_WINDOW_SIZE];
+    uint16_t head[DEFLATE_HASH_SIZE];
+    uint16_t prev[DEFLATE_WINDOW_SIZE];
+    uint32_t fill;          // Bytes of valid data in the window
+    uint32_t pos;           // Position of the next byte to be encoded
+    uint32_t insert_pos;    // Positions below this one are in the hash chains
+    uint32_t cached_pos;    // Match lookahead of lazy evaluation
+    uint32_t cached_length;
+    uint32_t cached_distance;
+
+    uint8_t level;
+    uint16_t max_chain;
+    uint16_t nice_length;
+    bool lazy;
+    bool block_open;        // A fixed Huffman block has been started and not yet terminated
+
+    uint32_t bit_buf;
+    uint32_t bit_cnt;
+
+    uint8_t *out;
+    size_t out_size;
+    size_t out_len;
+    deflate_sink_t sink;
+    void *sink_ctx;
+    esp_loader_error_t error;   // First error reported by the sink
+
+    uint32_t adler_a;
+    uint32_t adler_b;
+    uint32_t total_in;
+    uint32_t total_out;
+} deflate_encoder_t;
+
+/**
+  * @brief Initializes the encoder and emits the zlib stream header.
+  *
+  * @param out[in]       Buffer collecting compressed data before it is handed to the sink.
+  * @param out_size[in]  Size of the output buffer, every sink call but the last one is this long.
+  */
+void deflate_encoder_init(deflate_encoder_t *enc, uint8_t level, uint8_t *out, size_t out_size,
+                          deflate_sink_t sink, void *sink_ctx);
+
+/**
+  * @brief Changes the compression level of the data that has not been encoded yet.
+  */
+esp_loader_error_t deflate_encoder_set_level(deflate_encoder_t *enc, uint8_t level);
+
+/**
+  * @brief Compresses data, handing every filled output buffer to the sink.
+  */
+esp_loader_error_t deflate_encoder_write(deflate_encoder_t *enc, const uint8_t *data, size_t size);
+
+/**
+  * @brief Compresses all buffered data, terminates the stream and flushes the output buffer.
+  */
+esp_loader_error_t deflate_encoder_finish(deflate_encoder_t *enc);
+
+#ifdef __cplusplus
+}
+#endif
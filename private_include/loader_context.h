@@ -0,0 +1,252 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_loader.h"
+#include "esp_loader_io.h"
+#include "capture.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Every module keeps the state it has per target in a static array with an entry per loader,
+   indexed by the slot of the loader selected by the calling thread. Slot 0 is the default
+   loader, used until another one is selected. */
+#if SERIAL_FLASHER_MAX_LOADERS > 1
+#define LOADER_COUNT SERIAL_FLASHER_MAX_LOADERS
+#else
+#define LOADER_COUNT 1
+#endif
+
+struct esp_loader {
+    uint32_t slot;
+    uint32_t generation;            // Changes whenever the slot is handed to a new loader
+    bool in_use;
+    const esp_loader_port_t *port;  // NULL to use the loader_port_*() functions
+    void *port_context;
+};
+
+#if LOADER_COUNT > 1
+
+const esp_loader_t *loader_context(void);
+
+#else
+
+static inline const esp_loader_t *loader_context(void)
+{
+    static const esp_loader_t default_loader = { .slot = 0, .generation = 1, .in_use = true };
+    return &default_loader;
+}
+
+#endif
+
+static inline uint32_t loader_slot(void)
+{
+    return LOADER_COUNT > 1 ? loader_context()->slot : 0;
+}
+
+/* Modules reset the state they keep for a slot when its generation differs from the one of the
+   loader using the slot. States start out zeroed, generations of loaders in use do not. */
+static inline uint32_t loader_generation(void)
+{
+    return loader_context()->generation;
+}
+
+/* The port functions of the selected loader. Loaders created without a port table, the default
+   one included, use the loader_port_*() functions. */
+#if LOADER_COUNT > 1
+#define PORT_BOUND(loader) ((loader)->port != NULL)
+#else
+#define PORT_BOUND(loader) false
+#endif
+
+#ifndef SERIAL_FLASHER_INTERFACE_SDIO
+static inline esp_loader_error_t port_change_transmission_rate(uint32_t transmission_rate)
+{
+    const esp_loader_t *loader = loader_context();
+    esp_loader_error_t err = ESP_LOADER_ERROR_UNSUPPORTED_FUNC;
+    if (!PORT_BOUND(loader)) {
+        err = loader_port_change_transmission_rate(transmission_rate);
+    } else if (loader->port->change_transmission_rate != NULL) {
+        err = loader->port->change_transmission_rate(loader->port_context, transmission_rate);
+    }
+    if (err == ESP_LOADER_SUCCESS) {
+        capture_event(ESP_LOADER_CAPTURE_RATE, transmission_rate);
+    }
+    return err;
+}
+
+static inline esp_loader_error_t port_write(const uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    const esp_loader_t *loader = loader_context();
+    const esp_loader_error_t err = PORT_BOUND(loader) ?
+                                   loader->port->write(loader->port_context, data, size, timeout) :
+                                   loader_port_write(data, size, timeout);
+    capture_bytes(ESP_LOADER_CAPTURE_TX, data, size, err);
+    return err;
+}
+
+static inline esp_loader_error_t port_read(uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    const esp_loader_t *loader = loader_context();
+    const esp_loader_error_t err = PORT_BOUND(loader) ?
+                                   loader->port->read(loader->port_context, data, size, timeout) :
+                                   loader_port_read(data, size, timeout);
+    capture_bytes(ESP_LOADER_CAPTURE_RX, data, err == ESP_LOADER_SUCCESS ? size : 0, err);
+    return err;
+}
+#else
+static inline esp_loader_error_t port_write(uint32_t function, uint32_t addr, const uint8_t *data,
+        uint16_t size, uint32_t timeout)
+{
+    const esp_loader_t *loader = loader_context();
+    if (!PORT_BOUND(loader)) {
+        return loader_port_write(function, addr, data, size, timeout);
+    }
+    return loader->port->write(loader->port_context, function, addr, data, size, timeout);
+}
+
+static inline esp_loader_error_t port_read(uint32_t function, uint32_t addr, uint8_t *data,
+        uint16_t size, uint32_t timeout)
+{
+    const esp_loader_t *loader = loader_context();
+    if (!PORT_BOUND(loader)) {
+        return loader_port_read(function, addr, data, size, timeout);
+    }
+    return loader->port->read(loader->port_context, function, addr, data, size, timeout);
+}
+#endif
+
+#if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
+static inline esp_loader_error_t port_read_some(uint8_t *data, uint16_t size, uint32_t timeout,
+        uint16_t *received)
+{
+    const esp_loader_t *loader = loader_context();
+    esp_loader_error_t err;
+    *received = 0;
+    if (!PORT_BOUND(loader)) {
+        err = loader_port_read_some(data, size, timeout, received);
+    } else if (loader->port->read_some == NULL) {
+        err = loader->port->read(loader->port_context, data, 1, timeout);
+        *received = err == ESP_LOADER_SUCCESS ? 1 : 0;
+    } else {
+        err = loader->port->read_some(loader->port_context, data, size, timeout, received);
+    }
+    capture_bytes(ESP_LOADER_CAPTURE_RX, data, *received, err);
+    return err;
+}
+#endif
+
+static inline void port_delay_ms(uint32_t ms)
+{
+    const esp_loader_t *loader = loader_context();
+    if (!PORT_BOUND(loader)) {
+        loader_port_delay_ms(ms);
+    } else {
+        loader->port->delay_ms(loader->port_context, ms);
+    }
+}
+
+static inline void port_start_timer(uint32_t ms)
+{
+    const esp_loader_t *loader = loader_context();
+    if (!PORT_BOUND(loader)) {
+        loader_port_start_timer(ms);
+    } else {
+        loader->port->start_timer(loader->port_context, ms);
+    }
+}
+
+static inline uint32_t port_remaining_time(void)
+{
+    const esp_loader_t *loader = loader_context();
+    if (!PORT_BOUND(loader)) {
+        return loader_port_remaining_time();
+    }
+    return loader->port->remaining_time(loader->port_context);
+}
+
+static inline void port_enter_bootloader(void)
+{
+    const esp_loader_t *loader = loader_context();
+    if (!PORT_BOUND(loader)) {
+        loader_port_enter_bootloader();
+    } else {
+        loader->port->enter_bootloader(loader->port_context);
+    }
+    capture_event(ESP_LOADER_CAPTURE_ENTER_BOOTLOADER, 0);
+}
+
+static inline void port_reset_target(void)
+{
+    const esp_loader_t *loader = loader_context();
+    if (!PORT_BOUND(loader)) {
+        loader_port_reset_target();
+    } else {
+        loader->port->reset_target(loader->port_context);
+    }
+    capture_event(ESP_LOADER_CAPTURE_RESET, 0);
+}
+
+static inline void port_debug_print(const char *str)
+{
+    const esp_loader_t *loader = loader_context();
+    if (!PORT_BOUND(loader)) {
+        loader_port_debug_print(str);
+    } else if (loader->port->debug_print != NULL) {
+        loader->port->debug_print(loader->port_context, str);
+    }
+}
+
+static inline uint32_t port_get_time_ms(void)
+{
+    const esp_loader_t *loader = loader_context();
+    if (!PORT_BOUND(loader)) {
+        return loader_port_get_time_ms();
+    }
+    return loader->port->get_time_ms != NULL ? loader->port->get_time_ms(loader->port_context) : 0;
+}
+
+#ifdef SERIAL_FLASHER_INTERFACE_SPI
+static inline void port_spi_set_cs(uint32_t level)
+{
+    const esp_loader_t *loader = loader_context();
+    if (!PORT_BOUND(loader)) {
+        loader_port_spi_set_cs(level);
+    } else {
+        loader->port->spi_set_cs(loader->port_context, level);
+    }
+}
+#endif
+
+#ifdef SERIAL_FLASHER_INTERFACE_SDIO
+static inline esp_loader_error_t port_sdio_card_init(void)
+{
+    const esp_loader_t *loader = loader_context();
+    if (!PORT_BOUND(loader)) {
+        return loader_port_sdio_card_init();
+    }
+    return loader->port->sdio_card_init(loader->port_context);
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
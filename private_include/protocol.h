@@ -18,6 +18,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "esp_loader.h"
+#include "md5_hash.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -70,6 +71,8 @@ typedef enum __attribute__((packed))
     FLASH_DEFL_END = 0x12,
     SPI_FLASH_MD5 = 0x13,
     GET_SECURITY_INFO = 0x14,
+    ERASE_FLASH = 0xd0,
+    ERASE_REGION = 0xd1,
     READ_FLASH_STUB = 0xd2,
 } command_t;
 
@@ -134,6 +137,18 @@ typedef struct __attribute__((packed))
     uint32_t max_inflight_packets;
 } flash_read_stub_cmd;
 
+typedef struct __attribute__((packed))
+{
+    command_common_t common;
+} erase_flash_command_t;
+
+typedef struct __attribute__((packed))
+{
+    command_common_t common;
+    uint32_t offset;
+    uint32_t size;
+} erase_region_command_t;
+
 typedef struct __attribute__((packed))
 {
     command_common_t common;
@@ -250,13 +265,24 @@ esp_loader_error_t loader_initialize_conn(esp_loader_connect_args_t *connect_arg
 #if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
 esp_loader_error_t loader_flash_begin_cmd(uint32_t offset, uint32_t erase_size, uint32_t block_size, uint32_t blocks_to_write, bool encryption);
 
-esp_loader_error_t loader_flash_data_cmd(const uint8_t *data, uint32_t size);
+esp_loader_error_t loader_flash_data_cmd(const uint8_t *data, uint32_t size, uint32_t padding,
+                                         struct MD5Context *md5, uint32_t md5_size);
 
 esp_loader_error_t loader_flash_end_cmd(bool stay_in_loader);
 
+esp_loader_error_t loader_flash_defl_begin_cmd(uint32_t offset, uint32_t erase_size, uint32_t block_size, uint32_t blocks_to_write, bool encryption);
+
+esp_loader_error_t loader_flash_defl_data_cmd(const uint8_t *data, uint32_t size);
+
+esp_loader_error_t loader_flash_defl_end_cmd(bool stay_in_loader);
+
 esp_loader_error_t loader_flash_read_rom_cmd(uint32_t address, uint8_t *data);
 
-esp_loader_error_t loader_flash_read_stub_cmd(uint32_t address, uint32_t size, uint32_t size_per_packet);
+esp_loader_error_t loader_flash_read_stub_cmd(uint32_t address, uint32_t size, uint32_t size_per_packet, uint32_t max_inflight_packets);
+
+esp_loader_error_t loader_erase_flash_cmd(void);
+
+esp_loader_error_t loader_erase_region_cmd(uint32_t offset, uint32_t size);
 
 esp_loader_error_t loader_sync_cmd(void);
 
@@ -33,8 +33,36 @@ typedef struct {
                                       case resp_data_size is the maximum response data size allowed.
                                       Set to NULL to require fixed response size of resp_data_size. */
     uint32_t *reg_value; // Out parameter for the READ_REG command, will return zero otherwise
+    uint8_t *data_checksum; /* Checksum field of the command, set from the data before the command
+                               is sent. Set to NULL if the command has no checksum. */
+    struct MD5Context *data_md5; // Updated with the first data_md5_size bytes of the data if not NULL
+    size_t data_md5_size;
+    size_t data_padding; /* Number of 0xff bytes sent after the data, without being stored anywhere.
+                            They are part of the data and of data_size. */
 } send_cmd_config;
 
 void log_loader_internal_error(error_code_t error);
 
+/**
+  * @brief Adds a part of the command data to its checksum and to the MD5 hash, if requested.
+  *
+  * @param config[in] Command configuration.
+  * @param offset[in] Offset of the part in the command data.
+  * @param size[in] Size of the part.
+  * @param checksum[inout] Checksum of the previous parts, NULL to only hash the part.
+  */
+void update_data_digest(const send_cmd_config *config, size_t offset, size_t size, uint8_t *checksum);
+
+/**
+  * @brief Adds the padding at the end of the command data to its checksum and to the MD5 hash.
+  *
+  * @param config[in] Command configuration.
+  * @param checksum[inout] Checksum of the data before the padding, NULL to only hash it.
+  */
+void update_padding_digest(const send_cmd_config *config, uint8_t *checksum);
+
+#define PADDING_PATTERN 0xFF
+
+#define CHECKSUM_INITIAL_VALUE 0xEF
+
 esp_loader_error_t send_cmd(const send_cmd_config *config);
@@ -17,10 +17,105 @@
 
 #include "esp_loader.h"
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdlib.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    SLIP_STATE_WAIT_START,  // Discarding bytes until the opening delimiter
+    SLIP_STATE_START,       // Skipping repeated delimiters before the payload
+    SLIP_STATE_DATA,
+    SLIP_STATE_ESCAPE,      // Escape byte received, the next byte is decoded
+    SLIP_STATE_OVERFLOW,    // Buffer full, discarding bytes until the closing delimiter
+} slip_state_t;
+
+/**
+  * @brief Incremental SLIP decoder, can be fed with chunks of any size.
+  */
+typedef struct {
+    uint8_t *buff;
+    size_t max_size;
+    size_t size;
+    slip_state_t state;
+} slip_decoder_t;
+
+void SLIP_decoder_init(slip_decoder_t *decoder, uint8_t *buff, size_t max_size);
+
+/**
+  * @brief Decodes bytes until the end of the current frame or the end of the input.
+  *
+  * @param decoder[in] Decoder state.
+  * @param data[in] Received bytes.
+  * @param size[in] Number of received bytes.
+  * @param consumed[out] Number of bytes used, the rest belongs to following frames.
+  * @param complete[out] Set when the closing delimiter was found, decoder->size holds the
+  *                      frame size then. Frames longer than max_size are truncated.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_INVALID_RESPONSE Invalid escape sequence
+  */
+esp_loader_error_t SLIP_decoder_feed(slip_decoder_t *decoder, const uint8_t *data, size_t size,
+                                     size_t *consumed, bool *complete);
+
 esp_loader_error_t SLIP_receive_packet(uint8_t *buff, size_t max_size, size_t *recv_size);
 
+/**
+  * @brief Drops buffered received data and any partially assembled frame.
+  */
+void SLIP_reset(void);
+
+/**
+  * @brief Appends escaped data to the frame being assembled in the transmit buffer.
+  *
+  * @note  The buffer is only written to the port when it fills up or on SLIP_flush().
+  */
 esp_loader_error_t SLIP_send(const uint8_t *data, size_t size);
 
 esp_loader_error_t SLIP_send_delimiter(void);
+
+/**
+  * @brief Starts a frame whose header is only known once its data has been added.
+  *
+  * @note  The data is added with SLIP_append() and the frame is completed by
+  *        SLIP_set_deferred_header(). Pending frames are flushed first.
+  *
+  * @param header_size[in] Size of the header.
+  *
+  * @return
+  *     - ESP_LOADER_SUCCESS Success
+  *     - ESP_LOADER_ERROR_INVALID_PARAM Header does not fit into the transmit buffer
+  *     - ESP_LOADER_ERROR_TIMEOUT Timeout flushing pending frames
+  */
+esp_loader_error_t SLIP_begin_deferred_frame(size_t header_size);
+
+/**
+  * @brief Escapes data into the transmit buffer, without ever flushing it.
+  *
+  * @return Number of data bytes that fit.
+  */
+size_t SLIP_append(const uint8_t *data, size_t size);
+
+/**
+  * @brief Places the header in front of the data added since SLIP_begin_deferred_frame().
+  *        The frame can then be continued with SLIP_send().
+  */
+void SLIP_set_deferred_header(const uint8_t *header, size_t size);
+
+/**
+  * @brief Writes the assembled frames to the port, has to be called before waiting for a reply.
+  */
+esp_loader_error_t SLIP_flush(void);
+
+#if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
+void SLIP_get_stats(esp_loader_transfer_stats_t *stats);
+
+void SLIP_reset_stats(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
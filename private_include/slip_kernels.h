@@ -0,0 +1,69 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef size_t (*slip_scan_fn_t)(const uint8_t *data, size_t size);
+
+typedef size_t (*slip_escape_fn_t)(const uint8_t *data, size_t size,
+                                   uint8_t *out, size_t out_size, size_t *out_len);
+
+typedef struct {
+    const char *name;
+    slip_scan_fn_t scan;
+    slip_escape_fn_t escape;
+} slip_kernel_t;
+
+/**
+  * @brief Finds the first byte that has a special meaning in SLIP (0xC0 or 0xDB).
+  *
+  * @return Index of the first special byte, or size if there is none.
+  */
+size_t SLIP_scan(const uint8_t *data, size_t size);
+
+/**
+  * @brief Escapes as much of the data as fits into the output buffer.
+  *
+  * @note  An escape sequence is never split, so at least two bytes of output space are needed
+  *        for progress to be guaranteed.
+  *
+  * @param data[in] Data to be escaped.
+  * @param size[in] Size of the data.
+  * @param out[out] Output buffer.
+  * @param out_size[in] Size of the output buffer.
+  * @param out_len[out] Number of bytes written to the output buffer.
+  *
+  * @return Number of data bytes consumed.
+  */
+size_t SLIP_escape(const uint8_t *data, size_t size, uint8_t *out, size_t out_size, size_t *out_len);
+
+/**
+  * @brief Lists the kernels usable on this CPU, the scalar one first and the one SLIP_scan()
+  *        and SLIP_escape() use last. Meant for tests and benchmarks.
+  *
+  * @return Number of kernels.
+  */
+size_t SLIP_get_kernels(const slip_kernel_t **kernels);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,489 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Streaming zlib (RFC 1950/1951) encoder with a fixed memory footprint.
+ *
+ * Matches are found with hash chains over a sliding window of DEFLATE_WINDOW_SIZE bytes and
+ * emitted using the fixed Huffman code, which needs no per-block tables and keeps the encoder
+ * small enough for MCU hosts. Level 0 emits stored blocks. */
+
+#include "deflate_encoder.h"
+#include <string.h>
+
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define MIN_LOOKAHEAD (MAX_MATCH + MIN_MATCH + 1)
+#define MAX_DIST (DEFLATE_WINDOW_SIZE - MIN_LOOKAHEAD)
+#define WINDOW_MASK (DEFLATE_WINDOW_SIZE - 1)
+#define HASH_BITS SERIAL_FLASHER_DEFLATE_WINDOW_BITS
+
+#define STORED_BLOCK_MAX 0xFFFF
+#define END_OF_BLOCK 256
+#define NO_CACHED_MATCH UINT32_MAX
+
+#define ADLER_MOD 65521
+#define ADLER_NMAX 5552
+
+typedef struct {
+    uint16_t max_chain;
+    uint16_t nice_length;
+    bool lazy;
+} level_config_t;
+
+static const level_config_t s_level_config[DEFLATE_LEVEL_MAX + 1] = {
+    {    0,   0, false }, // Stored blocks only
+    {    4,   8, false },
+    {    8,  16, false },
+    {   16,  32, false },
+    {   16,  32, true  },
+    {   32,  64, true  },
+    {  128, 128, true  },
+    {  256, 128, true  },
+    { 1024, 258, true  },
+    { 4096, 258, true  },
+};
+
+/* Fixed literal/length Huffman codes, bit reversed so they can be emitted LSB first */
+static const uint16_t s_fixed_lit_code[288] = {
+    0x00c, 0x08c, 0x04c, 0x0cc, 0x02c, 0x0ac, 0x06c, 0x0ec, 0x01c, 0x09c, 0x05c, 0x0dc, 0x03c, 0x0bc, 0x07c, 0x0fc,
+    0x002, 0x082, 0x042, 0x0c2, 0x022, 0x0a2, 0x062, 0x0e2, 0x012, 0x092, 0x052, 0x0d2, 0x032, 0x0b2, 0x072, 0x0f2,
+    0x00a, 0x08a, 0x04a, 0x0ca, 0x02a, 0x0aa, 0x06a, 0x0ea, 0x01a, 0x09a, 0x05a, 0x0da, 0x03a, 0x0ba, 0x07a, 0x0fa,
+    0x006, 0x086, 0x046, 0x0c6, 0x026, 0x0a6, 0x066, 0x0e6, 0x016, 0x096, 0x056, 0x0d6, 0x036, 0x0b6, 0x076, 0x0f6,
+    0x00e, 0x08e, 0x04e, 0x0ce, 0x02e, 0x0ae, 0x06e, 0x0ee, 0x01e, 0x09e, 0x05e, 0x0de, 0x03e, 0x0be, 0x07e, 0x0fe,
+    0x001, 0x081, 0x041, 0x0c1, 0x021, 0x0a1, 0x061, 0x0e1, 0x011, 0x091, 0x051, 0x0d1, 0x031, 0x0b1, 0x071, 0x0f1,
+    0x009, 0x089, 0x049, 0x0c9, 0x029, 0x0a9, 0x069, 0x0e9, 0x019, 0x099, 0x059, 0x0d9, 0x039, 0x0b9, 0x079, 0x0f9,
+    0x005, 0x085, 0x045, 0x0c5, 0x025, 0x0a5, 0x065, 0x0e5, 0x015, 0x095, 0x055, 0x0d5, 0x035, 0x0b5, 0x075, 0x0f5,
+    0x00d, 0x08d, 0x04d, 0x0cd, 0x02d, 0x0ad, 0x06d, 0x0ed, 0x01d, 0x09d, 0x05d, 0x0dd, 0x03d, 0x0bd, 0x07d, 0x0fd,
+    0x013, 0x113, 0x093, 0x193, 0x053, 0x153, 0x0d3, 0x1d3, 0x033, 0x133, 0x0b3, 0x1b3, 0x073, 0x173, 0x0f3, 0x1f3,
+    0x00b, 0x10b, 0x08b, 0x18b, 0x04b, 0x14b, 0x0cb, 0x1cb, 0x02b, 0x12b, 0x0ab, 0x1ab, 0x06b, 0x16b, 0x0eb, 0x1eb,
+    0x01b, 0x11b, 0x09b, 0x19b, 0x05b, 0x15b, 0x0db, 0x1db, 0x03b, 0x13b, 0x0bb, 0x1bb, 0x07b, 0x17b, 0x0fb, 0x1fb,
+    0x007, 0x107, 0x087, 0x187, 0x047, 0x147, 0x0c7, 0x1c7, 0x027, 0x127, 0x0a7, 0x1a7, 0x067, 0x167, 0x0e7, 0x1e7,
+    0x017, 0x117, 0x097, 0x197, 0x057, 0x157, 0x0d7, 0x1d7, 0x037, 0x137, 0x0b7, 0x1b7, 0x077, 0x177, 0x0f7, 0x1f7,
+    0x00f, 0x10f, 0x08f, 0x18f, 0x04f, 0x14f, 0x0cf, 0x1cf, 0x02f, 0x12f, 0x0af, 0x1af, 0x06f, 0x16f, 0x0ef, 0x1ef,
+    0x01f, 0x11f, 0x09f, 0x19f, 0x05f, 0x15f, 0x0df, 0x1df, 0x03f, 0x13f, 0x0bf, 0x1bf, 0x07f, 0x17f, 0x0ff, 0x1ff,
+    0x000, 0x040, 0x020, 0x060, 0x010, 0x050, 0x030, 0x070, 0x008, 0x048, 0x028, 0x068, 0x018, 0x058, 0x038, 0x078,
+    0x004, 0x044, 0x024, 0x064, 0x014, 0x054, 0x034, 0x074, 0x003, 0x083, 0x043, 0x0c3, 0x023, 0x0a3, 0x063, 0x0e3,
+};
+
+/* Fixed 5 bit distance codes, bit reversed */
+static const uint8_t s_fixed_dist_code[30] = {
+    0x00, 0x10, 0x08, 0x18, 0x04, 0x14, 0x0c, 0x1c, 0x02, 0x12,
+    0x0a, 0x1a, 0x06, 0x16, 0x0e, 0x1e, 0x01, 0x11, 0x09, 0x19,
+    0x05, 0x15, 0x0d, 0x1d, 0x03, 0x13, 0x0b, 0x1b, 0x07, 0x17,
+};
+
+static inline uint32_t floor_log2(uint32_t value)
+{
+    return 31 - __builtin_clz(value);
+}
+
+static inline uint32_t fixed_lit_bits(uint32_t symbol)
+{
+    if (symbol < 144) {
+        return 8;
+    } else if (symbol < 256) {
+        return 9;
+    } else if (symbol < 280) {
+        return 7;
+    }
+    return 8;
+}
+
+static void put_byte(deflate_encoder_t *enc, uint8_t byte)
+{
+    enc->out[enc->out_len++] = byte;
+    enc->total_out++;
+
+    if (enc->out_len == enc->out_size) {
+        if (enc->error == ESP_LOADER_SUCCESS) {
+            enc->error = enc->sink(enc->sink_ctx, enc->out, enc->out_len);
+        }
+        enc->out_len = 0;
+    }
+}
+
+/* Appends up to 16 bits, LSB first */
+static inline void put_bits(deflate_encoder_t *enc, uint32_t value, uint32_t bits)
+{
+    enc->bit_buf |= value << enc->bit_cnt;
+    enc->bit_cnt += bits;
+
+    while (enc->bit_cnt >= 8) {
+        put_byte(enc, enc->bit_buf & 0xFF);
+        enc->bit_buf >>= 8;
+        enc->bit_cnt -= 8;
+    }
+}
+
+static void align_to_byte(deflate_encoder_t *enc)
+{
+    if (enc->bit_cnt > 0) {
+        put_byte(enc, enc->bit_buf & 0xFF);
+        enc->bit_buf = 0;
+        enc->bit_cnt = 0;
+    }
+}
+
+static inline void put_symbol(deflate_encoder_t *enc, uint32_t symbol)
+{
+    put_bits(enc, s_fixed_lit_code[symbol], fixed_lit_bits(symbol));
+}
+
+static void open_fixed_block(deflate_encoder_t *enc)
+{
+    if (!enc->block_open) {
+        put_bits(enc, 0x2, 3); // BFINAL = 0, BTYPE = 01
+        enc->block_open = true;
+    }
+}
+
+static void close_fixed_block(deflate_encoder_t *enc)
+{
+    if (enc->block_open) {
+        put_symbol(enc, END_OF_BLOCK);
+        enc->block_open = false;
+    }
+}
+
+static void put_literal(deflate_encoder_t *enc, uint8_t literal)
+{
+    put_symbol(enc, literal);
+}
+
+static void put_match(deflate_encoder_t *enc, uint32_t length, uint32_t distance)
+{
+    uint32_t symbol;
+    uint32_t extra_bits = 0;
+    uint32_t extra = 0;
+
+    const uint32_t l = length - MIN_MATCH;
+    if (length == MAX_MATCH) {
+        symbol = 285;
+    } else if (l < 8) {
+        symbol = 257 + l;
+    } else {
+        extra_bits = floor_log2(l) - 2;
+        symbol = 261 + 4 * extra_bits + ((l >> extra_bits) & 3);
+        extra = l & ((1U << extra_bits) - 1);
+    }
+
+    put_symbol(enc, symbol);
+    if (extra_bits > 0) {
+        put_bits(enc, extra, extra_bits);
+    }
+
+    const uint32_t d = distance - 1;
+    if (d < 4) {
+        put_bits(enc, s_fixed_dist_code[d], 5);
+    } else {
+        const uint32_t n = floor_log2(d);
+        extra_bits = n - 1;
+        put_bits(enc, s_fixed_dist_code[2 * n + ((d >> extra_bits) & 1)], 5);
+        put_bits(enc, d & ((1U << extra_bits) - 1), extra_bits);
+    }
+}
+
+static void adler32_update(deflate_encoder_t *enc, const uint8_t *data, size_t size)
+{
+    uint32_t a = enc->adler_a;
+    uint32_t b = enc->adler_b;
+
+    while (size > 0) {
+        size_t chunk = size < ADLER_NMAX ? size : ADLER_NMAX;
+        size -= chunk;
+        while (chunk--) {
+            a += *data++;
+            b += a;
+        }
+        a %= ADLER_MOD;
+        b %= ADLER_MOD;
+    }
+
+    enc->adler_a = a;
+    enc->adler_b = b;
+}
+
+static inline uint32_t hash_at(const deflate_encoder_t *enc, uint32_t pos)
+{
+    const uint8_t *p = &enc->window[pos];
+    const uint32_t value = p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+    return (value * 2654435761U) >> (32 - HASH_BITS);
+}
+
+/* Inserts all positions up to, but not including, end into the hash chains */
+static void insert_up_to(deflate_encoder_t *enc, uint32_t end)
+{
+    while (enc->insert_pos < end && enc->insert_pos + MIN_MATCH <= enc->fill) {
+        const uint32_t pos = enc->insert_pos++;
+        const uint32_t hash = hash_at(enc, pos);
+        enc->prev[pos & WINDOW_MASK] = enc->head[hash];
+        enc->head[hash] = pos;
+    }
+}
+
+/* Position 0 doubles as the end of a hash chain, so it is never offered as a match */
+static uint32_t longest_match(const deflate_encoder_t *enc, uint32_t pos, uint32_t *distance)
+{
+    const uint32_t limit = pos > MAX_DIST ? pos - MAX_DIST : 0;
+    const uint32_t available = enc->fill - pos;
+    const uint32_t max_length = available < MAX_MATCH ? available : MAX_MATCH;
+    const uint8_t *scan = &enc->window[pos];
+
+    uint32_t best_length = MIN_MATCH - 1;
+    uint32_t chain = enc->max_chain;
+    uint32_t candidate = enc->prev[pos & WINDOW_MASK];
+
+    while (candidate > limit && chain-- > 0) {
+        const uint8_t *match = &enc->window[candidate];
+
+        if (match[best_length] == scan[best_length] && match[0] == scan[0] && match[1] == scan[1]) {
+            uint32_t length = 2;
+            while (length < max_length && match[length] == scan[length]) {
+                length++;
+            }
+
+            if (length > best_length) {
+                best_length = length;
+                *distance = pos - candidate;
+                if (length >= enc->nice_length || length >= max_length) {
+                    break;
+                }
+            }
+        }
+
+        candidate = enc->prev[candidate & WINDOW_MASK];
+    }
+
+    return best_length >= MIN_MATCH ? best_length : 0;
+}
+
+static uint32_t find_match(deflate_encoder_t *enc, uint32_t pos, uint32_t *distance)
+{
+    if (enc->cached_pos == pos) {
+        *distance = enc->cached_distance;
+        return enc->cached_length;
+    }
+
+    if (enc->fill - pos < MIN_MATCH) {
+        return 0;
+    }
+
+    insert_up_to(enc, pos + 1);
+    return longest_match(enc, pos, distance);
+}
+
+static void compress_stored(deflate_encoder_t *enc, bool flush)
+{
+    const uint32_t threshold = flush ? 1 : DEFLATE_WINDOW_SIZE;
+
+    while (enc->fill - enc->pos >= threshold && enc->error == ESP_LOADER_SUCCESS) {
+        uint32_t length = enc->fill - enc->pos;
+        if (length > STORED_BLOCK_MAX) {
+            length = STORED_BLOCK_MAX;
+        }
+
+        close_fixed_block(enc);
+        put_bits(enc, 0x0, 3); // BFINAL = 0, BTYPE = 00
+        align_to_byte(enc);
+        put_byte(enc, length & 0xFF);
+        put_byte(enc, length >> 8);
+        put_byte(enc, ~length & 0xFF);
+        put_byte(enc, (~length >> 8) & 0xFF);
+
+        const uint8_t *data = &enc->window[enc->pos];
+        for (uint32_t i = 0; i < length; i++) {
+            put_byte(enc, data[i]);
+        }
+
+        enc->pos += length;
+    }
+}
+
+static void compress_fixed(deflate_encoder_t *enc, bool flush)
+{
+    const uint32_t lookahead = flush ? 0 : MIN_LOOKAHEAD;
+
+    while (enc->fill - enc->pos > lookahead && enc->error == ESP_LOADER_SUCCESS) {
+        const uint32_t pos = enc->pos;
+        uint32_t distance = 0;
+        uint32_t length = find_match(enc, pos, &distance);
+
+        open_fixed_block(enc);
+
+        if (length > 0 && enc->lazy && length < enc->nice_length) {
+            uint32_t next_distance = 0;
+            const uint32_t next_length = find_match(enc, pos + 1, &next_distance);
+
+            enc->cached_pos = pos + 1;
+            enc->cached_length = next_length;
+            enc->cached_distance = next_distance;
+
+            if (next_length > length) {
+                put_literal(enc, enc->window[pos]);
+                enc->pos++;
+                continue;
+            }
+        }
+
+        if (length > 0) {
+            put_match(enc, length, distance);
+            /* Without lazy evaluation long matches are not worth indexing */
+            if (!enc->lazy && length > enc->nice_length && enc->insert_pos < pos + length) {
+                enc->insert_pos = pos + length;
+            }
+            enc->pos += length;
+        } else {
+            put_literal(enc, enc->window[pos]);
+            enc->pos++;
+        }
+    }
+}
+
+static void compress(deflate_encoder_t *enc, bool flush)
+{
+    if (enc->level == 0) {
+        compress_stored(enc, flush);
+    } else {
+        compress_fixed(enc, flush);
+    }
+}
+
+static inline uint16_t slide_index(uint16_t index)
+{
+    return index > DEFLATE_WINDOW_SIZE ? index - DEFLATE_WINDOW_SIZE : 0;
+}
+
+static void slide_window(deflate_encoder_t *enc)
+{
+    memmove(enc->window, &enc->window[DEFLATE_WINDOW_SIZE], DEFLATE_WINDOW_SIZE);
+    enc->fill -= DEFLATE_WINDOW_SIZE;
+    enc->pos -= DEFLATE_WINDOW_SIZE;
+    enc->insert_pos = enc->insert_pos > DEFLATE_WINDOW_SIZE ?
+                      enc->insert_pos - DEFLATE_WINDOW_SIZE : 0;
+    enc->cached_pos = NO_CACHED_MATCH;
+
+    for (uint32_t i = 0; i < DEFLATE_HASH_SIZE; i++) {
+        enc->head[i] = slide_index(enc->head[i]);
+    }
+    for (uint32_t i = 0; i < DEFLATE_WINDOW_SIZE; i++) {
+        enc->prev[i] = slide_index(enc->prev[i]);
+    }
+}
+
+static void apply_level(deflate_encoder_t *enc, uint8_t level)
+{
+    enc->level = level;
+    enc->max_chain = s_level_config[level].max_chain;
+    enc->nice_length = s_level_config[level].nice_length;
+    enc->lazy = s_level_config[level].lazy;
+}
+
+void deflate_encoder_init(deflate_encoder_t *enc, uint8_t level, uint8_t *out, size_t out_size,
+                          deflate_sink_t sink, void *sink_ctx)
+{
+    memset(enc->head, 0, sizeof(enc->head));
+    memset(enc->prev, 0, sizeof(enc->prev));
+    enc->fill = 0;
+    enc->pos = 0;
+    enc->insert_pos = 0;
+    enc->cached_pos = NO_CACHED_MATCH;
+    enc->block_open = false;
+    enc->bit_buf = 0;
+    enc->bit_cnt = 0;
+    enc->out = out;
+    enc->out_size = out_size;
+    enc->out_len = 0;
+    enc->sink = sink;
+    enc->sink_ctx = sink_ctx;
+    enc->error = ESP_LOADER_SUCCESS;
+    enc->adler_a = 1;
+    enc->adler_b = 0;
+    enc->total_in = 0;
+    enc->total_out = 0;
+
+    apply_level(enc, level > DEFLATE_LEVEL_MAX ? DEFLATE_LEVEL_MAX : level);
+
+    /* zlib header: deflate method with the window size we actually reference, default level */
+    const uint8_t cmf = ((SERIAL_FLASHER_DEFLATE_WINDOW_BITS - 8) << 4) | 0x08;
+    uint8_t flg = 2 << 6;
+    flg |= 31 - ((cmf << 8) | flg) % 31;
+    put_byte(enc, cmf);
+    put_byte(enc, flg);
+}
+
+esp_loader_error_t deflate_encoder_set_level(deflate_encoder_t *enc, uint8_t level)
+{
+    if (level > DEFLATE_LEVEL_MAX) {
+        return ESP_LOADER_ERROR_INVALID_PARAM;
+    }
+
+    /* Data passed over by stored blocks is not indexed, start the chains afresh */
+    if (enc->level == 0 && enc->insert_pos < enc->pos) {
+        enc->insert_pos = enc->pos;
+    }
+    enc->cached_pos = NO_CACHED_MATCH;
+
+    apply_level(enc, level);
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t deflate_encoder_write(deflate_encoder_t *enc, const uint8_t *data, size_t size)
+{
+    while (size > 0 && enc->error == ESP_LOADER_SUCCESS) {
+        if (enc->fill == 2 * DEFLATE_WINDOW_SIZE) {
+            slide_window(enc);
+        }
+
+        size_t chunk = 2 * DEFLATE_WINDOW_SIZE - enc->fill;
+        if (chunk > size) {
+            chunk = size;
+        }
+
+        memcpy(&enc->window[enc->fill], data, chunk);
+        adler32_update(enc, data, chunk);
+        enc->fill += chunk;
+        enc->total_in += chunk;
+        data += chunk;
+        size -= chunk;
+
+        compress(enc, false);
+    }
+
+    return enc->error;
+}
+
+esp_loader_error_t deflate_encoder_finish(deflate_encoder_t *enc)
+{
+    compress(enc, true);
+    close_fixed_block(enc);
+
+    /* An empty final block terminates the stream without knowing the last block in advance */
+    put_bits(enc, 0x3, 3); // BFINAL = 1, BTYPE = 01
+    put_symbol(enc, END_OF_BLOCK);
+    align_to_byte(enc);
+
+    const uint32_t adler = (enc->adler_b << 16) | enc->adler_a;
+    put_byte(enc, adler >> 24);
+    put_byte(enc, (adler >> 16) & 0xFF);
+    put_byte(enc, (adler >> 8) & 0xFF);
+    put_byte(enc, adler & 0xFF);
+
+    if (enc->out_len > 0 && enc->error == ESP_LOADER_SUCCESS) {
+        enc->error = enc->sink(enc->sink_ctx, enc->out, enc->out_len);
+        enc->out_len = 0;
+    }
+
+    return enc->error;
+}
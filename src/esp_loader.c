@@ -20,6 +20,8 @@
 #include "esp_targets.h"
 #include "md5_hash.h"
 #include "slip.h"
+#include "deflate_encoder.h"
+#include "loader_context.h"
 #include <string.h>
 #include <assert.h>
 
@@ -28,40 +30,149 @@
 #define DEFAULT_FLASH_TIMEOUT 3000
 #define LOAD_RAM_TIMEOUT_PER_MB 2000000
 #define MD5_TIMEOUT_PER_MB 8000
+#define ERASE_REGION_TIMEOUT_PER_MB 10000
+#define CHIP_ERASE_TIMEOUT_PER_MB 16000
+#define CHIP_ERASE_DEFAULT_FLASH_SIZE (16 * 1024 * 1024) // Assumed for the timeout when not detected
+#define WRITE_TIMEOUT_PER_MB 40000
+#define DEFLATE_WRITE_TIMEOUT_PER_MB 40000 // Per MB of uncompressed data
+#define FLASH_SECTOR_SIZE 0x1000
 
 typedef enum {
     SPI_FLASH_READ_ID = 0x9F
 } spi_flash_cmd_t;
 
-static const target_registers_t *s_reg = NULL;
-static target_chip_t s_target = ESP_UNKNOWN_CHIP;
+#ifndef SERIAL_FLASHER_INTERFACE_SDIO
+typedef enum {
+    TIMEOUT_COMMAND,
+    TIMEOUT_ERASE,
+    TIMEOUT_MD5,
+    TIMEOUT_WRITE,
+    TIMEOUT_CLASSES
+} timeout_class_t;
+#endif
+
+#if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
+/* Compressed packets are sized like esptool does for the ROM loader. The stub accepts
+   larger ones, but they would only grow the packet buffer. */
+#define DEFLATE_PACKET_SIZE_ROM 0x400
+#define DEFLATE_PACKET_SIZE_STUB 0x1000
+
+/* Blocks pulled from a source, the size of the ROM loader flash blocks */
+#define SOURCE_BLOCK_SIZE 0x400
+
+typedef struct {
+    bool passthrough;       // Data is compressed by the caller, the encoder is not used
+    bool auto_level;
+    bool finished;
+    uint32_t remaining;     // Bytes still expected from the caller
+    uint32_t image_size;
+    uint32_t compressed_size;
+    uint32_t compressed_sent;
+    uint32_t packet_size;
+    uint32_t staged;        // Pre-compressed bytes waiting in the packet buffer
+    uint32_t start_ms;
+    uint32_t end_ms;
+    uint32_t transfer_ms;
+    uint32_t packets_sent;
+    uint32_t interval_start_ms;
+    uint32_t interval_transfer_ms;
+} deflate_state_t;
+#endif
+
+/* Everything known about the target a loader is connected to */
+typedef struct {
+    uint32_t generation;
+    const target_registers_t *reg;
+    target_chip_t target;
 
 #if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
-static uint32_t s_flash_write_size = 0;
-static uint32_t s_target_flash_size = 0;
+    uint32_t flash_write_size;
+    uint32_t target_flash_size;
+    uint32_t erased_start;  // Flash from here on is erased, set by a chip erase
+    bool flash_written;     // Set once an image has been started since the connection
+    bool erase_planned;     // Set while esp_loader_flash_images() writes ranges it has erased
+
+    deflate_encoder_t deflate_encoder;
+    uint8_t deflate_packet[DEFLATE_PACKET_SIZE_STUB];
+    deflate_state_t deflate;
+
+    uint8_t source_block[SOURCE_BLOCK_SIZE];
+
+    uint8_t read_packet[SERIAL_FLASHER_READ_PACKET_SIZE];
+    uint32_t read_packet_size;
+    uint32_t read_max_inflight;
 #endif
 
 #if MD5_ENABLED
+    struct MD5Context md5_context;
+    uint32_t start_address;
+    uint32_t image_size;
+    uint8_t image_md5[16];
+    bool image_md5_known;
+#endif
+
+#ifndef SERIAL_FLASHER_INTERFACE_SDIO
+    uint32_t service_time[TIMEOUT_CLASSES]; // ms for commands, ms per MB for the others, 0 if unknown
+    uint32_t service_samples;
+    uint32_t timer_start;
+#endif
+} loader_state_t;
+
+static loader_state_t s_loader[LOADER_COUNT];
 
-static struct MD5Context s_md5_context;
-static uint32_t s_start_address;
-static uint32_t s_image_size;
+static loader_state_t *loader_state(void)
+{
+    loader_state_t *state = &s_loader[loader_slot()];
+
+    if (state->generation != loader_generation()) {
+        memset(state, 0, sizeof(*state));
+        state->generation = loader_generation();
+        state->target = ESP_UNKNOWN_CHIP;
+#if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
+        state->erased_start = UINT32_MAX;
+        state->read_packet_size = SERIAL_FLASHER_READ_PACKET_SIZE;
+        state->read_max_inflight = SERIAL_FLASHER_READ_MAX_INFLIGHT;
+#endif
+    }
+
+    return state;
+}
+
+#if MD5_ENABLED
 
 static inline void init_md5(uint32_t address, uint32_t size)
 {
-    s_start_address = address;
-    s_image_size = size;
-    MD5Init(&s_md5_context);
+    loader_state_t *state = loader_state();
+
+    state->start_address = address;
+    state->image_size = size;
+    state->image_md5_known = false;
+    MD5Init(&state->md5_context);
 }
 
 static inline void md5_update(const uint8_t *data, uint32_t size)
 {
-    MD5Update(&s_md5_context, data, size);
+    MD5Update(&loader_state()->md5_context, data, size);
+}
+
+/* Used when the host never sees the uncompressed image */
+static inline void md5_set_digest(const uint8_t digest[16])
+{
+    loader_state_t *state = loader_state();
+
+    memcpy(state->image_md5, digest, sizeof(state->image_md5));
+    state->image_md5_known = true;
 }
 
 static inline void md5_final(uint8_t digets[16])
 {
-    MD5Final(digets, &s_md5_context);
+    loader_state_t *state = loader_state();
+
+    if (state->image_md5_known) {
+        memcpy(digets, state->image_md5, sizeof(state->image_md5));
+    } else {
+        MD5Final(digets, &state->md5_context);
+    }
 }
 
 #endif
@@ -73,24 +184,120 @@ static uint32_t timeout_per_mb(uint32_t size_bytes, uint32_t time_per_mb)
     return MAX(timeout, DEFAULT_FLASH_TIMEOUT);
 }
 
+#ifndef SERIAL_FLASHER_INTERFACE_SDIO
+/* Service times are measured for the commands of each timeout class during the session.
+   Commands answered right away are modelled by their round trip time, the others by the time
+   per MB of data on top of that. Estimates rise to any slower sample at once and decay towards
+   faster ones by a quarter of the difference, a timeout doubles them. */
+
+static void reset_timeout_model(void)
+{
+    loader_state_t *state = loader_state();
+
+    memset(state->service_time, 0, sizeof(state->service_time));
+    state->service_samples = 0;
+}
+
+/* Starts the timer of a command. With SERIAL_FLASHER_TIMEOUT_MARGIN set the timeout is derived
+   from the service times measured so far, the fixed one is used until there are any. */
+static void start_command_timer(timeout_class_t class, uint32_t size, uint32_t fixed_timeout)
+{
+    loader_state_t *state = loader_state();
+    uint32_t timeout = fixed_timeout;
+
+#if SERIAL_FLASHER_TIMEOUT_MARGIN > 0
+    const uint32_t round_trip = state->service_time[TIMEOUT_COMMAND];
+    if (round_trip != 0 && (class == TIMEOUT_COMMAND || state->service_time[class] != 0)) {
+        const uint64_t expected = round_trip +
+                                  (class == TIMEOUT_COMMAND ? 0 : (uint64_t)state->service_time[class] * size / 1000000);
+        timeout = MIN(MAX(expected * SERIAL_FLASHER_TIMEOUT_MARGIN / 100, SERIAL_FLASHER_TIMEOUT_MIN), UINT32_MAX);
+    }
+#else
+    (void)class;
+    (void)size;
+#endif
+
+    state->timer_start = port_get_time_ms();
+    port_start_timer(timeout);
+}
+
+/* Records the service time of the command started by start_command_timer() */
+static void record_service_time(timeout_class_t class, uint32_t size, esp_loader_error_t result)
+{
+    loader_state_t *state = loader_state();
+    uint32_t *estimate = &state->service_time[class];
+
+    if (result == ESP_LOADER_ERROR_TIMEOUT) {
+        *estimate = *estimate > UINT32_MAX / 2 ? UINT32_MAX : *estimate * 2;
+        return;
+    } else if (result != ESP_LOADER_SUCCESS) {
+        return;
+    }
+
+    // A round trip takes at least a millisecond, the rest of the time is spent on the data
+    const uint32_t elapsed = MAX(port_get_time_ms() - state->timer_start, 1);
+    uint32_t sample = elapsed;
+    if (class != TIMEOUT_COMMAND) {
+        const uint32_t round_trip = state->service_time[TIMEOUT_COMMAND];
+        if (size == 0) {
+            return;
+        }
+        sample = MIN((uint64_t)(elapsed > round_trip ? elapsed - round_trip : 1) * 1000000 / size, UINT32_MAX);
+    }
+
+    if (sample >= *estimate) {
+        *estimate = sample;
+    } else {
+        *estimate -= (*estimate - sample) / 4;
+    }
+    state->service_samples++;
+}
+
+void esp_loader_get_timeout_model(esp_loader_timeout_model_t *model)
+{
+    loader_state_t *state = loader_state();
+
+    model->round_trip_ms = state->service_time[TIMEOUT_COMMAND];
+    model->erase_ms_per_mb = state->service_time[TIMEOUT_ERASE];
+    model->md5_ms_per_mb = state->service_time[TIMEOUT_MD5];
+    model->write_ms_per_mb = state->service_time[TIMEOUT_WRITE];
+    model->write_throughput = state->service_time[TIMEOUT_WRITE] == 0 ? 0 :
+                              (uint64_t)1000000 * 1000 / state->service_time[TIMEOUT_WRITE];
+    model->samples = state->service_samples;
+}
+
+void esp_loader_reset_timeout_model(void)
+{
+    reset_timeout_model();
+}
+#endif /* SERIAL_FLASHER_INTERFACE_SDIO */
+
 esp_loader_error_t esp_loader_connect(esp_loader_connect_args_t *connect_args)
 {
-    loader_port_enter_bootloader();
+    loader_state_t *state = loader_state();
+
+#ifndef SERIAL_FLASHER_INTERFACE_SDIO
+    reset_timeout_model();
+#endif
+
+    port_enter_bootloader();
 
     RETURN_ON_ERROR(loader_initialize_conn(connect_args));
 
-    RETURN_ON_ERROR(loader_detect_chip(&s_target, &s_reg));
+    RETURN_ON_ERROR(loader_detect_chip(&state->target, &state->reg));
 
 #if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
-    s_target_flash_size = 0;
+    state->target_flash_size = 0;
+    state->erased_start = UINT32_MAX;
+    state->flash_written = false;
 
-    if (s_target == ESP8266_CHIP) {
-        loader_port_start_timer(DEFAULT_TIMEOUT);
-        return loader_flash_begin_cmd(0, 0, 0, 0, s_target);
+    if (state->target == ESP8266_CHIP) {
+        port_start_timer(DEFAULT_TIMEOUT);
+        return loader_flash_begin_cmd(0, 0, 0, 0, state->target);
     } else {
         uint32_t spi_config;
-        RETURN_ON_ERROR( loader_read_spi_config(s_target, &spi_config) );
-        loader_port_start_timer(DEFAULT_TIMEOUT);
+        RETURN_ON_ERROR( loader_read_spi_config(state->target, &spi_config) );
+        port_start_timer(DEFAULT_TIMEOUT);
         return loader_spi_attach_cmd(spi_config);
     }
 #endif /* SERIAL_FLASHER_INTERFACE_UART || SERIAL_FLASHER_INTERFACE_USB */
@@ -100,21 +307,26 @@ esp_loader_error_t esp_loader_connect(esp_loader_connect_args_t *connect_args)
 
 target_chip_t esp_loader_get_target(void)
 {
-    return s_target;
+    return loader_state()->target;
 }
 
 #if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
 esp_loader_error_t esp_loader_connect_with_stub(esp_loader_connect_args_t *connect_args)
 {
-    s_target_flash_size = 0;
+    loader_state_t *state = loader_state();
 
-    loader_port_enter_bootloader();
+    state->target_flash_size = 0;
+    state->erased_start = UINT32_MAX;
+    state->flash_written = false;
+    reset_timeout_model();
+
+    port_enter_bootloader();
 
     RETURN_ON_ERROR(loader_initialize_conn(connect_args));
 
-    RETURN_ON_ERROR(loader_detect_chip(&s_target, &s_reg));
+    RETURN_ON_ERROR(loader_detect_chip(&state->target, &state->reg));
 
-    RETURN_ON_ERROR(loader_run_stub(s_target));
+    RETURN_ON_ERROR(loader_run_stub(state->target));
 
     return ESP_LOADER_SUCCESS;
 }
@@ -123,24 +335,29 @@ esp_loader_error_t esp_loader_connect_with_stub(esp_loader_connect_args_t *conne
 esp_loader_error_t esp_loader_connect_secure_download_mode(esp_loader_connect_args_t *connect_args,
         const uint32_t flash_size, const target_chip_t target_chip)
 {
-    s_target_flash_size = flash_size;
-    s_target = target_chip;
+    loader_state_t *state = loader_state();
+
+    state->target_flash_size = flash_size;
+    state->erased_start = UINT32_MAX;
+    state->flash_written = false;
+    state->target = target_chip;
+    reset_timeout_model();
 
-    loader_port_enter_bootloader();
+    port_enter_bootloader();
 
     RETURN_ON_ERROR(loader_initialize_conn(connect_args));
 
-    if (s_target == ESP_UNKNOWN_CHIP) {
-        RETURN_ON_ERROR(loader_detect_chip(&s_target, &s_reg));
+    if (state->target == ESP_UNKNOWN_CHIP) {
+        RETURN_ON_ERROR(loader_detect_chip(&state->target, &state->reg));
     }
 
-    if (s_target == ESP8266_CHIP) {
-        loader_port_start_timer(DEFAULT_TIMEOUT);
-        return loader_flash_begin_cmd(0, 0, 0, 0, s_target);
+    if (state->target == ESP8266_CHIP) {
+        port_start_timer(DEFAULT_TIMEOUT);
+        return loader_flash_begin_cmd(0, 0, 0, 0, state->target);
     } else {
         uint32_t spi_config;
-        RETURN_ON_ERROR( loader_read_spi_config(s_target, &spi_config) );
-        loader_port_start_timer(DEFAULT_TIMEOUT);
+        RETURN_ON_ERROR( loader_read_spi_config(state->target, &spi_config) );
+        port_start_timer(DEFAULT_TIMEOUT);
         return loader_spi_attach_cmd(spi_config);
     }
 
@@ -150,11 +367,13 @@ esp_loader_error_t esp_loader_connect_secure_download_mode(esp_loader_connect_ar
 
 static esp_loader_error_t spi_set_data_lengths(size_t mosi_bits, size_t miso_bits)
 {
+    loader_state_t *state = loader_state();
+
     if (mosi_bits > 0) {
-        RETURN_ON_ERROR( esp_loader_write_register(s_reg->mosi_dlen, mosi_bits - 1) );
+        RETURN_ON_ERROR( esp_loader_write_register(state->reg->mosi_dlen, mosi_bits - 1) );
     }
     if (miso_bits > 0) {
-        RETURN_ON_ERROR( esp_loader_write_register(s_reg->miso_dlen, miso_bits - 1) );
+        RETURN_ON_ERROR( esp_loader_write_register(state->reg->miso_dlen, miso_bits - 1) );
     }
 
     return ESP_LOADER_SUCCESS;
@@ -162,13 +381,16 @@ static esp_loader_error_t spi_set_data_lengths(size_t mosi_bits, size_t miso_bit
 
 static esp_loader_error_t spi_set_data_lengths_8266(size_t mosi_bits, size_t miso_bits)
 {
+    loader_state_t *state = loader_state();
     uint32_t mosi_mask = (mosi_bits == 0) ? 0 : mosi_bits - 1;
     uint32_t miso_mask = (miso_bits == 0) ? 0 : miso_bits - 1;
-    return esp_loader_write_register(s_reg->usr1, (miso_mask << 8) | (mosi_mask << 17));
+    return esp_loader_write_register(state->reg->usr1, (miso_mask << 8) | (mosi_mask << 17));
 }
 
 static esp_loader_error_t spi_flash_command(spi_flash_cmd_t cmd, void *data_tx, size_t tx_size, void *data_rx, size_t rx_size)
 {
+    loader_state_t *state = loader_state();
+
     assert(rx_size <= 32); // Reading more than 32 bits back from a SPI flash operation is unsupported
     assert(tx_size <= 64); // Writing more than 64 bytes of data with one SPI command is unsupported
 
@@ -181,10 +403,10 @@ static esp_loader_error_t spi_flash_command(spi_flash_cmd_t cmd, void *data_tx,
     // Save SPI configuration
     uint32_t old_spi_usr;
     uint32_t old_spi_usr2;
-    RETURN_ON_ERROR( esp_loader_read_register(s_reg->usr, &old_spi_usr) );
-    RETURN_ON_ERROR( esp_loader_read_register(s_reg->usr2, &old_spi_usr2) );
+    RETURN_ON_ERROR( esp_loader_read_register(state->reg->usr, &old_spi_usr) );
+    RETURN_ON_ERROR( esp_loader_read_register(state->reg->usr2, &old_spi_usr2) );
 
-    if (s_target == ESP8266_CHIP) {
+    if (state->target == ESP8266_CHIP) {
         RETURN_ON_ERROR( spi_set_data_lengths_8266(tx_size, rx_size) );
     } else {
         RETURN_ON_ERROR( spi_set_data_lengths(tx_size, rx_size) );
@@ -199,16 +421,16 @@ static esp_loader_error_t spi_flash_command(spi_flash_cmd_t cmd, void *data_tx,
         usr_reg |= SPI_USR_MOSI;
     }
 
-    RETURN_ON_ERROR( esp_loader_write_register(s_reg->usr, usr_reg) );
-    RETURN_ON_ERROR( esp_loader_write_register(s_reg->usr2, usr_reg_2 ) );
+    RETURN_ON_ERROR( esp_loader_write_register(state->reg->usr, usr_reg) );
+    RETURN_ON_ERROR( esp_loader_write_register(state->reg->usr2, usr_reg_2 ) );
 
     if (tx_size == 0) {
         // clear data register before we read it
-        RETURN_ON_ERROR( esp_loader_write_register(s_reg->w0, 0) );
+        RETURN_ON_ERROR( esp_loader_write_register(state->reg->w0, 0) );
     } else {
         uint32_t *data = (uint32_t *)data_tx;
         uint32_t words_to_write = (tx_size + 31) / (8 * 4);
-        uint32_t data_reg_addr = s_reg->w0;
+        uint32_t data_reg_addr = state->reg->w0;
 
         while (words_to_write--) {
             uint32_t word = *data++;
@@ -217,12 +439,12 @@ static esp_loader_error_t spi_flash_command(spi_flash_cmd_t cmd, void *data_tx,
         }
     }
 
-    RETURN_ON_ERROR( esp_loader_write_register(s_reg->cmd, SPI_CMD_USR) );
+    RETURN_ON_ERROR( esp_loader_write_register(state->reg->cmd, SPI_CMD_USR) );
 
     uint32_t trials = 10;
     while (trials--) {
         uint32_t cmd_reg;
-        RETURN_ON_ERROR( esp_loader_read_register(s_reg->cmd, &cmd_reg) );
+        RETURN_ON_ERROR( esp_loader_read_register(state->reg->cmd, &cmd_reg) );
         if ((cmd_reg & SPI_CMD_USR) == 0) {
             break;
         }
@@ -232,11 +454,11 @@ static esp_loader_error_t spi_flash_command(spi_flash_cmd_t cmd, void *data_tx,
         return ESP_LOADER_ERROR_TIMEOUT;
     }
 
-    RETURN_ON_ERROR( esp_loader_read_register(s_reg->w0, data_rx) );
+    RETURN_ON_ERROR( esp_loader_read_register(state->reg->w0, data_rx) );
 
     // Restore SPI configuration
-    RETURN_ON_ERROR( esp_loader_write_register(s_reg->usr, old_spi_usr) );
-    RETURN_ON_ERROR( esp_loader_write_register(s_reg->usr2, old_spi_usr2) );
+    RETURN_ON_ERROR( esp_loader_write_register(state->reg->usr, old_spi_usr) );
+    RETURN_ON_ERROR( esp_loader_write_register(state->reg->usr2, old_spi_usr2) );
 
     return ESP_LOADER_SUCCESS;
 }
@@ -316,67 +538,165 @@ esp_loader_error_t esp_loader_flash_detect_size(uint32_t *flash_size)
     return ESP_LOADER_ERROR_UNSUPPORTED_CHIP;
 }
 
-esp_loader_error_t esp_loader_flash_start(uint32_t offset, uint32_t image_size, uint32_t block_size)
+static esp_loader_error_t prepare_flash_params(uint32_t offset, uint32_t image_size)
 {
-    s_flash_write_size = block_size;
-
-    // Both the address and image size must be aligned to 4 bytes
-    if (offset % 4 != 0 || image_size % 4 != 0) {
-        return ESP_LOADER_ERROR_INVALID_PARAM;
-    }
+    loader_state_t *state = loader_state();
 
     /* Flash size will be known in advance if we're in secure download mode or we already read it*/
-    if (s_target_flash_size == 0) {
-        if (esp_loader_flash_detect_size(&s_target_flash_size) == ESP_LOADER_SUCCESS) {
-            if (image_size + offset > s_target_flash_size) {
+    if (state->target_flash_size == 0) {
+        if (esp_loader_flash_detect_size(&state->target_flash_size) == ESP_LOADER_SUCCESS) {
+            if (image_size + offset > state->target_flash_size) {
                 return ESP_LOADER_ERROR_IMAGE_SIZE;
             }
 
-            loader_port_start_timer(DEFAULT_TIMEOUT);
-            RETURN_ON_ERROR(loader_spi_parameters(s_target_flash_size));
+            port_start_timer(DEFAULT_TIMEOUT);
+            RETURN_ON_ERROR(loader_spi_parameters(state->target_flash_size));
         } else {
-            loader_port_debug_print("Flash size detection failed, falling back to default");
+            port_debug_print("Flash size detection failed, falling back to default");
+        }
+    }
+
+    return ESP_LOADER_SUCCESS;
+}
+
+static bool erase_cmds_supported(void)
+{
+    return esp_stub_get_running() || loader_state()->target == ESP32_CHIP;
+}
+
+esp_loader_error_t esp_loader_erase_chip(void)
+{
+    loader_state_t *state = loader_state();
+
+    if (!erase_cmds_supported()) {
+        return ESP_LOADER_ERROR_UNSUPPORTED_FUNC;
+    }
+
+    /* Erasing the whole chip takes time proportional to its size */
+    const uint32_t flash_size = state->target_flash_size != 0 ? state->target_flash_size : CHIP_ERASE_DEFAULT_FLASH_SIZE;
+    start_command_timer(TIMEOUT_ERASE, flash_size, timeout_per_mb(flash_size, CHIP_ERASE_TIMEOUT_PER_MB));
+    const esp_loader_error_t result = loader_erase_flash_cmd();
+    record_service_time(TIMEOUT_ERASE, flash_size, result);
+    RETURN_ON_ERROR(result);
+
+    state->erased_start = 0;
+
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t esp_loader_erase_region(uint32_t offset, uint32_t size)
+{
+    if (!erase_cmds_supported()) {
+        return ESP_LOADER_ERROR_UNSUPPORTED_FUNC;
+    }
+
+    if (offset % FLASH_SECTOR_SIZE != 0 || size % FLASH_SECTOR_SIZE != 0 || size == 0) {
+        return ESP_LOADER_ERROR_INVALID_PARAM;
+    }
+
+    start_command_timer(TIMEOUT_ERASE, size, timeout_per_mb(size, ERASE_REGION_TIMEOUT_PER_MB));
+    const esp_loader_error_t result = loader_erase_region_cmd(offset, size);
+    record_service_time(TIMEOUT_ERASE, size, result);
+
+    return result;
+}
+
+/* Erases the whole chip once an image covers SERIAL_FLASHER_CHIP_ERASE_THRESHOLD percent of it,
+   as long as it is the first image of the session, so that no image written before is lost, and
+   clears the erase size the ROM gets for images written to flash that is erased already, by
+   the chip erase or the plan of esp_loader_flash_images().
+   The stub takes the size as the number of bytes it will accept, so it always gets all of it. */
+static esp_loader_error_t prepare_erase(uint32_t offset, uint32_t image_size, uint32_t *erase_size)
+{
+    loader_state_t *state = loader_state();
+
+#if SERIAL_FLASHER_CHIP_ERASE_THRESHOLD > 0
+    if (!state->erase_planned && !state->flash_written && state->erased_start == UINT32_MAX &&
+            state->target_flash_size != 0 && erase_cmds_supported() &&
+            (uint64_t)image_size * 100 >= (uint64_t)state->target_flash_size * SERIAL_FLASHER_CHIP_ERASE_THRESHOLD) {
+        RETURN_ON_ERROR(esp_loader_erase_chip());
+    }
+#endif
+    state->flash_written = true;
+
+    if (state->erase_planned && !esp_stub_get_running()) {
+        *erase_size = 0;
+    }
+
+    if (state->erased_start != UINT32_MAX) {
+        if (offset >= state->erased_start && !esp_stub_get_running()) {
+            *erase_size = 0;
         }
+        state->erased_start = MAX(state->erased_start, ROUNDUP(offset + image_size, FLASH_SECTOR_SIZE));
+    }
+
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t esp_loader_flash_start(uint32_t offset, uint32_t image_size, uint32_t block_size)
+{
+    loader_state_t *state = loader_state();
+
+    state->flash_write_size = block_size;
+
+    // Both the address and image size must be aligned to 4 bytes
+    if (offset % 4 != 0 || image_size % 4 != 0) {
+        return ESP_LOADER_ERROR_INVALID_PARAM;
     }
 
+    RETURN_ON_ERROR(prepare_flash_params(offset, image_size));
+
 #if MD5_ENABLED
     init_md5(offset, image_size);
 #endif
 
-    bool encryption_in_cmd = encryption_in_begin_flash_cmd(s_target) && !esp_stub_get_running();
-    const uint32_t erase_size = calc_erase_size(esp_loader_get_target(), offset, image_size);
+    bool encryption_in_cmd = encryption_in_begin_flash_cmd(state->target) && !esp_stub_get_running();
+    uint32_t erase_size = calc_erase_size(esp_loader_get_target(), offset, image_size);
+    RETURN_ON_ERROR(prepare_erase(offset, image_size, &erase_size));
     const uint32_t blocks_to_write = (image_size + block_size - 1) / block_size;
 
-    const uint32_t erase_region_timeout_per_mb = 10000;
-    loader_port_start_timer(timeout_per_mb(erase_size, erase_region_timeout_per_mb));
-    return loader_flash_begin_cmd(offset, erase_size, block_size, blocks_to_write, encryption_in_cmd);
+    // Only the ROM erases before it responds, the stub erases as it writes
+    start_command_timer(TIMEOUT_ERASE, erase_size, timeout_per_mb(erase_size, ERASE_REGION_TIMEOUT_PER_MB));
+    const esp_loader_error_t result = loader_flash_begin_cmd(offset, erase_size, block_size, blocks_to_write,
+                                      encryption_in_cmd);
+    if (!esp_stub_get_running()) {
+        record_service_time(TIMEOUT_ERASE, erase_size, result);
+    }
+
+    return result;
 }
 
 
-esp_loader_error_t esp_loader_flash_write(void *payload, uint32_t size)
+esp_loader_error_t esp_loader_flash_write(const void *payload, uint32_t size)
 {
-    uint32_t padding_bytes = s_flash_write_size - size;
-    uint8_t *data = (uint8_t *)payload;
-    uint32_t padding_index = size;
+    loader_state_t *state = loader_state();
 
-    if (size > s_flash_write_size) {
+    if (size > state->flash_write_size) {
         return ESP_LOADER_ERROR_INVALID_PARAM;
     }
 
-    const uint8_t padding_pattern = 0xFF;
-    while (padding_bytes--) {
-        data[padding_index++] = padding_pattern;
-    }
+    // The rest of the block is padded while it is sent, the payload is left untouched
+    const uint8_t *data = (const uint8_t *)payload;
+    const uint32_t padding_bytes = state->flash_write_size - size;
 
+    // The block is hashed while it is sent, on the first attempt only
 #if MD5_ENABLED
-    md5_update(payload, (size + 3) & ~3);
+    struct MD5Context *md5 = &state->md5_context;
+#else
+    struct MD5Context *md5 = NULL;
 #endif
 
+    /* A block takes more than the default timeout on the wire at low rates, and the stub erases
+       ahead of the data it writes */
+    const uint32_t timeout = timeout_per_mb(state->flash_write_size, WRITE_TIMEOUT_PER_MB);
+
     unsigned int attempt = 0;
     esp_loader_error_t result = ESP_LOADER_ERROR_FAIL;
     do {
-        loader_port_start_timer(DEFAULT_TIMEOUT);
-        result = loader_flash_data_cmd(data, s_flash_write_size);
+        start_command_timer(TIMEOUT_WRITE, state->flash_write_size, timeout);
+        result = loader_flash_data_cmd(data, size, padding_bytes, attempt == 0 ? md5 : NULL,
+                                       (size + 3) & ~3);
+        record_service_time(TIMEOUT_WRITE, state->flash_write_size, result);
         attempt++;
     } while (result != ESP_LOADER_SUCCESS && attempt < SERIAL_FLASHER_WRITE_BLOCK_RETRIES);
 
@@ -386,180 +706,629 @@ esp_loader_error_t esp_loader_flash_write(void *payload, uint32_t size)
 
 esp_loader_error_t esp_loader_flash_finish(bool reboot)
 {
-    loader_port_start_timer(DEFAULT_TIMEOUT);
+    port_start_timer(DEFAULT_TIMEOUT);
 
     return loader_flash_end_cmd(!reboot);
 }
 
 
-esp_loader_error_t esp_loader_change_transmission_rate_stub(const uint32_t old_transmission_rate,
-        const uint32_t new_transmission_rate)
+/* Uncompressed block sizes esptool uses with the ROM loader and the stub */
+#define FLASH_WRITE_SIZE_ROM 0x400
+#define FLASH_WRITE_SIZE_STUB 0x4000
+
+esp_loader_error_t esp_loader_flash_writer_start(esp_loader_flash_writer_t *writer, uint32_t offset,
+        uint32_t image_size, void *buffer, uint32_t buffer_size)
 {
-    if (s_target == ESP8266_CHIP || !esp_stub_get_running()) {
-        return ESP_LOADER_ERROR_UNSUPPORTED_FUNC;
-    }
+    const uint32_t block_size = MIN(esp_stub_get_running() ? FLASH_WRITE_SIZE_STUB : FLASH_WRITE_SIZE_ROM,
+                                    buffer_size - buffer_size % 4);
 
-    loader_port_start_timer(DEFAULT_TIMEOUT);
+    if (buffer == NULL || block_size == 0 || image_size == 0) {
+        return ESP_LOADER_ERROR_INVALID_PARAM;
+    }
 
-    esp_loader_error_t err = loader_change_baudrate_cmd(new_transmission_rate, old_transmission_rate);
+    RETURN_ON_ERROR(esp_loader_flash_start(offset, ROUNDUP(image_size, 4), block_size));
 
-    // Wait for the stub to be ready to receive data.
-    if (err == ESP_LOADER_SUCCESS) {
-        loader_port_delay_ms(25);
-    }
+    writer->buffer = (uint8_t *)buffer;
+    writer->block_size = block_size;
+    writer->buffered = 0;
+    writer->remaining = image_size;
 
-    return err;
+    return ESP_LOADER_SUCCESS;
 }
 
-static uint32_t byte_popcnt(uint8_t byte)
+
+esp_loader_error_t esp_loader_flash_writer_append(esp_loader_flash_writer_t *writer, const void *data,
+        uint32_t size)
 {
-    uint32_t cnt = 0;
-    for (uint32_t bit = 0; bit < 8; bit++) {
-        cnt += byte & 0x01;
-        byte >>= 1;
+    if (size > writer->remaining) {
+        return ESP_LOADER_ERROR_INVALID_PARAM;
     }
 
-    return cnt;
-}
+    const uint8_t *bytes = (const uint8_t *)data;
+    writer->remaining -= size;
 
-esp_loader_error_t esp_loader_get_security_info(esp_loader_target_security_info_t *security_info)
-{
-    loader_port_start_timer(SHORT_TIMEOUT);
+    while (size > 0) {
+        if (writer->buffered == 0 && size >= writer->block_size) {
+            RETURN_ON_ERROR(esp_loader_flash_write(bytes, writer->block_size));
+            bytes += writer->block_size;
+            size -= writer->block_size;
+            continue;
+        }
 
-    get_security_info_response_data_t resp;
-    uint32_t response_received_size = 0;
-    RETURN_ON_ERROR(loader_get_security_info_cmd(&resp, &response_received_size));
+        const uint32_t to_buffer = MIN(size, writer->block_size - writer->buffered);
+        memcpy(&writer->buffer[writer->buffered], bytes, to_buffer);
+        writer->buffered += to_buffer;
+        bytes += to_buffer;
+        size -= to_buffer;
 
-    if (response_received_size == sizeof(get_security_info_response_data_t)) {
-        security_info->target_chip = target_from_chip_id(resp.chip_id);
-        security_info->eco_version = resp.eco_version;
-    } else if (response_received_size == sizeof(get_security_info_response_data_t) - 8) {
-        security_info->target_chip = ESP32S2_CHIP;
-        security_info->eco_version = 0;
-    } else {
-        return ESP_LOADER_ERROR_INVALID_RESPONSE;
+        if (writer->buffered == writer->block_size) {
+            writer->buffered = 0;
+            RETURN_ON_ERROR(esp_loader_flash_write(writer->buffer, writer->block_size));
+        }
     }
 
-    security_info->secure_boot_enabled =
-        (resp.flags & GET_SECURITY_INFO_SECURE_BOOT_EN) != 0;
-    security_info->secure_boot_aggressive_revoke_enabled =
-        (resp.flags & GET_SECURITY_INFO_SECURE_BOOT_AGGRESSIVE_REVOKE) != 0;
-    security_info->secure_download_mode_enabled =
-        (resp.flags & GET_SECURITY_INFO_SECURE_DOWNLOAD_ENABLE) != 0;
-    security_info->secure_boot_revoked_keys[0] =
-        (resp.flags & GET_SECURITY_INFO_SECURE_BOOT_KEY_REVOKE0) != 0;
-    security_info->secure_boot_revoked_keys[1] =
-        (resp.flags & GET_SECURITY_INFO_SECURE_BOOT_KEY_REVOKE1) != 0;
-    security_info->secure_boot_revoked_keys[2] =
-        (resp.flags & GET_SECURITY_INFO_SECURE_BOOT_KEY_REVOKE2) != 0;
-    security_info->jtag_software_disabled =
-        (resp.flags & GET_SECURITY_INFO_SOFT_DIS_JTAG) != 0;
-    security_info->jtag_hardware_disabled =
-        (resp.flags & GET_SECURITY_INFO_HARD_DIS_JTAG) != 0;
-    security_info->usb_disabled = (resp.flags & GET_SECURITY_INFO_DIS_USB) != 0;
-
-    // If the number of set bits in key_purposes is odd, flash is encrypted
-    uint32_t key_purposes_bit_cnt = 0;
-    for (size_t byte = 0; byte < sizeof(resp.key_purposes); byte++) {
-        key_purposes_bit_cnt += byte_popcnt(resp.key_purposes[byte]);
+    // The last block is padded as it is sent
+    if (writer->remaining == 0 && writer->buffered > 0) {
+        const uint32_t buffered = writer->buffered;
+        writer->buffered = 0;
+        RETURN_ON_ERROR(esp_loader_flash_write(writer->buffer, buffered));
     }
-    security_info->flash_encryption_enabled = key_purposes_bit_cnt % 2;
-
-    security_info->dcache_in_uart_download_disabled =
-        (resp.flags & GET_SECURITY_INFO_DIS_DOWNLOAD_DCACHE) != 0;
-    security_info->icache_in_uart_download_disabled =
-        (resp.flags & GET_SECURITY_INFO_DIS_DOWNLOAD_ICACHE) != 0;
 
     return ESP_LOADER_SUCCESS;
 }
 
-static esp_loader_error_t flash_read_stub(uint8_t *dest, uint32_t address, uint32_t length)
-{
-    uint8_t buf[256]; // Hardcoded for now, decent tradeoff between speed and stack usage
-    size_t recv_size = 0;
-    struct MD5Context md5_context;
-    MD5Init(&md5_context);
 
-    // The flasher stub requires reads to be aligned to 4 bytes.
-    // The solution is to read more than is needed and discard the unecessary bytes.
-    const uint32_t seek_back_len = address % 4;
-    address -= seek_back_len;
-    length += seek_back_len;
+#define DEFLATE_DEFAULT_LEVEL 6
+#define DEFLATE_AUTO_LEVEL_MIN 1
+#define DEFLATE_AUTO_LEVEL_INTERVAL 4 // Packets sent between compression level adjustments
 
-    const uint32_t overread_len = ROUNDUP(length, 4) - length;
-    length += overread_len;
+/* The host compresses and sends sequentially, so compression time adds directly to the
+   flashing time. Lower the level while compressing a packet takes a sizeable share of the
+   time needed to transfer it and raise it while the link is by far the bottleneck. */
+static void deflate_adjust_level(uint32_t now)
+{
+    loader_state_t *state = loader_state();
+    const uint32_t elapsed = now - state->deflate.interval_start_ms;
+    const uint32_t transfer = state->deflate.transfer_ms - state->deflate.interval_transfer_ms;
+    const uint32_t compress = elapsed - transfer;
 
-    loader_port_start_timer(DEFAULT_TIMEOUT);
-    loader_flash_read_stub_cmd(address, length, sizeof(buf));
+    state->deflate.interval_start_ms = now;
+    state->deflate.interval_transfer_ms = state->deflate.transfer_ms;
 
-    uint32_t copy_dest_start = 0;
-    int32_t remaining = length;
-    while (remaining > 0) {
-        loader_port_start_timer(DEFAULT_TIMEOUT);
-        const uint32_t to_receive = MIN(remaining, sizeof(buf));
-        RETURN_ON_ERROR(SLIP_receive_packet(buf, to_receive, &recv_size));
+    // No clock provided by the port
+    if (elapsed == 0) {
+        return;
+    }
 
-        if (recv_size != to_receive) {
-            return ESP_LOADER_ERROR_INVALID_RESPONSE;
-        }
+    uint8_t level = state->deflate_encoder.level;
+    if (compress * 2 > transfer && level > DEFLATE_AUTO_LEVEL_MIN) {
+        level--;
+    } else if (compress * 8 < transfer && level < DEFLATE_LEVEL_MAX) {
+        level++;
+    }
 
-        MD5Update(&md5_context, buf, recv_size);
+    deflate_encoder_set_level(&state->deflate_encoder, level);
+}
 
-        // Handle seek back and overread.
-        uint32_t copy_start = 0;
-        uint32_t copy_length = recv_size;
+static uint32_t deflate_uncompressed_size(uint32_t compressed)
+{
+    loader_state_t *state = loader_state();
+    uint64_t uncompressed;
+    if (state->deflate.passthrough) {
+        uncompressed = (uint64_t)compressed * state->deflate.image_size / state->deflate.compressed_size;
+    } else {
+        const uint32_t compressed_total = MAX(state->deflate_encoder.total_out, 1);
+        uncompressed = (uint64_t)compressed * state->deflate_encoder.total_in / compressed_total;
+    }
 
-        const bool first_read = remaining == length;
-        if (first_read) {
-            copy_start += seek_back_len;
-            copy_length -= seek_back_len;
-        }
+    return MIN(uncompressed, UINT32_MAX);
+}
 
-        const bool last_read = remaining - recv_size <= 0;
-        if (last_read) {
-            copy_length -= overread_len;
-        }
+static esp_loader_error_t deflate_send_packet(void *ctx, const uint8_t *data, size_t size)
+{
+    loader_state_t *state = loader_state();
 
-        memcpy(&dest[copy_dest_start], &buf[copy_start], copy_length);
-        copy_dest_start += copy_length;
+    (void)ctx;
 
-        remaining -= recv_size;
+    /* The target has to inflate and write the whole packet before it responds */
+    const uint32_t uncompressed = deflate_uncompressed_size(size);
+    const uint32_t timeout = timeout_per_mb(uncompressed, DEFLATE_WRITE_TIMEOUT_PER_MB);
 
-        // Ack by sending back total received byte count
-        const uint32_t bytes_recv = length - remaining;
-        loader_port_start_timer(DEFAULT_TIMEOUT);
-        RETURN_ON_ERROR(SLIP_send_delimiter());
-        RETURN_ON_ERROR(SLIP_send((const uint8_t *)&bytes_recv, sizeof(bytes_recv)));
-        RETURN_ON_ERROR(SLIP_send_delimiter());
-    }
+    const uint32_t start = port_get_time_ms();
 
-    uint8_t md5_calc[16];
-    MD5Final(md5_calc, &md5_context);
+    unsigned int attempt = 0;
+    esp_loader_error_t result = ESP_LOADER_ERROR_FAIL;
+    do {
+        start_command_timer(TIMEOUT_WRITE, uncompressed, timeout);
+        result = loader_flash_defl_data_cmd(data, size);
+        record_service_time(TIMEOUT_WRITE, uncompressed, result);
+        attempt++;
+    } while (result != ESP_LOADER_SUCCESS && attempt < SERIAL_FLASHER_WRITE_BLOCK_RETRIES);
 
-    loader_port_start_timer(DEFAULT_TIMEOUT);
-    uint8_t md5_recv[16];
-    RETURN_ON_ERROR(SLIP_receive_packet(md5_recv, sizeof(md5_recv), &recv_size));
+    const uint32_t now = port_get_time_ms();
+    state->deflate.transfer_ms += now - start;
+    state->deflate.packets_sent++;
+    state->deflate.compressed_sent += size;
 
-    if (recv_size != sizeof(md5_recv) || memcmp(md5_calc, md5_recv, sizeof(md5_calc))) {
-        return ESP_LOADER_ERROR_INVALID_MD5;
+    if (state->deflate.auto_level && state->deflate.packets_sent % DEFLATE_AUTO_LEVEL_INTERVAL == 0) {
+        deflate_adjust_level(now);
     }
 
-    return ESP_LOADER_SUCCESS;
+    return result;
 }
 
-esp_loader_error_t esp_loader_flash_read(uint8_t *dest, uint32_t address, uint32_t length)
+/* Sends FLASH_DEFL_BEGIN. A compressed size of 0 means it is not known in advance. */
+static esp_loader_error_t deflate_begin(uint32_t offset, uint32_t padded_size, uint32_t compressed_size)
 {
-    /* Flash size will be known in advance if we're in secure download mode or we already read it*/
-    if (s_target_flash_size == 0) {
-        if (esp_loader_flash_detect_size(&s_target_flash_size) == ESP_LOADER_SUCCESS) {
-            if (address + length >= s_target_flash_size) {
+    loader_state_t *state = loader_state();
+
+    RETURN_ON_ERROR(prepare_flash_params(offset, padded_size));
+
+    const bool stub_running = esp_stub_get_running();
+    const uint32_t packet_size = stub_running ? DEFLATE_PACKET_SIZE_STUB : DEFLATE_PACKET_SIZE_ROM;
+
+    /* Without the compressed size, announce the worst case. The target only uses
+       the packet count to tell whether more input is to be expected. */
+    if (compressed_size == 0) {
+        compressed_size = padded_size + padded_size / 8 + 64;
+    }
+    const uint32_t packets_to_write = (compressed_size + packet_size - 1) / packet_size;
+
+    /* The stub erases the flash as it writes, the ROM erases everything at once */
+    uint32_t erase_size = stub_running ? padded_size : ROUNDUP(padded_size, packet_size);
+    RETURN_ON_ERROR(prepare_erase(offset, padded_size, &erase_size));
+    const bool encryption_in_cmd = encryption_in_begin_flash_cmd(state->target) && !stub_running;
+
+    start_command_timer(TIMEOUT_ERASE, erase_size, timeout_per_mb(erase_size, ERASE_REGION_TIMEOUT_PER_MB));
+    const esp_loader_error_t result = loader_flash_defl_begin_cmd(offset, erase_size, packet_size,
+                                      packets_to_write, encryption_in_cmd);
+    if (!stub_running) {
+        record_service_time(TIMEOUT_ERASE, erase_size, result);
+    }
+    RETURN_ON_ERROR(result);
+
+    memset(&state->deflate, 0, sizeof(state->deflate));
+    state->deflate.image_size = padded_size;
+    state->deflate.packet_size = packet_size;
+    state->deflate.start_ms = port_get_time_ms();
+    state->deflate.interval_start_ms = state->deflate.start_ms;
+
+    return ESP_LOADER_SUCCESS;
+}
+
+static void deflate_complete(void)
+{
+    loader_state_t *state = loader_state();
+
+    state->deflate.finished = true;
+    state->deflate.end_ms = port_get_time_ms();
+}
+
+
+esp_loader_error_t esp_loader_flash_deflate_start(uint32_t offset, uint32_t image_size, int32_t level)
+{
+    loader_state_t *state = loader_state();
+
+    if (state->target == ESP8266_CHIP && !esp_stub_get_running()) {
+        return ESP_LOADER_ERROR_UNSUPPORTED_FUNC;
+    }
+
+    if (offset % 4 != 0 || image_size == 0 ||
+            level < ESP_LOADER_DEFLATE_LEVEL_AUTO || level > DEFLATE_LEVEL_MAX) {
+        return ESP_LOADER_ERROR_INVALID_PARAM;
+    }
+
+    // The image is padded to a multiple of 4 bytes, just like with esp_loader_flash_write()
+    const uint32_t padded_size = ROUNDUP(image_size, 4);
+
+    RETURN_ON_ERROR(deflate_begin(offset, padded_size, 0));
+
+#if MD5_ENABLED
+    init_md5(offset, padded_size);
+#endif
+
+    state->deflate.remaining = image_size;
+    state->deflate.auto_level = level == ESP_LOADER_DEFLATE_LEVEL_AUTO;
+
+    deflate_encoder_init(&state->deflate_encoder, state->deflate.auto_level ? DEFLATE_DEFAULT_LEVEL : level,
+                         state->deflate_packet, state->deflate.packet_size, deflate_send_packet, NULL);
+
+    return ESP_LOADER_SUCCESS;
+}
+
+
+esp_loader_error_t esp_loader_flash_deflate_write(const void *payload, uint32_t size)
+{
+    loader_state_t *state = loader_state();
+
+    if (state->deflate.passthrough || size > state->deflate.remaining) {
+        return ESP_LOADER_ERROR_INVALID_PARAM;
+    }
+
+#if MD5_ENABLED
+    md5_update(payload, size);
+#endif
+
+    RETURN_ON_ERROR(deflate_encoder_write(&state->deflate_encoder, payload, size));
+    state->deflate.remaining -= size;
+
+    if (state->deflate.remaining == 0 && !state->deflate.finished) {
+        const uint8_t padding[3] = { 0xFF, 0xFF, 0xFF };
+        const uint32_t padding_bytes = ROUNDUP(state->deflate_encoder.total_in, 4) - state->deflate_encoder.total_in;
+
+#if MD5_ENABLED
+        md5_update(padding, padding_bytes);
+#endif
+
+        RETURN_ON_ERROR(deflate_encoder_write(&state->deflate_encoder, padding, padding_bytes));
+        RETURN_ON_ERROR(deflate_encoder_finish(&state->deflate_encoder));
+
+        deflate_complete();
+    }
+
+    return ESP_LOADER_SUCCESS;
+}
+
+
+esp_loader_error_t esp_loader_flash_precompressed_start(uint32_t offset, uint32_t image_size,
+        uint32_t compressed_size, const uint8_t *image_md5)
+{
+    loader_state_t *state = loader_state();
+
+    if (state->target == ESP8266_CHIP && !esp_stub_get_running()) {
+        return ESP_LOADER_ERROR_UNSUPPORTED_FUNC;
+    }
+
+    if (offset % 4 != 0 || image_size % 4 != 0 || image_size == 0 || compressed_size == 0) {
+        return ESP_LOADER_ERROR_INVALID_PARAM;
+    }
+
+#if MD5_ENABLED
+    if (image_md5 == NULL) {
+        return ESP_LOADER_ERROR_INVALID_PARAM;
+    }
+#else
+    (void)image_md5;
+#endif
+
+    RETURN_ON_ERROR(deflate_begin(offset, image_size, compressed_size));
+
+#if MD5_ENABLED
+    init_md5(offset, image_size);
+    md5_set_digest(image_md5);
+#endif
+
+    state->deflate.passthrough = true;
+    state->deflate.compressed_size = compressed_size;
+    state->deflate.remaining = compressed_size;
+
+    return ESP_LOADER_SUCCESS;
+}
+
+
+esp_loader_error_t esp_loader_flash_precompressed_write(const void *payload, uint32_t size)
+{
+    loader_state_t *state = loader_state();
+
+    if (!state->deflate.passthrough || size > state->deflate.remaining) {
+        return ESP_LOADER_ERROR_INVALID_PARAM;
+    }
+
+    const uint8_t *data = (const uint8_t *)payload;
+    state->deflate.remaining -= size;
+
+    /* Full packets are sent straight from the caller's buffer, only fragments get copied
+       so that every packet but the last one has the size announced to the target */
+    while (size > 0) {
+        if (state->deflate.staged == 0 && size >= state->deflate.packet_size) {
+            RETURN_ON_ERROR(deflate_send_packet(NULL, data, state->deflate.packet_size));
+            data += state->deflate.packet_size;
+            size -= state->deflate.packet_size;
+            continue;
+        }
+
+        const uint32_t to_stage = MIN(size, state->deflate.packet_size - state->deflate.staged);
+        memcpy(&state->deflate_packet[state->deflate.staged], data, to_stage);
+        state->deflate.staged += to_stage;
+        data += to_stage;
+        size -= to_stage;
+
+        if (state->deflate.staged == state->deflate.packet_size) {
+            state->deflate.staged = 0;
+            RETURN_ON_ERROR(deflate_send_packet(NULL, state->deflate_packet, state->deflate.packet_size));
+        }
+    }
+
+    if (state->deflate.remaining == 0 && !state->deflate.finished) {
+        if (state->deflate.staged > 0) {
+            const uint32_t staged = state->deflate.staged;
+            state->deflate.staged = 0;
+            RETURN_ON_ERROR(deflate_send_packet(NULL, state->deflate_packet, staged));
+        }
+
+        deflate_complete();
+    }
+
+    return ESP_LOADER_SUCCESS;
+}
+
+
+esp_loader_error_t esp_loader_flash_deflate_finish(bool reboot)
+{
+    loader_state_t *state = loader_state();
+
+    if (!state->deflate.finished) {
+        return ESP_LOADER_ERROR_INVALID_PARAM;
+    }
+
+    port_start_timer(DEFAULT_TIMEOUT);
+
+    return loader_flash_defl_end_cmd(!reboot);
+}
+
+
+void esp_loader_flash_deflate_get_stats(esp_loader_flash_deflate_stats_t *stats)
+{
+    loader_state_t *state = loader_state();
+    const uint32_t end = state->deflate.finished ? state->deflate.end_ms : port_get_time_ms();
+
+    if (state->deflate.passthrough) {
+        stats->uncompressed_size = deflate_uncompressed_size(state->deflate.compressed_sent);
+        stats->level = -1;
+    } else {
+        stats->uncompressed_size = state->deflate_encoder.total_in;
+        stats->level = state->deflate_encoder.level;
+    }
+    stats->compressed_size = state->deflate.compressed_sent;
+    stats->total_time_ms = end - state->deflate.start_ms;
+    stats->transfer_time_ms = state->deflate.transfer_ms;
+    stats->compress_time_ms = stats->total_time_ms - state->deflate.transfer_ms;
+    stats->effective_throughput = stats->total_time_ms == 0 ? 0 :
+                                  (uint64_t)stats->uncompressed_size * 1000 / stats->total_time_ms;
+    stats->compression_ratio = stats->uncompressed_size == 0 ? 0.0f :
+                               (float)stats->compressed_size / stats->uncompressed_size;
+}
+
+
+esp_loader_error_t esp_loader_flash_source(uint32_t offset, uint32_t image_size, bool compress,
+        esp_loader_read_cb_t read, void *context)
+{
+    loader_state_t *state = loader_state();
+
+    if (read == NULL || image_size == 0) {
+        return ESP_LOADER_ERROR_INVALID_PARAM;
+    }
+
+    /* The ESP8266 ROM only takes uncompressed blocks */
+    const bool rom_only = state->target == ESP8266_CHIP && !esp_stub_get_running();
+    compress = compress && !rom_only;
+    if (compress) {
+        RETURN_ON_ERROR( esp_loader_flash_deflate_start(offset, image_size, ESP_LOADER_DEFLATE_LEVEL_AUTO) );
+    } else {
+        RETURN_ON_ERROR( esp_loader_flash_start(offset, ROUNDUP(image_size, 4), sizeof(state->source_block)) );
+    }
+
+    for (uint32_t read_offset = 0; read_offset < image_size; read_offset += sizeof(state->source_block)) {
+        const uint32_t to_read = MIN(image_size - read_offset, sizeof(state->source_block));
+
+        RETURN_ON_ERROR( read(context, read_offset, state->source_block, to_read) );
+
+        // Uncompressed blocks go out of the buffer the callback filled, padded while sent
+        if (compress) {
+            RETURN_ON_ERROR( esp_loader_flash_deflate_write(state->source_block, to_read) );
+        } else {
+            RETURN_ON_ERROR( esp_loader_flash_write(state->source_block, to_read) );
+        }
+    }
+
+#if MD5_ENABLED
+    if (!rom_only) {
+        RETURN_ON_ERROR( esp_loader_flash_verify() );
+    }
+#endif
+
+    /* Ending a flash operation makes the ROM loaders exit and run the application, like esptool
+       the operation is only ended with the stub */
+    if (!esp_stub_get_running()) {
+        return ESP_LOADER_SUCCESS;
+    }
+
+    return compress ? esp_loader_flash_deflate_finish(false) : esp_loader_flash_finish(false);
+}
+
+
+esp_loader_error_t esp_loader_change_transmission_rate_stub(const uint32_t old_transmission_rate,
+        const uint32_t new_transmission_rate)
+{
+    loader_state_t *state = loader_state();
+
+    if (state->target == ESP8266_CHIP || !esp_stub_get_running()) {
+        return ESP_LOADER_ERROR_UNSUPPORTED_FUNC;
+    }
+
+    port_start_timer(DEFAULT_TIMEOUT);
+    reset_timeout_model();
+
+    esp_loader_error_t err = loader_change_baudrate_cmd(new_transmission_rate, old_transmission_rate);
+
+    // Wait for the stub to be ready to receive data.
+    if (err == ESP_LOADER_SUCCESS) {
+        port_delay_ms(25);
+    }
+
+    return err;
+}
+
+static uint32_t byte_popcnt(uint8_t byte)
+{
+    uint32_t cnt = 0;
+    for (uint32_t bit = 0; bit < 8; bit++) {
+        cnt += byte & 0x01;
+        byte >>= 1;
+    }
+
+    return cnt;
+}
+
+esp_loader_error_t esp_loader_get_security_info(esp_loader_target_security_info_t *security_info)
+{
+    port_start_timer(SHORT_TIMEOUT);
+
+    get_security_info_response_data_t resp;
+    uint32_t response_received_size = 0;
+    RETURN_ON_ERROR(loader_get_security_info_cmd(&resp, &response_received_size));
+
+    if (response_received_size == sizeof(get_security_info_response_data_t)) {
+        security_info->target_chip = target_from_chip_id(resp.chip_id);
+        security_info->eco_version = resp.eco_version;
+    } else if (response_received_size == sizeof(get_security_info_response_data_t) - 8) {
+        security_info->target_chip = ESP32S2_CHIP;
+        security_info->eco_version = 0;
+    } else {
+        return ESP_LOADER_ERROR_INVALID_RESPONSE;
+    }
+
+    security_info->secure_boot_enabled =
+        (resp.flags & GET_SECURITY_INFO_SECURE_BOOT_EN) != 0;
+    security_info->secure_boot_aggressive_revoke_enabled =
+        (resp.flags & GET_SECURITY_INFO_SECURE_BOOT_AGGRESSIVE_REVOKE) != 0;
+    security_info->secure_download_mode_enabled =
+        (resp.flags & GET_SECURITY_INFO_SECURE_DOWNLOAD_ENABLE) != 0;
+    security_info->secure_boot_revoked_keys[0] =
+        (resp.flags & GET_SECURITY_INFO_SECURE_BOOT_KEY_REVOKE0) != 0;
+    security_info->secure_boot_revoked_keys[1] =
+        (resp.flags & GET_SECURITY_INFO_SECURE_BOOT_KEY_REVOKE1) != 0;
+    security_info->secure_boot_revoked_keys[2] =
+        (resp.flags & GET_SECURITY_INFO_SECURE_BOOT_KEY_REVOKE2) != 0;
+    security_info->jtag_software_disabled =
+        (resp.flags & GET_SECURITY_INFO_SOFT_DIS_JTAG) != 0;
+    security_info->jtag_hardware_disabled =
+        (resp.flags & GET_SECURITY_INFO_HARD_DIS_JTAG) != 0;
+    security_info->usb_disabled = (resp.flags & GET_SECURITY_INFO_DIS_USB) != 0;
+
+    // If the number of set bits in key_purposes is odd, flash is encrypted
+    uint32_t key_purposes_bit_cnt = 0;
+    for (size_t byte = 0; byte < sizeof(resp.key_purposes); byte++) {
+        key_purposes_bit_cnt += byte_popcnt(resp.key_purposes[byte]);
+    }
+    security_info->flash_encryption_enabled = key_purposes_bit_cnt % 2;
+
+    security_info->dcache_in_uart_download_disabled =
+        (resp.flags & GET_SECURITY_INFO_DIS_DOWNLOAD_DCACHE) != 0;
+    security_info->icache_in_uart_download_disabled =
+        (resp.flags & GET_SECURITY_INFO_DIS_DOWNLOAD_ICACHE) != 0;
+
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t esp_loader_flash_read_set_window(uint32_t packet_size, uint32_t max_inflight)
+{
+    loader_state_t *state = loader_state();
+
+    if (packet_size == 0 || packet_size > sizeof(state->read_packet) || packet_size % 4 != 0 ||
+            max_inflight == 0) {
+        return ESP_LOADER_ERROR_INVALID_PARAM;
+    }
+
+    state->read_packet_size = packet_size;
+    state->read_max_inflight = max_inflight;
+
+    return ESP_LOADER_SUCCESS;
+}
+
+static esp_loader_error_t flash_read_stub(uint8_t *dest, uint32_t address, uint32_t length)
+{
+    loader_state_t *state = loader_state();
+    size_t recv_size = 0;
+    struct MD5Context md5_context;
+    MD5Init(&md5_context);
+
+    // The flasher stub requires reads to be aligned to 4 bytes.
+    // The solution is to read more than is needed and discard the unecessary bytes.
+    const uint32_t seek_back_len = address % 4;
+    address -= seek_back_len;
+    length += seek_back_len;
+
+    const uint32_t overread_len = ROUNDUP(length, 4) - length;
+    length += overread_len;
+
+    // The stub keeps up to max_inflight packets on the wire and only waits for acknowledgement
+    // once that many are outstanding, so the round trip is paid once per window, not per packet.
+    port_start_timer(DEFAULT_TIMEOUT);
+    RETURN_ON_ERROR(loader_flash_read_stub_cmd(address, length, state->read_packet_size,
+                    state->read_max_inflight));
+
+    uint32_t copy_dest_start = 0;
+    int32_t remaining = length;
+    while (remaining > 0) {
+        port_start_timer(DEFAULT_TIMEOUT);
+        const uint32_t to_receive = MIN(remaining, state->read_packet_size);
+        RETURN_ON_ERROR(SLIP_receive_packet(state->read_packet, to_receive, &recv_size));
+
+        if (recv_size != to_receive) {
+            return ESP_LOADER_ERROR_INVALID_RESPONSE;
+        }
+
+        // Ack right away by sending back the total received byte count. The acks are cumulative,
+        // so the stub can refill the window before the packet is processed here.
+        remaining -= recv_size;
+        const uint32_t bytes_recv = length - remaining;
+        port_start_timer(DEFAULT_TIMEOUT);
+        RETURN_ON_ERROR(SLIP_send_delimiter());
+        RETURN_ON_ERROR(SLIP_send((const uint8_t *)&bytes_recv, sizeof(bytes_recv)));
+        RETURN_ON_ERROR(SLIP_send_delimiter());
+        RETURN_ON_ERROR(SLIP_flush());
+
+        MD5Update(&md5_context, state->read_packet, recv_size);
+
+        // Handle seek back and overread.
+        uint32_t copy_start = 0;
+        uint32_t copy_length = recv_size;
+
+        const bool first_read = bytes_recv == recv_size;
+        if (first_read) {
+            copy_start += seek_back_len;
+            copy_length -= seek_back_len;
+        }
+
+        const bool last_read = remaining <= 0;
+        if (last_read) {
+            copy_length -= overread_len;
+        }
+
+        memcpy(&dest[copy_dest_start], &state->read_packet[copy_start], copy_length);
+        copy_dest_start += copy_length;
+    }
+
+    uint8_t md5_calc[16];
+    MD5Final(md5_calc, &md5_context);
+
+    port_start_timer(DEFAULT_TIMEOUT);
+    uint8_t md5_recv[16];
+    RETURN_ON_ERROR(SLIP_receive_packet(md5_recv, sizeof(md5_recv), &recv_size));
+
+    if (recv_size != sizeof(md5_recv) || memcmp(md5_calc, md5_recv, sizeof(md5_calc))) {
+        return ESP_LOADER_ERROR_INVALID_MD5;
+    }
+
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t esp_loader_flash_read(uint8_t *dest, uint32_t address, uint32_t length)
+{
+    loader_state_t *state = loader_state();
+
+    /* Flash size will be known in advance if we're in secure download mode or we already read it*/
+    if (state->target_flash_size == 0) {
+        if (esp_loader_flash_detect_size(&state->target_flash_size) == ESP_LOADER_SUCCESS) {
+            if (address + length >= state->target_flash_size) {
                 return ESP_LOADER_ERROR_IMAGE_SIZE;
             }
 
-            loader_port_start_timer(DEFAULT_TIMEOUT);
-            RETURN_ON_ERROR(loader_spi_parameters(s_target_flash_size));
+            port_start_timer(DEFAULT_TIMEOUT);
+            RETURN_ON_ERROR(loader_spi_parameters(state->target_flash_size));
         } else {
-            loader_port_debug_print("Flash size detection failed, falling back to default");
+            port_debug_print("Flash size detection failed, falling back to default");
         }
     }
 
@@ -577,7 +1346,7 @@ esp_loader_error_t esp_loader_flash_read(uint8_t *dest, uint32_t address, uint32
         while (remaining > 0) {
             uint8_t buf[READ_FLASH_ROM_DATA_SIZE];
 
-            loader_port_start_timer(DEFAULT_TIMEOUT);
+            port_start_timer(DEFAULT_TIMEOUT);
             RETURN_ON_ERROR(loader_flash_read_rom_cmd(address + length - remaining, buf));
 
             const bool first_read = remaining == length;
@@ -596,13 +1365,318 @@ esp_loader_error_t esp_loader_flash_read(uint8_t *dest, uint32_t address, uint32
 
     return ESP_LOADER_SUCCESS;
 }
+
+/* Large enough for either digest format, zero terminated */
+#define MD5_STRING_SIZE (MAX(MD5_SIZE_ROM, MD5_SIZE_STUB) + 1)
+
+static void hexify(const uint8_t raw_md5[16], uint8_t hex_md5_out[32])
+{
+    static const uint8_t dec_to_hex[] = {
+        '0', '1', '2', '3', '4', '5', '6', '7',
+        '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'
+    };
+    for (int i = 0; i < 16; i++) {
+        *hex_md5_out++ = dec_to_hex[raw_md5[i] >> 4];
+        *hex_md5_out++ = dec_to_hex[raw_md5[i] & 0xF];
+    }
+}
+
+/* Has the target hash a region of its flash and compares the result with a digest computed
+   by the host. The ROM returns the digest as a hex string, the stub as raw bytes. */
+static esp_loader_error_t flash_md5_compare(uint32_t address, uint32_t size, const uint8_t raw_md5[16],
+        uint8_t received_md5[MD5_STRING_SIZE],
+        uint8_t calculated_md5[MD5_STRING_SIZE], bool *match)
+{
+    start_command_timer(TIMEOUT_MD5, size, timeout_per_mb(size, MD5_TIMEOUT_PER_MB));
+    const esp_loader_error_t result = loader_md5_cmd(address, size, received_md5);
+    record_service_time(TIMEOUT_MD5, size, result);
+    RETURN_ON_ERROR(result);
+
+    if (esp_stub_get_running()) {
+        *match = memcmp(raw_md5, received_md5, MD5_SIZE_STUB) == 0;
+        memcpy(calculated_md5, raw_md5, MD5_SIZE_STUB);
+    } else {
+        hexify(raw_md5, calculated_md5);
+        *match = memcmp(calculated_md5, received_md5, MD5_SIZE_ROM) == 0;
+    }
+
+    return ESP_LOADER_SUCCESS;
+}
+
+/* Digest of data as esp_loader_flash_deflate_write() leaves it on the target */
+static void padded_md5(const uint8_t *data, uint32_t size, uint8_t raw_md5[16])
+{
+    const uint8_t padding[3] = { 0xFF, 0xFF, 0xFF };
+    struct MD5Context context;
+
+    MD5Init(&context);
+    MD5Update(&context, data, size);
+    MD5Update(&context, padding, ROUNDUP(size, 4) - size);
+    MD5Final(raw_md5, &context);
+}
+
+esp_loader_error_t esp_loader_flash_delta(uint32_t offset, const void *image, uint32_t image_size,
+        uint32_t region_size, esp_loader_flash_delta_stats_t *stats)
+{
+    loader_state_t *state = loader_state();
+
+    if (state->target == ESP8266_CHIP && !esp_stub_get_running()) {
+        return ESP_LOADER_ERROR_UNSUPPORTED_FUNC;
+    }
+
+    /* Regions are erased independently, so they must not share a sector */
+    if (offset % FLASH_SECTOR_SIZE != 0 || image_size == 0 ||
+            region_size == 0 || region_size % FLASH_SECTOR_SIZE != 0) {
+        return ESP_LOADER_ERROR_INVALID_PARAM;
+    }
+
+    const uint8_t *data = (const uint8_t *)image;
+    uint8_t received_md5[MD5_STRING_SIZE] = {0};
+    uint8_t calculated_md5[MD5_STRING_SIZE] = {0};
+    uint32_t write_ms = 0;
+
+    memset(stats, 0, sizeof(*stats));
+    const uint32_t start = port_get_time_ms();
+
+    for (uint32_t done = 0; done < image_size; done += region_size) {
+        const uint32_t address = offset + done;
+        const uint32_t size = MIN(region_size, image_size - done);
+        const uint32_t padded_size = ROUNDUP(size, 4);
+
+        uint8_t raw_md5[16];
+        padded_md5(&data[done], size, raw_md5);
+
+        bool md5_match;
+        RETURN_ON_ERROR( flash_md5_compare(address, padded_size, raw_md5,
+                                           received_md5, calculated_md5, &md5_match) );
+        stats->regions++;
+
+        if (md5_match) {
+            stats->bytes_skipped += size;
+            continue;
+        }
+
+        const uint32_t write_start = port_get_time_ms();
+
+        RETURN_ON_ERROR( esp_loader_flash_deflate_start(address, size, ESP_LOADER_DEFLATE_LEVEL_AUTO) );
+        RETURN_ON_ERROR( esp_loader_flash_deflate_write(&data[done], size) );
+
+        /* Nothing else confirms that the target wrote the region, check it like the comparison */
+        RETURN_ON_ERROR( flash_md5_compare(address, padded_size, raw_md5,
+                                           received_md5, calculated_md5, &md5_match) );
+        if (!md5_match) {
+            port_debug_print("Error: MD5 checksum of written region does not match\n");
+            return ESP_LOADER_ERROR_INVALID_MD5;
+        }
+
+        write_ms += port_get_time_ms() - write_start;
+        stats->regions_written++;
+        stats->bytes_written += size;
+    }
+
+    stats->total_time_ms = port_get_time_ms() - start;
+    stats->write_time_ms = write_ms;
+    stats->compare_time_ms = stats->total_time_ms - write_ms;
+    stats->time_saved_ms = stats->bytes_written == 0 ? 0 :
+                           (uint64_t)write_ms * stats->bytes_skipped / stats->bytes_written;
+
+    return ESP_LOADER_SUCCESS;
+}
+
+/* Index of the image with the lowest offset above that of the previous one, -1 after the last.
+   The images are visited in address order without reordering the caller's array. */
+static int32_t next_image(const esp_loader_flash_image_t *images, uint32_t count, int32_t previous)
+{
+    int32_t next = -1;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if ((previous < 0 || images[i].offset > images[previous].offset) &&
+                (next < 0 || images[i].offset < images[next].offset)) {
+            next = i;
+        }
+    }
+
+    return next;
+}
+
+static inline uint32_t sector_start(uint32_t address)
+{
+    return address - address % FLASH_SECTOR_SIZE;
+}
+
+/* Images erased one by one must not share sectors, the erase of one would take out the other */
+static esp_loader_error_t validate_images(const esp_loader_flash_image_t *images, uint32_t count,
+        bool sectors_shareable)
+{
+    loader_state_t *state = loader_state();
+    uint32_t visited = 0;
+    int32_t previous = -1;
+
+    for (int32_t i = next_image(images, count, -1); i >= 0; previous = i, i = next_image(images, count, i)) {
+        const esp_loader_flash_image_t *image = &images[i];
+        visited++;
+
+        if (image->offset % 4 != 0 || image->size == 0 || image->data == NULL ||
+                (uint64_t)image->offset + image->size > UINT32_MAX) {
+            return ESP_LOADER_ERROR_INVALID_PARAM;
+        }
+
+        if (state->target_flash_size != 0 && image->offset + image->size > state->target_flash_size) {
+            return ESP_LOADER_ERROR_IMAGE_SIZE;
+        }
+
+        if (previous >= 0) {
+            const uint32_t previous_end = images[previous].offset + images[previous].size;
+            if (previous_end > image->offset ||
+                    (!sectors_shareable && ROUNDUP(previous_end, FLASH_SECTOR_SIZE) > sector_start(image->offset))) {
+                return ESP_LOADER_ERROR_INVALID_PARAM;
+            }
+        }
+    }
+
+    // Images at the same offset are only visited once
+    return visited == count ? ESP_LOADER_SUCCESS : ESP_LOADER_ERROR_INVALID_PARAM;
+}
+
+/* Erases the sectors covered by the images with as few commands as possible, images in
+   adjacent sectors share one. Flash between images is left alone. The whole chip is only
+   erased when nothing has been written since the connection. */
+static esp_loader_error_t erase_images(const esp_loader_flash_image_t *images, uint32_t count,
+                                       esp_loader_flash_images_stats_t *stats)
+{
+#if SERIAL_FLASHER_CHIP_ERASE_THRESHOLD > 0
+    loader_state_t *state = loader_state();
+    uint64_t covered = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        covered += images[i].size;
+    }
+
+    if (!state->flash_written && state->target_flash_size != 0 &&
+            covered * 100 >= (uint64_t)state->target_flash_size * SERIAL_FLASHER_CHIP_ERASE_THRESHOLD) {
+        RETURN_ON_ERROR( esp_loader_erase_chip() );
+        stats->erase_ranges = 1;
+        stats->bytes_erased = state->target_flash_size;
+        return ESP_LOADER_SUCCESS;
+    }
+#endif
+
+    int32_t i = next_image(images, count, -1);
+    while (i >= 0) {
+        const uint32_t start = sector_start(images[i].offset);
+        uint32_t end = ROUNDUP(images[i].offset + images[i].size, FLASH_SECTOR_SIZE);
+
+        i = next_image(images, count, i);
+        while (i >= 0 && sector_start(images[i].offset) <= end) {
+            end = MAX(end, ROUNDUP(images[i].offset + images[i].size, FLASH_SECTOR_SIZE));
+            i = next_image(images, count, i);
+        }
+
+        RETURN_ON_ERROR( esp_loader_erase_region(start, end - start) );
+        stats->erase_ranges++;
+        stats->bytes_erased += end - start;
+    }
+
+    return ESP_LOADER_SUCCESS;
+}
+
+static esp_loader_error_t write_images(esp_loader_flash_image_t *images, uint32_t count,
+                                       esp_loader_flash_images_stats_t *stats)
+{
+    for (int32_t i = next_image(images, count, -1); i >= 0; i = next_image(images, count, i)) {
+        esp_loader_flash_image_t *image = &images[i];
+        const uint32_t start = port_get_time_ms();
+
+        RETURN_ON_ERROR( esp_loader_flash_deflate_start(image->offset, image->size, ESP_LOADER_DEFLATE_LEVEL_AUTO) );
+        RETURN_ON_ERROR( esp_loader_flash_deflate_write(image->data, image->size) );
+
+        image->write_time_ms = port_get_time_ms() - start;
+        stats->bytes_written += image->size;
+    }
+
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t esp_loader_flash_images(esp_loader_flash_image_t *images, uint32_t count,
+        esp_loader_flash_images_stats_t *stats)
+{
+    loader_state_t *state = loader_state();
+
+    if (state->target == ESP8266_CHIP && !esp_stub_get_running()) {
+        return ESP_LOADER_ERROR_UNSUPPORTED_FUNC;
+    }
+
+    if (images == NULL || count == 0) {
+        return ESP_LOADER_ERROR_INVALID_PARAM;
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    const uint32_t start = port_get_time_ms();
+
+    // Flash size detection and parameters once for the whole session
+    RETURN_ON_ERROR( prepare_flash_params(images[next_image(images, count, -1)].offset, 0) );
+
+    /* Without the erase commands every image is erased as it is written */
+    const bool erase_upfront = erase_cmds_supported();
+    RETURN_ON_ERROR( validate_images(images, count, erase_upfront) );
+
+    if (erase_upfront) {
+        RETURN_ON_ERROR( erase_images(images, count, stats) );
+    }
+    const uint32_t erased = port_get_time_ms();
+
+    state->erase_planned = erase_upfront;
+    const esp_loader_error_t err = write_images(images, count, stats);
+    state->erase_planned = false;
+    RETURN_ON_ERROR( err );
+    const uint32_t written = port_get_time_ms();
+
+    /* All images are checked once everything has been sent, the stub finishes writing
+       in the background meanwhile */
+    for (int32_t i = next_image(images, count, -1); i >= 0; i = next_image(images, count, i)) {
+        esp_loader_flash_image_t *image = &images[i];
+        const uint32_t verify_start = port_get_time_ms();
+
+        uint8_t raw_md5[16];
+        uint8_t received_md5[MD5_STRING_SIZE] = {0};
+        uint8_t calculated_md5[MD5_STRING_SIZE] = {0};
+        padded_md5(image->data, image->size, raw_md5);
+
+        bool md5_match;
+        RETURN_ON_ERROR( flash_md5_compare(image->offset, ROUNDUP(image->size, 4), raw_md5,
+                                           received_md5, calculated_md5, &md5_match) );
+        if (!md5_match) {
+            port_debug_print("Error: MD5 checksum of written image does not match\n");
+            return ESP_LOADER_ERROR_INVALID_MD5;
+        }
+
+        image->verify_time_ms = port_get_time_ms() - verify_start;
+    }
+
+    const uint32_t end = port_get_time_ms();
+    stats->erase_time_ms = erased - start;
+    stats->write_time_ms = written - erased;
+    stats->verify_time_ms = end - written;
+    stats->total_time_ms = end - start;
+
+    return ESP_LOADER_SUCCESS;
+}
+
+void esp_loader_get_transfer_stats(esp_loader_transfer_stats_t *stats)
+{
+    SLIP_get_stats(stats);
+}
+
+void esp_loader_reset_transfer_stats(void)
+{
+    SLIP_reset_stats();
+}
 #endif /* SERIAL_FLASHER_INTERFACE_UART || SERIAL_FLASHER_INTERFACE_USB */
 
 esp_loader_error_t esp_loader_mem_start(uint32_t offset, uint32_t size, uint32_t block_size)
 {
 #if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
     if (esp_stub_get_running()) {
-        const esp_stub_t *stub = &esp_stub[s_target];
+        const esp_stub_t *stub = &esp_stub[loader_state()->target];
 
         // check we're not going to overwrite a running stub with this data
         const uint32_t load_start = offset;
@@ -611,7 +1685,7 @@ esp_loader_error_t esp_loader_mem_start(uint32_t offset, uint32_t size, uint32_t
             const uint32_t stub_start = stub->segments[seg].addr;
             const uint32_t stub_end = stub->segments[seg].addr + stub->segments[seg].size;
             if (load_start < stub_end && load_end > stub_start) {
-                loader_port_debug_print("Software loader is resident at the requested address, can't load binary at overlapping address range");
+                port_debug_print("Software loader is resident at the requested address, can't load binary at overlapping address range");
                 return ESP_LOADER_ERROR_INVALID_PARAM;
             }
         }
@@ -619,7 +1693,7 @@ esp_loader_error_t esp_loader_mem_start(uint32_t offset, uint32_t size, uint32_t
 #endif
 
     uint32_t blocks_to_write = ROUNDUP(size, block_size);
-    loader_port_start_timer(timeout_per_mb(size, LOAD_RAM_TIMEOUT_PER_MB));
+    port_start_timer(timeout_per_mb(size, LOAD_RAM_TIMEOUT_PER_MB));
     return loader_mem_begin_cmd(offset, size, blocks_to_write, block_size);
 }
 
@@ -631,7 +1705,7 @@ esp_loader_error_t esp_loader_mem_write(const void *payload, uint32_t size)
     unsigned int attempt = 0;
     esp_loader_error_t result = ESP_LOADER_ERROR_FAIL;
     do {
-        loader_port_start_timer(timeout_per_mb(size, LOAD_RAM_TIMEOUT_PER_MB));
+        port_start_timer(timeout_per_mb(size, LOAD_RAM_TIMEOUT_PER_MB));
         result = loader_mem_data_cmd(data, size);
         attempt++;
     } while (result != ESP_LOADER_SUCCESS && attempt < SERIAL_FLASHER_WRITE_BLOCK_RETRIES);
@@ -642,95 +1716,258 @@ esp_loader_error_t esp_loader_mem_write(const void *payload, uint32_t size)
 
 esp_loader_error_t esp_loader_mem_finish(uint32_t entrypoint)
 {
-    loader_port_start_timer(DEFAULT_TIMEOUT);
+    port_start_timer(DEFAULT_TIMEOUT);
     return loader_mem_end_cmd(entrypoint);
 }
 
 #ifndef SERIAL_FLASHER_INTERFACE_SDIO
 esp_loader_error_t esp_loader_read_mac(uint8_t *mac)
 {
-    if (s_target == ESP8266_CHIP) {
+    loader_state_t *state = loader_state();
+
+    if (state->target == ESP8266_CHIP) {
         return ESP_LOADER_ERROR_UNSUPPORTED_CHIP;
     }
 
-    return loader_read_mac(s_target, mac);
+    return loader_read_mac(state->target, mac);
 }
 
 esp_loader_error_t esp_loader_read_register(uint32_t address, uint32_t *reg_value)
 {
-    loader_port_start_timer(DEFAULT_TIMEOUT);
+    start_command_timer(TIMEOUT_COMMAND, 0, DEFAULT_TIMEOUT);
+    const esp_loader_error_t result = loader_read_reg_cmd(address, reg_value);
+    record_service_time(TIMEOUT_COMMAND, 0, result);
 
-    return loader_read_reg_cmd(address, reg_value);
+    return result;
 }
 
 
 esp_loader_error_t esp_loader_write_register(uint32_t address, uint32_t reg_value)
 {
-    loader_port_start_timer(DEFAULT_TIMEOUT);
+    start_command_timer(TIMEOUT_COMMAND, 0, DEFAULT_TIMEOUT);
+    const esp_loader_error_t result = loader_write_reg_cmd(address, reg_value, 0xFFFFFFFF, 0);
+    record_service_time(TIMEOUT_COMMAND, 0, result);
 
-    return loader_write_reg_cmd(address, reg_value, 0xFFFFFFFF, 0);
+    return result;
 }
 
 esp_loader_error_t esp_loader_change_transmission_rate(uint32_t transmission_rate)
 {
-    if (s_target == ESP8266_CHIP || esp_stub_get_running()) {
+    loader_state_t *state = loader_state();
+
+    if (state->target == ESP8266_CHIP || esp_stub_get_running()) {
         return ESP_LOADER_ERROR_UNSUPPORTED_FUNC;
     }
 
-    loader_port_start_timer(DEFAULT_TIMEOUT);
+    port_start_timer(DEFAULT_TIMEOUT);
+
+    // Service times measured at the old rate no longer apply
+    reset_timeout_model();
 
     return loader_change_baudrate_cmd(transmission_rate, 0);
 }
-#endif /* SERIAL_FLASHER_INTERFACE_SDIO */
 
-#if MD5_ENABLED
+#define AUTOTUNE_PROBE_REG 0x40001000 // Chip detection magic value, constant on all targets
+#define AUTOTUNE_PROBE_ROUNDS 4
+#define AUTOTUNE_PROBE_SIZE 256
+#define AUTOTUNE_SETTLE_MS 25
+#define AUTOTUNE_MIN_GAIN_PERCENT 5
+
+typedef struct {
+    uint32_t reg_value;
+    uint8_t digest[16];
+    uint32_t throughput;
+} link_probe_t;
+
+/* Timed round trips. A rate is only good if the responses match those received at a rate
+   known to work, flash reads cover the response path with data the host can checksum. */
+static esp_loader_error_t probe_link(link_probe_t *probe)
+{
+    uint32_t bytes = 0;
 
-static void hexify(const uint8_t raw_md5[16], uint8_t hex_md5_out[32])
+    memset(probe, 0, sizeof(*probe));
+    const uint32_t start = port_get_time_ms();
+
+#if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
+    struct MD5Context md5;
+    MD5Init(&md5);
+#endif
+
+    for (uint32_t round = 0; round < AUTOTUNE_PROBE_ROUNDS; round++) {
+        uint32_t reg_value;
+        RETURN_ON_ERROR( esp_loader_read_register(AUTOTUNE_PROBE_REG, &reg_value) );
+        if (round > 0 && reg_value != probe->reg_value) {
+            return ESP_LOADER_ERROR_INVALID_RESPONSE;
+        }
+        probe->reg_value = reg_value;
+        bytes += sizeof(reg_value);
+
+#if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
+        uint8_t data[AUTOTUNE_PROBE_SIZE];
+        RETURN_ON_ERROR( esp_loader_flash_read(data, round * sizeof(data), sizeof(data)) );
+        MD5Update(&md5, data, sizeof(data));
+        bytes += sizeof(data);
+#endif
+    }
+
+#if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
+    MD5Final(probe->digest, &md5);
+#endif
+
+    const uint32_t elapsed = port_get_time_ms() - start;
+    probe->throughput = elapsed == 0 ? 0 : (uint64_t)bytes * 1000 / elapsed;
+
+    return ESP_LOADER_SUCCESS;
+}
+
+/* Switches the target first, its response still arrives at the old rate. The SPI target
+   is a slave, only the host clock changes. */
+static esp_loader_error_t switch_link_rate(uint32_t old_rate, uint32_t new_rate)
 {
-    static const uint8_t dec_to_hex[] = {
-        '0', '1', '2', '3', '4', '5', '6', '7',
-        '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'
-    };
-    for (int i = 0; i < 16; i++) {
-        *hex_md5_out++ = dec_to_hex[raw_md5[i] >> 4];
-        *hex_md5_out++ = dec_to_hex[raw_md5[i] & 0xF];
+#if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
+    if (esp_stub_get_running()) {
+        RETURN_ON_ERROR( esp_loader_change_transmission_rate_stub(old_rate, new_rate) );
+    } else {
+        RETURN_ON_ERROR( esp_loader_change_transmission_rate(new_rate) );
+    }
+#else
+    (void)old_rate;
+#endif
+
+    RETURN_ON_ERROR( port_change_transmission_rate(new_rate) );
+    port_delay_ms(AUTOTUNE_SETTLE_MS);
+    reset_timeout_model();
+
+#if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
+    // Drop anything received while the two sides disagreed on the rate
+    SLIP_reset();
+#endif
+
+    return ESP_LOADER_SUCCESS;
+}
+
+/* Gets back to a working rate after a failed candidate. It is not known whether the target
+   switched, so first assume it did not, then that it did and has to be switched back. */
+static esp_loader_error_t restore_link_rate(uint32_t good_rate, uint32_t failed_rate)
+{
+    uint32_t reg_value;
+
+    RETURN_ON_ERROR( port_change_transmission_rate(good_rate) );
+    port_delay_ms(AUTOTUNE_SETTLE_MS);
+#if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
+    SLIP_reset();
+#endif
+    if (esp_loader_read_register(AUTOTUNE_PROBE_REG, &reg_value) == ESP_LOADER_SUCCESS) {
+        return ESP_LOADER_SUCCESS;
+    }
+
+    RETURN_ON_ERROR( port_change_transmission_rate(failed_rate) );
+    port_delay_ms(AUTOTUNE_SETTLE_MS);
+    RETURN_ON_ERROR( switch_link_rate(failed_rate, good_rate) );
+
+    return esp_loader_read_register(AUTOTUNE_PROBE_REG, &reg_value);
+}
+
+esp_loader_error_t esp_loader_autotune_link(uint32_t current_rate, const uint32_t *rates,
+        uint32_t rate_count, esp_loader_autotune_result_t *result)
+{
+#if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
+    if (loader_state()->target == ESP8266_CHIP) {
+        return ESP_LOADER_ERROR_UNSUPPORTED_FUNC;
+    }
+#endif
+
+    /* Candidates are tried from the lowest up and the first failure ends the search, which
+       only finds the fastest working rate when they are in increasing order */
+    if (rates == NULL || rate_count == 0) {
+        return ESP_LOADER_ERROR_INVALID_PARAM;
+    }
+    for (uint32_t i = 1; i < rate_count; i++) {
+        if (rates[i] <= rates[i - 1]) {
+            return ESP_LOADER_ERROR_INVALID_PARAM;
+        }
+    }
+
+    memset(result, 0, sizeof(*result));
+
+    // Fails before the target is switched if the port cannot change its rate
+    RETURN_ON_ERROR( port_change_transmission_rate(current_rate) );
+
+    link_probe_t good;
+    RETURN_ON_ERROR( probe_link(&good) );
+    uint32_t good_rate = current_rate;
+
+    for (uint32_t i = 0; i < rate_count; i++) {
+        const uint32_t rate = rates[i];
+        if (rate <= good_rate) {
+            continue;
+        }
+
+        result->rates_tried++;
+
+        link_probe_t probe;
+        esp_loader_error_t err = switch_link_rate(good_rate, rate);
+        if (err == ESP_LOADER_SUCCESS) {
+            err = probe_link(&probe);
+        }
+        if (err == ESP_LOADER_SUCCESS &&
+                (probe.reg_value != good.reg_value || memcmp(probe.digest, good.digest, sizeof(probe.digest)) != 0)) {
+            err = ESP_LOADER_ERROR_INVALID_RESPONSE;
+        }
+
+        if (err != ESP_LOADER_SUCCESS) {
+            result->rates_failed++;
+            RETURN_ON_ERROR( restore_link_rate(good_rate, rate) );
+            break;
+        }
+
+        // Some links do not get faster with the rate, USB CDC for example
+        if (good.throughput != 0 &&
+                (uint64_t)probe.throughput * 100 < (uint64_t)good.throughput * (100 + AUTOTUNE_MIN_GAIN_PERCENT)) {
+            RETURN_ON_ERROR( switch_link_rate(rate, good_rate) );
+            break;
+        }
+
+        good = probe;
+        good_rate = rate;
     }
+
+    result->transmission_rate = good_rate;
+    result->effective_throughput = good.throughput;
+
+    return ESP_LOADER_SUCCESS;
 }
+#endif /* SERIAL_FLASHER_INTERFACE_SDIO */
+
+#if MD5_ENABLED
 
 esp_loader_error_t esp_loader_flash_verify(void)
 {
-    if (s_target == ESP8266_CHIP && !esp_stub_get_running()) {
+    loader_state_t *state = loader_state();
+
+    if (state->target == ESP8266_CHIP && !esp_stub_get_running()) {
         return ESP_LOADER_ERROR_UNSUPPORTED_FUNC;
     }
 
     /* Zero termination require 1 byte */
-    uint8_t received_md5[MAX(MD5_SIZE_ROM, MD5_SIZE_STUB) + 1] = {0};
-    uint8_t calculated_md5[MAX(MD5_SIZE_ROM, MD5_SIZE_STUB) + 1] = {0};
+    uint8_t received_md5[MD5_STRING_SIZE] = {0};
+    uint8_t calculated_md5[MD5_STRING_SIZE] = {0};
 
     uint8_t raw_md5[16] = {0};
     md5_final(raw_md5);
 
-    loader_port_start_timer(timeout_per_mb(s_image_size, MD5_TIMEOUT_PER_MB));
-
-    RETURN_ON_ERROR( loader_md5_cmd(s_start_address, s_image_size, received_md5) );
-
     bool md5_match;
-    if (esp_stub_get_running()) {
-        md5_match = memcmp(raw_md5, received_md5, MD5_SIZE_STUB) == 0;
-        memcpy(calculated_md5, raw_md5, MD5_SIZE_STUB);
-    } else {
-        hexify(raw_md5, calculated_md5);
-        md5_match = memcmp(calculated_md5, received_md5, MD5_SIZE_ROM) == 0;
-    }
+    RETURN_ON_ERROR( flash_md5_compare(state->start_address, state->image_size, raw_md5,
+                                       received_md5, calculated_md5, &md5_match) );
 
     if (!md5_match) {
-        loader_port_debug_print("Error: MD5 checksum does not match:\n");
-        loader_port_debug_print("Expected:\n");
-        loader_port_debug_print((char *)received_md5);
-        loader_port_debug_print("\n");
-        loader_port_debug_print("Actual:\n");
-        loader_port_debug_print((char *)calculated_md5);
-        loader_port_debug_print("\n");
+        port_debug_print("Error: MD5 checksum does not match:\n");
+        port_debug_print("Expected:\n");
+        port_debug_print((char *)received_md5);
+        port_debug_print("\n");
+        port_debug_print("Actual:\n");
+        port_debug_print((char *)calculated_md5);
+        port_debug_print("\n");
 
         return ESP_LOADER_ERROR_INVALID_MD5;
     }
@@ -743,5 +1980,18 @@ esp_loader_error_t esp_loader_flash_verify(void)
 void esp_loader_reset_target(void)
 {
     esp_stub_set_running(false);
-    loader_port_reset_target();
+    port_reset_target();
 }
+
+__attribute__ ((weak)) uint32_t loader_port_get_time_ms(void)
+{
+    return 0;
+}
+
+#ifndef SERIAL_FLASHER_INTERFACE_SDIO
+__attribute__ ((weak)) esp_loader_error_t loader_port_change_transmission_rate(uint32_t transmission_rate)
+{
+    (void)transmission_rate;
+    return ESP_LOADER_ERROR_UNSUPPORTED_FUNC;
+}
+#endif
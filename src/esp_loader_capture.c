@@ -0,0 +1,277 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "esp_loader_capture.h"
+#include "loader_context.h"
+#include "capture.h"
+#include "protocol.h"
+#include <string.h>
+
+#if CAPTURE_ENABLED
+
+#define SLIP_END 0xC0
+#define SLIP_ESC 0xDB
+#define SLIP_ESC_END 0xDC
+#define SLIP_ESC_ESC 0xDD
+
+#define RING_MASK (SERIAL_FLASHER_CAPTURE_BUFFER_SIZE - 1)
+
+/* SLIP frame being decoded from one direction of the traffic */
+typedef struct {
+    uint32_t size;
+    bool escape;
+    bool invalid;
+    uint8_t head[ESP_LOADER_CAPTURE_FRAME_HEAD];
+} frame_decoder_t;
+
+/* The thread using a loader writes its records, another thread may read them. The positions only
+   grow, the writer alone moves head and the reader alone moves tail. */
+typedef struct {
+    uint8_t buffer[SERIAL_FLASHER_CAPTURE_BUFFER_SIZE];
+    uint32_t head;
+    uint32_t tail;
+    bool enabled;
+    uint32_t lost;          // Records dropped since the last one that fitted
+    frame_decoder_t tx_frame;
+    frame_decoder_t rx_frame;
+} capture_t;
+
+static capture_t s_capture[LOADER_COUNT];
+
+static capture_t *capture_of(const esp_loader_t *loader)
+{
+    return &s_capture[LOADER_COUNT > 1 && loader != NULL ? loader->slot : 0];
+}
+
+static void put_u16(uint8_t *out, uint16_t value)
+{
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *out, uint32_t value)
+{
+    put_u16(out, value & 0xFFFF);
+    put_u16(out + 2, value >> 16);
+}
+
+static void ring_copy(capture_t *capture, uint32_t position, const uint8_t *data, size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+
+    const uint32_t offset = position & RING_MASK;
+    const size_t first = MIN(size, SERIAL_FLASHER_CAPTURE_BUFFER_SIZE - offset);
+
+    memcpy(&capture->buffer[offset], data, first);
+    memcpy(&capture->buffer[0], data + first, size - first);
+}
+
+/* Appends a record with its payload in two parts, if it fits */
+static bool ring_put(capture_t *capture, uint8_t type, uint8_t status, const uint8_t *first,
+                     size_t first_size, const uint8_t *second, size_t second_size)
+{
+    const uint32_t head = capture->head;
+    const uint32_t tail = __atomic_load_n(&capture->tail, __ATOMIC_ACQUIRE);
+    const size_t size = first_size + second_size;
+
+    if (size > UINT16_MAX ||
+            ESP_LOADER_CAPTURE_RECORD_SIZE + size > SERIAL_FLASHER_CAPTURE_BUFFER_SIZE - (head - tail)) {
+        return false;
+    }
+
+    uint8_t header[ESP_LOADER_CAPTURE_RECORD_SIZE];
+    header[0] = type;
+    header[1] = status;
+    put_u16(&header[2], size);
+    put_u32(&header[4], port_get_time_ms());
+
+    ring_copy(capture, head, header, sizeof(header));
+    ring_copy(capture, head + sizeof(header), first, first_size);
+    ring_copy(capture, head + sizeof(header) + first_size, second, second_size);
+
+    __atomic_store_n(&capture->head, head + sizeof(header) + size, __ATOMIC_RELEASE);
+    return true;
+}
+
+static void record(capture_t *capture, uint8_t type, uint8_t status, const uint8_t *first,
+                   size_t first_size, const uint8_t *second, size_t second_size)
+{
+    // The loss is reported as soon as there is room again, ahead of the next record
+    if (capture->lost != 0) {
+        uint8_t count[4];
+        put_u32(count, capture->lost);
+        if (!ring_put(capture, ESP_LOADER_CAPTURE_LOST, 0, count, sizeof(count), NULL, 0)) {
+            capture->lost++;
+            return;
+        }
+        capture->lost = 0;
+    }
+
+    if (!ring_put(capture, type, status, first, first_size, second, second_size)) {
+        capture->lost++;
+    }
+}
+
+static void frame_reset(frame_decoder_t *frame)
+{
+    frame->size = 0;
+    frame->escape = false;
+    frame->invalid = false;
+}
+
+/* Follows the frames in the bytes and records each one completed by them */
+static void decode_frames(capture_t *capture, frame_decoder_t *frame, uint8_t type,
+                          const uint8_t *data, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        uint8_t byte = data[i];
+
+        // Frames start and end with END, so an END after any data completes a frame
+        if (byte == SLIP_END) {
+            if (frame->size != 0) {
+                uint8_t frame_size[4];
+                put_u32(frame_size, frame->size);
+                record(capture, type, frame->invalid ? ESP_LOADER_ERROR_INVALID_RESPONSE : 0,
+                       frame_size, sizeof(frame_size), frame->head,
+                       MIN(frame->size, ESP_LOADER_CAPTURE_FRAME_HEAD));
+            }
+            frame_reset(frame);
+            continue;
+        }
+
+        if (frame->escape) {
+            frame->escape = false;
+            if (byte == SLIP_ESC_END) {
+                byte = SLIP_END;
+            } else if (byte == SLIP_ESC_ESC) {
+                byte = SLIP_ESC;
+            } else {
+                frame->invalid = true;
+            }
+        } else if (byte == SLIP_ESC) {
+            frame->escape = true;
+            continue;
+        }
+
+        if (frame->size < ESP_LOADER_CAPTURE_FRAME_HEAD) {
+            frame->head[frame->size] = byte;
+        }
+        frame->size++;
+    }
+}
+
+void capture_bytes(esp_loader_capture_record_t type, const uint8_t *data, size_t size,
+                   esp_loader_error_t status)
+{
+    capture_t *capture = &s_capture[loader_slot()];
+    if (!__atomic_load_n(&capture->enabled, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    record(capture, type, status, data, size, NULL, 0);
+    if (type == ESP_LOADER_CAPTURE_TX) {
+        decode_frames(capture, &capture->tx_frame, ESP_LOADER_CAPTURE_TX_FRAME, data, size);
+    } else {
+        decode_frames(capture, &capture->rx_frame, ESP_LOADER_CAPTURE_RX_FRAME, data, size);
+    }
+}
+
+void capture_event(esp_loader_capture_event_t event, uint32_t value)
+{
+    capture_t *capture = &s_capture[loader_slot()];
+    if (!__atomic_load_n(&capture->enabled, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    // Whatever was on the way is lost with a reset
+    if (event != ESP_LOADER_CAPTURE_RATE) {
+        frame_reset(&capture->rx_frame);
+    }
+
+    uint8_t payload[4];
+    put_u32(payload, value);
+    record(capture, ESP_LOADER_CAPTURE_EVENT, event, payload, sizeof(payload), NULL, 0);
+}
+
+
+esp_loader_error_t esp_loader_capture_start(const esp_loader_t *loader)
+{
+    capture_t *capture = capture_of(loader);
+
+    __atomic_store_n(&capture->enabled, false, __ATOMIC_RELAXED);
+    capture->tail = 0;
+    capture->lost = 0;
+    frame_reset(&capture->tx_frame);
+    frame_reset(&capture->rx_frame);
+
+    const uint8_t header[ESP_LOADER_CAPTURE_HEADER_SIZE] = {
+        'E', 'S', 'F', 'C', ESP_LOADER_CAPTURE_VERSION, LOADER_COUNT > 1 && loader != NULL ? loader->slot : 0, 0, 0
+    };
+    memcpy(capture->buffer, header, sizeof(header));
+    __atomic_store_n(&capture->head, sizeof(header), __ATOMIC_RELEASE);
+
+    __atomic_store_n(&capture->enabled, true, __ATOMIC_RELEASE);
+    return ESP_LOADER_SUCCESS;
+}
+
+
+void esp_loader_capture_stop(const esp_loader_t *loader)
+{
+    __atomic_store_n(&capture_of(loader)->enabled, false, __ATOMIC_RELEASE);
+}
+
+
+size_t esp_loader_capture_read(const esp_loader_t *loader, void *buffer, size_t size)
+{
+    capture_t *capture = capture_of(loader);
+    const uint32_t tail = capture->tail;
+    const uint32_t head = __atomic_load_n(&capture->head, __ATOMIC_ACQUIRE);
+    const size_t taken = MIN(size, head - tail);
+
+    const uint32_t offset = tail & RING_MASK;
+    const size_t first = MIN(taken, SERIAL_FLASHER_CAPTURE_BUFFER_SIZE - offset);
+    memcpy(buffer, &capture->buffer[offset], first);
+    memcpy((uint8_t *)buffer + first, &capture->buffer[0], taken - first);
+
+    __atomic_store_n(&capture->tail, tail + taken, __ATOMIC_RELEASE);
+    return taken;
+}
+
+#else
+
+esp_loader_error_t esp_loader_capture_start(const esp_loader_t *loader)
+{
+    (void)loader;
+    return ESP_LOADER_ERROR_UNSUPPORTED_FUNC;
+}
+
+
+void esp_loader_capture_stop(const esp_loader_t *loader)
+{
+    (void)loader;
+}
+
+
+size_t esp_loader_capture_read(const esp_loader_t *loader, void *buffer, size_t size)
+{
+    (void)loader;
+    (void)buffer;
+    (void)size;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,87 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "loader_context.h"
+#include <stddef.h>
+
+#if LOADER_COUNT > 1
+
+static esp_loader_t s_loaders[LOADER_COUNT] = {
+    [0] = { .slot = 0, .generation = 1, .in_use = true },
+};
+
+// Each thread acts on the loader it has selected
+static _Thread_local esp_loader_t *s_selected;
+
+const esp_loader_t *loader_context(void)
+{
+    return s_selected != NULL ? s_selected : &s_loaders[0];
+}
+
+
+esp_loader_t *esp_loader_create(const esp_loader_port_t *port, void *port_context)
+{
+    for (uint32_t slot = 1; slot < LOADER_COUNT; slot++) {
+        esp_loader_t *loader = &s_loaders[slot];
+        if (__atomic_test_and_set(&loader->in_use, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+
+        loader->slot = slot;
+        loader->generation++;
+        loader->port = port;
+        loader->port_context = port_context;
+        return loader;
+    }
+
+    return NULL;
+}
+
+
+void esp_loader_destroy(esp_loader_t *loader)
+{
+    if (loader != NULL && loader != &s_loaders[0]) {
+        __atomic_clear(&loader->in_use, __ATOMIC_RELEASE);
+    }
+}
+
+
+void esp_loader_select(esp_loader_t *loader)
+{
+    s_selected = loader;
+}
+
+#else
+
+esp_loader_t *esp_loader_create(const esp_loader_port_t *port, void *port_context)
+{
+    (void)port;
+    (void)port_context;
+    return NULL;
+}
+
+
+void esp_loader_destroy(esp_loader_t *loader)
+{
+    (void)loader;
+}
+
+
+void esp_loader_select(esp_loader_t *loader)
+{
+    (void)loader;
+}
+
+#endif
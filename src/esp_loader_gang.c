@@ -0,0 +1,250 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "esp_loader_gang.h"
+#include "loader_context.h"
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_WORKERS (LOADER_COUNT - 1)
+
+typedef struct {
+    const esp_loader_gang_config_t *config;
+    esp_loader_gang_device_t *devices;
+
+    // Devices waiting for an attempt, in a ring that holds each device at most once
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    uint32_t queue[ESP_LOADER_GANG_MAX_DEVICES];
+    uint32_t queue_head;
+    uint32_t queue_length;
+    uint32_t busy;
+} gang_run_t;
+
+static uint32_t time_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+static void queue_push(gang_run_t *run, uint32_t device)
+{
+    run->queue[(run->queue_head + run->queue_length) % ESP_LOADER_GANG_MAX_DEVICES] = device;
+    run->queue_length++;
+}
+
+static esp_loader_error_t flash_device(const esp_loader_gang_config_t *config,
+                                       esp_loader_gang_result_t *result)
+{
+    // Each device gets its own copy of the descriptors, the image data stays shared
+    esp_loader_flash_image_t images[ESP_LOADER_GANG_MAX_IMAGES];
+    memcpy(images, config->images, config->image_count * sizeof(images[0]));
+    esp_loader_connect_args_t connect_args = config->connect;
+
+    result->step = ESP_LOADER_GANG_CONNECT;
+    result->transmission_rate = config->transmission_rate;
+    if (config->use_stub) {
+        RETURN_ON_ERROR( esp_loader_connect_with_stub(&connect_args) );
+    } else {
+        RETURN_ON_ERROR( esp_loader_connect(&connect_args) );
+    }
+
+    if (config->rate_count > 0) {
+        result->step = ESP_LOADER_GANG_AUTOTUNE;
+        esp_loader_autotune_result_t autotune;
+        esp_loader_error_t err = esp_loader_autotune_link(config->transmission_rate, config->rates,
+                                 config->rate_count, &autotune);
+        if (err == ESP_LOADER_SUCCESS) {
+            result->transmission_rate = autotune.transmission_rate;
+        } else if (err != ESP_LOADER_ERROR_UNSUPPORTED_FUNC) {
+            return err;
+        }
+    }
+
+    result->step = ESP_LOADER_GANG_WRITE;
+    esp_loader_flash_images_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    esp_loader_error_t err = esp_loader_flash_images(images, config->image_count, &stats);
+    result->erase_time_ms = stats.erase_time_ms;
+    result->write_time_ms = stats.write_time_ms;
+    result->verify_time_ms = stats.verify_time_ms;
+    if (err == ESP_LOADER_ERROR_INVALID_MD5) {
+        result->step = ESP_LOADER_GANG_VERIFY;
+    }
+    RETURN_ON_ERROR(err);
+
+    if (config->reset) {
+        result->step = ESP_LOADER_GANG_RESET;
+        esp_loader_reset_target();
+    }
+
+    result->step = ESP_LOADER_GANG_DONE;
+    return ESP_LOADER_SUCCESS;
+}
+
+static void attempt_device(const esp_loader_gang_config_t *config, esp_loader_gang_device_t *device)
+{
+    esp_loader_gang_result_t *result = &device->result;
+    const uint32_t start = time_ms();
+
+    result->attempts++;
+
+    // A new loader per attempt starts the device over with a clean connection state
+    esp_loader_t *loader = esp_loader_create(device->port, device->port_context);
+    if (loader == NULL) {
+        result->step = ESP_LOADER_GANG_CONNECT;
+        result->error = ESP_LOADER_ERROR_FAIL;
+    } else {
+        // The previous attempt may have left the port at an autotuned rate
+        if (result->attempts > 1 && config->rate_count > 0 &&
+                device->port->change_transmission_rate != NULL) {
+            device->port->change_transmission_rate(device->port_context, config->transmission_rate);
+        }
+
+        esp_loader_select(loader);
+        result->error = flash_device(config, result);
+        esp_loader_select(NULL);
+        esp_loader_destroy(loader);
+    }
+
+    result->total_time_ms += time_ms() - start;
+}
+
+static void *worker(void *arg)
+{
+    gang_run_t *run = arg;
+
+    pthread_mutex_lock(&run->lock);
+    for (;;) {
+        while (run->queue_length == 0 && run->busy > 0) {
+            pthread_cond_wait(&run->changed, &run->lock);
+        }
+        if (run->queue_length == 0) {
+            break;
+        }
+
+        const uint32_t index = run->queue[run->queue_head];
+        run->queue_head = (run->queue_head + 1) % ESP_LOADER_GANG_MAX_DEVICES;
+        run->queue_length--;
+        run->busy++;
+        pthread_mutex_unlock(&run->lock);
+
+        esp_loader_gang_device_t *device = &run->devices[index];
+        attempt_device(run->config, device);
+
+        pthread_mutex_lock(&run->lock);
+        run->busy--;
+        if (device->result.error != ESP_LOADER_SUCCESS &&
+                device->result.attempts < run->config->attempts) {
+            queue_push(run, index);
+        }
+        pthread_cond_broadcast(&run->changed);
+    }
+    pthread_mutex_unlock(&run->lock);
+
+    return NULL;
+}
+
+esp_loader_error_t esp_loader_gang_run(const esp_loader_gang_config_t *config,
+                                       esp_loader_gang_device_t *devices, uint32_t count,
+                                       esp_loader_gang_report_t *report)
+{
+    if (MAX_WORKERS == 0) {
+        return ESP_LOADER_ERROR_UNSUPPORTED_FUNC;
+    }
+
+    if (config->images == NULL || config->image_count == 0 ||
+            config->image_count > ESP_LOADER_GANG_MAX_IMAGES ||
+            (config->rate_count > 0 && config->rates == NULL) ||
+            devices == NULL || count == 0 || count > ESP_LOADER_GANG_MAX_DEVICES) {
+        return ESP_LOADER_ERROR_INVALID_PARAM;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (devices[i].port == NULL) {
+            return ESP_LOADER_ERROR_INVALID_PARAM;
+        }
+    }
+
+    const uint32_t start = time_ms();
+
+    gang_run_t run = {
+        .config = config,
+        .devices = devices,
+    };
+    pthread_mutex_init(&run.lock, NULL);
+    pthread_cond_init(&run.changed, NULL);
+
+    for (uint32_t i = 0; i < count; i++) {
+        memset(&devices[i].result, 0, sizeof(devices[i].result));
+        queue_push(&run, i);
+    }
+
+    uint32_t worker_count = config->workers == 0 || config->workers > count ? count : config->workers;
+    if (worker_count > MAX_WORKERS) {
+        worker_count = MAX_WORKERS;
+    }
+
+    pthread_t workers[MAX_WORKERS > 0 ? MAX_WORKERS : 1];
+    uint32_t started = 0;
+    for (; started < worker_count; started++) {
+        if (pthread_create(&workers[started], NULL, worker, &run) != 0) {
+            break;
+        }
+    }
+
+    // Without any worker thread the devices are flashed by the calling one
+    if (started == 0) {
+        worker(&run);
+    }
+
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    pthread_cond_destroy(&run.changed);
+    pthread_mutex_destroy(&run.lock);
+
+    memset(report, 0, sizeof(*report));
+    report->devices = count;
+    for (uint32_t i = 0; i < count; i++) {
+        const esp_loader_gang_result_t *result = &devices[i].result;
+        if (result->error == ESP_LOADER_SUCCESS) {
+            report->succeeded++;
+        } else {
+            report->failed++;
+        }
+        report->retries += result->attempts - 1;
+        report->device_time_ms += result->total_time_ms;
+    }
+    report->wall_time_ms = time_ms() - start;
+
+    return report->failed == 0 ? ESP_LOADER_SUCCESS : ESP_LOADER_ERROR_FAIL;
+}
+
+const char *esp_loader_gang_step_name(esp_loader_gang_step_t step)
+{
+    switch (step) {
+    case ESP_LOADER_GANG_CONNECT:  return "connect";
+    case ESP_LOADER_GANG_AUTOTUNE: return "autotune";
+    case ESP_LOADER_GANG_WRITE:    return "write";
+    case ESP_LOADER_GANG_VERIFY:   return "verify";
+    case ESP_LOADER_GANG_RESET:    return "reset";
+    case ESP_LOADER_GANG_DONE:     return "done";
+    default:                       return "unknown";
+    }
+}
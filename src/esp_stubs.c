@@ -16,17 +16,36 @@
 // auto-generated stubs from esp-flasher-stub v0.3.0
 
 #include "esp_stubs.h"
+#include "loader_context.h"
+#include <string.h>
 
-static bool stub_running = false;
+typedef struct {
+    uint32_t generation;
+    bool running;
+} stub_state_t;
+
+static stub_state_t s_stub[LOADER_COUNT];
+
+static inline stub_state_t *stub_state(void)
+{
+    stub_state_t *state = &s_stub[loader_slot()];
+
+    if (state->generation != loader_generation()) {
+        memset(state, 0, sizeof(*state));
+        state->generation = loader_generation();
+    }
+
+    return state;
+}
 
 bool esp_stub_get_running(void)
 {
-    return stub_running;
+    return stub_state()->running;
 }
 
 void esp_stub_set_running(bool stub_status)
 {
-    stub_running = stub_status;
+    stub_state()->running = stub_status;
 }
 
 #if (defined SERIAL_FLASHER_INTERFACE_UART) || (defined SERIAL_FLASHER_INTERFACE_USB)
@@ -12,7 +12,24 @@
 #include <string.h>
 
 
-static void MD5Transform(uint32_t buf[4], uint32_t const in[16]);
+/* Whole blocks are hashed straight from the caller's buffer. That needs a little endian CPU, and
+ * either an aligned buffer or a CPU that loads unaligned words at full speed (x86, ARM64 and ARMv7
+ * or ARMv7-M with unaligned access enabled). Otherwise, like on Xtensa and RISC-V, unaligned
+ * blocks are copied to the context first. */
+#ifndef MD5_UNALIGNED_IN_PLACE
+#if !defined(WORDS_BIGENDIAN) && (defined(__x86_64__) || defined(__i386__) || \
+        defined(__aarch64__) || defined(__ARM_FEATURE_UNALIGNED))
+#define MD5_UNALIGNED_IN_PLACE 1
+#else
+#define MD5_UNALIGNED_IN_PLACE 0
+#endif
+#endif
+
+
+static void md5_blocks(uint32_t buf[4], uint32_t const *in, size_t blocks);
+#if MD5_UNALIGNED_IN_PLACE
+static void md5_blocks_unaligned(uint32_t buf[4], const unsigned char *in, size_t blocks);
+#endif
 
 
 /* ===== start - public domain MD5 implementation ===== */
@@ -66,6 +83,30 @@ void MD5Init(struct MD5Context *ctx)
     ctx->bits[1] = 0;
 }
 
+/*
+ * Hash whole blocks from the caller's buffer, in place where possible.
+ */
+static void md5_update_blocks(struct MD5Context *ctx, unsigned char const *buf, size_t blocks)
+{
+#ifndef WORDS_BIGENDIAN
+    if ((uintptr_t) buf % sizeof(uint32_t) == 0) {
+        md5_blocks(ctx->buf, (uint32_t const *) buf, blocks);
+        return;
+    }
+#endif
+
+#if MD5_UNALIGNED_IN_PLACE
+    md5_blocks_unaligned(ctx->buf, buf, blocks);
+#else
+    while (blocks--) {
+        memcpy(ctx->in, buf, 64);
+        byteReverse(ctx->in, 16);
+        md5_blocks(ctx->buf, (uint32_t *) ctx->in, 1);
+        buf += 64;
+    }
+#endif
+}
+
 /*
  * Update context to reflect the concatenation of another buffer full
  * of bytes.
@@ -96,18 +137,17 @@ void MD5Update(struct MD5Context *ctx, unsigned char const *buf, unsigned len)
         }
         memcpy(p, buf, t);
         byteReverse(ctx->in, 16);
-        MD5Transform((uint32_t *)ctx->buf, (uint32_t *) ctx->in);
+        md5_blocks(ctx->buf, (uint32_t *) ctx->in, 1);
         buf += t;
         len -= t;
     }
-    /* Process data in 64-byte chunks */
 
-    while (len >= 64) {
-        memcpy(ctx->in, buf, 64);
-        byteReverse(ctx->in, 16);
-        MD5Transform((uint32_t *)ctx->buf, (uint32_t *) ctx->in);
-        buf += 64;
-        len -= 64;
+    /* Process data in 64-byte chunks, without copying them if possible */
+
+    if (len >= 64) {
+        md5_update_blocks(ctx, buf, len / 64);
+        buf += len & ~63U;
+        len &= 63;
     }
 
     /* Handle any remaining bytes of data. */
@@ -140,7 +180,7 @@ void MD5Final(unsigned char digest[16], struct MD5Context *ctx)
         /* Two lots of padding:  Pad the first block to 64 bytes */
         memset(p, 0, count);
         byteReverse(ctx->in, 16);
-        MD5Transform((uint32_t *)ctx->buf, (uint32_t *) ctx->in);
+        md5_blocks(ctx->buf, (uint32_t *) ctx->in, 1);
 
         /* Now fill the next block with 56 bytes */
         memset(ctx->in, 0, 56);
@@ -154,7 +194,7 @@ void MD5Final(unsigned char digest[16], struct MD5Context *ctx)
     ((uint32_t *) ctx->in)[14] = ctx->bits[0];
     ((uint32_t *) ctx->in)[15] = ctx->bits[1];
 
-    MD5Transform((uint32_t *)ctx->buf, (uint32_t *) ctx->in);
+    md5_blocks(ctx->buf, (uint32_t *) ctx->in, 1);
     byteReverse((unsigned char *) ctx->buf, 4);
     memcpy(digest, ctx->buf, 16);
     memset(ctx, 0, sizeof(struct MD5Context));  /* In case it's sensitive */
@@ -164,99 +204,132 @@ void MD5Final(unsigned char digest[16], struct MD5Context *ctx)
 
 /* #define F1(x, y, z) (x & y | ~x & z) */
 #define F1(x, y, z) (z ^ (x & (y ^ z)))
-#define F2(x, y, z) F1(z, x, y)
 #define F3(x, y, z) (x ^ y ^ z)
 #define F4(x, y, z) (y ^ (x | ~z))
 
-/* This is the central step in the MD5 algorithm. */
+/* This is the central step in the MD5 algorithm. The data and the constant are added first, they
+   do not depend on the previous step. */
 #define MD5STEP(f, w, x, y, z, data, s) \
-    ( w += f(x, y, z) + data,  w = w<<s | w>>(32-s),  w += x )
+    ( w += data,  w += f(x, y, z),  w = w<<s | w>>(32-s),  w += x )
+
+/* F2(x, y, z) is (x & z) | (y & ~z). The two terms never share a bit, so they are added to w
+   separately and the one not depending on x is computed in parallel with the previous step. */
+#define MD5STEP2(w, x, y, z, data, s) \
+    ( w += data,  w += y & ~z,  w += x & z,  w = w<<s | w>>(32-s),  w += x )
 
 /*
  * The core of the MD5 algorithm, this alters an existing MD5 hash to
- * reflect the addition of 16 longwords of new data.  MD5Update blocks
- * the data and converts bytes into longwords for this routine.
+ * reflect the addition of 16 longwords of new data for each block.
+ * IN(i) reads the i-th longword of the current block, which is STRIDE
+ * elements of the input long.
  */
-static void MD5Transform(uint32_t buf[4], uint32_t const in[16])
+#define MD5_BLOCKS(buf, blocks, IN, STRIDE) \
+    do { \
+        uint32_t a = buf[0], b = buf[1], c = buf[2], d = buf[3]; \
+        while (blocks--) { \
+            const uint32_t aa = a, bb = b, cc = c, dd = d; \
+            \
+            MD5STEP(F1, a, b, c, d, IN(0) + 0xd76aa478, 7); \
+            MD5STEP(F1, d, a, b, c, IN(1) + 0xe8c7b756, 12); \
+            MD5STEP(F1, c, d, a, b, IN(2) + 0x242070db, 17); \
+            MD5STEP(F1, b, c, d, a, IN(3) + 0xc1bdceee, 22); \
+            MD5STEP(F1, a, b, c, d, IN(4) + 0xf57c0faf, 7); \
+            MD5STEP(F1, d, a, b, c, IN(5) + 0x4787c62a, 12); \
+            MD5STEP(F1, c, d, a, b, IN(6) + 0xa8304613, 17); \
+            MD5STEP(F1, b, c, d, a, IN(7) + 0xfd469501, 22); \
+            MD5STEP(F1, a, b, c, d, IN(8) + 0x698098d8, 7); \
+            MD5STEP(F1, d, a, b, c, IN(9) + 0x8b44f7af, 12); \
+            MD5STEP(F1, c, d, a, b, IN(10) + 0xffff5bb1, 17); \
+            MD5STEP(F1, b, c, d, a, IN(11) + 0x895cd7be, 22); \
+            MD5STEP(F1, a, b, c, d, IN(12) + 0x6b901122, 7); \
+            MD5STEP(F1, d, a, b, c, IN(13) + 0xfd987193, 12); \
+            MD5STEP(F1, c, d, a, b, IN(14) + 0xa679438e, 17); \
+            MD5STEP(F1, b, c, d, a, IN(15) + 0x49b40821, 22); \
+            \
+            MD5STEP2(a, b, c, d, IN(1) + 0xf61e2562, 5); \
+            MD5STEP2(d, a, b, c, IN(6) + 0xc040b340, 9); \
+            MD5STEP2(c, d, a, b, IN(11) + 0x265e5a51, 14); \
+            MD5STEP2(b, c, d, a, IN(0) + 0xe9b6c7aa, 20); \
+            MD5STEP2(a, b, c, d, IN(5) + 0xd62f105d, 5); \
+            MD5STEP2(d, a, b, c, IN(10) + 0x02441453, 9); \
+            MD5STEP2(c, d, a, b, IN(15) + 0xd8a1e681, 14); \
+            MD5STEP2(b, c, d, a, IN(4) + 0xe7d3fbc8, 20); \
+            MD5STEP2(a, b, c, d, IN(9) + 0x21e1cde6, 5); \
+            MD5STEP2(d, a, b, c, IN(14) + 0xc33707d6, 9); \
+            MD5STEP2(c, d, a, b, IN(3) + 0xf4d50d87, 14); \
+            MD5STEP2(b, c, d, a, IN(8) + 0x455a14ed, 20); \
+            MD5STEP2(a, b, c, d, IN(13) + 0xa9e3e905, 5); \
+            MD5STEP2(d, a, b, c, IN(2) + 0xfcefa3f8, 9); \
+            MD5STEP2(c, d, a, b, IN(7) + 0x676f02d9, 14); \
+            MD5STEP2(b, c, d, a, IN(12) + 0x8d2a4c8a, 20); \
+            \
+            MD5STEP(F3, a, b, c, d, IN(5) + 0xfffa3942, 4); \
+            MD5STEP(F3, d, a, b, c, IN(8) + 0x8771f681, 11); \
+            MD5STEP(F3, c, d, a, b, IN(11) + 0x6d9d6122, 16); \
+            MD5STEP(F3, b, c, d, a, IN(14) + 0xfde5380c, 23); \
+            MD5STEP(F3, a, b, c, d, IN(1) + 0xa4beea44, 4); \
+            MD5STEP(F3, d, a, b, c, IN(4) + 0x4bdecfa9, 11); \
+            MD5STEP(F3, c, d, a, b, IN(7) + 0xf6bb4b60, 16); \
+            MD5STEP(F3, b, c, d, a, IN(10) + 0xbebfbc70, 23); \
+            MD5STEP(F3, a, b, c, d, IN(13) + 0x289b7ec6, 4); \
+            MD5STEP(F3, d, a, b, c, IN(0) + 0xeaa127fa, 11); \
+            MD5STEP(F3, c, d, a, b, IN(3) + 0xd4ef3085, 16); \
+            MD5STEP(F3, b, c, d, a, IN(6) + 0x04881d05, 23); \
+            MD5STEP(F3, a, b, c, d, IN(9) + 0xd9d4d039, 4); \
+            MD5STEP(F3, d, a, b, c, IN(12) + 0xe6db99e5, 11); \
+            MD5STEP(F3, c, d, a, b, IN(15) + 0x1fa27cf8, 16); \
+            MD5STEP(F3, b, c, d, a, IN(2) + 0xc4ac5665, 23); \
+            \
+            MD5STEP(F4, a, b, c, d, IN(0) + 0xf4292244, 6); \
+            MD5STEP(F4, d, a, b, c, IN(7) + 0x432aff97, 10); \
+            MD5STEP(F4, c, d, a, b, IN(14) + 0xab9423a7, 15); \
+            MD5STEP(F4, b, c, d, a, IN(5) + 0xfc93a039, 21); \
+            MD5STEP(F4, a, b, c, d, IN(12) + 0x655b59c3, 6); \
+            MD5STEP(F4, d, a, b, c, IN(3) + 0x8f0ccc92, 10); \
+            MD5STEP(F4, c, d, a, b, IN(10) + 0xffeff47d, 15); \
+            MD5STEP(F4, b, c, d, a, IN(1) + 0x85845dd1, 21); \
+            MD5STEP(F4, a, b, c, d, IN(8) + 0x6fa87e4f, 6); \
+            MD5STEP(F4, d, a, b, c, IN(15) + 0xfe2ce6e0, 10); \
+            MD5STEP(F4, c, d, a, b, IN(6) + 0xa3014314, 15); \
+            MD5STEP(F4, b, c, d, a, IN(13) + 0x4e0811a1, 21); \
+            MD5STEP(F4, a, b, c, d, IN(4) + 0xf7537e82, 6); \
+            MD5STEP(F4, d, a, b, c, IN(11) + 0xbd3af235, 10); \
+            MD5STEP(F4, c, d, a, b, IN(2) + 0x2ad7d2bb, 15); \
+            MD5STEP(F4, b, c, d, a, IN(9) + 0xeb86d391, 21); \
+            \
+            a += aa; \
+            b += bb; \
+            c += cc; \
+            d += dd; \
+            in += STRIDE; \
+        } \
+        buf[0] = a; \
+        buf[1] = b; \
+        buf[2] = c; \
+        buf[3] = d; \
+    } while (0)
+
+/* The state stays in registers from one block to the next */
+static void md5_blocks(uint32_t buf[4], uint32_t const *in, size_t blocks)
+{
+#define IN_WORD(i) in[i]
+    MD5_BLOCKS(buf, blocks, IN_WORD, 16);
+#undef IN_WORD
+}
+
+#if MD5_UNALIGNED_IN_PLACE
+static inline uint32_t load_unaligned(const unsigned char *p)
 {
-    register uint32_t a, b, c, d;
-
-    a = buf[0];
-    b = buf[1];
-    c = buf[2];
-    d = buf[3];
-
-    MD5STEP(F1, a, b, c, d, in[0] + 0xd76aa478, 7);
-    MD5STEP(F1, d, a, b, c, in[1] + 0xe8c7b756, 12);
-    MD5STEP(F1, c, d, a, b, in[2] + 0x242070db, 17);
-    MD5STEP(F1, b, c, d, a, in[3] + 0xc1bdceee, 22);
-    MD5STEP(F1, a, b, c, d, in[4] + 0xf57c0faf, 7);
-    MD5STEP(F1, d, a, b, c, in[5] + 0x4787c62a, 12);
-    MD5STEP(F1, c, d, a, b, in[6] + 0xa8304613, 17);
-    MD5STEP(F1, b, c, d, a, in[7] + 0xfd469501, 22);
-    MD5STEP(F1, a, b, c, d, in[8] + 0x698098d8, 7);
-    MD5STEP(F1, d, a, b, c, in[9] + 0x8b44f7af, 12);
-    MD5STEP(F1, c, d, a, b, in[10] + 0xffff5bb1, 17);
-    MD5STEP(F1, b, c, d, a, in[11] + 0x895cd7be, 22);
-    MD5STEP(F1, a, b, c, d, in[12] + 0x6b901122, 7);
-    MD5STEP(F1, d, a, b, c, in[13] + 0xfd987193, 12);
-    MD5STEP(F1, c, d, a, b, in[14] + 0xa679438e, 17);
-    MD5STEP(F1, b, c, d, a, in[15] + 0x49b40821, 22);
-
-    MD5STEP(F2, a, b, c, d, in[1] + 0xf61e2562, 5);
-    MD5STEP(F2, d, a, b, c, in[6] + 0xc040b340, 9);
-    MD5STEP(F2, c, d, a, b, in[11] + 0x265e5a51, 14);
-    MD5STEP(F2, b, c, d, a, in[0] + 0xe9b6c7aa, 20);
-    MD5STEP(F2, a, b, c, d, in[5] + 0xd62f105d, 5);
-    MD5STEP(F2, d, a, b, c, in[10] + 0x02441453, 9);
-    MD5STEP(F2, c, d, a, b, in[15] + 0xd8a1e681, 14);
-    MD5STEP(F2, b, c, d, a, in[4] + 0xe7d3fbc8, 20);
-    MD5STEP(F2, a, b, c, d, in[9] + 0x21e1cde6, 5);
-    MD5STEP(F2, d, a, b, c, in[14] + 0xc33707d6, 9);
-    MD5STEP(F2, c, d, a, b, in[3] + 0xf4d50d87, 14);
-    MD5STEP(F2, b, c, d, a, in[8] + 0x455a14ed, 20);
-    MD5STEP(F2, a, b, c, d, in[13] + 0xa9e3e905, 5);
-    MD5STEP(F2, d, a, b, c, in[2] + 0xfcefa3f8, 9);
-    MD5STEP(F2, c, d, a, b, in[7] + 0x676f02d9, 14);
-    MD5STEP(F2, b, c, d, a, in[12] + 0x8d2a4c8a, 20);
-
-    MD5STEP(F3, a, b, c, d, in[5] + 0xfffa3942, 4);
-    MD5STEP(F3, d, a, b, c, in[8] + 0x8771f681, 11);
-    MD5STEP(F3, c, d, a, b, in[11] + 0x6d9d6122, 16);
-    MD5STEP(F3, b, c, d, a, in[14] + 0xfde5380c, 23);
-    MD5STEP(F3, a, b, c, d, in[1] + 0xa4beea44, 4);
-    MD5STEP(F3, d, a, b, c, in[4] + 0x4bdecfa9, 11);
-    MD5STEP(F3, c, d, a, b, in[7] + 0xf6bb4b60, 16);
-    MD5STEP(F3, b, c, d, a, in[10] + 0xbebfbc70, 23);
-    MD5STEP(F3, a, b, c, d, in[13] + 0x289b7ec6, 4);
-    MD5STEP(F3, d, a, b, c, in[0] + 0xeaa127fa, 11);
-    MD5STEP(F3, c, d, a, b, in[3] + 0xd4ef3085, 16);
-    MD5STEP(F3, b, c, d, a, in[6] + 0x04881d05, 23);
-    MD5STEP(F3, a, b, c, d, in[9] + 0xd9d4d039, 4);
-    MD5STEP(F3, d, a, b, c, in[12] + 0xe6db99e5, 11);
-    MD5STEP(F3, c, d, a, b, in[15] + 0x1fa27cf8, 16);
-    MD5STEP(F3, b, c, d, a, in[2] + 0xc4ac5665, 23);
-
-    MD5STEP(F4, a, b, c, d, in[0] + 0xf4292244, 6);
-    MD5STEP(F4, d, a, b, c, in[7] + 0x432aff97, 10);
-    MD5STEP(F4, c, d, a, b, in[14] + 0xab9423a7, 15);
-    MD5STEP(F4, b, c, d, a, in[5] + 0xfc93a039, 21);
-    MD5STEP(F4, a, b, c, d, in[12] + 0x655b59c3, 6);
-    MD5STEP(F4, d, a, b, c, in[3] + 0x8f0ccc92, 10);
-    MD5STEP(F4, c, d, a, b, in[10] + 0xffeff47d, 15);
-    MD5STEP(F4, b, c, d, a, in[1] + 0x85845dd1, 21);
-    MD5STEP(F4, a, b, c, d, in[8] + 0x6fa87e4f, 6);
-    MD5STEP(F4, d, a, b, c, in[15] + 0xfe2ce6e0, 10);
-    MD5STEP(F4, c, d, a, b, in[6] + 0xa3014314, 15);
-    MD5STEP(F4, b, c, d, a, in[13] + 0x4e0811a1, 21);
-    MD5STEP(F4, a, b, c, d, in[4] + 0xf7537e82, 6);
-    MD5STEP(F4, d, a, b, c, in[11] + 0xbd3af235, 10);
-    MD5STEP(F4, c, d, a, b, in[2] + 0x2ad7d2bb, 15);
-    MD5STEP(F4, b, c, d, a, in[9] + 0xeb86d391, 21);
-
-    buf[0] += a;
-    buf[1] += b;
-    buf[2] += c;
-    buf[3] += d;
+    uint32_t word;
+    memcpy(&word, p, sizeof(word));
+    return word;
 }
+
+static void md5_blocks_unaligned(uint32_t buf[4], const unsigned char *in, size_t blocks)
+{
+#define IN_WORD(i) load_unaligned(&in[4 * (i)])
+    MD5_BLOCKS(buf, blocks, IN_WORD, 64);
+#undef IN_WORD
+}
+#endif
 /* ===== end - public domain MD5 implementation ===== */
@@ -15,6 +15,7 @@
 
 #include "protocol.h"
 #include "esp_loader_io.h"
+#include "loader_context.h"
 #include "esp_loader.h"
 #include "esp_targets.h"
 #include "sip.h"
@@ -105,34 +106,56 @@ static const esp_target_t esp_target[ESP_MAX_CHIP] = {
     },
 };
 
-static uint8_t s_sip_buf[SIP_PACKET_SIZE] __attribute__((aligned(4)));
-static uint32_t s_sip_seq_tx;
-static uint32_t s_sip_current_transaction_addr;
-static target_chip_t s_target_chip = ESP_UNKNOWN_CHIP;
+typedef struct {
+    uint32_t generation;
+    uint8_t sip_buf[SIP_PACKET_SIZE] __attribute__((aligned(4)));
+    uint32_t sip_seq_tx;
+    uint32_t sip_current_transaction_addr;
+    target_chip_t target_chip;
+} sdio_state_t;
+
+static sdio_state_t s_sdio[LOADER_COUNT];
+
+static inline sdio_state_t *sdio_state(void)
+{
+    sdio_state_t *state = &s_sdio[loader_slot()];
+
+    if (state->generation != loader_generation()) {
+        memset(state, 0, sizeof(*state));
+        state->generation = loader_generation();
+        state->target_chip = ESP_UNKNOWN_CHIP;
+    }
+
+    return state;
+}
 
 static esp_loader_error_t slave_read_register(const uint32_t addr, uint32_t *reg)
 {
+    sdio_state_t *state = sdio_state();
+
     assert(addr >> 2 <= 0x7F);
 
     uint8_t buf[4] __attribute__((aligned(4))) = {0};
     buf[0] = (addr >> 2) & 0x7F;
     buf[1] = 0x80;
 
-    RETURN_ON_ERROR(loader_port_write(1,
-                                      esp_target[s_target_chip].slchost_win_cmd_addr,
-                                      buf,
-                                      sizeof(buf),
-                                      loader_port_remaining_time()));
-
-    return loader_port_read(1,
-                            esp_target[s_target_chip].slchost_state_w0_addr,
-                            (uint8_t *)reg,
-                            sizeof(uint32_t),
-                            loader_port_remaining_time());
+    RETURN_ON_ERROR(port_write(1,
+                               esp_target[state->target_chip].slchost_win_cmd_addr,
+                               buf,
+                               sizeof(buf),
+                               port_remaining_time()));
+
+    return port_read(1,
+                     esp_target[state->target_chip].slchost_state_w0_addr,
+                     (uint8_t *)reg,
+                     sizeof(uint32_t),
+                     port_remaining_time());
 }
 
 static esp_loader_error_t slave_write_register(const uint32_t addr, uint32_t reg_val)
 {
+    sdio_state_t *state = sdio_state();
+
     assert(addr >> 2 <= 0x7F);
 
     uint8_t buf[8] __attribute__((aligned(4))) = {0};
@@ -140,26 +163,26 @@ static esp_loader_error_t slave_write_register(const uint32_t addr, uint32_t reg
     buf[4] = (addr >> 2) & 0x7F;
     buf[5] = 0xC0;
 
-    return loader_port_write(1,
-                             esp_target[s_target_chip].slchost_conf_w5_addr,
-                             buf,
-                             sizeof(buf),
-                             loader_port_remaining_time());
+    return port_write(1,
+                      esp_target[state->target_chip].slchost_conf_w5_addr,
+                      buf,
+                      sizeof(buf),
+                      port_remaining_time());
 }
 
 static esp_loader_error_t slave_wait_ready(const uint32_t timeout)
 {
     uint8_t reg __attribute__((aligned(4))) = 0;
 
-    loader_port_start_timer(timeout);
+    port_start_timer(timeout);
     while ((reg & SD_IO_CCR_FN_ENABLE_FUNC1_EN) == 0) {
-        if (loader_port_remaining_time() == 0) {
+        if (port_remaining_time() == 0) {
             return ESP_LOADER_ERROR_TIMEOUT;
         }
 
-        RETURN_ON_ERROR(loader_port_read(0, SD_IO_CCCR_FN_READY,
-                                         &reg, sizeof(reg),
-                                         loader_port_remaining_time()));
+        RETURN_ON_ERROR(port_read(0, SD_IO_CCCR_FN_READY,
+                                  &reg, sizeof(reg),
+                                  port_remaining_time()));
     }
 
     return ESP_LOADER_SUCCESS;
@@ -172,20 +195,20 @@ static esp_loader_error_t slave_init_io(void)
     // Enable function 1, we will use it for upload
     // The alignment requirement comes from the esp port DMA requirements
     uint8_t reg __attribute__((aligned(4)));
-    RETURN_ON_ERROR(loader_port_read(0, SD_IO_CCCR_FN_ENABLE,
-                                     &reg, sizeof(reg),
-                                     loader_port_remaining_time()));
+    RETURN_ON_ERROR(port_read(0, SD_IO_CCCR_FN_ENABLE,
+                              &reg, sizeof(reg),
+                              port_remaining_time()));
 
     reg |= SD_IO_CCR_FN_ENABLE_FUNC1_EN;
     uint8_t expected_val = reg;
-    RETURN_ON_ERROR(loader_port_write(0, SD_IO_CCCR_FN_ENABLE,
-                                      &reg, sizeof(reg),
-                                      loader_port_remaining_time()));
+    RETURN_ON_ERROR(port_write(0, SD_IO_CCCR_FN_ENABLE,
+                               &reg, sizeof(reg),
+                               port_remaining_time()));
 
     // Read back to verify
-    RETURN_ON_ERROR(loader_port_read(0, SD_IO_CCCR_FN_ENABLE,
-                                     &reg, sizeof(reg),
-                                     loader_port_remaining_time()));
+    RETURN_ON_ERROR(port_read(0, SD_IO_CCCR_FN_ENABLE,
+                              &reg, sizeof(reg),
+                              port_remaining_time()));
 
     if (reg != expected_val) {
         return ESP_LOADER_ERROR_FAIL;
@@ -196,6 +219,8 @@ static esp_loader_error_t slave_init_io(void)
 
 static esp_loader_error_t slave_detect_chip(void)
 {
+    sdio_state_t *state = sdio_state();
+
     RETURN_ON_ERROR(slave_wait_ready(100));
 
     for (int chip = 0; chip < ESP_MAX_CHIP; chip++) {
@@ -204,14 +229,14 @@ static esp_loader_error_t slave_detect_chip(void)
         }
 
         uint32_t reg;
-        RETURN_ON_ERROR(loader_port_read(1,
-                                         esp_target[chip].slchost_date_addr,
-                                         (uint8_t *)&reg,
-                                         sizeof(uint32_t),
-                                         loader_port_remaining_time()));
+        RETURN_ON_ERROR(port_read(1,
+                                  esp_target[chip].slchost_date_addr,
+                                  (uint8_t *)&reg,
+                                  sizeof(uint32_t),
+                                  port_remaining_time()));
 
         if (reg == esp_target[chip].slchost_date_expected_val) {
-            s_target_chip = (target_chip_t)chip;
+            state->target_chip = (target_chip_t)chip;
             return ESP_LOADER_SUCCESS;
         }
     }
@@ -221,18 +246,20 @@ static esp_loader_error_t slave_detect_chip(void)
 
 static esp_loader_error_t slave_init_link(void)
 {
+    sdio_state_t *state = sdio_state();
+
     RETURN_ON_ERROR(slave_wait_ready(100));
 
     uint32_t reg = 0;
 
     // Configure stitching
-    RETURN_ON_ERROR(slave_read_register(esp_target[s_target_chip].slc_conf1_addr, &reg));
-    reg |= esp_target[s_target_chip].slc_conf1_tx_stitch_en |
-           esp_target[s_target_chip].slc_conf1_rx_stitch_en;
+    RETURN_ON_ERROR(slave_read_register(esp_target[state->target_chip].slc_conf1_addr, &reg));
+    reg |= esp_target[state->target_chip].slc_conf1_tx_stitch_en |
+           esp_target[state->target_chip].slc_conf1_rx_stitch_en;
     uint32_t expected_val = reg;
-    RETURN_ON_ERROR(slave_write_register(esp_target[s_target_chip].slc_conf1_addr, reg));
+    RETURN_ON_ERROR(slave_write_register(esp_target[state->target_chip].slc_conf1_addr, reg));
 
-    RETURN_ON_ERROR(slave_read_register(esp_target[s_target_chip].slc_conf1_addr, &reg));
+    RETURN_ON_ERROR(slave_read_register(esp_target[state->target_chip].slc_conf1_addr, &reg));
     if (reg != expected_val) {
         return ESP_LOADER_ERROR_FAIL;
     }
@@ -241,24 +268,25 @@ static esp_loader_error_t slave_init_link(void)
 
     // Configure the tx packet load enable
     // This bit does not stay set, so reading it back to check for success is pointless
-    RETURN_ON_ERROR(slave_read_register(esp_target[s_target_chip].slc_len_conf_addr, &reg));
-    reg |= esp_target[s_target_chip].slc_len_conf_tx_packet_load_en;
+    RETURN_ON_ERROR(slave_read_register(esp_target[state->target_chip].slc_len_conf_addr, &reg));
+    reg |= esp_target[state->target_chip].slc_len_conf_tx_packet_load_en;
     expected_val = reg;
-    RETURN_ON_ERROR(slave_write_register(esp_target[s_target_chip].slc_len_conf_addr, reg));
+    RETURN_ON_ERROR(slave_write_register(esp_target[state->target_chip].slc_len_conf_addr, reg));
 
     return ESP_LOADER_SUCCESS;
 }
 
 esp_loader_error_t loader_initialize_conn(esp_loader_connect_args_t *connect_args)
 {
+    sdio_state_t *state = sdio_state();
     esp_loader_error_t err = ESP_LOADER_ERROR_FAIL;
     for (uint8_t trial = 0; trial < connect_args->trials; trial++) {
-        err = loader_port_sdio_card_init();
+        err = port_sdio_card_init();
         if (err == ESP_LOADER_SUCCESS) {
             break;
         }
-        loader_port_debug_print("Retrying card connection...");
-        loader_port_delay_ms(100);
+        port_debug_print("Retrying card connection...");
+        port_delay_ms(100);
     }
 
     if (err != ESP_LOADER_SUCCESS) {
@@ -271,7 +299,7 @@ esp_loader_error_t loader_initialize_conn(esp_loader_connect_args_t *connect_arg
 
     RETURN_ON_ERROR(slave_init_link());
 
-    s_sip_seq_tx = 0;
+    state->sip_seq_tx = 0;
 
     return ESP_LOADER_SUCCESS;
 }
@@ -279,19 +307,23 @@ esp_loader_error_t loader_initialize_conn(esp_loader_connect_args_t *connect_arg
 esp_loader_error_t loader_mem_begin_cmd(const uint32_t offset, const uint32_t size,
                                         uint32_t blocks_to_write, uint32_t block_size)
 {
+    sdio_state_t *state = sdio_state();
+
     // This function only sets up global variables to be used by the loader_mem_data_cmd() function.
     // This is because the sip protocol requires no set up for block size or number of blocks.
     (void) blocks_to_write;
     (void) block_size;
     (void) size;
 
-    s_sip_current_transaction_addr = offset;
+    state->sip_current_transaction_addr = offset;
 
     return ESP_LOADER_SUCCESS;
 }
 
 esp_loader_error_t loader_mem_data_cmd(const uint8_t *data, uint32_t size)
 {
+    sdio_state_t *state = sdio_state();
+
     RETURN_ON_ERROR(slave_wait_ready(100));
 
     int32_t remaining = size;
@@ -304,40 +336,42 @@ esp_loader_error_t loader_mem_data_cmd(const uint8_t *data, uint32_t size)
             .fc[0] = SIP_PACKET_TYPE_CTRL & SIP_TYPE_MASK,
             .fc[1] = 0x00,
             .len = data_size + nondata_size,
-            .sequence_num = s_sip_seq_tx,
+            .sequence_num = state->sip_seq_tx,
             .u.tx_info.u.cmdid = SIP_CMD_ID_WRITE_MEMORY,
         };
 
         const sip_cmd_write_memory cmd = {
-            .addr = s_sip_current_transaction_addr + size - remaining,
+            .addr = state->sip_current_transaction_addr + size - remaining,
             .len = data_size,
         };
 
-        memcpy(&s_sip_buf[0], &header, sizeof(header));
-        memcpy(&s_sip_buf[sizeof(header)], &cmd, sizeof(cmd));
+        memcpy(&state->sip_buf[0], &header, sizeof(header));
+        memcpy(&state->sip_buf[sizeof(header)], &cmd, sizeof(cmd));
         memcpy(
-            &s_sip_buf[sizeof(header) + sizeof(cmd)],
+            &state->sip_buf[sizeof(header) + sizeof(cmd)],
             &data[size - remaining],
             data_size
         );
 
-        RETURN_ON_ERROR(loader_port_write(1,
-                                          esp_target[s_target_chip].slchost_packet_space_end - header.len,
-                                          s_sip_buf,
-                                          header.len,
-                                          loader_port_remaining_time()));
+        RETURN_ON_ERROR(port_write(1,
+                                   esp_target[state->target_chip].slchost_packet_space_end - header.len,
+                                   state->sip_buf,
+                                   header.len,
+                                   port_remaining_time()));
 
         remaining -= data_size;
-        s_sip_seq_tx++;
+        state->sip_seq_tx++;
     }
 
-    s_sip_current_transaction_addr += size;
+    state->sip_current_transaction_addr += size;
 
     return ESP_LOADER_SUCCESS;
 }
 
 esp_loader_error_t loader_mem_end_cmd(uint32_t entrypoint)
 {
+    sdio_state_t *state = sdio_state();
+
     RETURN_ON_ERROR(slave_wait_ready(100));
 
     const sip_header_t header = {
@@ -350,14 +384,14 @@ esp_loader_error_t loader_mem_end_cmd(uint32_t entrypoint)
 
     const sip_cmd_bootup cmd = { .boot_addr = entrypoint, .discard_link = 1};
 
-    memcpy(&s_sip_buf[0], &header, sizeof(header));
-    memcpy(&s_sip_buf[sizeof(header)], &cmd, sizeof(cmd));
+    memcpy(&state->sip_buf[0], &header, sizeof(header));
+    memcpy(&state->sip_buf[sizeof(header)], &cmd, sizeof(cmd));
 
-    return loader_port_write(1,
-                             esp_target[s_target_chip].slchost_packet_space_end - header.len,
-                             s_sip_buf,
-                             header.len,
-                             loader_port_remaining_time()
+    return port_write(1,
+                      esp_target[state->target_chip].slchost_packet_space_end - header.len,
+                      state->sip_buf,
+                      header.len,
+                      port_remaining_time()
                             );
 
     return ESP_LOADER_SUCCESS;
@@ -365,8 +399,10 @@ esp_loader_error_t loader_mem_end_cmd(uint32_t entrypoint)
 
 esp_loader_error_t loader_detect_chip(target_chip_t *target_chip, const target_registers_t **target_data)
 {
+    sdio_state_t *state = sdio_state();
+
     (void) target_data;
-    *target_chip = s_target_chip;
+    *target_chip = state->target_chip;
 
     return ESP_LOADER_SUCCESS;
 }
@@ -16,17 +16,42 @@
 #include "protocol.h"
 #include "protocol_prv.h"
 #include "esp_loader_io.h"
+#include "loader_context.h"
 #include "esp_stubs.h"
 #include <stddef.h>
 #include <string.h>
 
 #define CMD_SIZE(cmd) ( sizeof(cmd) - sizeof(command_common_t) )
 
-static uint32_t s_sequence_number = 0;
+typedef struct {
+    uint32_t generation;
+    uint32_t sequence_number;
+} serial_state_t;
 
-static uint8_t compute_checksum(const uint8_t *data, uint32_t size)
+static serial_state_t s_serial[LOADER_COUNT];
+
+static inline serial_state_t *serial_state(void)
+{
+    serial_state_t *state = &s_serial[loader_slot()];
+
+    if (state->generation != loader_generation()) {
+        memset(state, 0, sizeof(*state));
+        state->generation = loader_generation();
+    }
+
+    return state;
+}
+
+static uint8_t compute_checksum(uint8_t checksum, const uint8_t *data, size_t size)
 {
-    uint8_t checksum = 0xEF;
+    // XOR whole words, then fold the word into the byte checksum
+    uint32_t word_checksum = 0;
+    for (; size >= sizeof(uint32_t); data += sizeof(uint32_t), size -= sizeof(uint32_t)) {
+        uint32_t word;
+        memcpy(&word, data, sizeof(word));
+        word_checksum ^= word;
+    }
+    checksum ^= word_checksum ^ (word_checksum >> 8) ^ (word_checksum >> 16) ^ (word_checksum >> 24);
 
     while (size--) {
         checksum ^= *data++;
@@ -35,22 +60,53 @@ static uint8_t compute_checksum(const uint8_t *data, uint32_t size)
     return checksum;
 }
 
+void update_data_digest(const send_cmd_config *config, size_t offset, size_t size, uint8_t *checksum)
+{
+    const uint8_t *data = (const uint8_t *)config->data + offset;
+
+    if (checksum != NULL) {
+        *checksum = compute_checksum(*checksum, data, size);
+    }
+
+    if (config->data_md5 != NULL && offset < config->data_md5_size) {
+        MD5Update(config->data_md5, data, MIN(size, config->data_md5_size - offset));
+    }
+}
+
+void update_padding_digest(const send_cmd_config *config, uint8_t *checksum)
+{
+    static const uint8_t padding[4] = { PADDING_PATTERN, PADDING_PATTERN, PADDING_PATTERN, PADDING_PATTERN };
+    const size_t padding_start = config->data_size - config->data_padding;
+
+    // Every pair of padding bytes cancels out
+    if (checksum != NULL && config->data_padding % 2 != 0) {
+        *checksum ^= PADDING_PATTERN;
+    }
+
+    if (config->data_md5 != NULL && padding_start < config->data_md5_size) {
+        size_t to_hash = MIN(config->data_padding, config->data_md5_size - padding_start);
+        for (; to_hash > 0; to_hash -= MIN(to_hash, sizeof(padding))) {
+            MD5Update(config->data_md5, padding, MIN(to_hash, sizeof(padding)));
+        }
+    }
+}
+
 void log_loader_internal_error(error_code_t error)
 {
-    loader_port_debug_print("Error: ");
+    port_debug_print("Error: ");
 
     switch (error) {
-    case INVALID_CRC:     loader_port_debug_print("INVALID_CRC"); break;
-    case INVALID_COMMAND: loader_port_debug_print("INVALID_COMMAND"); break;
-    case COMMAND_FAILED:  loader_port_debug_print("COMMAND_FAILED"); break;
-    case FLASH_WRITE_ERR: loader_port_debug_print("FLASH_WRITE_ERR"); break;
-    case FLASH_READ_ERR:  loader_port_debug_print("FLASH_READ_ERR"); break;
-    case READ_LENGTH_ERR: loader_port_debug_print("READ_LENGTH_ERR"); break;
-    case DEFLATE_ERROR:   loader_port_debug_print("DEFLATE_ERROR"); break;
-    default:              loader_port_debug_print("UNKNOWN ERROR"); break;
+    case INVALID_CRC:     port_debug_print("INVALID_CRC"); break;
+    case INVALID_COMMAND: port_debug_print("INVALID_COMMAND"); break;
+    case COMMAND_FAILED:  port_debug_print("COMMAND_FAILED"); break;
+    case FLASH_WRITE_ERR: port_debug_print("FLASH_WRITE_ERR"); break;
+    case FLASH_READ_ERR:  port_debug_print("FLASH_READ_ERR"); break;
+    case READ_LENGTH_ERR: port_debug_print("READ_LENGTH_ERR"); break;
+    case DEFLATE_ERROR:   port_debug_print("DEFLATE_ERROR"); break;
+    default:              port_debug_print("UNKNOWN ERROR"); break;
     }
 
-    loader_port_debug_print("\n");
+    port_debug_print("\n");
 }
 
 esp_loader_error_t loader_flash_begin_cmd(uint32_t offset,
@@ -73,7 +129,7 @@ esp_loader_error_t loader_flash_begin_cmd(uint32_t offset,
         .encrypted = 0
     };
 
-    s_sequence_number = 0;
+    serial_state()->sequence_number = 0;
 
     const send_cmd_config cmd_config = {
         .cmd = &flash_begin_cmd,
@@ -84,17 +140,100 @@ esp_loader_error_t loader_flash_begin_cmd(uint32_t offset,
 }
 
 
-esp_loader_error_t loader_flash_data_cmd(const uint8_t *data, uint32_t size)
+esp_loader_error_t loader_flash_data_cmd(const uint8_t *data, uint32_t size, uint32_t padding,
+                                         struct MD5Context *md5, uint32_t md5_size)
 {
+    serial_state_t *state = serial_state();
     data_command_t data_cmd = {
         .common = {
             .direction = WRITE_DIRECTION,
             .command = FLASH_DATA,
+            .size = CMD_SIZE(data_cmd) + size + padding,
+            .checksum = 0
+        },
+        .data_size = size + padding,
+        .sequence_number = state->sequence_number++,
+    };
+
+    const send_cmd_config cmd_config = {
+        .cmd = &data_cmd,
+        .cmd_size = sizeof(data_cmd),
+        .data = data,
+        .data_size = size + padding,
+        .data_checksum = (uint8_t *) &data_cmd.common.checksum,
+        .data_md5 = md5,
+        .data_md5_size = md5_size,
+        .data_padding = padding,
+    };
+
+    return send_cmd(&cmd_config);
+}
+
+
+esp_loader_error_t loader_flash_end_cmd(bool stay_in_loader)
+{
+    flash_end_command_t end_cmd = {
+        .common = {
+            .direction = WRITE_DIRECTION,
+            .command = FLASH_END,
+            .size = CMD_SIZE(end_cmd),
+            .checksum = 0
+        },
+        .stay_in_loader = stay_in_loader
+    };
+
+    const send_cmd_config cmd_config = {
+        .cmd = &end_cmd,
+        .cmd_size = sizeof(end_cmd)
+    };
+
+    return send_cmd(&cmd_config);
+}
+
+
+esp_loader_error_t loader_flash_defl_begin_cmd(uint32_t offset,
+        uint32_t erase_size,
+        uint32_t block_size,
+        uint32_t blocks_to_write,
+        bool encryption)
+{
+    flash_begin_command_t flash_begin_cmd = {
+        .common = {
+            .direction = WRITE_DIRECTION,
+            .command = FLASH_DEFL_BEGIN,
+            .size = CMD_SIZE(flash_begin_cmd) - (encryption ? 0 : sizeof(uint32_t)),
+            .checksum = 0
+        },
+        .erase_size = erase_size,
+        .packet_count = blocks_to_write,
+        .packet_size = block_size,
+        .offset = offset,
+        .encrypted = 0
+    };
+
+    serial_state()->sequence_number = 0;
+
+    const send_cmd_config cmd_config = {
+        .cmd = &flash_begin_cmd,
+        .cmd_size = sizeof(flash_begin_cmd) - (encryption ? 0 : sizeof(uint32_t)),
+    };
+
+    return send_cmd(&cmd_config);
+}
+
+
+esp_loader_error_t loader_flash_defl_data_cmd(const uint8_t *data, uint32_t size)
+{
+    serial_state_t *state = serial_state();
+    data_command_t data_cmd = {
+        .common = {
+            .direction = WRITE_DIRECTION,
+            .command = FLASH_DEFL_DATA,
             .size = CMD_SIZE(data_cmd) + size,
-            .checksum = compute_checksum(data, size)
+            .checksum = 0
         },
         .data_size = size,
-        .sequence_number = s_sequence_number++,
+        .sequence_number = state->sequence_number++,
     };
 
     const send_cmd_config cmd_config = {
@@ -102,18 +241,19 @@ esp_loader_error_t loader_flash_data_cmd(const uint8_t *data, uint32_t size)
         .cmd_size = sizeof(data_cmd),
         .data = data,
         .data_size = size,
+        .data_checksum = (uint8_t *) &data_cmd.common.checksum,
     };
 
     return send_cmd(&cmd_config);
 }
 
 
-esp_loader_error_t loader_flash_end_cmd(bool stay_in_loader)
+esp_loader_error_t loader_flash_defl_end_cmd(bool stay_in_loader)
 {
     flash_end_command_t end_cmd = {
         .common = {
             .direction = WRITE_DIRECTION,
-            .command = FLASH_END,
+            .command = FLASH_DEFL_END,
             .size = CMD_SIZE(end_cmd),
             .checksum = 0
         },
@@ -154,7 +294,7 @@ esp_loader_error_t loader_flash_read_rom_cmd(const uint32_t address, uint8_t *da
 
 
 esp_loader_error_t loader_flash_read_stub_cmd(const uint32_t address, const uint32_t size,
-        const uint32_t size_per_packet)
+        const uint32_t size_per_packet, const uint32_t max_inflight_packets)
 {
     const flash_read_stub_cmd flash_read_cmd = {
         .common = {
@@ -166,7 +306,7 @@ esp_loader_error_t loader_flash_read_stub_cmd(const uint32_t address, const uint
         .address = address,
         .total_size = size,
         .packet_data_size = size_per_packet,
-        .max_inflight_packets = 1,
+        .max_inflight_packets = max_inflight_packets,
     };
 
     const send_cmd_config cmd_config = {
@@ -178,6 +318,48 @@ esp_loader_error_t loader_flash_read_stub_cmd(const uint32_t address, const uint
 }
 
 
+esp_loader_error_t loader_erase_flash_cmd(void)
+{
+    const erase_flash_command_t erase_cmd = {
+        .common = {
+            .direction = WRITE_DIRECTION,
+            .command = ERASE_FLASH,
+            .size = CMD_SIZE(erase_cmd),
+            .checksum = 0
+        },
+    };
+
+    const send_cmd_config cmd_config = {
+        .cmd = &erase_cmd,
+        .cmd_size = sizeof(erase_cmd),
+    };
+
+    return send_cmd(&cmd_config);
+}
+
+
+esp_loader_error_t loader_erase_region_cmd(const uint32_t offset, const uint32_t size)
+{
+    const erase_region_command_t erase_cmd = {
+        .common = {
+            .direction = WRITE_DIRECTION,
+            .command = ERASE_REGION,
+            .size = CMD_SIZE(erase_cmd),
+            .checksum = 0
+        },
+        .offset = offset,
+        .size = size,
+    };
+
+    const send_cmd_config cmd_config = {
+        .cmd = &erase_cmd,
+        .cmd_size = sizeof(erase_cmd),
+    };
+
+    return send_cmd(&cmd_config);
+}
+
+
 esp_loader_error_t loader_sync_cmd(void)
 {
     sync_command_t sync_cmd = {
@@ -295,7 +477,7 @@ esp_loader_error_t loader_mem_begin_cmd(uint32_t offset, uint32_t size, uint32_t
         .offset = offset
     };
 
-    s_sequence_number = 0;
+    serial_state()->sequence_number = 0;
 
     const send_cmd_config cmd_config = {
         .cmd = &mem_begin_cmd,
@@ -308,15 +490,16 @@ esp_loader_error_t loader_mem_begin_cmd(uint32_t offset, uint32_t size, uint32_t
 
 esp_loader_error_t loader_mem_data_cmd(const uint8_t *data, uint32_t size)
 {
+    serial_state_t *state = serial_state();
     data_command_t data_cmd = {
         .common = {
             .direction = WRITE_DIRECTION,
             .command = MEM_DATA,
             .size = CMD_SIZE(data_cmd) + size,
-            .checksum = compute_checksum(data, size)
+            .checksum = 0
         },
         .data_size = size,
-        .sequence_number = s_sequence_number++,
+        .sequence_number = state->sequence_number++,
     };
 
     const send_cmd_config cmd_config = {
@@ -324,6 +507,7 @@ esp_loader_error_t loader_mem_data_cmd(const uint8_t *data, uint32_t size)
         .cmd_size = sizeof(data_cmd),
         .data = data,
         .data_size = size,
+        .data_checksum = (uint8_t *) &data_cmd.common.checksum,
     };
 
     return send_cmd(&cmd_config);
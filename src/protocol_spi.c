@@ -16,7 +16,9 @@
 #include "protocol.h"
 #include "protocol_prv.h"
 #include "esp_loader_io.h"
+#include "loader_context.h"
 #include <stddef.h>
+#include <string.h>
 #include <assert.h>
 
 typedef struct __attribute__((packed))
@@ -67,8 +69,25 @@ typedef enum {
     SLAVE_CMD_DONE = 0x55,
 } slave_cmd_t;
 
-static uint8_t s_slave_seq_tx;
-static uint8_t s_slave_seq_rx;
+typedef struct {
+    uint32_t generation;
+    uint8_t slave_seq_tx;
+    uint8_t slave_seq_rx;
+} spi_state_t;
+
+static spi_state_t s_spi[LOADER_COUNT];
+
+static inline spi_state_t *spi_state(void)
+{
+    spi_state_t *state = &s_spi[loader_slot()];
+
+    if (state->generation != loader_generation()) {
+        memset(state, 0, sizeof(*state));
+        state->generation = loader_generation();
+    }
+
+    return state;
+}
 
 static esp_loader_error_t write_slave_reg(const uint8_t *data, const uint32_t addr,
         const uint8_t size);
@@ -87,8 +106,8 @@ esp_loader_error_t loader_initialize_conn(esp_loader_connect_args_t *connect_arg
                                        sizeof(slave_ready_flag)));
 
         if (slave_ready_flag != SLAVE_CMD_IDLE) {
-            loader_port_debug_print("Waiting for Slave to be idle...\n");
-            loader_port_delay_ms(100);
+            port_debug_print("Waiting for Slave to be idle...\n");
+            port_delay_ms(100);
         } else {
             break;
         }
@@ -103,8 +122,8 @@ esp_loader_error_t loader_initialize_conn(esp_loader_connect_args_t *connect_arg
                                        sizeof(slave_ready_flag)));
 
         if (slave_ready_flag != SLAVE_CMD_READY) {
-            loader_port_debug_print("Waiting for Slave to be ready...\n");
-            loader_port_delay_ms(100);
+            port_debug_print("Waiting for Slave to be ready...\n");
+            port_delay_ms(100);
         } else {
             break;
         }
@@ -116,15 +135,22 @@ esp_loader_error_t loader_initialize_conn(esp_loader_connect_args_t *connect_arg
 
 esp_loader_error_t send_cmd(const send_cmd_config *config)
 {
+    spi_state_t *state = spi_state();
+
     // Commands with response data are not supported by the ROM for the SPI interface
     if (config->resp_data != NULL) {
         return ESP_LOADER_ERROR_INVALID_PARAM;
     }
 
+    if (config->data_checksum != NULL) {
+        *config->data_checksum = CHECKSUM_INITIAL_VALUE;
+        update_data_digest(config, 0, config->data_size, config->data_checksum);
+    }
+
     uint32_t target_buf_size;
     bool slave_ready = false;
     while (!slave_ready) {
-        RETURN_ON_ERROR(handle_slave_state(SLAVE_REGISTER_RXSTA, &s_slave_seq_rx, &slave_ready,
+        RETURN_ON_ERROR(handle_slave_state(SLAVE_REGISTER_RXSTA, &state->slave_seq_rx, &slave_ready,
                                            &target_buf_size));
     }
 
@@ -135,24 +161,24 @@ esp_loader_error_t send_cmd(const send_cmd_config *config)
     /* Start and write the command */
     transaction_preamble_t preamble = {.cmd = TRANS_CMD_WRDMA};
 
-    loader_port_spi_set_cs(0);
-    RETURN_ON_ERROR(loader_port_write((const uint8_t *)&preamble, sizeof(preamble),
-                                      loader_port_remaining_time()));
-    RETURN_ON_ERROR(loader_port_write((const uint8_t *)config->cmd, config->cmd_size,
-                                      loader_port_remaining_time()));
+    port_spi_set_cs(0);
+    RETURN_ON_ERROR(port_write((const uint8_t *)&preamble, sizeof(preamble),
+                               port_remaining_time()));
+    RETURN_ON_ERROR(port_write((const uint8_t *)config->cmd, config->cmd_size,
+                               port_remaining_time()));
     if (config->data != NULL && config->data_size != 0) {
-        RETURN_ON_ERROR(loader_port_write((const uint8_t *)config->data, config->data_size,
-                                          loader_port_remaining_time()));
+        RETURN_ON_ERROR(port_write((const uint8_t *)config->data, config->data_size,
+                                   port_remaining_time()));
     }
 
-    loader_port_spi_set_cs(1);
+    port_spi_set_cs(1);
 
     /* Terminate the write */
-    loader_port_spi_set_cs(0);
+    port_spi_set_cs(0);
     preamble.cmd = TRANS_CMD_WR_DONE;
-    RETURN_ON_ERROR(loader_port_write((const uint8_t *)&preamble, sizeof(preamble),
-                                      loader_port_remaining_time()));
-    loader_port_spi_set_cs(1);
+    RETURN_ON_ERROR(port_write((const uint8_t *)&preamble, sizeof(preamble),
+                               port_remaining_time()));
+    port_spi_set_cs(1);
 
     command_t command = ((const command_common_t *)config->cmd)->command;
     return check_response(command, config->reg_value);
@@ -167,11 +193,11 @@ static esp_loader_error_t read_slave_reg(uint8_t *out_data, const uint32_t addr,
         .addr = addr,
     };
 
-    loader_port_spi_set_cs(0);
-    RETURN_ON_ERROR(loader_port_write((const uint8_t *)&preamble, sizeof(preamble),
-                                      loader_port_remaining_time()));
-    RETURN_ON_ERROR(loader_port_read(out_data, size, loader_port_remaining_time()));
-    loader_port_spi_set_cs(1);
+    port_spi_set_cs(0);
+    RETURN_ON_ERROR(port_write((const uint8_t *)&preamble, sizeof(preamble),
+                               port_remaining_time()));
+    RETURN_ON_ERROR(port_read(out_data, size, port_remaining_time()));
+    port_spi_set_cs(1);
 
     return ESP_LOADER_SUCCESS;
 }
@@ -185,11 +211,11 @@ static esp_loader_error_t write_slave_reg(const uint8_t *data, const uint32_t ad
         .addr = addr,
     };
 
-    loader_port_spi_set_cs(0);
-    RETURN_ON_ERROR(loader_port_write((const uint8_t *)&preamble, sizeof(preamble),
-                                      loader_port_remaining_time()));
-    RETURN_ON_ERROR(loader_port_write(data, size, loader_port_remaining_time()));
-    loader_port_spi_set_cs(1);
+    port_spi_set_cs(0);
+    RETURN_ON_ERROR(port_write((const uint8_t *)&preamble, sizeof(preamble),
+                               port_remaining_time()));
+    RETURN_ON_ERROR(port_write(data, size, port_remaining_time()));
+    port_spi_set_cs(1);
 
     return ESP_LOADER_SUCCESS;
 }
@@ -234,12 +260,13 @@ static esp_loader_error_t handle_slave_state(const uint32_t status_reg_addr, uin
 
 static esp_loader_error_t check_response(const command_t cmd, uint32_t *reg_value)
 {
+    spi_state_t *state = spi_state();
     uint8_t buf[sizeof(common_response_t) + sizeof(response_status_t)] __attribute__((aligned(4)));
 
     uint32_t target_buf_size;
     bool slave_ready = false;
     while (!slave_ready) {
-        RETURN_ON_ERROR(handle_slave_state(SLAVE_REGISTER_TXSTA, &s_slave_seq_tx, &slave_ready,
+        RETURN_ON_ERROR(handle_slave_state(SLAVE_REGISTER_TXSTA, &state->slave_seq_tx, &slave_ready,
                                            &target_buf_size));
     }
 
@@ -251,20 +278,20 @@ static esp_loader_error_t check_response(const command_t cmd, uint32_t *reg_valu
         .cmd = TRANS_CMD_RDDMA,
     };
 
-    loader_port_spi_set_cs(0);
-    RETURN_ON_ERROR(loader_port_write((const uint8_t *)&preamble, sizeof(preamble),
-                                      loader_port_remaining_time()));
-    RETURN_ON_ERROR(loader_port_read(buf, sizeof(buf),
-                                     loader_port_remaining_time()));
+    port_spi_set_cs(0);
+    RETURN_ON_ERROR(port_write((const uint8_t *)&preamble, sizeof(preamble),
+                               port_remaining_time()));
+    RETURN_ON_ERROR(port_read(buf, sizeof(buf),
+                              port_remaining_time()));
 
-    loader_port_spi_set_cs(1);
+    port_spi_set_cs(1);
 
     /* Terminate the read */
-    loader_port_spi_set_cs(0);
+    port_spi_set_cs(0);
     preamble.cmd = TRANS_CMD_CMD8;
-    RETURN_ON_ERROR(loader_port_write((const uint8_t *)&preamble, sizeof(preamble),
-                                      loader_port_remaining_time()));
-    loader_port_spi_set_cs(1);
+    RETURN_ON_ERROR(port_write((const uint8_t *)&preamble, sizeof(preamble),
+                               port_remaining_time()));
+    port_spi_set_cs(1);
 
     common_response_t *common = (common_response_t *)&buf[0];
     if ((common->direction != READ_DIRECTION) || (common->command != cmd)) {
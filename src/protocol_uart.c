@@ -16,6 +16,7 @@
 #include "protocol.h"
 #include "protocol_prv.h"
 #include "esp_loader_io.h"
+#include "loader_context.h"
 #include "esp_stubs.h"
 #include "slip.h"
 #include <stddef.h>
@@ -23,19 +24,27 @@
 
 static esp_loader_error_t check_response(const send_cmd_config *config);
 
+// Data is checksummed, hashed and escaped in chunks the size of an MD5 block
+#define DATA_CHUNK_SIZE 64
+// Without the checksum, data is hashed and escaped in chunks that stay in the L1 cache
+#define STUB_DATA_CHUNK_SIZE 1024
+
 esp_loader_error_t loader_initialize_conn(esp_loader_connect_args_t *connect_args)
 {
     esp_loader_error_t err;
     int32_t trials = connect_args->trials;
 
+    // Whatever was received before the reset is stale
+    SLIP_reset();
+
     do {
-        loader_port_start_timer(connect_args->sync_timeout);
+        port_start_timer(connect_args->sync_timeout);
         err = loader_sync_cmd();
         if (err == ESP_LOADER_ERROR_TIMEOUT) {
             if (--trials == 0) {
                 return ESP_LOADER_ERROR_TIMEOUT;
             }
-            loader_port_delay_ms(100);
+            port_delay_ms(100);
         } else if (err != ESP_LOADER_SUCCESS) {
             return err;
         }
@@ -89,18 +98,107 @@ esp_loader_error_t loader_run_stub(target_chip_t target)
     return ESP_LOADER_SUCCESS;
 }
 
-esp_loader_error_t send_cmd(const send_cmd_config *config)
+/* Padding never needs escaping, it is sent from a constant block instead of the caller's buffer */
+static esp_loader_error_t send_padding(size_t size)
+{
+    static const uint8_t padding[16] = {
+        PADDING_PATTERN, PADDING_PATTERN, PADDING_PATTERN, PADDING_PATTERN,
+        PADDING_PATTERN, PADDING_PATTERN, PADDING_PATTERN, PADDING_PATTERN,
+        PADDING_PATTERN, PADDING_PATTERN, PADDING_PATTERN, PADDING_PATTERN,
+        PADDING_PATTERN, PADDING_PATTERN, PADDING_PATTERN, PADDING_PATTERN,
+    };
+
+    while (size > 0) {
+        const size_t chunk = MIN(size, sizeof(padding));
+        RETURN_ON_ERROR(SLIP_send(padding, chunk));
+        size -= chunk;
+    }
+
+    return ESP_LOADER_SUCCESS;
+}
+
+/* The checksum of the data goes into the command header, which is sent before the data. To walk
+   the data only once, it is escaped into the transmit buffer behind space reserved for the header
+   while its checksum and hash are computed. Whatever does not fit into the buffer is walked a
+   second time, after the header has been completed and the buffer sent. This is only needed for
+   the ROM loaders, whose blocks are about the size of the buffer. */
+static esp_loader_error_t send_cmd_with_checksum(const send_cmd_config *config)
 {
+    const uint8_t *data = (const uint8_t *)config->data;
+    const size_t data_size = config->data_size - config->data_padding;
+    uint8_t checksum = CHECKSUM_INITIAL_VALUE;
+    size_t escaped = 0;
+
+    RETURN_ON_ERROR(SLIP_begin_deferred_frame(config->cmd_size));
+
+    while (escaped < data_size) {
+        const size_t chunk = MIN(DATA_CHUNK_SIZE, data_size - escaped);
+        const size_t used = SLIP_append(&data[escaped], chunk);
+        update_data_digest(config, escaped, used, &checksum);
+        escaped += used;
+        if (used < chunk) {
+            break;
+        }
+    }
+
+    if (escaped < data_size) {
+        update_data_digest(config, escaped, data_size - escaped, &checksum);
+    }
+    update_padding_digest(config, &checksum);
+
+    *config->data_checksum = checksum;
+    SLIP_set_deferred_header((const uint8_t *)config->cmd, config->cmd_size);
+
+    RETURN_ON_ERROR(SLIP_send(&data[escaped], data_size - escaped));
+
+    return send_padding(config->data_padding);
+}
+
+/* The flasher stub does not check the data checksum, so the header goes out first and each chunk
+   of the data is hashed right before it is escaped. Blocks of any size are walked only once. */
+static esp_loader_error_t send_cmd_hashing_data(const send_cmd_config *config)
+{
+    const uint8_t *data = (const uint8_t *)config->data;
+    const size_t data_size = config->data_size - config->data_padding;
+
     RETURN_ON_ERROR(SLIP_send_delimiter());
 
     RETURN_ON_ERROR(SLIP_send((const uint8_t *)config->cmd, config->cmd_size));
 
-    if (config->data != NULL && config->data_size != 0) {
-        RETURN_ON_ERROR(SLIP_send((const uint8_t *)config->data, config->data_size));
+    if (config->data_md5 == NULL) {
+        RETURN_ON_ERROR(SLIP_send(data, data_size));
+    } else {
+        for (size_t offset = 0; offset < data_size; offset += STUB_DATA_CHUNK_SIZE) {
+            const size_t chunk = MIN(STUB_DATA_CHUNK_SIZE, data_size - offset);
+            update_data_digest(config, offset, chunk, NULL);
+            RETURN_ON_ERROR(SLIP_send(&data[offset], chunk));
+        }
+        update_padding_digest(config, NULL);
+    }
+
+    return send_padding(config->data_padding);
+}
+
+esp_loader_error_t send_cmd(const send_cmd_config *config)
+{
+    if (config->data_checksum != NULL && esp_stub_get_running()) {
+        RETURN_ON_ERROR(send_cmd_hashing_data(config));
+    } else if (config->data_checksum != NULL) {
+        RETURN_ON_ERROR(send_cmd_with_checksum(config));
+    } else {
+        RETURN_ON_ERROR(SLIP_send_delimiter());
+
+        RETURN_ON_ERROR(SLIP_send((const uint8_t *)config->cmd, config->cmd_size));
+
+        if (config->data != NULL && config->data_size != 0) {
+            RETURN_ON_ERROR(SLIP_send((const uint8_t *)config->data, config->data_size));
+        }
     }
 
     RETURN_ON_ERROR(SLIP_send_delimiter());
 
+    RETURN_ON_ERROR(SLIP_flush());
+
     command_t command = ((const command_common_t *)config->cmd)->command;
     const uint8_t response_cnt = command == SYNC ? 8 : 1;
 
@@ -14,110 +14,333 @@
  */
 
 #include "slip.h"
+#include "slip_kernels.h"
 #include "esp_loader_io.h"
+#include "loader_context.h"
+#include <string.h>
 
 static const uint8_t DELIMITER = 0xC0;
-static const uint8_t C0_REPLACEMENT[2] = {0xDB, 0xDC};
-static const uint8_t DB_REPLACEMENT[2] = {0xDB, 0xDD};
 
-static inline esp_loader_error_t peripheral_read(uint8_t *buff, const size_t size)
+#define RX_BUFFER_SIZE 256
+
+typedef struct {
+    uint32_t generation;
+
+    // Bytes read from the port in bulk, anything past the end of a frame is kept for the next one
+    uint8_t rx_buffer[RX_BUFFER_SIZE];
+    size_t rx_pos;
+    size_t rx_len;
+
+    // Frames are assembled here and written with as few port calls as the buffer size allows
+    uint8_t tx_buffer[SERIAL_FLASHER_TX_BUFFER_SIZE];
+    size_t tx_len;
+    size_t tx_start;   // Frames with a deferred header start past the beginning of the buffer
+    size_t tx_slot;    // End of the space reserved for the deferred header
+    bool tx_in_frame;
+
+    esp_loader_transfer_stats_t stats;
+} slip_context_t;
+
+static slip_context_t s_slip[LOADER_COUNT];
+
+static inline slip_context_t *slip_context(void)
 {
-    return loader_port_read(buff, size, loader_port_remaining_time());
+    slip_context_t *state = &s_slip[loader_slot()];
+
+    if (state->generation != loader_generation()) {
+        memset(state, 0, sizeof(*state));
+        state->generation = loader_generation();
+    }
+
+    return state;
+}
+
+static inline esp_loader_error_t peripheral_read_some(void)
+{
+    slip_context_t *state = slip_context();
+    uint16_t received = 0;
+
+    RETURN_ON_ERROR( port_read_some(state->rx_buffer, sizeof(state->rx_buffer),
+                                    port_remaining_time(), &received) );
+
+    state->rx_pos = 0;
+    state->rx_len = received;
+    state->stats.port_reads++;
+    state->stats.bytes_read += received;
+
+    return ESP_LOADER_SUCCESS;
 }
 
 static inline esp_loader_error_t peripheral_write(const uint8_t *buff, const size_t size)
 {
-    return loader_port_write(buff, size, loader_port_remaining_time());
+    slip_context_t *state = slip_context();
+
+    state->stats.port_writes++;
+    state->stats.bytes_written += size;
+
+    return port_write(buff, size, port_remaining_time());
 }
 
 
-esp_loader_error_t SLIP_receive_packet(uint8_t *buff, const size_t max_size, size_t *recv_size)
+void SLIP_decoder_init(slip_decoder_t *decoder, uint8_t *buff, const size_t max_size)
 {
-    uint8_t ch;
+    decoder->buff = buff;
+    decoder->max_size = max_size;
+    decoder->size = 0;
+    decoder->state = SLIP_STATE_WAIT_START;
+}
 
-    // Wait for delimiter
-    do {
-        RETURN_ON_ERROR( peripheral_read(&ch, 1) );
-    } while (ch != DELIMITER);
 
-    // Workaround: bootloader sends two dummy(0xC0) bytes after response when baud rate is changed.
-    do {
-        RETURN_ON_ERROR( peripheral_read(&ch, 1) );
-    } while (ch == DELIMITER);
+esp_loader_error_t SLIP_decoder_feed(slip_decoder_t *decoder, const uint8_t *data, const size_t size,
+                                     size_t *consumed, bool *complete)
+{
+    *complete = false;
 
-    buff[0] = ch;
+    for (size_t i = 0; i < size; i++) {
+        uint8_t ch = data[i];
 
-    // Receive either until either delimiter or maximum receive size
-    for (size_t i = 1; i < max_size; i++) {
-        RETURN_ON_ERROR( peripheral_read(&ch, 1) );
+        switch (decoder->state) {
+        case SLIP_STATE_WAIT_START:
+            if (ch == DELIMITER) {
+                decoder->state = SLIP_STATE_START;
+            }
+            continue;
+
+        case SLIP_STATE_START:
+            // Workaround: bootloader sends two dummy(0xC0) bytes after response when baud rate is changed.
+            if (ch == DELIMITER) {
+                continue;
+            }
+            decoder->state = SLIP_STATE_DATA;
+            break;
 
-        if (ch == 0xDB) {
-            RETURN_ON_ERROR( peripheral_read(&ch, 1) );
+        case SLIP_STATE_ESCAPE:
             if (ch == 0xDC) {
-                buff[i] = 0xC0;
+                ch = DELIMITER;
             } else if (ch == 0xDD) {
-                buff[i] = 0xDB;
+                ch = 0xDB;
             } else {
+                *consumed = i + 1;
                 return ESP_LOADER_ERROR_INVALID_RESPONSE;
             }
-        } else if (ch == DELIMITER) {
-            *recv_size = i;
+            decoder->state = SLIP_STATE_DATA;
+            decoder->buff[decoder->size++] = ch;
+            if (decoder->size == decoder->max_size) {
+                decoder->state = SLIP_STATE_OVERFLOW;
+            }
+            continue;
+
+        case SLIP_STATE_OVERFLOW:
+            // Ignore unsupported or unecessary packet data instead of failing
+            if (ch == DELIMITER) {
+                *consumed = i + 1;
+                *complete = true;
+                return ESP_LOADER_SUCCESS;
+            }
+            continue;
+
+        default:
+            break;
+        }
+
+        // SLIP_STATE_DATA, copy the run of plain bytes in one go
+        size_t run_max = size - i;
+        if (run_max > decoder->max_size - decoder->size) {
+            run_max = decoder->max_size - decoder->size;
+        }
+        const size_t run = i + SLIP_scan(&data[i], run_max);
+        if (run > i) {
+            memcpy(&decoder->buff[decoder->size], &data[i], run - i);
+            decoder->size += run - i;
+            i = run - 1;
+            if (decoder->size == decoder->max_size) {
+                decoder->state = SLIP_STATE_OVERFLOW;
+            }
+            continue;
+        }
+
+        if (ch == DELIMITER) {
+            *consumed = i + 1;
+            *complete = true;
             return ESP_LOADER_SUCCESS;
+        } else if (ch == 0xDB) {
+            decoder->state = SLIP_STATE_ESCAPE;
         } else {
-            buff[i] = ch;
+            // Buffer full
+            decoder->state = SLIP_STATE_OVERFLOW;
         }
     }
 
-    // Wait for delimiter if we already reached max receive size
-    // This enables us to ignore unsupported or unecessary packet data instead of failing
-    do {
-        RETURN_ON_ERROR( peripheral_read(&ch, 1) );
-    } while (ch != DELIMITER);
-
-    *recv_size = max_size;
-
+    *consumed = size;
     return ESP_LOADER_SUCCESS;
 }
 
 
-esp_loader_error_t SLIP_send(const uint8_t *data, const size_t size)
+esp_loader_error_t SLIP_receive_packet(uint8_t *buff, const size_t max_size, size_t *recv_size)
 {
-    uint32_t to_write = 0;  // Bytes ready to write as they are
-    uint32_t written = 0;   // Bytes already written
+    slip_context_t *state = slip_context();
+    slip_decoder_t decoder;
+    SLIP_decoder_init(&decoder, buff, max_size);
 
-    for (uint32_t i = 0; i < size; i++) {
-        if (data[i] != 0xC0 && data[i] != 0xDB) {
-            to_write++; // Queue this byte for writing
-            continue;
+    for (;;) {
+        if (state->rx_pos == state->rx_len) {
+            RETURN_ON_ERROR( peripheral_read_some() );
         }
 
-        // We have a byte that needs encoding, write the queue first
-        if (to_write > 0) {
-            RETURN_ON_ERROR( peripheral_write(&data[written], to_write) );
+        size_t consumed;
+        bool complete;
+        esp_loader_error_t err = SLIP_decoder_feed(&decoder, &state->rx_buffer[state->rx_pos],
+                                 state->rx_len - state->rx_pos, &consumed, &complete);
+        state->rx_pos += consumed;
+        RETURN_ON_ERROR(err);
+
+        if (complete) {
+            *recv_size = decoder.size;
+            state->stats.frames_received++;
+            return ESP_LOADER_SUCCESS;
         }
+    }
+}
 
-        // Write the encoded byte
-        if (data[i] == 0xC0) {
-            RETURN_ON_ERROR( peripheral_write(C0_REPLACEMENT, 2) );
-        } else {
-            RETURN_ON_ERROR( peripheral_write(DB_REPLACEMENT, 2) );
+
+void SLIP_reset(void)
+{
+    slip_context_t *state = slip_context();
+
+    state->rx_pos = 0;
+    state->rx_len = 0;
+    state->tx_len = 0;
+    state->tx_start = 0;
+    state->tx_in_frame = false;
+}
+
+
+esp_loader_error_t SLIP_send(const uint8_t *data, const size_t size)
+{
+    slip_context_t *state = slip_context();
+    size_t i = 0;
+
+    while (i < size) {
+        // An escaped byte takes two bytes of buffer space
+        if (state->tx_len + 2 > sizeof(state->tx_buffer)) {
+            RETURN_ON_ERROR( SLIP_flush() );
         }
 
-        // Update to start again after the encoded byte
-        written = i + 1;
-        to_write = 0;
+        size_t written;
+        i += SLIP_escape(&data[i], size - i, &state->tx_buffer[state->tx_len],
+                         sizeof(state->tx_buffer) - state->tx_len, &written);
+        state->tx_len += written;
     }
 
-    // Write the rest of the bytes that didn't need encoding
-    if (to_write > 0) {
-        RETURN_ON_ERROR( peripheral_write(&data[written], to_write) );
+    return ESP_LOADER_SUCCESS;
+}
+
+
+esp_loader_error_t SLIP_begin_deferred_frame(const size_t header_size)
+{
+    slip_context_t *state = slip_context();
+
+    // Room for the opening delimiter and the header, even if all of it needs escaping
+    const size_t slot = 1 + 2 * header_size;
+
+    if (slot + 2 > sizeof(state->tx_buffer)) {
+        return ESP_LOADER_ERROR_INVALID_PARAM;
     }
 
+    RETURN_ON_ERROR( SLIP_flush() );
+
+    state->tx_len = slot;
+    state->tx_slot = slot;
+    state->tx_in_frame = true;
+
     return ESP_LOADER_SUCCESS;
 }
 
 
+size_t SLIP_append(const uint8_t *data, const size_t size)
+{
+    slip_context_t *state = slip_context();
+    size_t written;
+    const size_t used = SLIP_escape(data, size, &state->tx_buffer[state->tx_len],
+                                    sizeof(state->tx_buffer) - state->tx_len, &written);
+    state->tx_len += written;
+
+    return used;
+}
+
+
+void SLIP_set_deferred_header(const uint8_t *header, const size_t size)
+{
+    slip_context_t *state = slip_context();
+
+    // Escaped to the front of the slot, then moved to end where the data starts
+    size_t written;
+    SLIP_escape(header, size, &state->tx_buffer[1], state->tx_slot - 1, &written);
+
+    state->tx_start = state->tx_slot - 1 - written;
+    memmove(&state->tx_buffer[state->tx_start + 1], &state->tx_buffer[1], written);
+    state->tx_buffer[state->tx_start] = DELIMITER;
+}
+
+
 esp_loader_error_t SLIP_send_delimiter(void)
 {
-    return peripheral_write(&DELIMITER, 1);
+    slip_context_t *state = slip_context();
+
+    if (state->tx_len == sizeof(state->tx_buffer)) {
+        RETURN_ON_ERROR( SLIP_flush() );
+    }
+
+    state->tx_buffer[state->tx_len++] = DELIMITER;
+
+    // Delimiters come in pairs around each frame
+    if (state->tx_in_frame) {
+        state->stats.frames_sent++;
+    }
+    state->tx_in_frame = !state->tx_in_frame;
+
+    return ESP_LOADER_SUCCESS;
+}
+
+
+esp_loader_error_t SLIP_flush(void)
+{
+    slip_context_t *state = slip_context();
+
+    if (state->tx_len == 0) {
+        return ESP_LOADER_SUCCESS;
+    }
+
+    // The buffer is emptied even on failure, a partially sent frame cannot be completed anyway
+    const size_t start = state->tx_start;
+    const size_t len = state->tx_len;
+    state->tx_start = 0;
+    state->tx_len = 0;
+
+    return peripheral_write(&state->tx_buffer[start], len - start);
+}
+
+
+void SLIP_get_stats(esp_loader_transfer_stats_t *stats)
+{
+    *stats = slip_context()->stats;
+}
+
+
+void SLIP_reset_stats(void)
+{
+    slip_context_t *state = slip_context();
+
+    memset(&state->stats, 0, sizeof(state->stats));
+}
+
+
+__attribute__ ((weak)) esp_loader_error_t loader_port_read_some(uint8_t *data, uint16_t size,
+        uint32_t timeout, uint16_t *received)
+{
+    *received = 0;
+    RETURN_ON_ERROR( loader_port_read(data, 1, timeout) );
+    *received = 1;
+
+    return ESP_LOADER_SUCCESS;
 }
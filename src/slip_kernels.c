@@ -0,0 +1,293 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "slip_kernels.h"
+#include <string.h>
+
+// Vector kernels are only built for hosts, microcontroller ports use the scalar ones
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define SLIP_KERNELS_SSE2
+#define SLIP_KERNELS_AVX2
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__ARM_NEON)
+#define SLIP_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+static size_t scan_scalar(const uint8_t *data, const size_t size)
+{
+    size_t i = 0;
+
+    while (i < size && data[i] != 0xC0 && data[i] != 0xDB) {
+        i++;
+    }
+
+    return i;
+}
+
+
+static size_t escape_scalar(const uint8_t *data, const size_t size,
+                            uint8_t *out, const size_t out_size, size_t *out_len)
+{
+    size_t i = 0;
+    size_t o = 0;
+
+    while (i < size) {
+        // Copy the run of bytes that do not need encoding in one go
+        size_t run_max = size - i;
+        if (run_max > out_size - o) {
+            run_max = out_size - o;
+        }
+        const size_t run = scan_scalar(&data[i], run_max);
+        memcpy(&out[o], &data[i], run);
+        i += run;
+        o += run;
+
+        if (i == size || o + 2 > out_size) {
+            break;
+        }
+        out[o++] = 0xDB;
+        out[o++] = data[i++] == 0xC0 ? 0xDC : 0xDD;
+    }
+
+    *out_len = o;
+    return i;
+}
+
+
+// Escapes a block with at least one special byte, bit n of the mask is set for special byte n.
+// Branchless, as blocks that need escaping tend to contain several special bytes.
+static inline size_t escape_block(const uint8_t *data, const size_t size, uint64_t mask,
+                                  const unsigned mask_bits_per_byte, uint8_t *out)
+{
+    size_t o = 0;
+
+    for (size_t j = 0; j < size; j++, mask >>= mask_bits_per_byte) {
+        const uint8_t byte = data[j];
+        const size_t special = mask & 1;
+        out[o] = special ? 0xDB : byte;
+        out[o + 1] = byte == 0xC0 ? 0xDC : 0xDD; // Overwritten by the next byte if not special
+        o += 1 + special;
+    }
+
+    return o;
+}
+
+#ifdef SLIP_KERNELS_SSE2
+static inline uint32_t special_mask_sse2(const uint8_t *data)
+{
+    const __m128i block = _mm_loadu_si128((const __m128i *)data);
+    const __m128i special = _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8((char)0xC0)),
+                                         _mm_cmpeq_epi8(block, _mm_set1_epi8((char)0xDB)));
+    return (uint32_t)_mm_movemask_epi8(special);
+}
+
+static size_t scan_sse2(const uint8_t *data, const size_t size)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16) {
+        const uint32_t mask = special_mask_sse2(&data[i]);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+
+    return i + scan_scalar(&data[i], size - i);
+}
+
+static size_t escape_sse2(const uint8_t *data, const size_t size,
+                          uint8_t *out, const size_t out_size, size_t *out_len)
+{
+    size_t i = 0;
+    size_t o = 0;
+
+    // A block takes up to twice its size once escaped
+    for (; i + 16 <= size && o + 32 <= out_size; i += 16) {
+        const uint32_t mask = special_mask_sse2(&data[i]);
+        // Stored whole, the bytes before the first special one are already in place
+        _mm_storeu_si128((__m128i *)&out[o], _mm_loadu_si128((const __m128i *)&data[i]));
+        if (mask == 0) {
+            o += 16;
+        } else {
+            const unsigned first = __builtin_ctz(mask);
+            o += first;
+            o += escape_block(&data[i + first], 16 - first, mask >> first, 1, &out[o]);
+        }
+    }
+
+    size_t tail_len;
+    i += escape_scalar(&data[i], size - i, &out[o], out_size - o, &tail_len);
+    *out_len = o + tail_len;
+    return i;
+}
+#endif
+
+#ifdef SLIP_KERNELS_AVX2
+// Built for AVX2 regardless of the compiler flags, only called after checking the CPU
+__attribute__ ((target("avx2"))) static inline uint32_t special_mask_avx2(const uint8_t *data)
+{
+    const __m256i block = _mm256_loadu_si256((const __m256i *)data);
+    const __m256i special = _mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8((char)0xC0)),
+                                            _mm256_cmpeq_epi8(block, _mm256_set1_epi8((char)0xDB)));
+    return (uint32_t)_mm256_movemask_epi8(special);
+}
+
+__attribute__ ((target("avx2"))) static size_t scan_avx2(const uint8_t *data, const size_t size)
+{
+    size_t i = 0;
+
+    for (; i + 32 <= size; i += 32) {
+        const uint32_t mask = special_mask_avx2(&data[i]);
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+
+    return i + scan_sse2(&data[i], size - i);
+}
+
+__attribute__ ((target("avx2"))) static size_t escape_avx2(const uint8_t *data, const size_t size,
+        uint8_t *out, const size_t out_size, size_t *out_len)
+{
+    size_t i = 0;
+    size_t o = 0;
+
+    for (; i + 32 <= size && o + 64 <= out_size; i += 32) {
+        const uint32_t mask = special_mask_avx2(&data[i]);
+        _mm256_storeu_si256((__m256i *)&out[o], _mm256_loadu_si256((const __m256i *)&data[i]));
+        if (mask == 0) {
+            o += 32;
+        } else {
+            const unsigned first = __builtin_ctz(mask);
+            o += first;
+            o += escape_block(&data[i + first], 32 - first, mask >> first, 1, &out[o]);
+        }
+    }
+
+    size_t tail_len;
+    i += escape_sse2(&data[i], size - i, &out[o], out_size - o, &tail_len);
+    *out_len = o + tail_len;
+    return i;
+}
+#endif
+
+#ifdef SLIP_KERNELS_NEON
+// NEON has no movemask, the comparison result is narrowed to four bits per byte instead
+static inline uint64_t special_mask_neon(const uint8_t *data)
+{
+    const uint8x16_t block = vld1q_u8(data);
+    const uint8x16_t special = vorrq_u8(vceqq_u8(block, vdupq_n_u8(0xC0)),
+                                        vceqq_u8(block, vdupq_n_u8(0xDB)));
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(special), 4)), 0);
+}
+
+static size_t scan_neon(const uint8_t *data, const size_t size)
+{
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16) {
+        const uint64_t mask = special_mask_neon(&data[i]);
+        if (mask != 0) {
+            return i + __builtin_ctzll(mask) / 4;
+        }
+    }
+
+    return i + scan_scalar(&data[i], size - i);
+}
+
+static size_t escape_neon(const uint8_t *data, const size_t size,
+                          uint8_t *out, const size_t out_size, size_t *out_len)
+{
+    size_t i = 0;
+    size_t o = 0;
+
+    for (; i + 16 <= size && o + 32 <= out_size; i += 16) {
+        const uint64_t mask = special_mask_neon(&data[i]);
+        vst1q_u8(&out[o], vld1q_u8(&data[i]));
+        if (mask == 0) {
+            o += 16;
+        } else {
+            const unsigned first = __builtin_ctzll(mask) / 4;
+            o += first;
+            o += escape_block(&data[i + first], 16 - first, mask >> (4 * first), 4, &out[o]);
+        }
+    }
+
+    size_t tail_len;
+    i += escape_scalar(&data[i], size - i, &out[o], out_size - o, &tail_len);
+    *out_len = o + tail_len;
+    return i;
+}
+#endif
+
+// The AVX2 kernel comes last, so it can be left out when the CPU does not support it
+static const slip_kernel_t s_kernels[] = {
+    { "scalar", scan_scalar, escape_scalar },
+#ifdef SLIP_KERNELS_SSE2
+    { "sse2", scan_sse2, escape_sse2 },
+#endif
+#ifdef SLIP_KERNELS_AVX2
+    { "avx2", scan_avx2, escape_avx2 },
+#endif
+#ifdef SLIP_KERNELS_NEON
+    { "neon", scan_neon, escape_neon },
+#endif
+};
+static size_t s_kernel_count;
+static const slip_kernel_t *s_kernel;
+
+/* Loaders driven from several threads may select the kernel at the same time, they all come to
+   the same choice and only store it atomically */
+static const slip_kernel_t *select_kernel(void)
+{
+    const slip_kernel_t *kernel = __atomic_load_n(&s_kernel, __ATOMIC_ACQUIRE);
+    if (kernel != NULL) {
+        return kernel;
+    }
+
+    size_t count = sizeof(s_kernels) / sizeof(s_kernels[0]);
+#ifdef SLIP_KERNELS_AVX2
+    if (!__builtin_cpu_supports("avx2")) {
+        count--;
+    }
+#endif
+
+    kernel = &s_kernels[count - 1];
+    __atomic_store_n(&s_kernel_count, count, __ATOMIC_RELAXED);
+    __atomic_store_n(&s_kernel, kernel, __ATOMIC_RELEASE);
+    return kernel;
+}
+
+
+size_t SLIP_scan(const uint8_t *data, const size_t size)
+{
+    return select_kernel()->scan(data, size);
+}
+
+
+size_t SLIP_escape(const uint8_t *data, const size_t size,
+                   uint8_t *out, const size_t out_size, size_t *out_len)
+{
+    return select_kernel()->escape(data, size, out, out_size, out_len);
+}
+
+
+size_t SLIP_get_kernels(const slip_kernel_t **kernels)
+{
+    select_kernel();
+    *kernels = s_kernels;
+    return __atomic_load_n(&s_kernel_count, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,100 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "catch.hpp"
+#include "md5_hash.h"
+#include <zlib.h>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+using namespace std;
+
+// Arrays generated by create_compressed_resources(), see test/CMakeLists.txt
+#define DECLARE_COMPRESSED(name)                    \
+    extern const uint8_t  name[];                   \
+    extern const uint32_t name##_size;              \
+    extern const uint32_t name##_compressed_size;   \
+    extern const uint8_t  name##_md5[16];
+
+extern "C" {
+    DECLARE_COMPRESSED(ESP32_bootloader_bin)
+    DECLARE_COMPRESSED(ESP32_hello_world_bin)
+    DECLARE_COMPRESSED(ESP32_partition_table_bin)
+    DECLARE_COMPRESSED(ESP_UNALIGNED_image_bin)
+}
+
+namespace
+{
+
+struct compressed_binary {
+    const char *path;
+    const uint8_t *data;
+    uint32_t size;
+    uint32_t compressed_size;
+    const uint8_t *md5;
+};
+
+#define COMPRESSED_BINARY(path, name) \
+    compressed_binary { path, name, name##_size, name##_compressed_size, name##_md5 }
+
+vector<uint8_t> read_file(const string &path)
+{
+    ifstream file(path, ios::binary);
+    REQUIRE( file.is_open() );
+    return vector<uint8_t>(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+void check_binary(const compressed_binary &binary)
+{
+    INFO( binary.path );
+
+    auto image = read_file(binary.path);
+    image.resize((image.size() + 3) & ~3, 0xff);
+    REQUIRE( binary.size == image.size() );
+
+    vector<uint8_t> data(binary.size + 1);
+    uLongf data_size = data.size();
+    REQUIRE( uncompress(&data[0], &data_size, binary.data, binary.compressed_size) == Z_OK );
+    data.resize(data_size);
+    REQUIRE( data == image );
+
+    struct MD5Context context;
+    unsigned char digest[16];
+    MD5Init(&context);
+    MD5Update(&context, &image[0], image.size());
+    MD5Final(digest, &context);
+    REQUIRE( vector<uint8_t>(digest, digest + 16) == vector<uint8_t>(binary.md5, binary.md5 + 16) );
+}
+
+}
+
+
+TEST_CASE( "Compressed example binaries inflate to the original images" )
+{
+    check_binary(COMPRESSED_BINARY(HOST_TEST_BINARIES_DIR "/ESP32/bootloader.bin",
+                                   ESP32_bootloader_bin));
+    check_binary(COMPRESSED_BINARY(HOST_TEST_BINARIES_DIR "/ESP32/hello_world.bin",
+                                   ESP32_hello_world_bin));
+    check_binary(COMPRESSED_BINARY(HOST_TEST_BINARIES_DIR "/ESP32/partition-table.bin",
+                                   ESP32_partition_table_bin));
+}
+
+TEST_CASE( "Compressed binaries are padded with 0xff to a multiple of 4 bytes" )
+{
+    check_binary(COMPRESSED_BINARY(HOST_TEST_UNALIGNED_DIR "/ESP_UNALIGNED/image.bin",
+                                   ESP_UNALIGNED_image_bin));
+    REQUIRE( ESP_UNALIGNED_image_bin_size == 8 );
+}
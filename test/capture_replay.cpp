@@ -0,0 +1,320 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "capture_replay.h"
+#include "esp_loader_capture.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace
+{
+
+uint32_t read_u16(const uint8_t *data)
+{
+    return data[0] | data[1] << 8;
+}
+
+uint32_t read_u32(const uint8_t *data)
+{
+    return read_u16(data) | read_u16(data + 2) << 16;
+}
+
+}
+
+struct capture_replay_t {
+    vector<capture_replay_record_t> records;
+    capture_replay_stats_t stats = {};
+    uint32_t clock_ms = 0;
+    uint32_t deadline_ms = 0;
+
+    // Each direction and the events are played back in their own recorded order
+    size_t tx_record = 0;
+    size_t tx_offset = 0;
+    size_t rx_record = 0;
+    size_t rx_offset = 0;
+    size_t event_record = 0;
+};
+
+namespace
+{
+
+// Moves the position to the next record of the type, from the record it is at
+void seek(const capture_replay_t *replay, size_t &position, uint8_t type)
+{
+    while (position < replay->records.size() && replay->records[position].type != type) {
+        position++;
+    }
+}
+
+// The library sees the time the record was made at
+void played(capture_replay_t *replay, const capture_replay_record_t &record)
+{
+    replay->stats.records++;
+    replay->clock_ms = max(replay->clock_ms, record.time_ms);
+}
+
+void mismatch(capture_replay_t *replay, uint64_t offset)
+{
+    if (replay->stats.mismatches++ == 0) {
+        replay->stats.first_mismatch = offset;
+    }
+}
+
+// Moves to the next recorded write with bytes left, returns false at the end of the capture
+bool next_tx(capture_replay_t *replay)
+{
+    while (true) {
+        seek(replay, replay->tx_record, ESP_LOADER_CAPTURE_TX);
+        if (replay->tx_record == replay->records.size()) {
+            return false;
+        }
+        if (!replay->records[replay->tx_record].payload.empty()) {
+            return true;
+        }
+        played(replay, replay->records[replay->tx_record++]);
+    }
+}
+
+esp_loader_error_t port_write(void *context, const uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    capture_replay_t *replay = (capture_replay_t *)context;
+    esp_loader_error_t status = ESP_LOADER_SUCCESS;
+    bool differs = false;
+    uint64_t differs_at = 0;
+
+    for (uint16_t i = 0; i < size && !differs; i++) {
+        differs_at = replay->stats.tx_bytes + i;
+        if (!next_tx(replay)) {
+            differs = true;
+            break;
+        }
+
+        const capture_replay_record_t &record = replay->records[replay->tx_record];
+        differs = record.payload[replay->tx_offset++] != data[i];
+        if (replay->tx_offset == record.payload.size()) {
+            status = (esp_loader_error_t)record.status;
+            played(replay, record);
+            replay->tx_record++;
+            replay->tx_offset = 0;
+        }
+    }
+
+    // The rest of a write that differs is not compared, the streams are out of step
+    if (differs) {
+        mismatch(replay, differs_at);
+    }
+    replay->stats.tx_bytes += size;
+    return status;
+}
+
+esp_loader_error_t port_read_some(void *context, uint8_t *data, uint16_t size, uint32_t timeout,
+                                  uint16_t *received)
+{
+    capture_replay_t *replay = (capture_replay_t *)context;
+
+    *received = 0;
+    seek(replay, replay->rx_record, ESP_LOADER_CAPTURE_RX);
+    if (replay->rx_record == replay->records.size()) {
+        // Nothing more was received in the field
+        replay->clock_ms += timeout;
+        return ESP_LOADER_ERROR_TIMEOUT;
+    }
+
+    const capture_replay_record_t &record = replay->records[replay->rx_record];
+    *received = min<size_t>(size, record.payload.size() - replay->rx_offset);
+    memcpy(data, &record.payload[replay->rx_offset], *received);
+    replay->rx_offset += *received;
+    replay->stats.rx_bytes += *received;
+    if (replay->rx_offset < record.payload.size()) {
+        return ESP_LOADER_SUCCESS;
+    }
+
+    played(replay, record);
+    replay->rx_record++;
+    replay->rx_offset = 0;
+    if (record.status != ESP_LOADER_SUCCESS) {
+        replay->stats.failed_reads++;
+    }
+    return (esp_loader_error_t)record.status;
+}
+
+esp_loader_error_t port_read(void *context, uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    while (size > 0) {
+        uint16_t received;
+        RETURN_ON_ERROR( port_read_some(context, data, size, timeout, &received) );
+        data += received;
+        size -= received;
+    }
+    return ESP_LOADER_SUCCESS;
+}
+
+void check_event(capture_replay_t *replay, uint8_t event, uint32_t value)
+{
+    seek(replay, replay->event_record, ESP_LOADER_CAPTURE_EVENT);
+    if (replay->event_record == replay->records.size()) {
+        mismatch(replay, replay->stats.tx_bytes);
+        return;
+    }
+
+    const capture_replay_record_t &record = replay->records[replay->event_record++];
+    if (record.status != event || read_u32(&record.payload[0]) != value) {
+        mismatch(replay, replay->stats.tx_bytes);
+    }
+    played(replay, record);
+}
+
+esp_loader_error_t port_change_transmission_rate(void *context, uint32_t transmission_rate)
+{
+    check_event((capture_replay_t *)context, ESP_LOADER_CAPTURE_RATE, transmission_rate);
+    return ESP_LOADER_SUCCESS;
+}
+
+void port_enter_bootloader(void *context)
+{
+    check_event((capture_replay_t *)context, ESP_LOADER_CAPTURE_ENTER_BOOTLOADER, 0);
+}
+
+void port_reset_target(void *context)
+{
+    check_event((capture_replay_t *)context, ESP_LOADER_CAPTURE_RESET, 0);
+}
+
+void port_delay_ms(void *context, uint32_t ms)
+{
+    ((capture_replay_t *)context)->clock_ms += ms;
+}
+
+void port_start_timer(void *context, uint32_t ms)
+{
+    capture_replay_t *replay = (capture_replay_t *)context;
+    replay->deadline_ms = replay->clock_ms + ms;
+}
+
+uint32_t port_remaining_time(void *context)
+{
+    const capture_replay_t *replay = (const capture_replay_t *)context;
+    return replay->deadline_ms > replay->clock_ms ? replay->deadline_ms - replay->clock_ms : 0;
+}
+
+void port_debug_print(void *context, const char *str)
+{
+}
+
+uint32_t port_get_time_ms(void *context)
+{
+    return ((capture_replay_t *)context)->clock_ms;
+}
+
+esp_loader_port_t make_port()
+{
+    esp_loader_port_t port = {};
+    port.write = port_write;
+    port.read = port_read;
+    port.change_transmission_rate = port_change_transmission_rate;
+    port.read_some = port_read_some;
+    port.delay_ms = port_delay_ms;
+    port.start_timer = port_start_timer;
+    port.remaining_time = port_remaining_time;
+    port.enter_bootloader = port_enter_bootloader;
+    port.reset_target = port_reset_target;
+    port.debug_print = port_debug_print;
+    port.get_time_ms = port_get_time_ms;
+    return port;
+}
+
+}
+
+const esp_loader_port_t capture_replay_port = make_port();
+
+bool capture_parse(const vector<uint8_t> &capture, vector<capture_replay_record_t> &records, string &error)
+{
+    if (capture.size() < ESP_LOADER_CAPTURE_HEADER_SIZE || memcmp(&capture[0], "ESFC", 4) != 0) {
+        error = "no capture header";
+        return false;
+    }
+    if (capture[4] != ESP_LOADER_CAPTURE_VERSION) {
+        error = "unknown capture version " + to_string(capture[4]);
+        return false;
+    }
+
+    records.clear();
+    size_t offset = ESP_LOADER_CAPTURE_HEADER_SIZE;
+    while (offset < capture.size()) {
+        if (capture.size() - offset < ESP_LOADER_CAPTURE_RECORD_SIZE) {
+            error = "truncated record header at offset " + to_string(offset);
+            return false;
+        }
+
+        const uint8_t *header = &capture[offset];
+        const size_t size = read_u16(&header[2]);
+        offset += ESP_LOADER_CAPTURE_RECORD_SIZE;
+        if (capture.size() - offset < size) {
+            error = "truncated record at offset " + to_string(offset - ESP_LOADER_CAPTURE_RECORD_SIZE);
+            return false;
+        }
+
+        capture_replay_record_t record;
+        record.type = header[0];
+        record.status = header[1];
+        record.time_ms = read_u32(&header[4]);
+        record.payload.assign(capture.begin() + offset, capture.begin() + offset + size);
+        offset += size;
+
+        const bool counted = record.type == ESP_LOADER_CAPTURE_EVENT || record.type == ESP_LOADER_CAPTURE_LOST ||
+                             record.type == ESP_LOADER_CAPTURE_TX_FRAME || record.type == ESP_LOADER_CAPTURE_RX_FRAME;
+        if (counted && record.payload.size() < 4) {
+            error = "short payload of a record at offset " + to_string(offset - size - ESP_LOADER_CAPTURE_RECORD_SIZE);
+            return false;
+        }
+        records.push_back(record);
+    }
+
+    return true;
+}
+
+capture_replay_t *capture_replay_create(const vector<uint8_t> &capture)
+{
+    vector<capture_replay_record_t> records;
+    string error;
+    if (!capture_parse(capture, records, error)) {
+        return NULL;
+    }
+
+    capture_replay_t *replay = new capture_replay_t;
+    for (const capture_replay_record_t &record : records) {
+        if (record.type == ESP_LOADER_CAPTURE_LOST) {
+            replay->stats.lost_records += read_u32(&record.payload[0]);
+        } else if (record.type == ESP_LOADER_CAPTURE_TX || record.type == ESP_LOADER_CAPTURE_RX ||
+                   record.type == ESP_LOADER_CAPTURE_EVENT) {
+            replay->records.push_back(record);
+        }
+    }
+    return replay;
+}
+
+void capture_replay_destroy(capture_replay_t *replay)
+{
+    delete replay;
+}
+
+capture_replay_stats_t capture_replay_stats(const capture_replay_t *replay)
+{
+    capture_replay_stats_t stats = replay->stats;
+    stats.remaining = replay->records.size() - stats.records;
+    return stats;
+}
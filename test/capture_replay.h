@@ -0,0 +1,67 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Replay of sessions recorded with esp_loader_capture_start(), for builds with
+ * SERIAL_FLASHER_INTERFACE_UART or SERIAL_FLASHER_INTERFACE_USB.
+ *
+ * The replay is a port that plays the target side of a capture back to the library: reads return
+ * the received bytes in the order and in the chunks they were recorded, and fail where the
+ * recorded reads failed, such as on timeouts. Written bytes are compared against the recorded
+ * ones, so a library that no longer sends what it sent in the field is caught at the first byte
+ * that differs. Port events are checked against the recorded ones as well.
+ *
+ * The clock of the replay follows the timestamps of the capture, so the library sees the timing
+ * of the field session, and delays and timers advance it without sleeping. */
+
+#pragma once
+
+#include "esp_loader_io.h"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct capture_replay_t;
+
+struct capture_replay_record_t {
+    uint8_t type;               // esp_loader_capture_record_t
+    uint8_t status;
+    uint32_t time_ms;
+    std::vector<uint8_t> payload;
+};
+
+struct capture_replay_stats_t {
+    uint64_t tx_bytes;          // Bytes written by the library
+    uint64_t rx_bytes;          // Recorded bytes returned to the library
+    uint32_t records;           // Records played back, reads, writes and events
+    uint32_t remaining;         // Records not reached yet
+    uint32_t failed_reads;      // Recorded read failures returned
+    uint32_t lost_records;      // Recorded as dropped during the capture
+    uint32_t mismatches;        // Writes and events that differ from the capture
+    uint64_t first_mismatch;    // Offset of the first written byte that differs, if any
+};
+
+/* Splits a capture stream into its records, including the frame records. Returns false if the
+   stream does not start with a capture header or ends within a record, with error describing it. */
+bool capture_parse(const std::vector<uint8_t> &capture, std::vector<capture_replay_record_t> &records,
+                   std::string &error);
+
+// Returns NULL if the capture cannot be parsed
+capture_replay_t *capture_replay_create(const std::vector<uint8_t> &capture);
+void capture_replay_destroy(capture_replay_t *replay);
+
+capture_replay_stats_t capture_replay_stats(const capture_replay_t *replay);
+
+// Port with the replay as its context
+extern const esp_loader_port_t capture_replay_port;
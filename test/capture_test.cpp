@@ -0,0 +1,190 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "catch.hpp"
+#include "capture_replay.h"
+#include "link_model.h"
+#include "target_sim.h"
+#include "esp_loader.h"
+#include "esp_loader_capture.h"
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+
+#define ESP_ERR_CHECK(exp) REQUIRE( (exp) == ESP_LOADER_SUCCESS )
+
+namespace
+{
+
+const uint32_t APP_ADDRESS = 0x10000;
+const uint32_t BLOCK_SIZE = 4096;
+
+void drain(const esp_loader_t *loader, vector<uint8_t> *capture)
+{
+    uint8_t buffer[4096];
+    size_t taken;
+    while (capture != NULL && (taken = esp_loader_capture_read(loader, buffer, sizeof(buffer))) > 0) {
+        capture->insert(capture->end(), buffer, buffer + taken);
+    }
+}
+
+/* Connects to the stub, writes the image and verifies it with the loader selected. The capture
+   is drained after every block when given. */
+esp_loader_error_t flash_session(const vector<uint8_t> &image, const esp_loader_t *loader,
+                                 vector<uint8_t> *capture)
+{
+    esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+    RETURN_ON_ERROR( esp_loader_connect_with_stub(&connect_config) );
+    RETURN_ON_ERROR( esp_loader_flash_start(APP_ADDRESS, image.size(), BLOCK_SIZE) );
+    for (size_t offset = 0; offset < image.size(); offset += BLOCK_SIZE) {
+        RETURN_ON_ERROR( esp_loader_flash_write((void *)&image[offset], BLOCK_SIZE) );
+        drain(loader, capture);
+    }
+    return esp_loader_flash_verify();
+}
+
+// Flashes the image into the simulator through the link model and returns the capture
+vector<uint8_t> record_session(const vector<uint8_t> &image)
+{
+    target_sim_t *sim = target_sim_create();
+    link_model_t *link = link_model_create(&target_sim_port, sim);
+    esp_loader_t *loader = esp_loader_create(&link_model_port, link);
+    REQUIRE( loader != NULL );
+
+    vector<uint8_t> capture;
+    esp_loader_select(loader);
+    ESP_ERR_CHECK( esp_loader_capture_start(loader) );
+    ESP_ERR_CHECK( flash_session(image, loader, &capture) );
+    esp_loader_capture_stop(loader);
+    drain(loader, &capture);
+    esp_loader_select(NULL);
+
+    esp_loader_destroy(loader);
+    link_model_destroy(link);
+    target_sim_destroy(sim);
+    return capture;
+}
+
+vector<uint8_t> make_image()
+{
+    vector<uint8_t> image(16 * BLOCK_SIZE);
+    for (size_t i = 0; i < image.size(); i++) {
+        image[i] = i * 7 + i / 251;
+    }
+    return image;
+}
+
+}
+
+TEST_CASE( "Captured session holds the traffic and its frames" )
+{
+    const vector<uint8_t> capture = record_session(make_image());
+
+    vector<capture_replay_record_t> records;
+    string error;
+    REQUIRE( capture_parse(capture, records, error) );
+    REQUIRE( capture[5] == 1 );     // Slot of the created loader
+
+    uint32_t flash_data_frames = 0;
+    uint32_t responses = 0;
+    uint32_t last_time_ms = 0;
+    for (const capture_replay_record_t &record : records) {
+        REQUIRE( record.type != ESP_LOADER_CAPTURE_LOST );
+        REQUIRE( record.time_ms >= last_time_ms );
+        last_time_ms = record.time_ms;
+
+        if (record.type == ESP_LOADER_CAPTURE_TX_FRAME && record.payload[4] == 0x00 && record.payload[5] == 0x03) {
+            // Command and data headers before the block, of which only the head is kept
+            REQUIRE( record.payload.size() == 4 + ESP_LOADER_CAPTURE_FRAME_HEAD );
+            REQUIRE( (record.payload[0] | record.payload[1] << 8) == 8 + 16 + BLOCK_SIZE );
+            flash_data_frames++;
+        }
+        responses += record.type == ESP_LOADER_CAPTURE_RX_FRAME && record.payload[4] == 0x01;
+    }
+    REQUIRE( flash_data_frames == 16 );
+    REQUIRE( responses > 16 );
+}
+
+TEST_CASE( "Captured session replays without the target" )
+{
+    const vector<uint8_t> image = make_image();
+    const vector<uint8_t> capture = record_session(image);
+
+    capture_replay_t *replay = capture_replay_create(capture);
+    REQUIRE( replay != NULL );
+    esp_loader_t *loader = esp_loader_create(&capture_replay_port, replay);
+    esp_loader_select(loader);
+
+    SECTION( "The same session gets the recorded responses" ) {
+        ESP_ERR_CHECK( flash_session(image, loader, NULL) );
+
+        const capture_replay_stats_t stats = capture_replay_stats(replay);
+        REQUIRE( stats.mismatches == 0 );
+        REQUIRE( stats.remaining == 0 );
+        REQUIRE( stats.lost_records == 0 );
+    }
+
+    SECTION( "A session sending other data is caught" ) {
+        vector<uint8_t> other = image;
+        other[5 * BLOCK_SIZE + 100] ^= 0xFF;
+
+        REQUIRE( flash_session(other, loader, NULL) == ESP_LOADER_ERROR_INVALID_MD5 );
+
+        const capture_replay_stats_t stats = capture_replay_stats(replay);
+        REQUIRE( stats.mismatches > 0 );
+        REQUIRE( stats.first_mismatch > 5 * BLOCK_SIZE );
+        REQUIRE( stats.first_mismatch < stats.tx_bytes );
+    }
+
+    esp_loader_select(NULL);
+    esp_loader_destroy(loader);
+    capture_replay_destroy(replay);
+}
+
+TEST_CASE( "Capture counts the records dropped while its buffer is full" )
+{
+    target_sim_t *sim = target_sim_create();
+    link_model_t *link = link_model_create(&target_sim_port, sim);
+    esp_loader_t *loader = esp_loader_create(&link_model_port, link);
+
+    // The session does not fit into the buffer unless it is drained
+    vector<uint8_t> capture;
+    esp_loader_select(loader);
+    ESP_ERR_CHECK( esp_loader_capture_start(loader) );
+    ESP_ERR_CHECK( flash_session(vector<uint8_t>(32 * BLOCK_SIZE, 0x5A), loader, NULL) );
+    drain(loader, &capture);
+
+    uint32_t value;
+    ESP_ERR_CHECK( esp_loader_read_register(0x3ff5a000, &value) );
+    esp_loader_capture_stop(loader);
+    drain(loader, &capture);
+    esp_loader_select(NULL);
+
+    vector<capture_replay_record_t> records;
+    string error;
+    REQUIRE( capture_parse(capture, records, error) );
+    const auto lost = find_if(records.begin(), records.end(), [](const capture_replay_record_t & record) {
+        return record.type == ESP_LOADER_CAPTURE_LOST;
+    });
+    REQUIRE( lost != records.end() );
+    REQUIRE( (lost->payload[0] | lost->payload[1] << 8) > 0 );
+    REQUIRE( lost + 1 != records.end() );
+
+    esp_loader_destroy(loader);
+    link_model_destroy(link);
+    target_sim_destroy(sim);
+}
@@ -0,0 +1,246 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Benchmark of the host side data path of flash writes.
+ *
+ * loader_flash_data_cmd() checksums, hashes and escapes each block in a single pass where the
+ * transmit buffer allows it. With the flasher stub, which does not check the checksum, it hashes
+ * and escapes blocks of any size in a single pass. It is compared against checksumming, hashing
+ * and escaping the block in three separate passes, the way it used to be done. Both have to
+ * produce the same frames and the same MD5 digest. The target acknowledges every command
+ * immediately. */
+
+#include "protocol.h"
+#include "esp_stubs.h"
+#include "slip.h"
+#include "md5_hash.h"
+#include "esp_loader_io.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+
+vector<uint8_t> s_written;
+bool s_capture;
+uint8_t s_last_command;
+vector<uint8_t> s_response;
+size_t s_response_pos;
+
+vector<uint8_t> make_data(size_t size, bool escape_heavy)
+{
+    mt19937 generator(3);
+    vector<uint8_t> data(size);
+    for (auto &byte : data) {
+        const uint32_t r = generator();
+        if (escape_heavy && r % 4 == 0) {
+            byte = (r & 0x100) ? 0xC0 : 0xDB;
+        } else {
+            byte = (r >> 16) & 0xFF;
+        }
+    }
+    return data;
+}
+
+uint8_t checksum_bytewise(const uint8_t *data, size_t size)
+{
+    uint8_t checksum = 0xEF;
+    while (size--) {
+        checksum ^= *data++;
+    }
+    return checksum;
+}
+
+// The data path before it was fused
+void send_three_pass(const uint8_t *data, uint32_t size, uint32_t sequence,
+                     struct MD5Context *md5, uint32_t md5_size)
+{
+    data_command_t data_cmd = {};
+    data_cmd.common.direction = WRITE_DIRECTION;
+    data_cmd.common.command = FLASH_DATA;
+    data_cmd.common.size = sizeof(data_cmd) - sizeof(command_common_t) + size;
+    data_cmd.common.checksum = esp_stub_get_running() ? 0 : checksum_bytewise(data, size);
+    data_cmd.data_size = size;
+    data_cmd.sequence_number = sequence;
+
+    MD5Update(md5, data, md5_size);
+
+    SLIP_send_delimiter();
+    SLIP_send((const uint8_t *)&data_cmd, sizeof(data_cmd));
+    SLIP_send(data, size);
+    SLIP_send_delimiter();
+    SLIP_flush();
+
+    uint8_t response[16];
+    size_t response_size;
+    SLIP_receive_packet(response, sizeof(response), &response_size);
+}
+
+template <typename F>
+double mb_per_s(size_t bytes, F work)
+{
+    const auto start = chrono::steady_clock::now();
+    work();
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return bytes / elapsed.count() / 1e6;
+}
+
+}
+
+esp_loader_error_t loader_port_write(const uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    // Commands always start a write, their header never needs escaping
+    if (data[0] == 0xC0 && size > 2) {
+        s_last_command = data[2];
+    }
+    if (s_capture) {
+        s_written.insert(s_written.end(), data, data + size);
+    }
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t loader_port_read(uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    uint16_t received;
+    while (size > 0) {
+        RETURN_ON_ERROR( loader_port_read_some(data, size, timeout, &received) );
+        data += received;
+        size -= received;
+    }
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t loader_port_read_some(uint8_t *data, uint16_t size, uint32_t timeout,
+        uint16_t *received)
+{
+    if (s_response_pos == s_response.size()) {
+        s_response = { 0xC0, READ_DIRECTION, s_last_command, 2, 0, 0, 0, 0, 0, 0, 0, 0xC0 };
+        s_response_pos = 0;
+    }
+    *received = min<size_t>(size, s_response.size() - s_response_pos);
+    memcpy(data, &s_response[s_response_pos], *received);
+    s_response_pos += *received;
+    return ESP_LOADER_SUCCESS;
+}
+
+void loader_port_enter_bootloader(void) { }
+
+void loader_port_reset_target(void) { }
+
+void loader_port_delay_ms(uint32_t ms) { }
+
+void loader_port_start_timer(uint32_t ms) { }
+
+uint32_t loader_port_remaining_time(void)
+{
+    return 100;
+}
+
+void loader_port_debug_print(const char *str) { }
+
+esp_loader_error_t loader_port_change_transmission_rate(uint32_t baudrate)
+{
+    return ESP_LOADER_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t image_size = argc > 1 ? strtoul(argv[1], NULL, 0) : 4 * 1024 * 1024;
+    bool identical = true;
+
+    printf("TX buffer %d bytes, %zu bytes per run\n", SERIAL_FLASHER_TX_BUFFER_SIZE, image_size);
+    printf("%-6s %-14s %6s %16s %16s\n", "loader", "data", "block", "3-pass MB/s", "fused MB/s");
+
+    for (bool stub : { false, true }) {
+        esp_stub_set_running(stub);
+        const char *loader = stub ? "stub" : "ROM";
+
+        for (bool escape_heavy : { false, true }) {
+            const auto image = make_data(image_size, escape_heavy);
+            const char *name = escape_heavy ? "escape-heavy" : "random";
+
+            for (uint32_t block : { 256, 1024, 4096, 16384 }) {
+                // The same blocks sent both ways have to give identical frames and digests
+                const uint32_t blocks = (image_size + block - 1) / block;
+                const uint32_t last = image_size - (blocks - 1) * block;
+                uint8_t digest[2][16];
+                vector<uint8_t> frames[2];
+
+                s_capture = true;
+                for (int fused = 0; fused < 2; fused++) {
+                    struct MD5Context md5;
+                    MD5Init(&md5);
+                    s_written.clear();
+                    loader_flash_begin_cmd(0, 0, block, blocks, false);
+                    s_written.clear();
+                    for (uint32_t i = 0; i < min(blocks, 8U); i++) {
+                        // Padding at the end of the image is sent, but not hashed
+                        const uint32_t size = i == blocks - 1 ? last : block;
+                        const uint32_t md5_size = size - 4 * (i % 2);
+                        if (fused) {
+                            loader_flash_data_cmd(&image[i * block], size, 0, &md5, md5_size);
+                        } else {
+                            send_three_pass(&image[i * block], size, i, &md5, md5_size);
+                        }
+                    }
+
+                    // A short block padded by the encoder has to match one padded in a copy
+                    const uint32_t short_size = block - 6;
+                    if (fused) {
+                        loader_flash_data_cmd(&image[0], short_size, block - short_size, &md5, block - 4);
+                    } else {
+                        vector<uint8_t> padded(&image[0], &image[short_size]);
+                        padded.resize(block, 0xFF);
+                        send_three_pass(&padded[0], block, min(blocks, 8U), &md5, block - 4);
+                    }
+                    MD5Final(digest[fused], &md5);
+                    frames[fused] = s_written;
+                }
+                s_capture = false;
+
+                if (frames[0] != frames[1] || memcmp(digest[0], digest[1], sizeof(digest[0])) != 0) {
+                    printf("%-6s %-14s %6u fused path output differs\n", loader, name, block);
+                    identical = false;
+                }
+
+                // Whole blocks only, the timing does not need the tail
+                const size_t timed = (image_size / block) * block;
+                struct MD5Context md5;
+                MD5Init(&md5);
+                const double three_pass = mb_per_s(timed, [&] {
+                    for (size_t offset = 0; offset < timed; offset += block) {
+                        send_three_pass(&image[offset], block, 0, &md5, block);
+                    }
+                });
+                MD5Init(&md5);
+                loader_flash_begin_cmd(0, 0, block, blocks, false);
+                const double fused = mb_per_s(timed, [&] {
+                    for (size_t offset = 0; offset < timed; offset += block) {
+                        loader_flash_data_cmd(&image[offset], block, 0, &md5, block);
+                    }
+                });
+                printf("%-6s %-14s %6u %16.0f %16.0f\n", loader, name, block, three_pass, fused);
+            }
+        }
+    }
+
+    return identical ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,202 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "catch.hpp"
+#include "deflate_encoder.h"
+#include <zlib.h>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+
+struct sink_state {
+    vector<uint8_t> stream;
+    vector<size_t> packet_sizes;
+    size_t fail_after = SIZE_MAX;
+};
+
+esp_loader_error_t collect_packet(void *ctx, const uint8_t *data, size_t size)
+{
+    auto state = static_cast<sink_state *>(ctx);
+
+    if (state->packet_sizes.size() == state->fail_after) {
+        return ESP_LOADER_ERROR_TIMEOUT;
+    }
+
+    state->stream.insert(state->stream.end(), data, data + size);
+    state->packet_sizes.push_back(size);
+    return ESP_LOADER_SUCCESS;
+}
+
+deflate_encoder_t s_encoder;
+uint8_t s_packet[1024];
+
+vector<uint8_t> compress(const vector<uint8_t> &data, uint8_t level, size_t chunk_size,
+                         sink_state &state)
+{
+    deflate_encoder_init(&s_encoder, level, s_packet, sizeof(s_packet), collect_packet, &state);
+
+    for (size_t offset = 0; offset < data.size(); offset += chunk_size) {
+        const size_t to_write = min(chunk_size, data.size() - offset);
+        REQUIRE( deflate_encoder_write(&s_encoder, &data[offset], to_write) == ESP_LOADER_SUCCESS );
+    }
+    REQUIRE( deflate_encoder_finish(&s_encoder) == ESP_LOADER_SUCCESS );
+
+    return state.stream;
+}
+
+vector<uint8_t> inflate(const vector<uint8_t> &stream, size_t expected_size)
+{
+    vector<uint8_t> data(expected_size + 1);
+    uLongf data_size = data.size();
+
+    REQUIRE( uncompress(&data[0], &data_size, &stream[0], stream.size()) == Z_OK );
+    data.resize(data_size);
+    return data;
+}
+
+vector<uint8_t> read_file(const char *path)
+{
+    ifstream file(path, ios::binary);
+    REQUIRE( file.is_open() );
+    return vector<uint8_t>(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+}
+
+vector<uint8_t> random_bytes(size_t size)
+{
+    mt19937 generator(42);
+    vector<uint8_t> data(size);
+    for (auto &byte : data) {
+        byte = generator() & 0xFF;
+    }
+    return data;
+}
+
+}
+
+
+TEST_CASE( "Deflate stream round trips through zlib at every level" )
+{
+    const auto image = read_file(HOST_TEST_DATA_DIR "/hello-world.bin");
+
+    for (uint8_t level = DEFLATE_LEVEL_MIN; level <= DEFLATE_LEVEL_MAX; level++) {
+        INFO( "level " << (int)level );
+        sink_state state;
+        const auto stream = compress(image, level, 1000, state);
+
+        REQUIRE( inflate(stream, image.size()) == image );
+        if (level > 0) {
+            REQUIRE( stream.size() < image.size() );
+        }
+    }
+}
+
+TEST_CASE( "Deflate stream is independent of the write chunking" )
+{
+    const auto image = read_file(HOST_TEST_DATA_DIR "/hello-world.bin");
+
+    sink_state whole_state;
+    const auto whole = compress(image, 6, image.size(), whole_state);
+
+    for (size_t chunk_size : { 1, 7, 4096, 65536 }) {
+        sink_state state;
+        REQUIRE( compress(image, 6, chunk_size, state) == whole );
+    }
+}
+
+TEST_CASE( "Incompressible data stays within the announced worst case" )
+{
+    const auto data = random_bytes(100000);
+
+    for (uint8_t level : { 0, 1, 9 }) {
+        sink_state state;
+        const auto stream = compress(data, level, 4096, state);
+
+        REQUIRE( inflate(stream, data.size()) == data );
+        REQUIRE( stream.size() <= data.size() + data.size() / 8 + 64 );
+    }
+}
+
+TEST_CASE( "Long runs and empty input are encoded correctly" )
+{
+    vector<uint8_t> data(200000, 0xFF);
+    for (size_t i = 0; i < data.size(); i += 5000) {
+        data[i] = i & 0xFF;
+    }
+
+    sink_state state;
+    auto stream = compress(data, 9, 3000, state);
+    REQUIRE( inflate(stream, data.size()) == data );
+    REQUIRE( stream.size() < data.size() / 50 );
+
+    sink_state empty_state;
+    stream = compress(vector<uint8_t>(), 6, 1, empty_state);
+    REQUIRE( inflate(stream, 0).empty() );
+}
+
+TEST_CASE( "Packets are handed to the sink at full size" )
+{
+    const auto data = random_bytes(50000);
+
+    sink_state state;
+    compress(data, 1, 999, state);
+
+    REQUIRE( state.packet_sizes.size() > 1 );
+    for (size_t i = 0; i + 1 < state.packet_sizes.size(); i++) {
+        REQUIRE( state.packet_sizes[i] == sizeof(s_packet) );
+    }
+    REQUIRE( state.packet_sizes.back() <= sizeof(s_packet) );
+    REQUIRE( state.stream.size() == s_encoder.total_out );
+}
+
+TEST_CASE( "Level can be changed in the middle of the stream" )
+{
+    const auto image = read_file(HOST_TEST_DATA_DIR "/hello-world.bin");
+    const size_t chunk_size = 10000;
+
+    sink_state state;
+    deflate_encoder_init(&s_encoder, 6, s_packet, sizeof(s_packet), collect_packet, &state);
+
+    uint8_t level = 0;
+    for (size_t offset = 0; offset < image.size(); offset += chunk_size) {
+        REQUIRE( deflate_encoder_set_level(&s_encoder, level) == ESP_LOADER_SUCCESS );
+        level = (level + 4) % (DEFLATE_LEVEL_MAX + 1);
+
+        const size_t to_write = min(chunk_size, image.size() - offset);
+        REQUIRE( deflate_encoder_write(&s_encoder, &image[offset], to_write) == ESP_LOADER_SUCCESS );
+    }
+    REQUIRE( deflate_encoder_finish(&s_encoder) == ESP_LOADER_SUCCESS );
+
+    REQUIRE( inflate(state.stream, image.size()) == image );
+    REQUIRE( deflate_encoder_set_level(&s_encoder, DEFLATE_LEVEL_MAX + 1) == ESP_LOADER_ERROR_INVALID_PARAM );
+}
+
+TEST_CASE( "Sink errors are reported to the caller" )
+{
+    const auto data = random_bytes(20000);
+
+    sink_state state;
+    state.fail_after = 2;
+    deflate_encoder_init(&s_encoder, 1, s_packet, sizeof(s_packet), collect_packet, &state);
+
+    REQUIRE( deflate_encoder_write(&s_encoder, &data[0], data.size()) == ESP_LOADER_ERROR_TIMEOUT );
+    REQUIRE( deflate_encoder_finish(&s_encoder) == ESP_LOADER_ERROR_TIMEOUT );
+    REQUIRE( state.packet_sizes.size() == 2 );
+}
@@ -0,0 +1,309 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fault_link.h"
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+
+const uint8_t SLIP_END = 0xC0;
+
+struct pending_byte_t {
+    uint8_t value;
+    bool stall;     // The line goes quiet before this byte
+};
+
+}
+
+struct fault_link_t {
+    const esp_loader_port_t *inner;
+    void *inner_context;
+    fault_link_config_t config;
+    fault_link_stats_t stats = {};
+    bool enabled = false;
+
+    mt19937 generator;
+    uniform_real_distribution<double> probability;
+
+    bool frame_has_data = false;        // Host frame with bytes after its start
+    deque<pending_byte_t> to_host;      // Damaged bytes not yet taken by the host
+    uint32_t stall_end_ms = 0;
+    bool stalling = false;
+    bool stall_carried = false;
+};
+
+namespace
+{
+
+bool hit(fault_link_t *link, double rate)
+{
+    return rate > 0 && link->probability(link->generator) < rate;
+}
+
+// Appends the byte as it comes out of the link, stall marks the first byte appended
+void damage(fault_link_t *link, uint8_t byte, bool towards_host, vector<pending_byte_t> &out)
+{
+    const fault_link_config_t &config = link->config;
+    link->stats.bytes++;
+
+    // A stall before a dropped byte delays the byte after it
+    bool stall = link->stall_carried;
+    if (towards_host && hit(link, config.stall_rate)) {
+        link->stats.stalls++;
+        stall = true;
+    }
+    if (hit(link, config.spurious_end_rate)) {
+        link->stats.spurious_ends++;
+        out.push_back({ SLIP_END, stall });
+        stall = false;
+    }
+    link->stall_carried = false;
+    if (hit(link, config.drop_rate)) {
+        link->stats.drops++;
+        link->stall_carried = stall;
+        return;
+    }
+    if (hit(link, config.bit_flip_rate)) {
+        link->stats.bit_flips++;
+        byte ^= 1 << (link->generator() % 8);
+    }
+    out.push_back({ byte, stall });
+    if (hit(link, config.duplicate_rate)) {
+        link->stats.duplicates++;
+        out.push_back({ byte, false });
+    }
+}
+
+esp_loader_error_t port_write(void *context, const uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    fault_link_t *link = (fault_link_t *)context;
+
+    // Frames are counted as the host sent them, an END after data completes one
+    for (uint16_t i = 0; i < size; i++) {
+        if (data[i] == SLIP_END) {
+            link->stats.frames += link->frame_has_data;
+            link->frame_has_data = false;
+        } else {
+            link->frame_has_data = true;
+        }
+    }
+
+    if (!link->enabled || !link->config.to_target) {
+        return link->inner->write(link->inner_context, data, size, timeout);
+    }
+
+    vector<pending_byte_t> damaged;
+    for (uint16_t i = 0; i < size; i++) {
+        damage(link, data[i], false, damaged);
+    }
+
+    // Duplicates can make the data outgrow a single write
+    vector<uint8_t> bytes(damaged.size());
+    transform(damaged.begin(), damaged.end(), bytes.begin(), [](const pending_byte_t & byte) {
+        return byte.value;
+    });
+    for (size_t offset = 0; offset < bytes.size(); offset += UINT16_MAX) {
+        const uint16_t chunk = min<size_t>(bytes.size() - offset, UINT16_MAX);
+        RETURN_ON_ERROR( link->inner->write(link->inner_context, &bytes[offset], chunk, timeout) );
+    }
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t port_read_some(void *context, uint8_t *data, uint16_t size, uint32_t timeout,
+                                  uint16_t *received)
+{
+    fault_link_t *link = (fault_link_t *)context;
+    const esp_loader_port_t *inner = link->inner;
+
+    *received = 0;
+    if (link->to_host.empty()) {
+        uint8_t buffer[1024];
+        uint16_t taken = 0;
+        RETURN_ON_ERROR( inner->read_some(link->inner_context, buffer, min<uint16_t>(size, sizeof(buffer)),
+                                          timeout, &taken) );
+
+        vector<pending_byte_t> damaged;
+        for (uint16_t i = 0; i < taken; i++) {
+            if (link->enabled && link->config.to_host) {
+                damage(link, buffer[i], true, damaged);
+            } else {
+                damaged.push_back({ buffer[i], false });
+            }
+        }
+        link->to_host.insert(link->to_host.end(), damaged.begin(), damaged.end());
+    }
+
+    while (*received < size && !link->to_host.empty()) {
+        pending_byte_t &byte = link->to_host.front();
+        if (byte.stall) {
+            // The bytes before the stall are delivered first
+            if (*received > 0) {
+                break;
+            }
+
+            const uint32_t now_ms = inner->get_time_ms(link->inner_context);
+            if (!link->stalling) {
+                link->stalling = true;
+                link->stall_end_ms = now_ms + link->config.stall_ms;
+            }
+            const uint32_t wait_ms = link->stall_end_ms > now_ms ? link->stall_end_ms - now_ms : 0;
+            if (wait_ms > timeout) {
+                inner->delay_ms(link->inner_context, timeout);
+                return ESP_LOADER_ERROR_TIMEOUT;
+            }
+            inner->delay_ms(link->inner_context, wait_ms);
+            link->stalling = false;
+            byte.stall = false;
+        }
+
+        data[(*received)++] = byte.value;
+        link->to_host.pop_front();
+    }
+
+    return *received > 0 ? ESP_LOADER_SUCCESS : ESP_LOADER_ERROR_TIMEOUT;
+}
+
+esp_loader_error_t port_read(void *context, uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    fault_link_t *link = (fault_link_t *)context;
+    const uint32_t deadline_ms = link->inner->get_time_ms(link->inner_context) + timeout;
+
+    while (size > 0) {
+        const uint32_t now_ms = link->inner->get_time_ms(link->inner_context);
+        uint16_t received;
+        RETURN_ON_ERROR( port_read_some(context, data, size, deadline_ms > now_ms ? deadline_ms - now_ms : 0,
+                                        &received) );
+        data += received;
+        size -= received;
+    }
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t port_change_transmission_rate(void *context, uint32_t transmission_rate)
+{
+    fault_link_t *link = (fault_link_t *)context;
+    if (link->inner->change_transmission_rate == NULL) {
+        return ESP_LOADER_ERROR_UNSUPPORTED_FUNC;
+    }
+    return link->inner->change_transmission_rate(link->inner_context, transmission_rate);
+}
+
+void port_delay_ms(void *context, uint32_t ms)
+{
+    fault_link_t *link = (fault_link_t *)context;
+    link->inner->delay_ms(link->inner_context, ms);
+}
+
+void port_start_timer(void *context, uint32_t ms)
+{
+    fault_link_t *link = (fault_link_t *)context;
+    link->inner->start_timer(link->inner_context, ms);
+}
+
+uint32_t port_remaining_time(void *context)
+{
+    fault_link_t *link = (fault_link_t *)context;
+    return link->inner->remaining_time(link->inner_context);
+}
+
+// Whatever was on the way is lost with a reset
+void reset_link(fault_link_t *link)
+{
+    link->to_host.clear();
+    link->stalling = false;
+    link->stall_carried = false;
+    link->frame_has_data = false;
+}
+
+void port_enter_bootloader(void *context)
+{
+    fault_link_t *link = (fault_link_t *)context;
+    link->inner->enter_bootloader(link->inner_context);
+    reset_link(link);
+}
+
+void port_reset_target(void *context)
+{
+    fault_link_t *link = (fault_link_t *)context;
+    link->inner->reset_target(link->inner_context);
+    reset_link(link);
+}
+
+void port_debug_print(void *context, const char *str)
+{
+    fault_link_t *link = (fault_link_t *)context;
+    if (link->inner->debug_print != NULL) {
+        link->inner->debug_print(link->inner_context, str);
+    }
+}
+
+uint32_t port_get_time_ms(void *context)
+{
+    fault_link_t *link = (fault_link_t *)context;
+    return link->inner->get_time_ms(link->inner_context);
+}
+
+esp_loader_port_t make_port()
+{
+    esp_loader_port_t port = {};
+    port.write = port_write;
+    port.read = port_read;
+    port.change_transmission_rate = port_change_transmission_rate;
+    port.read_some = port_read_some;
+    port.delay_ms = port_delay_ms;
+    port.start_timer = port_start_timer;
+    port.remaining_time = port_remaining_time;
+    port.enter_bootloader = port_enter_bootloader;
+    port.reset_target = port_reset_target;
+    port.debug_print = port_debug_print;
+    port.get_time_ms = port_get_time_ms;
+    return port;
+}
+
+}
+
+const esp_loader_port_t fault_link_port = make_port();
+
+fault_link_t *fault_link_create(const esp_loader_port_t *inner, void *inner_context,
+                                const fault_link_config_t &config)
+{
+    fault_link_t *link = new fault_link_t;
+    link->inner = inner;
+    link->inner_context = inner_context;
+    link->config = config;
+    link->generator.seed(config.seed);
+    return link;
+}
+
+void fault_link_destroy(fault_link_t *link)
+{
+    delete link;
+}
+
+void fault_link_enable(fault_link_t *link, bool enable)
+{
+    link->enabled = enable;
+}
+
+fault_link_stats_t fault_link_stats(const fault_link_t *link)
+{
+    return link->stats;
+}
@@ -0,0 +1,70 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Fault injecting serial link, for builds with SERIAL_FLASHER_INTERFACE_UART or
+ * SERIAL_FLASHER_INTERFACE_USB.
+ *
+ * The link is a port that wraps another one, usually the link model, and damages the bytes passing
+ * through it the way a marginal cable does: single bit flips, dropped and duplicated bytes,
+ * spurious SLIP END bytes and stalls during which nothing arrives. Each fault hits a byte with
+ * its own probability, in the directions it is enabled for. The faults come from a seeded
+ * generator, so a run can be repeated exactly.
+ *
+ * A stall holds back the bytes to the host from the faulty byte on. The time is taken from the
+ * delays and the clock of the wrapped port, which has to provide get_time_ms(), so stalls cost no
+ * wall time behind the link model. */
+
+#pragma once
+
+#include "esp_loader_io.h"
+#include <stdint.h>
+
+struct fault_link_t;
+
+struct fault_link_config_t {
+    double bit_flip_rate = 0;       // Probability of a byte having one of its bits inverted
+    double drop_rate = 0;           // Of a byte being lost
+    double duplicate_rate = 0;      // Of a byte arriving twice
+    double spurious_end_rate = 0;   // Of a SLIP END byte appearing before a byte
+    double stall_rate = 0;          // Of the line going quiet before a byte to the host
+    uint32_t stall_ms = 500;        // How long a stall lasts
+    bool to_target = true;          // Damage the bytes sent by the host
+    bool to_host = true;            // Damage the bytes received by the host
+    uint32_t seed = 1;
+};
+
+struct fault_link_stats_t {
+    uint64_t bytes;             // Bytes passed in either direction
+    uint32_t frames;            // SLIP frames sent by the host, counted before any damage
+    uint32_t bit_flips;
+    uint32_t drops;
+    uint32_t duplicates;
+    uint32_t spurious_ends;
+    uint32_t stalls;
+};
+
+/* Wraps the port, which is given inner_context. Faults are injected once the link has been
+   enabled with fault_link_enable(), the wrapped port has to provide read_some(). */
+fault_link_t *fault_link_create(const esp_loader_port_t *inner, void *inner_context,
+                                const fault_link_config_t &config = fault_link_config_t());
+void fault_link_destroy(fault_link_t *link);
+
+// Starts or stops damaging bytes, for example to connect over a clean link
+void fault_link_enable(fault_link_t *link, bool enable);
+
+fault_link_stats_t fault_link_stats(const fault_link_t *link);
+
+// Port with the fault injecting link as its context
+extern const esp_loader_port_t fault_link_port;
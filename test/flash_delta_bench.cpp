@@ -0,0 +1,528 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Benchmark of esp_loader_flash_delta() against writing the whole image, of
+ * esp_loader_flash_images() against writing a set of images one by one, and of the buffered
+ * flash writer against writing 1 KB blocks. It is built with adaptive timeouts, which are
+ * checked to detect a stalled target quickly and to give slow erases the time they need, and
+ * with two loaders, which flash two simulated targets from two threads at the same time.
+ *
+ * Each target is the software ESP32 of target_sim.h running the stub, behind the serial link
+ * model of link_model.h and a fault injecting link of fault_link.h, which cuts the line to the
+ * target to stall it. Like the stub, the simulator writes no more than the size given to the
+ * flash begin commands. Like NOR flash, writes can only clear bits, so regions written without
+ * being erased first end up corrupted. Time is virtual, so the numbers are the same on every
+ * run. */
+
+#include "esp_loader.h"
+#include "esp_loader_io.h"
+#include "target_sim.h"
+#include "link_model.h"
+#include "fault_link.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+
+const uint32_t FLASH_SIZE = 4 * 1024 * 1024;
+const uint32_t SECTOR_SIZE = 4096;
+const uint32_t IMAGE_OFFSET = 0x10000;
+const uint32_t INITIAL_BAUD = 115200;
+
+struct target_t {
+    target_sim_t *sim;
+    link_model_t *link;
+    fault_link_t *line;     // Drops everything to the target once enabled
+};
+
+// The default loader drives the first target, a created loader the second
+target_t s_targets[2];
+
+void target_create(target_t &target)
+{
+    fault_link_config_t line_config;
+    line_config.drop_rate = 1;
+    line_config.to_host = false;
+
+    target.sim = target_sim_create(FLASH_SIZE);
+    target.link = link_model_create(&target_sim_port, target.sim);
+    target.line = fault_link_create(&link_model_port, target.link, line_config);
+}
+
+void target_destroy(target_t &target)
+{
+    fault_link_destroy(target.line);
+    link_model_destroy(target.link);
+    target_sim_destroy(target.sim);
+}
+
+// Virtual time of the link of the target
+double time_ms(const target_t &target = s_targets[0])
+{
+    return link_model_stats(target.link).time_us / 1000.0;
+}
+
+vector<uint8_t> &flash(const target_t &target = s_targets[0])
+{
+    return target_sim_flash(target.sim);
+}
+
+// Starts the stub on the target through the selected loader and switches to the rate
+bool connect(const target_t &target, uint32_t baud)
+{
+    // Also forgets about the stub of the previous session
+    esp_loader_reset_target();
+    fault_link_port.change_transmission_rate(target.line, INITIAL_BAUD);
+
+    esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+    return esp_loader_connect_with_stub(&connect_config) == ESP_LOADER_SUCCESS &&
+           esp_loader_change_transmission_rate_stub(INITIAL_BAUD, baud) == ESP_LOADER_SUCCESS &&
+           fault_link_port.change_transmission_rate(target.line, baud) == ESP_LOADER_SUCCESS;
+}
+
+// Compresses roughly like application code: words drawn from a small vocabulary
+vector<uint8_t> make_image(uint32_t size, uint32_t seed)
+{
+    mt19937 generator(seed);
+    vector<uint32_t> words(512);
+    for (auto &word : words) {
+        word = generator();
+    }
+
+    vector<uint8_t> image(size);
+    for (uint32_t i = 0; i < size; i += 4) {
+        const uint32_t word = words[generator() % words.size()];
+        memcpy(&image[i], &word, min(4U, size - i));
+    }
+    return image;
+}
+
+bool flash_holds(const vector<uint8_t> &image, uint32_t offset = IMAGE_OFFSET,
+                 const target_t &target = s_targets[0])
+{
+    return equal(image.begin(), image.end(), flash(target).begin() + offset);
+}
+
+// Returns the virtual time taken in milliseconds, negative on failure
+double flash_full(const vector<uint8_t> &image)
+{
+    const double start_ms = time_ms();
+
+    if (esp_loader_flash_deflate_start(IMAGE_OFFSET, image.size(), ESP_LOADER_DEFLATE_LEVEL_AUTO) != ESP_LOADER_SUCCESS ||
+            esp_loader_flash_deflate_write(&image[0], image.size()) != ESP_LOADER_SUCCESS ||
+            esp_loader_flash_verify() != ESP_LOADER_SUCCESS || !flash_holds(image)) {
+        return -1;
+    }
+
+    return time_ms() - start_ms;
+}
+
+bool flash_delta(const vector<uint8_t> &image, uint32_t region_size, esp_loader_flash_delta_stats_t *stats)
+{
+    return esp_loader_flash_delta(IMAGE_OFFSET, &image[0], image.size(), region_size, stats) == ESP_LOADER_SUCCESS &&
+           flash_holds(image);
+}
+
+// Uncompressed writes of chunks as they come off a network, through the writer and in 1 KB blocks
+bool flash_through_writer(const vector<uint8_t> &image)
+{
+    const uint32_t chunk_size = 1460;
+
+    fill(flash().begin(), flash().end(), 0x5A);
+    double start_ms = time_ms();
+    const uint32_t block_size = 1024;
+    if (esp_loader_flash_start(IMAGE_OFFSET, (image.size() + 3) & ~3U, block_size) != ESP_LOADER_SUCCESS) {
+        return false;
+    }
+    for (size_t written = 0; written < image.size(); written += block_size) {
+        const uint32_t size = min<size_t>(block_size, image.size() - written);
+        if (esp_loader_flash_write(&image[written], size) != ESP_LOADER_SUCCESS) {
+            return false;
+        }
+    }
+    if (esp_loader_flash_verify() != ESP_LOADER_SUCCESS || !flash_holds(image)) {
+        return false;
+    }
+    const double blocks_ms = time_ms() - start_ms;
+
+    fill(flash().begin(), flash().end(), 0x5A);
+    start_ms = time_ms();
+    static uint8_t buffer[16 * 1024];
+    esp_loader_flash_writer_t writer;
+    if (esp_loader_flash_writer_start(&writer, IMAGE_OFFSET, image.size(), buffer, sizeof(buffer)) != ESP_LOADER_SUCCESS) {
+        return false;
+    }
+    for (size_t written = 0; written < image.size(); written += chunk_size) {
+        const uint32_t size = min<size_t>(chunk_size, image.size() - written);
+        if (esp_loader_flash_writer_append(&writer, &image[written], size) != ESP_LOADER_SUCCESS) {
+            return false;
+        }
+    }
+    if (esp_loader_flash_verify() != ESP_LOADER_SUCCESS || !flash_holds(image)) {
+        return false;
+    }
+    const double writer_ms = time_ms() - start_ms;
+
+    printf("\nUncompressed in %u byte chunks: %u byte writer blocks in %.0f ms, %u byte blocks in %.0f ms\n",
+           chunk_size, writer.block_size, writer_ms, block_size, blocks_ms);
+
+    // Fewer, larger blocks save a round trip each
+    return writer_ms < blocks_ms;
+}
+
+// Runs with SERIAL_FLASHER_TIMEOUT_MARGIN set by the build
+bool check_adaptive_timeouts()
+{
+    target_t &target = s_targets[0];
+    esp_loader_reset_timeout_model();
+
+    uint32_t reg_value;
+    for (int i = 0; i < 4; i++) {
+        if (esp_loader_read_register(0x40001000, &reg_value) != ESP_LOADER_SUCCESS) {
+            return false;
+        }
+    }
+
+    // A stalled target is given up on after the minimum timeout instead of a second
+    fault_link_enable(target.line, true);
+    const double stall_start_ms = time_ms();
+    const esp_loader_error_t stall_err = esp_loader_read_register(0x40001000, &reg_value);
+    const double stall_ms = time_ms() - stall_start_ms;
+    fault_link_enable(target.line, false);
+    if (stall_err != ESP_LOADER_ERROR_TIMEOUT) {
+        return false;
+    }
+
+    // Flash erasing at 40 kB/s takes longer than the fixed 10 s per MB allow for
+    const link_model_config_t config = link_model_config(target.link);
+    link_model_config_t slow_config = config;
+    slow_config.erase_ms_per_sector = SECTOR_SIZE * 25 / 1000.0;
+    link_model_set_config(target.link, slow_config);
+    const uint32_t large_erase = 1024 * 1024;
+    if (esp_loader_erase_region(0, SECTOR_SIZE) != ESP_LOADER_SUCCESS) {
+        return false;
+    }
+    const double erase_start_ms = time_ms();
+    if (esp_loader_erase_region(0, large_erase) != ESP_LOADER_SUCCESS) {
+        return false;
+    }
+    const double erase_ms = time_ms() - erase_start_ms;
+    link_model_set_config(target.link, config);
+
+    esp_loader_timeout_model_t model;
+    esp_loader_get_timeout_model(&model);
+    printf("\nAdaptive timeouts: %u ms round trip, erase %u ms/MB from %u samples\n", model.round_trip_ms,
+           model.erase_ms_per_mb, model.samples);
+    printf("Stalled target detected in %.0f ms, %u byte erase completed in %.0f ms\n", stall_ms, large_erase,
+           erase_ms);
+
+    return stall_ms < 200 && erase_ms > 10.0 * large_erase / 1e3;
+}
+
+// Bootloader, partition table and application, written one by one and in a single session
+bool flash_image_set(const vector<uint8_t> &app)
+{
+    const vector<uint8_t> bootloader = make_image(26 * 1024 + 6, 3);
+    const vector<uint8_t> partition_table = make_image(3 * 1024, 4);
+    esp_loader_flash_image_t images[] = {
+        { IMAGE_OFFSET, &app[0], (uint32_t)app.size() },
+        { 0x1000, &bootloader[0], (uint32_t)bootloader.size() },
+        { 0x8000, &partition_table[0], (uint32_t)partition_table.size() },
+    };
+    const vector<uint8_t> *contents[] = { &app, &bootloader, &partition_table };
+
+    auto holds_all = [&] {
+        for (size_t i = 0; i < 3; i++) {
+            if (!flash_holds(*contents[i], images[i].offset)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    fill(flash().begin(), flash().end(), 0x5A);
+    const double start_ms = time_ms();
+    for (const auto &image : images) {
+        if (esp_loader_flash_deflate_start(image.offset, image.size, ESP_LOADER_DEFLATE_LEVEL_AUTO) != ESP_LOADER_SUCCESS ||
+                esp_loader_flash_deflate_write(image.data, image.size) != ESP_LOADER_SUCCESS ||
+                esp_loader_flash_verify() != ESP_LOADER_SUCCESS) {
+            return false;
+        }
+    }
+    const double separate_ms = time_ms() - start_ms;
+    if (!holds_all()) {
+        return false;
+    }
+
+    fill(flash().begin(), flash().end(), 0x5A);
+    esp_loader_flash_images_stats_t stats;
+    if (esp_loader_flash_images(images, 3, &stats) != ESP_LOADER_SUCCESS || !holds_all()) {
+        return false;
+    }
+
+    printf("\n%-16s %10s %10s\n", "image", "write ms", "verify ms");
+    for (const auto &image : images) {
+        printf("0x%-14x %10u %10u\n", image.offset, image.write_time_ms, image.verify_time_ms);
+    }
+    printf("%u erase ranges, %u bytes erased in %u ms, written in %u ms, verified in %u ms\n",
+           stats.erase_ranges, stats.bytes_erased, stats.erase_time_ms, stats.write_time_ms,
+           stats.verify_time_ms);
+    printf("Image set flashed in %u ms in one session, %.0f ms one by one\n", stats.total_time_ms, separate_ms);
+
+    // Overlapping images are rejected before anything is written
+    esp_loader_flash_image_t overlapping[] = {
+        { 0x1000, &bootloader[0], (uint32_t)bootloader.size() },
+        { 0x1000 + (uint32_t)bootloader.size() - 6, &partition_table[0], (uint32_t)partition_table.size() },
+    };
+    esp_loader_flash_images_stats_t rejected_stats;
+    if (esp_loader_flash_images(overlapping, 2, &rejected_stats) != ESP_LOADER_ERROR_INVALID_PARAM) {
+        return false;
+    }
+
+    // The bootloader and partition table sectors are adjacent and are erased together
+    return stats.erase_ranges == 2;
+}
+
+// Two targets flashed at the same time from two threads, one through the default loader and one
+// through a created loader with its own port functions
+bool flash_two_targets(uint32_t baud, const vector<uint8_t> &image)
+{
+    esp_loader_t *loader = esp_loader_create(&fault_link_port, s_targets[1].line);
+    if (loader == NULL) {
+        return false;
+    }
+
+    const vector<uint8_t> other_image = make_image(image.size() / 2, 5);
+    fill(flash(s_targets[0]).begin(), flash(s_targets[0]).end(), 0xFF);
+    fill(flash(s_targets[1]).begin(), flash(s_targets[1]).end(), 0xFF);
+
+    struct {
+        esp_loader_t *loader;
+        const target_t *target;
+        const vector<uint8_t> *image;
+        bool flashed;
+        double ms;
+    } targets[] = {
+        { NULL, &s_targets[0], &image },
+        { loader, &s_targets[1], &other_image },
+    };
+
+    vector<thread> threads;
+    for (auto &target : targets) {
+        threads.emplace_back([&target, baud] {
+            esp_loader_select(target.loader);
+            const double start_ms = time_ms(*target.target);
+
+            esp_loader_flash_image_t app = { IMAGE_OFFSET, &(*target.image)[0], (uint32_t)target.image->size() };
+            esp_loader_flash_images_stats_t stats;
+            target.flashed = connect(*target.target, baud) &&
+                             esp_loader_flash_images(&app, 1, &stats) == ESP_LOADER_SUCCESS &&
+                             flash_holds(*target.image, IMAGE_OFFSET, *target.target);
+            target.ms = time_ms(*target.target) - start_ms;
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    esp_loader_destroy(loader);
+
+    printf("\nTwo targets flashed concurrently: %zu bytes in %.0f ms, %zu bytes in %.0f ms\n",
+           image.size(), targets[0].ms, other_image.size(), targets[1].ms);
+
+    return targets[0].flashed && targets[1].flashed;
+}
+
+// Runs every check, the targets are created and destroyed around it
+int run(uint32_t baud, uint32_t image_size)
+{
+    if (!connect(s_targets[0], baud)) {
+        printf("Could not connect to the simulated target\n");
+        return EXIT_FAILURE;
+    }
+
+    // The update only changes the end of the application, as appending a feature would
+    const vector<uint8_t> old_image = make_image(image_size, 1);
+    vector<uint8_t> new_image = old_image;
+    const vector<uint8_t> tail = make_image(8 * 1024, 2);
+    copy(tail.begin(), tail.end(), new_image.end() - tail.size());
+
+    const double full_ms = flash_full(new_image);
+    if (full_ms < 0) {
+        printf("Writing the whole image failed\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%u byte image at %u baud, whole image written in %.0f ms\n\n", image_size, baud, full_ms);
+    printf("%-10s %-10s %10s %14s %10s %10s\n", "region", "flash", "written", "skipped bytes", "time ms",
+           "saved ms");
+
+    bool faster = true;
+    for (uint32_t region_size : { 16 * 1024, ESP_LOADER_FLASH_DELTA_REGION_SIZE, 256 * 1024 }) {
+        const struct {
+            const char *name;
+            const vector<uint8_t> *flash;
+        } cases[] = {
+            { "erased", NULL }, { "old image", &old_image }, { "new image", &new_image },
+        };
+
+        for (const auto &test_case : cases) {
+            fill(flash().begin(), flash().end(), 0xFF);
+            if (test_case.flash != NULL) {
+                copy(test_case.flash->begin(), test_case.flash->end(), flash().begin() + IMAGE_OFFSET);
+            }
+
+            esp_loader_flash_delta_stats_t stats;
+            if (!flash_delta(new_image, region_size, &stats) ||
+                    stats.bytes_skipped + stats.bytes_written != image_size) {
+                printf("Delta flashing with %u byte regions onto the %s failed\n", region_size, test_case.name);
+                return EXIT_FAILURE;
+            }
+
+            printf("%-10u %-10s %4u of %-3u %14u %10u %10u\n", region_size, test_case.name,
+                   stats.regions_written, stats.regions, stats.bytes_skipped, stats.total_time_ms,
+                   stats.time_saved_ms);
+
+            // An update of the tail has to take a fraction of the time of a full write
+            if (test_case.flash == &old_image && region_size <= ESP_LOADER_FLASH_DELTA_REGION_SIZE &&
+                    stats.total_time_ms * 4 > full_ms) {
+                faster = false;
+            }
+        }
+    }
+
+    if (!check_adaptive_timeouts()) {
+        printf("Adaptive timeouts failed\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!flash_through_writer(new_image)) {
+        printf("Writing through the buffered writer failed\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!flash_image_set(new_image)) {
+        printf("Flashing the image set failed\n");
+        return EXIT_FAILURE;
+    }
+
+    // After a chip erase the stub still gets the whole image to write, rewriting it has to erase again
+    copy(old_image.begin(), old_image.end(), flash().begin() + IMAGE_OFFSET);
+    const double chip_erase_start_ms = time_ms();
+    if (esp_loader_erase_chip() != ESP_LOADER_SUCCESS) {
+        printf("Chip erase failed\n");
+        return EXIT_FAILURE;
+    }
+    const double chip_erase_ms = time_ms() - chip_erase_start_ms;
+    const double after_erase_ms = flash_full(new_image);
+    if (after_erase_ms < 0 || flash_full(old_image) < 0) {
+        printf("Writing after a chip erase failed\n");
+        return EXIT_FAILURE;
+    }
+    printf("\nChip erase in %.0f ms, whole image written after it in %.0f ms\n", chip_erase_ms, after_erase_ms);
+
+    if (!flash_two_targets(baud, new_image)) {
+        printf("Flashing two targets concurrently failed\n");
+        return EXIT_FAILURE;
+    }
+
+    return faster ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+}
+
+
+int main(int argc, char *argv[])
+{
+    const uint32_t baud = argc > 1 ? strtoul(argv[1], NULL, 0) : 921600;
+    const uint32_t image_size = argc > 2 ? strtoul(argv[2], NULL, 0) : 1024 * 1024 - 2;
+
+    if (baud == 0 || image_size < 64 * 1024 || image_size > FLASH_SIZE - IMAGE_OFFSET) {
+        printf("Usage: %s [baud] [image size]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    for (auto &target : s_targets) {
+        target_create(target);
+    }
+    const int result = run(baud, image_size);
+    for (auto &target : s_targets) {
+        target_destroy(target);
+    }
+
+    return result;
+}
+
+
+esp_loader_error_t loader_port_write(const uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    return fault_link_port.write(s_targets[0].line, data, size, timeout);
+}
+
+esp_loader_error_t loader_port_read_some(uint8_t *data, uint16_t size, uint32_t timeout, uint16_t *received)
+{
+    return fault_link_port.read_some(s_targets[0].line, data, size, timeout, received);
+}
+
+esp_loader_error_t loader_port_read(uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    return fault_link_port.read(s_targets[0].line, data, size, timeout);
+}
+
+esp_loader_error_t loader_port_change_transmission_rate(uint32_t transmission_rate)
+{
+    return fault_link_port.change_transmission_rate(s_targets[0].line, transmission_rate);
+}
+
+void loader_port_enter_bootloader(void)
+{
+    fault_link_port.enter_bootloader(s_targets[0].line);
+}
+
+void loader_port_reset_target(void)
+{
+    fault_link_port.reset_target(s_targets[0].line);
+}
+
+void loader_port_delay_ms(uint32_t ms)
+{
+    fault_link_port.delay_ms(s_targets[0].line, ms);
+}
+
+void loader_port_start_timer(uint32_t ms)
+{
+    fault_link_port.start_timer(s_targets[0].line, ms);
+}
+
+uint32_t loader_port_remaining_time(void)
+{
+    return fault_link_port.remaining_time(s_targets[0].line);
+}
+
+uint32_t loader_port_get_time_ms(void)
+{
+    return fault_link_port.get_time_ms(s_targets[0].line);
+}
+
+void loader_port_debug_print(const char *str)
+{
+}
@@ -0,0 +1,256 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Benchmark of esp_loader_flash_read() through the flasher stub.
+ *
+ * The target is the software ESP32 of target_sim.h behind the serial link model of
+ * link_model.h, with a one way latency added to the link. Time is virtual, so a sweep over
+ * megabytes of data at slow rates finishes instantly and gives the same numbers on every run.
+ *
+ * Before the sweep, esp_loader_autotune_link() is checked against a link that flips bits of the
+ * data to the host above a certain rate, through the fault injecting link of fault_link.h. */
+
+#include "esp_loader.h"
+#include "esp_loader_io.h"
+#include "target_sim.h"
+#include "link_model.h"
+#include "fault_link.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+
+const uint32_t FLASH_SIZE = 16 * 1024 * 1024;
+const uint32_t INITIAL_BAUD = 115200;
+
+struct {
+    target_sim_t *sim;
+    link_model_t *link;
+    fault_link_t *fault;
+    uint32_t max_stable_baud;   // Data to the host gets corrupted above it, 0 for no limit
+} s_bench;
+
+void set_latency(uint32_t latency_us)
+{
+    link_model_config_t config = link_model_config(s_bench.link);
+    config.latency_us = latency_us;
+    link_model_set_config(s_bench.link, config);
+}
+
+struct window_t {
+    uint32_t packet_size;
+    uint32_t max_inflight;
+};
+
+// Returns the read throughput in bytes per second of virtual time, 0 on failure
+double measure_read(uint32_t latency_us, const window_t &window, uint32_t length, vector<uint8_t> &buf)
+{
+    set_latency(latency_us);
+
+    if (esp_loader_flash_read_set_window(window.packet_size, window.max_inflight) != ESP_LOADER_SUCCESS) {
+        return 0;
+    }
+
+    // Odd address and length exercise the alignment handling of the read path
+    const uint32_t address = 0x1001;
+    const vector<uint8_t> &flash = target_sim_flash(s_bench.sim);
+    fill(buf.begin(), buf.end(), 0);
+
+    const uint64_t start_us = link_model_stats(s_bench.link).time_us;
+    if (esp_loader_flash_read(&buf[0], address, length) != ESP_LOADER_SUCCESS ||
+            !equal(buf.begin(), buf.begin() + length, flash.begin() + address)) {
+        return 0;
+    }
+
+    return length / ((link_model_stats(s_bench.link).time_us - start_us) / 1e6);
+}
+
+}
+
+
+int main(int argc, char *argv[])
+{
+    const uint32_t baud = argc > 1 ? strtoul(argv[1], NULL, 0) : 921600;
+    const uint32_t length = argc > 2 ? strtoul(argv[2], NULL, 0) : 256 * 1024 - 3;
+
+    if (baud == 0 || length == 0 || length > FLASH_SIZE / 2) {
+        printf("Usage: %s [baud] [read length]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    s_bench.sim = target_sim_create(FLASH_SIZE);
+    mt19937 generator(1);
+    for (auto &byte : target_sim_flash(s_bench.sim)) {
+        byte = generator() & 0xFF;
+    }
+    s_bench.link = link_model_create(&target_sim_port, s_bench.sim);
+    fault_link_config_t fault_config;
+    /* A flip that breaks the framing of a flash read leaves the stub waiting for acknowledgements,
+       which the rate cannot be restored from. The flips of this seed only damage the data. */
+    fault_config.bit_flip_rate = 0.005;
+    fault_config.to_target = false;
+    fault_config.seed = 2;
+    s_bench.fault = fault_link_create(&link_model_port, s_bench.link, fault_config);
+
+    esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+    if (esp_loader_connect_with_stub(&connect_config) != ESP_LOADER_SUCCESS) {
+        printf("Could not connect to the simulated target\n");
+        return EXIT_FAILURE;
+    }
+
+    // The link corrupts data above 1.5 Mbaud, autotuning has to settle just below
+    set_latency(125);
+    s_bench.max_stable_baud = 1500000;
+    const uint32_t rates[] = { 230400, 460800, 921600, 1500000, 2000000, 3000000 };
+    esp_loader_autotune_result_t autotune;
+    if (esp_loader_autotune_link(INITIAL_BAUD, rates, sizeof(rates) / sizeof(rates[0]), &autotune) != ESP_LOADER_SUCCESS ||
+            autotune.transmission_rate != s_bench.max_stable_baud || autotune.rates_failed != 1 ||
+            link_model_config(s_bench.link).baud != s_bench.max_stable_baud ||
+            target_sim_transmission_rate(s_bench.sim) != s_bench.max_stable_baud) {
+        printf("Link autotuning did not settle at %u baud\n", s_bench.max_stable_baud);
+        return EXIT_FAILURE;
+    }
+    printf("Link autotuned to %u baud after trying %u rates, %.1f KiB/s effective\n\n",
+           autotune.transmission_rate, autotune.rates_tried, autotune.effective_throughput / 1024.0);
+
+    // The sweep runs over a clean link
+    s_bench.max_stable_baud = 0;
+    if (esp_loader_change_transmission_rate_stub(autotune.transmission_rate, baud) != ESP_LOADER_SUCCESS ||
+            loader_port_change_transmission_rate(baud) != ESP_LOADER_SUCCESS) {
+        printf("Could not change the rate to %u baud\n", baud);
+        return EXIT_FAILURE;
+    }
+
+    const uint32_t latencies_us[] = { 0, 125, 1000, 4000 };
+    const window_t windows[] = {
+        { 256, 1 }, { SERIAL_FLASHER_READ_PACKET_SIZE, 1 }, { SERIAL_FLASHER_READ_PACKET_SIZE, 2 },
+        { SERIAL_FLASHER_READ_PACKET_SIZE, 4 }, { SERIAL_FLASHER_READ_PACKET_SIZE, 8 },
+        { SERIAL_FLASHER_READ_PACKET_SIZE, 16 },
+    };
+
+    printf("Stub flash read throughput in KiB/s, %u bytes at %u baud (link limit %.1f KiB/s)\n\n",
+           length, baud, baud / 10.0 / 1024);
+    printf("%-12s", "latency");
+    for (const auto &window : windows) {
+        printf("%6ux%-4u", window.packet_size, window.max_inflight);
+    }
+    printf("\n");
+
+    vector<uint8_t> buf(length);
+    bool windowing_helps = true;
+    esp_loader_reset_transfer_stats();
+
+    for (uint32_t latency_us : latencies_us) {
+        printf("%8.3f ms ", latency_us / 1000.0);
+
+        double previous = 0;
+        double widest = 0;
+        for (const auto &window : windows) {
+            const double throughput = measure_read(latency_us, window, length, buf);
+            if (throughput == 0) {
+                printf("\nRead with packet size %u and window %u failed\n",
+                       window.packet_size, window.max_inflight);
+                return EXIT_FAILURE;
+            }
+            printf("%11.1f", throughput / 1024);
+
+            if (previous == 0) {
+                previous = throughput;
+            }
+            widest = throughput;
+        }
+        printf("\n");
+
+        // Once the round trip exceeds the packet time the window has to pay off against
+        // the former fixed 256 byte stop-and-wait reads
+        const double packet_us = 256 * 10e6 / baud;
+        if (2 * latency_us >= packet_us && widest < 1.5 * previous) {
+            windowing_helps = false;
+        }
+    }
+
+    esp_loader_transfer_stats_t stats;
+    esp_loader_get_transfer_stats(&stats);
+    printf("\n%u frames sent with %u port writes, %u frames received with %u port reads\n",
+           stats.frames_sent, stats.port_writes, stats.frames_received, stats.port_reads);
+
+    fault_link_destroy(s_bench.fault);
+    link_model_destroy(s_bench.link);
+    target_sim_destroy(s_bench.sim);
+
+    return windowing_helps ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
+esp_loader_error_t loader_port_write(const uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    return fault_link_port.write(s_bench.fault, data, size, timeout);
+}
+
+esp_loader_error_t loader_port_read_some(uint8_t *data, uint16_t size, uint32_t timeout, uint16_t *received)
+{
+    return fault_link_port.read_some(s_bench.fault, data, size, timeout, received);
+}
+
+esp_loader_error_t loader_port_read(uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    return fault_link_port.read(s_bench.fault, data, size, timeout);
+}
+
+esp_loader_error_t loader_port_change_transmission_rate(uint32_t transmission_rate)
+{
+    fault_link_enable(s_bench.fault, s_bench.max_stable_baud != 0 && transmission_rate > s_bench.max_stable_baud);
+    return fault_link_port.change_transmission_rate(s_bench.fault, transmission_rate);
+}
+
+void loader_port_enter_bootloader(void)
+{
+    fault_link_port.enter_bootloader(s_bench.fault);
+}
+
+void loader_port_reset_target(void)
+{
+    fault_link_port.reset_target(s_bench.fault);
+}
+
+void loader_port_delay_ms(uint32_t ms)
+{
+    fault_link_port.delay_ms(s_bench.fault, ms);
+}
+
+void loader_port_start_timer(uint32_t ms)
+{
+    fault_link_port.start_timer(s_bench.fault, ms);
+}
+
+uint32_t loader_port_remaining_time(void)
+{
+    return fault_link_port.remaining_time(s_bench.fault);
+}
+
+uint32_t loader_port_get_time_ms(void)
+{
+    return fault_link_port.get_time_ms(s_bench.fault);
+}
+
+void loader_port_debug_print(const char *str)
+{
+}
@@ -0,0 +1,545 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Throughput benchmark suite of the flashing operations, against the software ESP32 target.
+ *
+ * Flash writes, compressed flash writes, flash reads, flash verification and RAM loads are run
+ * with the ROM loader and with the stub, at several baud rates and block sizes, and compressed
+ * writes with images of different compressibility. The target is reached through the serial link
+ * model, which runs in virtual time, so throughput and command rate are reproducible. The host
+ * CPU time is measured for real, without the time spent in the simulator.
+ *
+ * The results can be written as JSON and compared against an earlier JSON file, in which case
+ * the benchmark fails on throughput regressions beyond a threshold and on results missing from
+ * the run. */
+
+#include "esp_loader.h"
+#include "esp_loader_io.h"
+#include "target_sim.h"
+#include "link_model.h"
+#include <time.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+
+const uint32_t FLASH_ADDRESS = 0x10000;
+const uint32_t RAM_ADDRESS = 0x3ffb0000;
+const uint32_t INITIAL_BAUD = 115200;
+const double MB = 1024 * 1024;
+
+struct {
+    target_sim_t *sim;
+    link_model_t *link;
+} s_bench;
+
+double thread_cpu_ns()
+{
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+struct result_t {
+    string name;
+    string op;
+    string mode;
+    uint32_t baud;
+    uint32_t block;
+    string data;
+    double bytes_per_s;
+    double commands_per_s;
+    double cpu_ms_per_mb;
+};
+
+// Measures one operation over size bytes of image data
+class measurement_t
+{
+public:
+    measurement_t() : m_start(link_model_stats(s_bench.link)), m_cpu_ns(thread_cpu_ns())
+    {
+    }
+
+    result_t finish(const char *op, const char *mode, uint32_t baud, uint32_t block, const char *data,
+                    size_t size)
+    {
+        const double cpu_ns = thread_cpu_ns() - m_cpu_ns;
+        const link_model_stats_t end = link_model_stats(s_bench.link);
+        const double seconds = (end.time_us - m_start.time_us) / 1e6;
+        const double host_cpu_ns = cpu_ns - (end.inner_cpu_ns - m_start.inner_cpu_ns);
+
+        result_t result;
+        result.op = op;
+        result.mode = mode;
+        result.baud = baud;
+        result.block = block;
+        result.data = data;
+        result.name = result.op + "/" + mode + "/" + to_string(baud) + "/" + to_string(block) + "/" + data;
+        result.bytes_per_s = size / seconds;
+        result.commands_per_s = (end.commands - m_start.commands) / seconds;
+        result.cpu_ms_per_mb = host_cpu_ns / 1e6 / (size / MB);
+        return result;
+    }
+
+private:
+    link_model_stats_t m_start;
+    double m_cpu_ns;
+};
+
+vector<uint8_t> make_image(uint32_t size, const string &data)
+{
+    vector<uint8_t> image(size, 0);
+    mt19937 generator(22);
+    for (auto &byte : image) {
+        if (data == "random") {
+            byte = generator() & 0xFF;
+        } else if (data == "mixed") {
+            // Half of the bytes repeat, so that the image compresses somewhat
+            byte = generator() % 2 ? generator() & 0xFF : 0x55;
+        }
+    }
+    return image;
+}
+
+bool check(esp_loader_error_t err, const char *what)
+{
+    if (err != ESP_LOADER_SUCCESS) {
+        printf("%s failed with error %d\n", what, err);
+        return false;
+    }
+    return true;
+}
+
+bool flash_plain(const vector<uint8_t> &image, uint32_t block_size)
+{
+    if (!check(esp_loader_flash_start(FLASH_ADDRESS, image.size(), block_size), "Flash start")) {
+        return false;
+    }
+    for (size_t offset = 0; offset < image.size(); offset += block_size) {
+        const uint32_t size = min<size_t>(block_size, image.size() - offset);
+        if (!check(esp_loader_flash_write((void *)&image[offset], size), "Flash write")) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool flash_deflated(const vector<uint8_t> &image, uint32_t chunk_size)
+{
+    if (!check(esp_loader_flash_deflate_start(FLASH_ADDRESS, image.size(), -1), "Compressed flash start")) {
+        return false;
+    }
+    for (size_t offset = 0; offset < image.size(); offset += chunk_size) {
+        const uint32_t size = min<size_t>(chunk_size, image.size() - offset);
+        if (!check(esp_loader_flash_deflate_write(&image[offset], size), "Compressed flash write")) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool flash_holds(const vector<uint8_t> &image)
+{
+    const vector<uint8_t> &flash = target_sim_flash(s_bench.sim);
+    if (!equal(image.begin(), image.end(), flash.begin() + FLASH_ADDRESS)) {
+        printf("Flash does not hold the image\n");
+        return false;
+    }
+    return true;
+}
+
+bool connect(bool stub, uint32_t baud)
+{
+    // Also forgets about the stub of the previous session
+    esp_loader_reset_target();
+    loader_port_change_transmission_rate(INITIAL_BAUD);
+
+    esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+    if (stub) {
+        return check(esp_loader_connect_with_stub(&connect_config), "Connecting to the stub") &&
+               check(esp_loader_change_transmission_rate_stub(INITIAL_BAUD, baud), "Changing the stub rate") &&
+               check(loader_port_change_transmission_rate(baud), "Changing the host rate");
+    }
+
+    return check(esp_loader_connect(&connect_config), "Connecting to the ROM loader") &&
+           check(esp_loader_change_transmission_rate(baud), "Changing the ROM loader rate") &&
+           check(loader_port_change_transmission_rate(baud), "Changing the host rate");
+}
+
+// Runs every operation of one loader at one baud rate
+bool run_session(bool stub, uint32_t baud, uint32_t image_size, vector<result_t> &results)
+{
+    const char *mode = stub ? "stub" : "rom";
+    const vector<uint32_t> write_blocks = stub ? vector<uint32_t> { 1024, 4096, 16384 } :
+                                          vector<uint32_t> { 256, 1024 };
+
+    if (!connect(stub, baud)) {
+        return false;
+    }
+
+    const vector<uint8_t> random_image = make_image(image_size, "random");
+    for (uint32_t block_size : write_blocks) {
+        measurement_t measurement;
+        if (!flash_plain(random_image, block_size)) {
+            return false;
+        }
+        results.push_back(measurement.finish("flash_write", mode, baud, block_size, "random", image_size));
+        if (!flash_holds(random_image)) {
+            return false;
+        }
+    }
+
+    for (const char *data : { "random", "mixed", "zeros" }) {
+        const vector<uint8_t> image = make_image(image_size, data);
+        {
+            measurement_t measurement;
+            if (!flash_deflated(image, 4096)) {
+                return false;
+            }
+            results.push_back(measurement.finish("flash_deflate_write", mode, baud, 4096, data, image_size));
+        }
+        if (!flash_holds(image)) {
+            return false;
+        }
+
+        if (strcmp(data, "mixed") == 0) {
+            measurement_t measurement;
+            if (!check(esp_loader_flash_verify(), "Flash verify")) {
+                return false;
+            }
+            results.push_back(measurement.finish("flash_verify", mode, baud, 0, data, image_size));
+        }
+    }
+
+    const vector<uint8_t> zeros = make_image(image_size, "zeros");
+    vector<uint8_t> read_back(image_size);
+    {
+        measurement_t measurement;
+        if (!check(esp_loader_flash_read(&read_back[0], FLASH_ADDRESS, image_size), "Flash read")) {
+            return false;
+        }
+        results.push_back(measurement.finish("flash_read", mode, baud, 0, "zeros", image_size));
+    }
+    if (read_back != zeros) {
+        printf("Flash read returned wrong data\n");
+        return false;
+    }
+
+    // RAM loads would overwrite a running stub
+    if (!stub) {
+        for (uint32_t block_size : { 1024, 6144 }) {
+            measurement_t measurement;
+            if (!check(esp_loader_mem_start(RAM_ADDRESS, image_size, block_size), "RAM load start")) {
+                return false;
+            }
+            for (size_t offset = 0; offset < image_size; offset += block_size) {
+                const uint32_t size = min<size_t>(block_size, image_size - offset);
+                if (!check(esp_loader_mem_write(&random_image[offset], size), "RAM load")) {
+                    return false;
+                }
+            }
+            results.push_back(measurement.finish("mem_write", mode, baud, block_size, "random", image_size));
+
+            if (target_sim_memory(s_bench.sim, RAM_ADDRESS, image_size) != random_image) {
+                printf("RAM does not hold the image\n");
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+double json_number(const string &line, const char *key)
+{
+    const size_t at = line.find(string("\"") + key + "\":");
+    return at == string::npos ? NAN : strtod(line.c_str() + at + strlen(key) + 3, NULL);
+}
+
+string json_string(const string &line, const char *key)
+{
+    const string prefix = string("\"") + key + "\": \"";
+    const size_t at = line.find(prefix);
+    if (at == string::npos) {
+        return "";
+    }
+    const size_t start = at + prefix.size();
+    return line.substr(start, line.find('"', start) - start);
+}
+
+// Reads a file written by write_json(), which has one result per line
+bool read_json(const char *path, uint32_t &image_size, map<string, result_t> &results)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        printf("Could not open %s\n", path);
+        return false;
+    }
+
+    char buffer[1024];
+    while (fgets(buffer, sizeof(buffer), file) != NULL) {
+        const string line = buffer;
+        if (line.find("\"image_size\":") != string::npos) {
+            image_size = json_number(line, "image_size");
+        }
+
+        result_t result;
+        result.name = json_string(line, "name");
+        if (!result.name.empty()) {
+            result.baud = json_number(line, "baud");
+            result.bytes_per_s = json_number(line, "bytes_per_s");
+            result.commands_per_s = json_number(line, "commands_per_s");
+            result.cpu_ms_per_mb = json_number(line, "cpu_ms_per_mb");
+            results[result.name] = result;
+        }
+    }
+
+    fclose(file);
+    return image_size != 0;
+}
+
+bool write_json(const char *path, uint32_t image_size, const vector<result_t> &results)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        printf("Could not create %s\n", path);
+        return false;
+    }
+
+    fprintf(file, "{\n  \"benchmark\": \"serial_flasher_bench\",\n  \"image_size\": %u,\n  \"results\": [\n", image_size);
+    for (size_t i = 0; i < results.size(); i++) {
+        const result_t &result = results[i];
+        fprintf(file, "    {\"name\": \"%s\", \"op\": \"%s\", \"mode\": \"%s\", \"baud\": %u, \"block\": %u, "
+                "\"data\": \"%s\", \"bytes_per_s\": %.1f, \"commands_per_s\": %.1f, \"cpu_ms_per_mb\": %.3f}%s\n",
+                result.name.c_str(), result.op.c_str(), result.mode.c_str(), result.baud, result.block,
+                result.data.c_str(), result.bytes_per_s, result.commands_per_s, result.cpu_ms_per_mb,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    return fclose(file) == 0;
+}
+
+// Prints the changes against the baseline, returns the number of regressions and missing results
+int compare(const map<string, result_t> &baseline, const vector<result_t> &results,
+            double threshold, double cpu_threshold)
+{
+    int regressions = 0;
+
+    printf("\n%-44s %12s %8s %10s %8s %10s %8s\n", "compared to baseline", "bytes/s", "change",
+           "commands/s", "change", "CPU ms/MB", "change");
+    for (const result_t &result : results) {
+        const auto old = baseline.find(result.name);
+        if (old == baseline.end()) {
+            printf("%-44s not in the baseline\n", result.name.c_str());
+            continue;
+        }
+
+        const double throughput = 100 * (result.bytes_per_s / old->second.bytes_per_s - 1);
+        const double commands = 100 * (result.commands_per_s / old->second.commands_per_s - 1);
+        const double cpu = 100 * (result.cpu_ms_per_mb / old->second.cpu_ms_per_mb - 1);
+        const bool regressed = throughput < -threshold || (cpu_threshold > 0 && cpu > cpu_threshold);
+
+        printf("%-44s %12.0f %+7.1f%% %10.0f %+7.1f%% %10.2f %+7.1f%%  %s\n", result.name.c_str(),
+               result.bytes_per_s, throughput, result.commands_per_s, commands, result.cpu_ms_per_mb, cpu,
+               regressed ? "REGRESSION" : "");
+        regressions += regressed;
+    }
+
+    for (const auto &old : baseline) {
+        if (none_of(results.begin(), results.end(), [&](const result_t & result) {
+        return result.name == old.first;
+    })) {
+            printf("%-44s missing from this run\n", old.first.c_str());
+            regressions++;
+        }
+    }
+
+    return regressions;
+}
+
+void usage(const char *program)
+{
+    printf("Usage: %s [--size bytes] [--baud rate]... [--json file] [--compare file]\n"
+           "       [--threshold percent] [--cpu-threshold percent]\n", program);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t image_size = 256 * 1024;
+    vector<uint32_t> bauds;
+    const char *json_path = NULL;
+    const char *baseline_path = NULL;
+    double threshold = 5;
+    double cpu_threshold = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const string arg = argv[i];
+        if (i + 1 == argc) {
+            usage(argv[0]);
+            return 1;
+        } else if (arg == "--size") {
+            image_size = strtoul(argv[++i], NULL, 0);
+        } else if (arg == "--baud") {
+            bauds.push_back(strtoul(argv[++i], NULL, 0));
+        } else if (arg == "--json") {
+            json_path = argv[++i];
+        } else if (arg == "--compare") {
+            baseline_path = argv[++i];
+        } else if (arg == "--threshold") {
+            threshold = strtod(argv[++i], NULL);
+        } else if (arg == "--cpu-threshold") {
+            cpu_threshold = strtod(argv[++i], NULL);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // A comparison runs the sweep of the baseline
+    map<string, result_t> baseline;
+    if (baseline_path != NULL) {
+        if (!read_json(baseline_path, image_size, baseline)) {
+            return 1;
+        }
+        const bool bauds_given = !bauds.empty();
+        for (const auto &result : baseline) {
+            if (!bauds_given && find(bauds.begin(), bauds.end(), result.second.baud) == bauds.end()) {
+                bauds.push_back(result.second.baud);
+            }
+        }
+    }
+    if (bauds.empty()) {
+        bauds = { 115200, 921600, 2000000 };
+    }
+    if (image_size == 0 || image_size % 4096 != 0) {
+        printf("The image size has to be a multiple of 4096\n");
+        return 1;
+    }
+
+    s_bench.sim = target_sim_create();
+    s_bench.link = link_model_create(&target_sim_port, s_bench.sim);
+
+    vector<result_t> results;
+    bool failed = false;
+    for (bool stub : { false, true }) {
+        for (uint32_t baud : bauds) {
+            if (!run_session(stub, baud, image_size, results)) {
+                printf("The %s session at %u baud failed\n", stub ? "stub" : "ROM loader", baud);
+                failed = true;
+            }
+        }
+    }
+
+    link_model_destroy(s_bench.link);
+    target_sim_destroy(s_bench.sim);
+
+    printf("%-22s %5s %8s %6s %7s %12s %11s %10s\n", "operation", "mode", "baud", "block", "data",
+           "bytes/s", "commands/s", "CPU ms/MB");
+    for (const result_t &result : results) {
+        printf("%-22s %5s %8u %6u %7s %12.0f %11.0f %10.2f\n", result.op.c_str(), result.mode.c_str(),
+               result.baud, result.block, result.data.c_str(), result.bytes_per_s, result.commands_per_s,
+               result.cpu_ms_per_mb);
+    }
+
+    if (json_path != NULL && !write_json(json_path, image_size, results)) {
+        failed = true;
+    }
+
+    if (baseline_path != NULL) {
+        const int regressions = compare(baseline, results, threshold, cpu_threshold);
+        if (regressions > 0) {
+            printf("\n%d results missing or regressed beyond %.1f%% throughput", regressions, threshold);
+            if (cpu_threshold > 0) {
+                printf(" or %.1f%% CPU time", cpu_threshold);
+            }
+            printf("\n");
+            failed = true;
+        }
+    }
+
+    if (failed) {
+        printf("Benchmark failed\n");
+        return 1;
+    }
+    return 0;
+}
+
+
+esp_loader_error_t loader_port_write(const uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    return link_model_port.write(s_bench.link, data, size, timeout);
+}
+
+esp_loader_error_t loader_port_read_some(uint8_t *data, uint16_t size, uint32_t timeout, uint16_t *received)
+{
+    return link_model_port.read_some(s_bench.link, data, size, timeout, received);
+}
+
+esp_loader_error_t loader_port_read(uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    return link_model_port.read(s_bench.link, data, size, timeout);
+}
+
+esp_loader_error_t loader_port_change_transmission_rate(uint32_t transmission_rate)
+{
+    return link_model_port.change_transmission_rate(s_bench.link, transmission_rate);
+}
+
+void loader_port_enter_bootloader(void)
+{
+    link_model_port.enter_bootloader(s_bench.link);
+}
+
+void loader_port_reset_target(void)
+{
+    link_model_port.reset_target(s_bench.link);
+}
+
+void loader_port_delay_ms(uint32_t ms)
+{
+    link_model_port.delay_ms(s_bench.link, ms);
+}
+
+void loader_port_start_timer(uint32_t ms)
+{
+    link_model_port.start_timer(s_bench.link, ms);
+}
+
+uint32_t loader_port_remaining_time(void)
+{
+    return link_model_port.remaining_time(s_bench.link);
+}
+
+uint32_t loader_port_get_time_ms(void)
+{
+    return link_model_port.get_time_ms(s_bench.link);
+}
+
+void loader_port_debug_print(const char *str)
+{
+}
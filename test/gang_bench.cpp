@@ -0,0 +1,326 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Benchmark of esp_loader_gang_run() flashing many simulated targets at the same time.
+ *
+ * Every target is a simulator of target_sim.h served on a pseudo-terminal, which the host opens
+ * with the Linux port like the serial port of a USB-UART adapter. The serving is paced, bytes take
+ * the time they would take on the link at the current baud rate in real time, so the wall time
+ * of the gang is what matters, as on a production fixture.
+ *
+ * The link of one target flips a bit of the compressed image during its first attempt, so that
+ * attempt fails, the link of another one is cut during its first attempt, and that of the last
+ * one is never connected. */
+
+#include "esp_loader.h"
+#include "esp_loader_io.h"
+#include "esp_loader_gang.h"
+#include "linux_port.h"
+#include "target_sim.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+
+const uint8_t SLIP_END = 0xC0;
+const uint8_t SLIP_ESC = 0xDB;
+const uint8_t CMD_FLASH_DEFL_DATA = 0x11;
+const uint32_t FLASH_SIZE = 4 * 1024 * 1024;
+
+const uint32_t INITIAL_RATE = 115200;
+const uint32_t RATES[] = { 230400, 460800, 921600, 2000000 };
+
+enum fault_t {
+    FAULT_NONE,
+    FAULT_CORRUPT_FIRST_ATTEMPT,  // Flips a bit of the first compressed data
+    FAULT_SILENT_FIRST_ATTEMPT,   // Drops everything sent until the next reset
+    FAULT_DEAD,                   // Drops everything sent
+};
+
+struct device_t {
+    target_sim_t *sim = NULL;
+    loader_linux_port_t port = { -1, 0 };
+    string name;
+    fault_t fault = FAULT_NONE;
+    atomic<uint32_t> resets{0};
+    bool corrupted = false;
+
+    ~device_t()
+    {
+        loader_port_linux_close(&port);
+        if (sim != NULL) {
+            target_sim_destroy(sim);
+        }
+    }
+};
+
+// Index of a data byte of the first FLASH_DEFL_DATA frame in the written bytes that can be flipped
+// without changing the framing, or size if there is none
+size_t corruptible_byte(const uint8_t *data, size_t size, uint8_t mask)
+{
+    const uint8_t frame_start[] = { SLIP_END, 0x00, CMD_FLASH_DEFL_DATA };
+    const uint8_t *frame = search(data, data + size, frame_start, frame_start + sizeof(frame_start));
+
+    // Past the command and data headers
+    for (size_t i = frame - data + sizeof(frame_start) + 40; i < size; i++) {
+        const uint8_t flipped = data[i] ^ mask;
+        if (data[i] != SLIP_END && data[i] != SLIP_ESC && flipped != SLIP_END && flipped != SLIP_ESC &&
+                data[i - 1] != SLIP_ESC) {
+            return i;
+        }
+    }
+    return size;
+}
+
+// Port functions of a target, the Linux port on its pseudo-terminal with the fault of its link
+esp_loader_error_t faulty_write(void *context, const uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    device_t *device = (device_t *)context;
+    const bool first_attempt = device->resets <= 1;
+
+    if (device->fault == FAULT_DEAD || (device->fault == FAULT_SILENT_FIRST_ATTEMPT && first_attempt)) {
+        return ESP_LOADER_SUCCESS;
+    }
+
+    if (device->fault == FAULT_CORRUPT_FIRST_ATTEMPT && first_attempt && !device->corrupted) {
+        const uint8_t mask = 0x10;
+        const size_t at = corruptible_byte(data, size, mask);
+        if (at < size) {
+            vector<uint8_t> corrupted(data, data + size);
+            corrupted[at] ^= mask;
+            device->corrupted = true;
+            return loader_port_linux.write(&device->port, &corrupted[0], size, timeout);
+        }
+    }
+
+    return loader_port_linux.write(&device->port, data, size, timeout);
+}
+
+esp_loader_error_t faulty_read(void *context, uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    return loader_port_linux.read(&((device_t *)context)->port, data, size, timeout);
+}
+
+esp_loader_error_t faulty_read_some(void *context, uint8_t *data, uint16_t size, uint32_t timeout,
+                                    uint16_t *received)
+{
+    return loader_port_linux.read_some(&((device_t *)context)->port, data, size, timeout, received);
+}
+
+esp_loader_error_t faulty_change_transmission_rate(void *context, uint32_t transmission_rate)
+{
+    return loader_port_linux.change_transmission_rate(&((device_t *)context)->port, transmission_rate);
+}
+
+void faulty_delay_ms(void *context, uint32_t ms)
+{
+    loader_port_linux.delay_ms(&((device_t *)context)->port, ms);
+}
+
+void faulty_start_timer(void *context, uint32_t ms)
+{
+    loader_port_linux.start_timer(&((device_t *)context)->port, ms);
+}
+
+uint32_t faulty_remaining_time(void *context)
+{
+    return loader_port_linux.remaining_time(&((device_t *)context)->port);
+}
+
+// The modem lines of a pseudo-terminal reach nothing, the simulator is reset directly
+void faulty_enter_bootloader(void *context)
+{
+    device_t *device = (device_t *)context;
+
+    device->resets++;
+    target_sim_pty_reset(device->sim);
+    loader_port_linux.enter_bootloader(&device->port);
+}
+
+void faulty_reset_target(void *context)
+{
+    loader_port_linux.reset_target(&((device_t *)context)->port);
+}
+
+// The failing targets provoke errors on purpose
+void faulty_debug_print(void *context, const char *str)
+{
+}
+
+uint32_t faulty_get_time_ms(void *context)
+{
+    return loader_port_linux.get_time_ms(&((device_t *)context)->port);
+}
+
+esp_loader_port_t faulty_port()
+{
+    esp_loader_port_t port = {};
+    port.write = faulty_write;
+    port.read = faulty_read;
+    port.read_some = faulty_read_some;
+    port.change_transmission_rate = faulty_change_transmission_rate;
+    port.delay_ms = faulty_delay_ms;
+    port.start_timer = faulty_start_timer;
+    port.remaining_time = faulty_remaining_time;
+    port.enter_bootloader = faulty_enter_bootloader;
+    port.reset_target = faulty_reset_target;
+    port.debug_print = faulty_debug_print;
+    port.get_time_ms = faulty_get_time_ms;
+    return port;
+}
+
+bool device_open(device_t &device)
+{
+    device.sim = target_sim_create(FLASH_SIZE);
+
+    // Flash that is not erased, so that images written without erasing end up corrupted
+    vector<uint8_t> &flash = target_sim_flash(device.sim);
+    fill(flash.begin(), flash.end(), 0x5A);
+
+    if (!target_sim_pty_start(device.sim, device.name, true)) {
+        return false;
+    }
+
+    const loader_linux_config_t config = { device.name.c_str(), INITIAL_RATE };
+    return loader_port_linux_open(&device.port, &config) == ESP_LOADER_SUCCESS;
+}
+
+// Stops serving the target, its flash can be looked at afterwards
+void device_close(device_t &device)
+{
+    loader_port_linux_close(&device.port);
+    target_sim_pty_stop(device.sim);
+}
+
+// Compresses roughly like application code: words drawn from a small vocabulary
+vector<uint8_t> make_image(uint32_t size, uint32_t seed)
+{
+    mt19937 generator(seed);
+    vector<uint32_t> words(512);
+    for (auto &word : words) {
+        word = generator();
+    }
+
+    vector<uint8_t> image(size);
+    for (uint32_t i = 0; i < size; i += 4) {
+        const uint32_t word = words[generator() % words.size()];
+        memcpy(&image[i], &word, min(4U, size - i));
+    }
+    return image;
+}
+
+}
+
+
+int main(int argc, char *argv[])
+{
+    const uint32_t count = argc > 1 ? strtoul(argv[1], NULL, 0) : 16;
+    const uint32_t image_size = argc > 2 ? strtoul(argv[2], NULL, 0) : 256 * 1024;
+
+    if (count < 4 || count > SERIAL_FLASHER_MAX_LOADERS - 1 || image_size == 0 ||
+            image_size > FLASH_SIZE - 0x10000) {
+        printf("Usage: %s [devices, 4 to %d] [image size]\n", argv[0], SERIAL_FLASHER_MAX_LOADERS - 1);
+        return EXIT_FAILURE;
+    }
+
+    const vector<uint8_t> app = make_image(image_size, 1);
+    const vector<uint8_t> partition_table = make_image(3 * 1024, 2);
+    const esp_loader_flash_image_t images[] = {
+        { 0x8000, &partition_table[0], (uint32_t)partition_table.size() },
+        { 0x10000, &app[0], (uint32_t)app.size() },
+    };
+
+    vector<unique_ptr<device_t>> devices;
+    vector<esp_loader_gang_device_t> gang(count);
+    const esp_loader_port_t port = faulty_port();
+    for (uint32_t i = 0; i < count; i++) {
+        devices.emplace_back(new device_t);
+        devices[i]->fault = i == 1 ? FAULT_CORRUPT_FIRST_ATTEMPT :
+                            i == 2 ? FAULT_SILENT_FIRST_ATTEMPT :
+                            i == count - 1 ? FAULT_DEAD : FAULT_NONE;
+        if (!device_open(*devices[i])) {
+            printf("Could not serve a simulated target on a pseudo-terminal\n");
+            return EXIT_FAILURE;
+        }
+        gang[i].name = devices[i]->name.c_str();
+        gang[i].port = &port;
+        gang[i].port_context = devices[i].get();
+    }
+
+    esp_loader_gang_config_t config = ESP_LOADER_GANG_CONFIG_DEFAULT();
+    config.images = images;
+    config.image_count = sizeof(images) / sizeof(images[0]);
+    config.connect.trials = 3;
+    config.transmission_rate = INITIAL_RATE;
+    config.rates = RATES;
+    config.rate_count = sizeof(RATES) / sizeof(RATES[0]);
+    config.attempts = 2;
+
+    esp_loader_gang_report_t report;
+    const esp_loader_error_t err = esp_loader_gang_run(&config, &gang[0], count, &report);
+
+    for (auto &device : devices) {
+        device_close(*device);
+    }
+
+    printf("%-14s %8s %8s %9s %9s %9s %9s  %s\n", "device", "attempts", "rate", "erase ms", "write ms",
+           "verify ms", "total ms", "result");
+    bool flashed = true;
+    for (uint32_t i = 0; i < count; i++) {
+        const esp_loader_gang_result_t &result = gang[i].result;
+        printf("%-14s %8u %8u %9u %9u %9u %9u  %s %s\n", gang[i].name, result.attempts, result.transmission_rate,
+               result.erase_time_ms, result.write_time_ms, result.verify_time_ms, result.total_time_ms,
+               result.error == ESP_LOADER_SUCCESS ? "ok" : "failed in",
+               result.error == ESP_LOADER_SUCCESS ? "" : esp_loader_gang_step_name(result.step));
+
+        if (result.error == ESP_LOADER_SUCCESS) {
+            for (const auto &image : images) {
+                const uint8_t *data = (const uint8_t *)image.data;
+                const vector<uint8_t> &flash = target_sim_flash(devices[i]->sim);
+                flashed = flashed && equal(data, data + image.size, flash.begin() + image.offset);
+            }
+        }
+    }
+
+    printf("\n%u of %u devices flashed in %u ms wall time, %u ms one after another, %u retries\n",
+           report.succeeded, report.devices, report.wall_time_ms, report.device_time_ms, report.retries);
+
+    // The faulty targets are retried, the dead one fails to connect on every attempt
+    const esp_loader_gang_result_t &dead = gang[count - 1].result;
+    if (err != ESP_LOADER_ERROR_FAIL || report.failed != 1 || dead.step != ESP_LOADER_GANG_CONNECT ||
+            dead.attempts != 2 || gang[1].result.attempts != 2 || gang[2].result.attempts != 2 ||
+            report.retries != 3 || !flashed) {
+        printf("Gang programming failed\n");
+        return EXIT_FAILURE;
+    }
+
+    // Flashing at the same time has to pay off against one after another
+    if (report.wall_time_ms * 2 > report.device_time_ms) {
+        printf("Devices were not flashed in parallel\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
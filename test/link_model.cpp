@@ -0,0 +1,412 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "link_model.h"
+#include <time.h>
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+
+const uint8_t SLIP_END = 0xC0;
+const uint8_t SLIP_ESC = 0xDB;
+const uint8_t SLIP_ESC_END = 0xDC;
+const size_t COMMAND_HEADER_SIZE = 8;
+const size_t FRAME_HEAD_SIZE = 24;  // Enough for the command header and the flash begin sizes
+const uint64_t OHAI_FRAME = 0xC04F484149C0; // Sent by the stub once it runs
+
+const uint8_t CMD_FLASH_BEGIN = 0x02;
+const uint8_t CMD_FLASH_DATA = 0x03;
+const uint8_t CMD_CHANGE_BAUDRATE = 0x0F;
+const uint8_t CMD_FLASH_DEFL_BEGIN = 0x10;
+const uint8_t CMD_FLASH_DEFL_DATA = 0x11;
+const uint8_t CMD_SPI_FLASH_MD5 = 0x13;
+const uint8_t CMD_ERASE_FLASH = 0xD0;
+const uint8_t CMD_ERASE_REGION = 0xD1;
+const uint32_t SECTOR_SIZE = 4096;
+
+uint32_t read_u32(const uint8_t *data)
+{
+    return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+uint64_t thread_cpu_ns()
+{
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+}
+
+struct link_model_t {
+    const esp_loader_port_t *inner;
+    void *inner_context;
+    link_model_config_t config;
+    link_model_stats_t stats = {};
+
+    uint64_t now_ns = 0;
+    uint64_t deadline_ns = 0;
+    uint64_t rx_free_ns = 0;        // When the last byte to the host has left the target
+    uint64_t target_free_ns = 0;    // When the target is done with what it has received
+
+    // Frame being sent by the host
+    vector<uint8_t> frame_head;
+    bool escape = false;
+
+    // Bytes to the host and when each becomes readable
+    deque<uint8_t> rx_data;
+    deque<uint64_t> rx_ready_ns;
+    uint64_t rx_last_bytes = 0;
+
+    // Rate of the target, 0 while it follows the host as the ROM loader does after a reset
+    uint32_t target_baud = 0;
+    uint32_t next_target_baud = 0;  // Taken once the acknowledgement has been sent
+
+    // The stub erases as it writes
+    bool stub = false;
+    uint64_t erase_pending_ns = 0;
+    uint64_t erase_per_block_ns = 0;
+};
+
+namespace
+{
+
+uint64_t byte_ns(const link_model_t *link)
+{
+    return link->config.byte_ns != 0 ? link->config.byte_ns : 10 * 1000000000ull / link->config.baud;
+}
+
+bool rates_differ(const link_model_t *link)
+{
+    return link->target_baud != 0 && link->target_baud != link->config.baud;
+}
+
+uint64_t erase_ns(const link_model_t *link, uint32_t size)
+{
+    return (size + SECTOR_SIZE - 1) / SECTOR_SIZE * link->config.erase_ms_per_sector * 1e6;
+}
+
+uint64_t processing_ns(link_model_t *link, const vector<uint8_t> &head)
+{
+    const link_model_config_t &config = link->config;
+    const uint8_t command = head[1];
+
+    if (command == CMD_CHANGE_BAUDRATE && head.size() >= 12) {
+        link->next_target_baud = read_u32(&head[8]);
+    } else if ((command == CMD_FLASH_BEGIN || command == CMD_FLASH_DEFL_BEGIN) && head.size() >= 24) {
+        // The ROM erases the whole region first, the stub erases ahead of each block it writes
+        if (!link->stub) {
+            return erase_ns(link, read_u32(&head[8]));
+        }
+        link->erase_pending_ns = erase_ns(link, read_u32(&head[8]));
+        link->erase_per_block_ns = erase_ns(link, read_u32(&head[16]));
+    } else if (command == CMD_FLASH_DATA || command == CMD_FLASH_DEFL_DATA) {
+        const uint64_t erase = min(link->erase_pending_ns, link->erase_per_block_ns);
+        link->erase_pending_ns -= erase;
+        return config.write_ms_per_block * 1e6 + erase;
+    } else if (command == CMD_ERASE_REGION && head.size() >= 16) {
+        return erase_ns(link, read_u32(&head[12]));
+    } else if (command == CMD_ERASE_FLASH) {
+        return erase_ns(link, config.flash_size);
+    } else if (command == CMD_SPI_FLASH_MD5 && head.size() >= 16) {
+        return read_u32(&head[12]) / 1024.0 * config.md5_us_per_kb * 1000;
+    }
+
+    return config.command_us * 1000ull;
+}
+
+// A frame has reached the target, which handles it after whatever it is busy with
+void frame_arrived(link_model_t *link, uint64_t arrival_ns)
+{
+    uint64_t start_ns = max(arrival_ns, link->target_free_ns);
+
+    // Commands have a request direction byte, other frames are flash read acknowledgements
+    if (link->frame_head.size() >= COMMAND_HEADER_SIZE && link->frame_head[0] == 0x00) {
+        link->stats.commands++;
+        start_ns += link->config.turnaround_us * 1000ull + processing_ns(link, link->frame_head);
+    }
+
+    link->target_free_ns = start_ns;
+    link->frame_head.clear();
+}
+
+void decode(link_model_t *link, uint8_t byte, uint64_t arrival_ns)
+{
+    // Frames start and end with END, so an END after any data completes a frame
+    if (byte == SLIP_END) {
+        if (!link->frame_head.empty()) {
+            frame_arrived(link, arrival_ns);
+        }
+        return;
+    }
+
+    if (link->escape) {
+        byte = byte == SLIP_ESC_END ? SLIP_END : SLIP_ESC;
+        link->escape = false;
+    } else if (byte == SLIP_ESC) {
+        link->escape = true;
+        return;
+    }
+
+    if (link->frame_head.size() < FRAME_HEAD_SIZE) {
+        link->frame_head.push_back(byte);
+    }
+}
+
+// Takes whatever the wrapped port has to send and schedules it on the line to the host
+void pull(link_model_t *link)
+{
+    const esp_loader_port_t *inner = link->inner;
+    const uint64_t cpu_start = thread_cpu_ns();
+
+    uint8_t buffer[1024];
+    while (true) {
+        uint16_t received = 0;
+        if (inner->read_some != NULL) {
+            if (inner->read_some(link->inner_context, buffer, sizeof(buffer), 0, &received) != ESP_LOADER_SUCCESS) {
+                break;
+            }
+        } else if (inner->read(link->inner_context, buffer, 1, 0) == ESP_LOADER_SUCCESS) {
+            received = 1;
+        } else {
+            break;
+        }
+
+        // Lost while the two ends disagree on the rate
+        if (rates_differ(link)) {
+            continue;
+        }
+
+        const uint64_t frame_ns = link->config.usb_frame_us * 1000ull;
+        for (uint16_t i = 0; i < received; i++) {
+            link->rx_free_ns = max(link->rx_free_ns, link->target_free_ns) + byte_ns(link);
+            const uint64_t arrival_ns = link->rx_free_ns + link->config.latency_us * 1000ull;
+            const uint64_t ready_ns = frame_ns != 0 ? (arrival_ns + frame_ns - 1) / frame_ns * frame_ns : arrival_ns;
+            link->rx_data.push_back(buffer[i]);
+            link->rx_ready_ns.push_back(ready_ns);
+
+            link->rx_last_bytes = (link->rx_last_bytes << 8 | buffer[i]) & 0xFFFFFFFFFFFF;
+            link->stub |= link->rx_last_bytes == OHAI_FRAME;
+        }
+        link->stats.rx_bytes += received;
+    }
+
+    if (link->next_target_baud != 0) {
+        link->target_baud = link->next_target_baud;
+        link->next_target_baud = 0;
+    }
+
+    link->stats.inner_cpu_ns += thread_cpu_ns() - cpu_start;
+}
+
+esp_loader_error_t port_write(void *context, const uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    link_model_t *link = (link_model_t *)context;
+
+    // The host waits until its bytes are on the wire
+    const uint64_t latency_ns = link->config.latency_us * 1000ull;
+    const bool garbled = rates_differ(link);
+    for (uint16_t i = 0; i < size; i++) {
+        link->now_ns += byte_ns(link);
+        if (!garbled) {
+            decode(link, data[i], link->now_ns + latency_ns);
+        }
+    }
+    link->stats.tx_bytes += size;
+
+    // The target cannot make sense of bytes at another rate
+    if (garbled) {
+        return ESP_LOADER_SUCCESS;
+    }
+
+    const uint64_t cpu_start = thread_cpu_ns();
+    const esp_loader_error_t err = link->inner->write(link->inner_context, data, size, timeout);
+    link->stats.inner_cpu_ns += thread_cpu_ns() - cpu_start;
+
+    pull(link);
+    return err;
+}
+
+esp_loader_error_t port_read_some(void *context, uint8_t *data, uint16_t size, uint32_t timeout,
+                                  uint16_t *received)
+{
+    link_model_t *link = (link_model_t *)context;
+    const uint64_t timeout_ns = timeout * 1000000ull;
+
+    *received = 0;
+    if (link->rx_data.empty()) {
+        pull(link);
+    }
+    if (link->rx_data.empty() || link->rx_ready_ns.front() > link->now_ns + timeout_ns) {
+        link->now_ns += timeout_ns;
+        link->stats.timeouts++;
+        return ESP_LOADER_ERROR_TIMEOUT;
+    }
+
+    link->now_ns = max(link->now_ns, link->rx_ready_ns.front());
+    while (*received < size && !link->rx_data.empty() && link->rx_ready_ns.front() <= link->now_ns) {
+        data[(*received)++] = link->rx_data.front();
+        link->rx_data.pop_front();
+        link->rx_ready_ns.pop_front();
+    }
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t port_read(void *context, uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    link_model_t *link = (link_model_t *)context;
+    const uint64_t deadline_ns = link->now_ns + timeout * 1000000ull;
+
+    while (size > 0) {
+        const uint32_t remaining = deadline_ns > link->now_ns ? (deadline_ns - link->now_ns) / 1000000 : 0;
+        uint16_t received;
+        const esp_loader_error_t err = port_read_some(context, data, size, remaining, &received);
+        if (err != ESP_LOADER_SUCCESS) {
+            return err;
+        }
+        data += received;
+        size -= received;
+    }
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t port_change_transmission_rate(void *context, uint32_t transmission_rate)
+{
+    link_model_t *link = (link_model_t *)context;
+
+    if (link->inner->change_transmission_rate != NULL) {
+        RETURN_ON_ERROR( link->inner->change_transmission_rate(link->inner_context, transmission_rate) );
+    }
+    link->config.baud = transmission_rate;
+    return ESP_LOADER_SUCCESS;
+}
+
+void port_delay_ms(void *context, uint32_t ms)
+{
+    ((link_model_t *)context)->now_ns += ms * 1000000ull;
+}
+
+void port_start_timer(void *context, uint32_t ms)
+{
+    link_model_t *link = (link_model_t *)context;
+    link->deadline_ns = link->now_ns + ms * 1000000ull;
+}
+
+uint32_t port_remaining_time(void *context)
+{
+    const link_model_t *link = (const link_model_t *)context;
+    return link->deadline_ns > link->now_ns ? (link->deadline_ns - link->now_ns) / 1000000 : 0;
+}
+
+// A reset drops whatever is on the way and leaves the target idle
+void reset_link(link_model_t *link)
+{
+    link->rx_data.clear();
+    link->rx_ready_ns.clear();
+    link->frame_head.clear();
+    link->escape = false;
+    link->rx_free_ns = link->now_ns;
+    link->target_free_ns = link->now_ns;
+    link->rx_last_bytes = 0;
+    link->target_baud = 0;
+    link->next_target_baud = 0;
+    link->stub = false;
+    link->erase_pending_ns = 0;
+}
+
+void port_enter_bootloader(void *context)
+{
+    link_model_t *link = (link_model_t *)context;
+    link->inner->enter_bootloader(link->inner_context);
+    reset_link(link);
+}
+
+void port_reset_target(void *context)
+{
+    link_model_t *link = (link_model_t *)context;
+    link->inner->reset_target(link->inner_context);
+    reset_link(link);
+}
+
+void port_debug_print(void *context, const char *str)
+{
+    link_model_t *link = (link_model_t *)context;
+    if (link->inner->debug_print != NULL) {
+        link->inner->debug_print(link->inner_context, str);
+    }
+}
+
+uint32_t port_get_time_ms(void *context)
+{
+    return ((link_model_t *)context)->now_ns / 1000000;
+}
+
+esp_loader_port_t make_port()
+{
+    esp_loader_port_t port = {};
+    port.write = port_write;
+    port.read = port_read;
+    port.change_transmission_rate = port_change_transmission_rate;
+    port.read_some = port_read_some;
+    port.delay_ms = port_delay_ms;
+    port.start_timer = port_start_timer;
+    port.remaining_time = port_remaining_time;
+    port.enter_bootloader = port_enter_bootloader;
+    port.reset_target = port_reset_target;
+    port.debug_print = port_debug_print;
+    port.get_time_ms = port_get_time_ms;
+    return port;
+}
+
+}
+
+const esp_loader_port_t link_model_port = make_port();
+
+link_model_t *link_model_create(const esp_loader_port_t *inner, void *inner_context,
+                                const link_model_config_t &config)
+{
+    link_model_t *link = new link_model_t;
+    link->inner = inner;
+    link->inner_context = inner_context;
+    link->config = config;
+    return link;
+}
+
+void link_model_destroy(link_model_t *link)
+{
+    delete link;
+}
+
+link_model_stats_t link_model_stats(const link_model_t *link)
+{
+    link_model_stats_t stats = link->stats;
+    stats.time_us = link->now_ns / 1000;
+    return stats;
+}
+
+link_model_config_t link_model_config(const link_model_t *link)
+{
+    return link->config;
+}
+
+void link_model_set_config(link_model_t *link, const link_model_config_t &config)
+{
+    link->config = config;
+}
@@ -0,0 +1,75 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Serial link model, for builds with SERIAL_FLASHER_INTERFACE_UART or SERIAL_FLASHER_INTERFACE_USB.
+ *
+ * The model is a port that wraps another one, usually an in-process target such as
+ * target_sim_port, and runs everything on a virtual clock. Bytes take their time on the wire in
+ * each direction, the target starts on a command after a turnaround delay and takes a processing
+ * time that depends on the command: erases by the sector, flash data commands by the block, MD5
+ * digests by the size of the region and other commands a fixed time. Once the stub has announced
+ * itself, the erase of a flash begin command is spread over the data commands, as the stub erases
+ * as it writes. The model finds the commands by decoding the SLIP frames the host sends.
+ * Responses become readable once their last byte would have arrived, with a USB link only at the
+ * following frame boundary. The target changes its rate with the CHANGE_BAUDRATE command, after
+ * acknowledging it at the old rate, and bytes sent while the two ends disagree on the rate are
+ * lost.
+ *
+ * Delays, timers and timeouts advance the virtual clock instead of sleeping, so flashing megabytes
+ * at 115200 baud takes milliseconds of wall time and gives the same timings on every run. */
+
+#pragma once
+
+#include "esp_loader_io.h"
+#include <stdint.h>
+
+struct link_model_t;
+
+struct link_model_config_t {
+    uint32_t baud = 115200;             // Changed by the transmission rate of the port
+    uint32_t byte_ns = 0;               // Time of a byte on the wire, 0 for 10 bits at the baud rate
+    uint32_t usb_frame_us = 0;          // Received bytes reach the host at frame boundaries, 0 for none
+    uint32_t latency_us = 0;            // Added to the way of every byte, in both directions
+    uint32_t turnaround_us = 0;         // From a command arriving to the target starting on it
+    uint32_t command_us = 50;           // Processing of commands without flash operations
+    double erase_ms_per_sector = 10;    // Per 4 KB sector erased
+    double write_ms_per_block = 1;      // Per flash data command, compressed or not
+    uint32_t md5_us_per_kb = 50;        // Flash read and hashing of MD5 commands
+    uint32_t flash_size = 4 * 1024 * 1024;  // Erased by the erase flash command
+};
+
+struct link_model_stats_t {
+    uint64_t tx_bytes;          // Bytes from the host
+    uint64_t rx_bytes;          // Bytes to the host
+    uint32_t commands;          // Commands sent by the host
+    uint32_t timeouts;          // Reads that timed out
+    uint64_t time_us;           // Virtual time
+    uint64_t inner_cpu_ns;      // CPU time spent in the functions of the wrapped port
+};
+
+/* Wraps the port, which is given inner_context. The wrapped port is only asked to write, read
+   without waiting, change its rate, reset the target and print, its timers are not used. */
+link_model_t *link_model_create(const esp_loader_port_t *inner, void *inner_context,
+                                const link_model_config_t &config = link_model_config_t());
+void link_model_destroy(link_model_t *link);
+
+// The parameters of the link, which can be changed at any time to take effect from then on
+link_model_config_t link_model_config(const link_model_t *link);
+void link_model_set_config(link_model_t *link, const link_model_config_t &config);
+
+link_model_stats_t link_model_stats(const link_model_t *link);
+
+// Port with the link model as its context
+extern const esp_loader_port_t link_model_port;
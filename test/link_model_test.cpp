@@ -0,0 +1,187 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "catch.hpp"
+#include "link_model.h"
+#include "target_sim.h"
+#include "esp_loader.h"
+#include <chrono>
+#include <vector>
+
+using namespace std;
+using namespace std::chrono;
+
+#define ESP_ERR_CHECK(exp) REQUIRE( (exp) == ESP_LOADER_SUCCESS )
+
+namespace
+{
+
+const uint32_t APP_ADDRESS = 0x10000;
+
+// A target that never answers
+esp_loader_error_t dead_write(void *context, const uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t dead_read(void *context, uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    return ESP_LOADER_ERROR_TIMEOUT;
+}
+
+void dead_reset(void *context)
+{
+}
+
+esp_loader_port_t make_dead_port()
+{
+    esp_loader_port_t port = {};
+    port.write = dead_write;
+    port.read = dead_read;
+    port.enter_bootloader = dead_reset;
+    port.reset_target = dead_reset;
+    return port;
+}
+
+// Flashes the image uncompressed through the link, returns the virtual time taken in ms
+uint64_t flash_through(link_model_t *link, const vector<uint8_t> &image, uint32_t block_size)
+{
+    esp_loader_t *loader = esp_loader_create(&link_model_port, link);
+    REQUIRE( loader != NULL );
+    esp_loader_select(loader);
+
+    esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+    ESP_ERR_CHECK( esp_loader_connect_with_stub(&connect_config) );
+
+    const uint64_t start_us = link_model_stats(link).time_us;
+    ESP_ERR_CHECK( esp_loader_flash_start(APP_ADDRESS, image.size(), block_size) );
+    for (size_t offset = 0; offset < image.size(); offset += block_size) {
+        ESP_ERR_CHECK( esp_loader_flash_write((void *)&image[offset], min<size_t>(block_size, image.size() - offset)) );
+    }
+    ESP_ERR_CHECK( esp_loader_flash_verify() );
+    const uint64_t elapsed_us = link_model_stats(link).time_us - start_us;
+
+    esp_loader_select(NULL);
+    esp_loader_destroy(loader);
+    return elapsed_us / 1000;
+}
+
+}
+
+TEST_CASE( "Link model flashes megabytes at 115200 baud in virtual time" )
+{
+    target_sim_t *sim = target_sim_create();
+    const vector<uint8_t> image(1024 * 1024, 0xA5);
+    link_model_config_t config;
+    config.erase_ms_per_sector = 0;
+    config.write_ms_per_block = 0;
+    config.md5_us_per_kb = 0;
+    link_model_t *link = link_model_create(&target_sim_port, sim, config);
+
+    const auto wall_start = steady_clock::now();
+    const uint64_t elapsed_ms = flash_through(link, image, 16384);
+
+    // 10 bits per byte on the wire, with little more than the image to send
+    const uint64_t wire_ms = image.size() * 10 * 1000 / 115200;
+    REQUIRE( elapsed_ms >= wire_ms );
+    REQUIRE( elapsed_ms < wire_ms * 11 / 10 );
+    REQUIRE( steady_clock::now() - wall_start < seconds(5) );
+    REQUIRE( equal(image.begin(), image.end(), target_sim_flash(sim).begin() + APP_ADDRESS) );
+
+    link_model_destroy(link);
+    target_sim_destroy(sim);
+}
+
+TEST_CASE( "Link model charges target processing by command" )
+{
+    target_sim_t *sim = target_sim_create();
+    const vector<uint8_t> image(64 * 1024, 0x5A);
+    link_model_config_t config;
+    config.baud = 2000000;
+    config.erase_ms_per_sector = 50;
+    config.write_ms_per_block = 10;
+    config.turnaround_us = 1000;
+    config.usb_frame_us = 1000;
+    link_model_t *link = link_model_create(&target_sim_port, sim, config);
+
+    /* The image on the wire, 16 sectors erased by the stub as it writes the 16 blocks, a
+       turnaround for each of the 18 commands. Headers, responses, the MD5 digest and up to a
+       USB frame for each response come on top. */
+    const uint64_t expected_ms = image.size() * 10 * 1000 / 2000000 + 16 * 50 + 16 * 10 + 18;
+    const uint64_t elapsed_ms = flash_through(link, image, 4096);
+    REQUIRE( elapsed_ms >= expected_ms );
+    REQUIRE( elapsed_ms < expected_ms + 40 );
+
+    link_model_destroy(link);
+    target_sim_destroy(sim);
+}
+
+TEST_CASE( "Link model times out on the virtual clock" )
+{
+    const esp_loader_port_t dead_port = make_dead_port();
+    link_model_t *link = link_model_create(&dead_port, NULL);
+
+    esp_loader_t *loader = esp_loader_create(&link_model_port, link);
+    REQUIRE( loader != NULL );
+    esp_loader_select(loader);
+
+    const auto wall_start = steady_clock::now();
+    esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+    REQUIRE( esp_loader_connect(&connect_config) == ESP_LOADER_ERROR_TIMEOUT );
+
+    // Every trial waits out its sync timeout, none of it in real time
+    const link_model_stats_t stats = link_model_stats(link);
+    REQUIRE( stats.timeouts >= connect_config.trials );
+    REQUIRE( stats.time_us >= (uint64_t)connect_config.trials * connect_config.sync_timeout * 1000 );
+    REQUIRE( steady_clock::now() - wall_start < seconds(1) );
+
+    esp_loader_select(NULL);
+    esp_loader_destroy(loader);
+    link_model_destroy(link);
+}
+
+TEST_CASE( "Link model loses bytes while the two ends disagree on the rate" )
+{
+    target_sim_t *sim = target_sim_create();
+    link_model_config_t config;
+    config.latency_us = 2000;
+    link_model_t *link = link_model_create(&target_sim_port, sim, config);
+
+    esp_loader_t *loader = esp_loader_create(&link_model_port, link);
+    REQUIRE( loader != NULL );
+    esp_loader_select(loader);
+
+    esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+    ESP_ERR_CHECK( esp_loader_connect_with_stub(&connect_config) );
+
+    // A command and its response each take the latency on top of their time on the wire
+    uint32_t reg_value;
+    const uint64_t start_us = link_model_stats(link).time_us;
+    ESP_ERR_CHECK( esp_loader_read_register(0x40001000, &reg_value) );
+    REQUIRE( link_model_stats(link).time_us - start_us >= 2 * config.latency_us );
+
+    // The target acknowledges at the old rate, then only understands the new one
+    ESP_ERR_CHECK( esp_loader_change_transmission_rate_stub(115200, 921600) );
+    REQUIRE( target_sim_transmission_rate(sim) == 921600 );
+    REQUIRE( esp_loader_read_register(0x40001000, &reg_value) == ESP_LOADER_ERROR_TIMEOUT );
+
+    ESP_ERR_CHECK( link_model_port.change_transmission_rate(link, 921600) );
+    ESP_ERR_CHECK( esp_loader_read_register(0x40001000, &reg_value) );
+
+    esp_loader_select(NULL);
+    esp_loader_destroy(loader);
+    link_model_destroy(link);
+    target_sim_destroy(sim);
+}
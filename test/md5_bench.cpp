@@ -0,0 +1,84 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Throughput benchmark of MD5Update().
+ *
+ * The same data is hashed in updates of several sizes, from an aligned and from an unaligned
+ * buffer, as flash writes and stub reads do. All of the variants have to give the same digest. */
+
+#include "md5_hash.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    const size_t size = 4 * 1024 * 1024;
+    const unsigned rounds = argc > 1 ? strtoul(argv[1], NULL, 0) : 8;
+
+    // One spare byte in front gives the unaligned copy
+    vector<uint32_t> storage(size / 4 + 2);
+    uint8_t *aligned = (uint8_t *)&storage[0];
+    uint8_t *unaligned = aligned + 5;
+    mt19937 generator(5);
+    for (size_t i = 0; i < size; i++) {
+        aligned[i] = generator() & 0xFF;
+    }
+    memmove(unaligned, aligned, size);
+
+    uint8_t expected[16];
+    bool first = true;
+    bool identical = true;
+
+    printf("%-10s %8s %10s\n", "buffer", "update", "MB/s");
+
+    for (bool is_aligned : { true, false }) {
+        const uint8_t *data = is_aligned ? aligned : unaligned;
+        if (!is_aligned) {
+            memmove(unaligned, aligned, size);
+        }
+
+        for (size_t update : { 64, 256, 1000, 4096, 16384 }) {
+            uint8_t digest[16];
+            const auto start = chrono::steady_clock::now();
+            for (unsigned round = 0; round < rounds; round++) {
+                struct MD5Context context;
+                MD5Init(&context);
+                for (size_t offset = 0; offset < size; offset += update) {
+                    MD5Update(&context, &data[offset], min(update, size - offset));
+                }
+                MD5Final(digest, &context);
+            }
+            const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+            if (first) {
+                memcpy(expected, digest, sizeof(expected));
+                first = false;
+            } else if (memcmp(expected, digest, sizeof(expected)) != 0) {
+                identical = false;
+                printf("%-10s %8zu digest differs\n", is_aligned ? "aligned" : "unaligned", update);
+            }
+            printf("%-10s %8zu %10.0f\n", is_aligned ? "aligned" : "unaligned", update,
+                   size * rounds / elapsed.count() / 1e6);
+        }
+    }
+
+    return identical ? EXIT_SUCCESS : EXIT_FAILURE;
+}
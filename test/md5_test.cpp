@@ -0,0 +1,109 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "catch.hpp"
+#include "md5_hash.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+
+string to_hex(const uint8_t digest[16])
+{
+    char hex[33];
+    for (int i = 0; i < 16; i++) {
+        snprintf(&hex[2 * i], 3, "%02x", digest[i]);
+    }
+    return hex;
+}
+
+string md5(const uint8_t *data, size_t size)
+{
+    uint8_t digest[16];
+    struct MD5Context context;
+    MD5Init(&context);
+    MD5Update(&context, data, size);
+    MD5Final(digest, &context);
+    return to_hex(digest);
+}
+
+string md5(const string &text)
+{
+    return md5((const uint8_t *)text.data(), text.size());
+}
+
+}
+
+TEST_CASE( "MD5 matches the RFC 1321 test suite" )
+{
+    REQUIRE( md5("") == "d41d8cd98f00b204e9800998ecf8427e" );
+    REQUIRE( md5("a") == "0cc175b9c0f1b6a831c399e269772661" );
+    REQUIRE( md5("abc") == "900150983cd24fb0d6963f7d28e17f72" );
+    REQUIRE( md5("message digest") == "f96b697d7cb7938d525a2f31aaf161d0" );
+    REQUIRE( md5("abcdefghijklmnopqrstuvwxyz") == "c3fcd3d76192e4007dfb496cca67e13b" );
+    REQUIRE( md5("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789") ==
+             "d174ab98d277d9f5a5611c2c9f419d9f" );
+    REQUIRE( md5("12345678901234567890123456789012345678901234567890123456789012345678901234567890") ==
+             "57edf4a22be3c955ac49da2e2107b67a" );
+}
+
+TEST_CASE( "MD5 matches the previous implementation for any size, split and alignment" )
+{
+    vector<uint8_t> buffer(4100);
+    for (size_t i = 0; i < 4000; i++) {
+        buffer[i] = (uint8_t)(i * 7 + 3);
+    }
+
+    // Digest of the digests of the first 0 to 300 bytes, as computed by the reference
+    // implementation this one replaced. It covers every padding case of MD5Final().
+    for (size_t offset = 0; offset < 4; offset++) {
+        INFO( "offset " << offset );
+        if (offset != 0) {
+            memmove(&buffer[offset], &buffer[offset - 1], 4000);
+        }
+        const uint8_t *data = &buffer[offset];
+
+        struct MD5Context all;
+        MD5Init(&all);
+        for (size_t size = 0; size <= 300; size++) {
+            uint8_t digest[16];
+            struct MD5Context context;
+            MD5Init(&context);
+            MD5Update(&context, data, size);
+            MD5Final(digest, &context);
+            MD5Update(&all, digest, sizeof(digest));
+        }
+        uint8_t digest[16];
+        MD5Final(digest, &all);
+        REQUIRE( to_hex(digest) == "bbc8219ce2f09cb1b1235ce3b7ef018c" );
+
+        // Updates that leave data buffered in the context, then whole blocks from odd addresses
+        for (size_t split : { 1, 3, 63, 64, 65, 1000 }) {
+            INFO( "split " << split );
+            struct MD5Context context;
+            MD5Init(&context);
+            for (size_t done = 0; done < 4000; done += split) {
+                MD5Update(&context, &data[done], min(split, 4000 - done));
+            }
+            MD5Final(digest, &context);
+            REQUIRE( to_hex(digest) == "c57ef237fd76a26b7a47338894496cac" );
+        }
+    }
+}
@@ -0,0 +1,44 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Stand-in for pigpio, so that the Raspberry Pi port builds on any host for the port benchmark.
+   The GPIOs do nothing, only the serial port is measured. */
+
+#pragma once
+
+#define PI_OUTPUT 1
+
+static inline int gpioInitialise(void)
+{
+    return 0;
+}
+
+static inline void gpioTerminate(void)
+{
+}
+
+static inline int gpioSetMode(unsigned gpio, unsigned mode)
+{
+    (void)gpio;
+    (void)mode;
+    return 0;
+}
+
+static inline int gpioWrite(unsigned gpio, unsigned level)
+{
+    (void)gpio;
+    (void)level;
+    return 0;
+}
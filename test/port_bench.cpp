@@ -0,0 +1,188 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host serial port benchmark, built once with the Linux port and once with the Raspberry Pi one.
+ *
+ * The port opens the slave side of a pseudo-terminal and a thread echoes everything written to it
+ * back from the master side. Blocks are written and read back with loader_port_read_some(), as the
+ * SLIP receive path does, and with loader_port_read(), as the response headers are. The result is
+ * the CPU time the port spends in the calling thread per MB, which is what a gang of targets driven
+ * from one host adds up. The port timers and clock are checked against a sleep. */
+
+#include "esp_loader_io.h"
+#if PORT_BENCH_LINUX
+#include "linux_port.h"
+#else
+#include "raspberry_port.h"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace std;
+
+#define BLOCK_SIZE 2048
+
+static atomic<bool> s_stop(false);
+
+static void echo_run(int master)
+{
+    vector<uint8_t> buffer(BLOCK_SIZE);
+
+    while (!s_stop) {
+        struct pollfd request = { master, POLLIN, 0 };
+        if (poll(&request, 1, 10) <= 0) {
+            continue;
+        }
+
+        const ssize_t received = read(master, buffer.data(), buffer.size());
+        for (ssize_t sent = 0; sent < received; ) {
+            const ssize_t written = write(master, &buffer[sent], received - sent);
+            if (written > 0) {
+                sent += written;
+            }
+        }
+    }
+}
+
+static double thread_cpu_seconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Writes the data in blocks and reads every block back, returns false on errors or differences
+static bool loopback(const vector<uint8_t> &data, bool read_some, double &cpu, double &wall)
+{
+    vector<uint8_t> received(BLOCK_SIZE);
+    bool identical = true;
+
+    const auto start = chrono::steady_clock::now();
+    const double cpu_start = thread_cpu_seconds();
+
+    for (size_t offset = 0; offset < data.size(); offset += BLOCK_SIZE) {
+        const uint16_t size = min((size_t)BLOCK_SIZE, data.size() - offset);
+        if (loader_port_write(&data[offset], size, 1000) != ESP_LOADER_SUCCESS) {
+            return false;
+        }
+
+        if (read_some) {
+            for (uint16_t filled = 0; filled < size; ) {
+                uint16_t chunk;
+                if (loader_port_read_some(&received[filled], size - filled, 1000, &chunk) != ESP_LOADER_SUCCESS) {
+                    return false;
+                }
+                filled += chunk;
+            }
+        } else {
+            loader_port_start_timer(1000);
+            if (loader_port_read(received.data(), size, 1000) != ESP_LOADER_SUCCESS) {
+                return false;
+            }
+        }
+
+        identical &= memcmp(received.data(), &data[offset], size) == 0;
+    }
+
+    cpu = thread_cpu_seconds() - cpu_start;
+    wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return identical;
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t size = argc > 1 ? strtoul(argv[1], NULL, 0) : 4 * 1024 * 1024;
+
+    const int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        printf("Pseudo-terminal could not be created\n");
+        return 1;
+    }
+
+#if PORT_BENCH_LINUX
+    const char *name = "linux";
+    const loader_linux_config_t config = { ptsname(master), 115200 };
+    if (loader_port_linux_init(&config) != ESP_LOADER_SUCCESS) {
+        return 1;
+    }
+#else
+    const char *name = "raspberry";
+    const loader_raspberry_config_t config = { ptsname(master), 115200, 0, 0 };
+    if (loader_port_raspberry_init(&config) != ESP_LOADER_SUCCESS) {
+        return 1;
+    }
+#endif
+
+    thread echo(echo_run, master);
+
+    vector<uint8_t> data(size);
+    mt19937 generator(19);
+    for (auto &byte : data) {
+        byte = generator() & 0xFF;
+    }
+
+    bool success = true;
+
+    printf("%-10s %-10s %12s %10s\n", "port", "read", "CPU ms/MB", "MB/s");
+    for (bool read_some : { true, false }) {
+        double cpu = 0, wall = 0;
+        if (!loopback(data, read_some, cpu, wall)) {
+            printf("%-10s %-10s loopback failed\n", name, read_some ? "read_some" : "read");
+            success = false;
+            continue;
+        }
+        printf("%-10s %-10s %12.1f %10.2f\n", name, read_some ? "read_some" : "read",
+               cpu * 1e3 / (size / 1e6), size / wall / 1e6);
+    }
+
+    // Timers and the clock have to advance while the thread sleeps, not only while it runs
+    const uint32_t start_ms = loader_port_get_time_ms();
+    loader_port_start_timer(100);
+    loader_port_delay_ms(200);
+    const uint32_t remaining = loader_port_remaining_time();
+    const uint32_t slept_ms = loader_port_get_time_ms() - start_ms;
+    printf("Remaining time of a 100 ms timer after sleeping 200 ms: %u ms, clock advanced %u ms\n",
+           remaining, slept_ms);
+    if (remaining != 0 || slept_ms < 200) {
+        success = false;
+    }
+
+    const bool custom_rate = loader_port_change_transmission_rate(1234567) == ESP_LOADER_SUCCESS;
+    printf("Non-standard rate 1234567: %s\n", custom_rate ? "accepted" : "rejected");
+
+#if PORT_BENCH_LINUX
+    if (!custom_rate) {
+        success = false;
+    }
+#endif
+
+    s_stop = true;
+    echo.join();
+    loader_port_deinit();
+    close(master);
+
+    return success ? 0 : 1;
+}
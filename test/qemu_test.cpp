@@ -17,6 +17,8 @@
 #include "test_port.h"
 #include "esp_loader.h"
 #include "esp_loader_io.h"
+#include "md5_hash.h"
+#include <zlib.h>
 #include <algorithm>
 #include <iostream>
 #include <fstream>
@@ -27,6 +29,9 @@ using namespace std;
 #define ESP_ERR_CHECK(exp) REQUIRE( (exp) == ESP_LOADER_SUCCESS )
 
 const uint32_t APP_START_ADDRESS = 0x10000;
+const uint32_t DEFLATE_APP_START_ADDRESS = 0x200000;
+const uint32_t PRECOMPRESSED_APP_START_ADDRESS = 0x300000;
+const uint32_t SOURCE_APP_START_ADDRESS = 0x380000;
 
 
 TEST_CASE( "Can connect " )
@@ -110,6 +115,141 @@ TEST_CASE( "Can write application to flash" )
     // NOTE: loader_flash_finish() is not called to prevent reset of target
 }
 
+TEST_CASE( "Can write compressed application to flash" )
+{
+    ifstream new_image;
+    ifstream qemu_image;
+
+    new_image.open ("../hello-world.bin", ios::binary | ios::in);
+    qemu_image.open ("empty_file.bin", ios::binary | ios::in);
+
+    REQUIRE ( new_image.is_open() );
+    REQUIRE ( qemu_image.is_open() );
+
+    auto new_image_size = file_size_is(new_image);
+    vector<uint8_t> image_data(new_image_size);
+    new_image.read((char *)&image_data[0], new_image_size);
+
+    ESP_ERR_CHECK( esp_loader_flash_deflate_start(DEFLATE_APP_START_ADDRESS, new_image_size,
+                   ESP_LOADER_DEFLATE_LEVEL_AUTO) );
+
+    // Odd sized chunks exercise the encoder buffering
+    const size_t chunk_size = 1000;
+    for (size_t written = 0; written < new_image_size; written += chunk_size) {
+        size_t to_write = min(chunk_size, new_image_size - written);
+        ESP_ERR_CHECK( esp_loader_flash_deflate_write(&image_data[written], to_write) );
+    }
+
+    esp_loader_flash_deflate_stats_t stats;
+    esp_loader_flash_deflate_get_stats(&stats);
+    REQUIRE ( stats.uncompressed_size == ((new_image_size + 3) & ~3U) );
+    REQUIRE ( stats.compressed_size < stats.uncompressed_size );
+
+    qemu_image.seekg(DEFLATE_APP_START_ADDRESS);
+    new_image.seekg(0);
+
+    REQUIRE ( file_compare(new_image, qemu_image, new_image_size) );
+
+    ESP_ERR_CHECK ( esp_loader_flash_verify() );
+
+    // NOTE: esp_loader_flash_deflate_finish() is not called to prevent reset of target
+}
+
+struct source_t {
+    ifstream *image;
+    uint32_t next_offset;
+};
+
+esp_loader_error_t read_source(void *context, uint32_t offset, void *buffer, uint32_t size)
+{
+    source_t *source = (source_t *)context;
+
+    // Blocks have to be requested in order, no larger than the library buffer
+    if (offset != source->next_offset || size > 1024) {
+        return ESP_LOADER_ERROR_FAIL;
+    }
+    source->next_offset += size;
+
+    source->image->read((char *)buffer, size);
+    return *source->image ? ESP_LOADER_SUCCESS : ESP_LOADER_ERROR_FAIL;
+}
+
+TEST_CASE( "Can write application to flash from a read callback" )
+{
+    ifstream new_image;
+    ifstream qemu_image;
+
+    new_image.open ("../hello-world.bin", ios::binary | ios::in);
+    qemu_image.open ("empty_file.bin", ios::binary | ios::in);
+
+    REQUIRE ( new_image.is_open() );
+    REQUIRE ( qemu_image.is_open() );
+
+    auto new_image_size = file_size_is(new_image);
+    source_t source = { &new_image, 0 };
+
+    // Verified by the library when MD5 is enabled
+    ESP_ERR_CHECK( esp_loader_flash_source(SOURCE_APP_START_ADDRESS, new_image_size, true, read_source, &source) );
+    REQUIRE ( source.next_offset == new_image_size );
+
+    qemu_image.seekg(SOURCE_APP_START_ADDRESS);
+    new_image.seekg(0);
+
+    REQUIRE ( file_compare(new_image, qemu_image, new_image_size) );
+}
+
+TEST_CASE( "Can write pre-compressed application to flash" )
+{
+    ifstream new_image;
+    ifstream qemu_image;
+
+    new_image.open ("../hello-world.bin", ios::binary | ios::in);
+    qemu_image.open ("empty_file.bin", ios::binary | ios::in);
+
+    REQUIRE ( new_image.is_open() );
+    REQUIRE ( qemu_image.is_open() );
+
+    // Mirror what bin2zlib.py does at build time: pad, hash and compress
+    auto new_image_size = file_size_is(new_image);
+    vector<uint8_t> image_data((new_image_size + 3) & ~3U, 0xFF);
+    new_image.read((char *)&image_data[0], new_image_size);
+
+    uint8_t image_md5[16];
+    struct MD5Context md5_context;
+    MD5Init(&md5_context);
+    MD5Update(&md5_context, &image_data[0], image_data.size());
+    MD5Final(image_md5, &md5_context);
+
+    uLongf compressed_size = compressBound(image_data.size());
+    vector<uint8_t> compressed(compressed_size);
+    REQUIRE ( compress2(&compressed[0], &compressed_size, &image_data[0],
+                        image_data.size(), Z_BEST_COMPRESSION) == Z_OK );
+
+    ESP_ERR_CHECK( esp_loader_flash_precompressed_start(PRECOMPRESSED_APP_START_ADDRESS,
+                   image_data.size(), compressed_size, image_md5) );
+
+    // Odd sized chunks exercise both the zero-copy and the staging path
+    const size_t chunk_size = 5000;
+    for (size_t written = 0; written < compressed_size; written += chunk_size) {
+        size_t to_write = min(chunk_size, (size_t)compressed_size - written);
+        ESP_ERR_CHECK( esp_loader_flash_precompressed_write(&compressed[written], to_write) );
+    }
+
+    esp_loader_flash_deflate_stats_t stats;
+    esp_loader_flash_deflate_get_stats(&stats);
+    REQUIRE ( stats.uncompressed_size == image_data.size() );
+    REQUIRE ( stats.compressed_size == compressed_size );
+
+    qemu_image.seekg(PRECOMPRESSED_APP_START_ADDRESS);
+    new_image.seekg(0);
+
+    REQUIRE ( file_compare(new_image, qemu_image, new_image_size) );
+
+    ESP_ERR_CHECK ( esp_loader_flash_verify() );
+
+    // NOTE: esp_loader_flash_deflate_finish() is not called to prevent reset of target
+}
+
 TEST_CASE( "Can write and read register" )
 {
     uint32_t reg_value = 0;
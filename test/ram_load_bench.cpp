@@ -0,0 +1,173 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Benchmark of loading a program to RAM over SPI or SDIO, against the slave simulator of the
+ * interface the library is built for.
+ *
+ * The image is loaded with a few block sizes. Time is the virtual time of the simulator, so the
+ * results depend only on the protocol: the throughput, the transactions and status polls the
+ * host spends per command, and the share of the bus time that is not image data. The benchmark
+ * fails if the RAM of the simulator does not hold the image afterwards, the program is not
+ * started at its entry point, or the slave saw a protocol error. */
+
+#include "esp_loader.h"
+#include "esp_loader_io.h"
+#ifdef SERIAL_FLASHER_INTERFACE_SPI
+#include "spi_slave_sim.h"
+#else
+#include "sdio_slave_sim.h"
+#endif
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+
+const uint32_t LOAD_ADDRESS = 0x40380000;
+
+struct result_t {
+    bool loaded;
+    uint64_t time_ns;
+    uint64_t data_ns;           // Bus time of the image bytes alone
+    uint32_t transactions;
+    uint32_t polls;
+    uint32_t idle_polls;
+    uint32_t errors;
+};
+
+#ifdef SERIAL_FLASHER_INTERFACE_SPI
+const char *INTERFACE_NAME = "SPI";
+
+typedef spi_slave_sim_t slave_sim_t;
+
+slave_sim_t *slave_create()
+{
+    return spi_slave_sim_create();
+}
+
+result_t slave_result(slave_sim_t *sim, const vector<uint8_t> &image)
+{
+    const spi_slave_sim_stats_t stats = spi_slave_sim_stats(sim);
+    const spi_slave_sim_config_t config;
+    result_t result = {};
+    result.loaded = spi_slave_sim_memory(sim, LOAD_ADDRESS, image.size()) == image &&
+                    spi_slave_sim_entry(sim) == LOAD_ADDRESS;
+    result.time_ns = stats.time_ns;
+    result.data_ns = image.size() * 8 * 1000000000ull / config.clock_hz;
+    result.transactions = stats.transactions;
+    result.polls = stats.status_polls;
+    result.idle_polls = stats.idle_polls;
+    result.errors = stats.errors;
+    return result;
+}
+
+#define slave_bind spi_slave_sim_bind
+#define slave_destroy spi_slave_sim_destroy
+#else
+const char *INTERFACE_NAME = "SDIO";
+
+typedef sdio_slave_sim_t slave_sim_t;
+
+slave_sim_t *slave_create()
+{
+    return sdio_slave_sim_create();
+}
+
+result_t slave_result(slave_sim_t *sim, const vector<uint8_t> &image)
+{
+    const sdio_slave_sim_stats_t stats = sdio_slave_sim_stats(sim);
+    const sdio_slave_sim_config_t config;
+    result_t result = {};
+    result.loaded = sdio_slave_sim_memory(sim, LOAD_ADDRESS, image.size()) == image &&
+                    sdio_slave_sim_entry(sim) == LOAD_ADDRESS;
+    result.time_ns = stats.time_ns;
+    result.data_ns = image.size() * 8 * 1000000000ull / (config.bus_width * config.clock_hz);
+    result.transactions = stats.transactions;
+    result.polls = stats.ready_polls;
+    result.idle_polls = stats.idle_polls;
+    result.errors = stats.errors + stats.overruns;
+    return result;
+}
+
+#define slave_bind sdio_slave_sim_bind
+#define slave_destroy sdio_slave_sim_destroy
+#endif
+
+bool load(const vector<uint8_t> &image, uint32_t block_size, result_t &result)
+{
+    slave_sim_t *sim = slave_create();
+    slave_bind(sim);
+
+    esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+    bool success = esp_loader_connect(&connect_config) == ESP_LOADER_SUCCESS &&
+                   esp_loader_mem_start(LOAD_ADDRESS, image.size(), block_size) == ESP_LOADER_SUCCESS;
+
+    for (size_t offset = 0; success && offset < image.size(); offset += block_size) {
+        const uint32_t size = min<size_t>(block_size, image.size() - offset);
+        success = esp_loader_mem_write(&image[offset], size) == ESP_LOADER_SUCCESS;
+    }
+    success = success && esp_loader_mem_finish(LOAD_ADDRESS) == ESP_LOADER_SUCCESS;
+
+    result = slave_result(sim, image);
+    slave_destroy(sim);
+    return success;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    const uint32_t image_size = argc > 1 ? strtoul(argv[1], NULL, 0) : 64 * 1024;
+    const uint32_t block_sizes[] = { 1024, 2048, 6144 };
+
+    if (image_size == 0 || image_size % 4 != 0) {
+        printf("Usage: %s [image size, a multiple of 4]\n", argv[0]);
+        return 1;
+    }
+
+    vector<uint8_t> image(image_size);
+    mt19937 generator(21);
+    for (auto &byte : image) {
+        byte = generator() & 0xFF;
+    }
+
+    printf("%s RAM load of %u bytes\n", INTERFACE_NAME, image_size);
+    printf("%6s %10s %9s %13s %10s %10s %9s\n", "block", "time us", "KB/s", "transactions",
+           "polls", "idle polls", "overhead");
+
+    bool failed = false;
+    for (uint32_t block_size : block_sizes) {
+        result_t result;
+        const bool success = load(image, block_size, result);
+
+        printf("%6u %10llu %9.0f %13u %10u %10u %8.1f%%  %s\n", block_size,
+               (unsigned long long)(result.time_ns / 1000), image_size * 1e9 / 1024 / result.time_ns,
+               result.transactions, result.polls, result.idle_polls,
+               100.0 * ((double)result.time_ns - result.data_ns) / result.time_ns,
+               !success ? "failed" : !result.loaded ? "wrong RAM contents" : result.errors != 0 ? "protocol errors" : "ok");
+
+        failed |= !success || !result.loaded || result.errors != 0;
+    }
+
+    if (failed) {
+        printf("RAM load failed\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,368 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sdio_slave_sim.h"
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <map>
+
+using namespace std;
+
+namespace
+{
+
+const uint32_t CCCR_FN_ENABLE = 0x02;
+const uint32_t CCCR_FN_READY = 0x03;
+const uint8_t FUNC1 = 1 << 1;
+
+// ESP32 SLC host registers on function 1
+const uint32_t SLCHOST_DATE = 0x178;
+const uint32_t SLCHOST_DATE_VALUE = 0x16022500;
+const uint32_t SLCHOST_STATE_W0 = 0x64;
+const uint32_t SLCHOST_CONF_W5 = 0x80;
+const uint32_t SLCHOST_WIN_CMD = 0x84;
+const uint32_t PACKET_SPACE_END = 0x1f800;
+
+// SLC registers behind the register window
+const uint32_t SLC_CONF1 = 0x60;
+const uint32_t SLC_CONF1_STITCH = 1 << 5 | 1 << 6;
+const uint32_t SLC_LEN_CONF = 0xE4;
+const uint32_t SLC_LEN_CONF_TX_PACKET_LOAD_EN = 1 << 24;
+
+const uint8_t WINDOW_READ = 0x80;
+const uint8_t WINDOW_WRITE = 0xC0;
+
+const size_t SIP_HEADER_SIZE = 12;
+const size_t SIP_PACKET_SIZE = 256;
+const uint8_t SIP_HDR_F_SYNC = 0x04;
+const uint32_t SIP_CMD_WRITE_MEMORY = 1;
+const uint32_t SIP_CMD_BOOTUP = 5;
+
+uint32_t read_u32(const uint8_t *data)
+{
+    return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+}
+
+struct sdio_slave_sim_t {
+    sdio_slave_sim_config_t config;
+    sdio_slave_sim_stats_t stats = {};
+    uint64_t timer_end_ns = 0;
+
+    bool card_ready = false;
+    uint8_t fn_enable = 0;
+    uint32_t window = 0;                // Value of the last register window read
+    map<uint32_t, uint32_t> regs;
+    deque<uint64_t> rx_queue;           // Times the received packets are processed at
+    uint32_t sequence = 0;
+
+    map<uint32_t, vector<uint8_t>> memory;
+    uint32_t entry = 0;
+    bool running = false;
+};
+
+namespace
+{
+
+sdio_slave_sim_t *s_bound;
+
+void reset(sdio_slave_sim_t *sim)
+{
+    sim->card_ready = false;
+    sim->fn_enable = 0;
+    sim->window = 0;
+    sim->regs.clear();
+    sim->rx_queue.clear();
+    sim->sequence = 0;
+    sim->memory.clear();
+    sim->entry = 0;
+    sim->running = false;
+}
+
+// Accounts a transaction, returns false if the slave cannot take it
+bool transfer(sdio_slave_sim_t *sim, const void *data, size_t size)
+{
+    sim->stats.transactions++;
+    sim->stats.bus_bytes += size;
+    sim->stats.time_ns += sim->config.command_ns +
+                          size * 8 * 1000000000ull / (sim->config.bus_width * sim->config.clock_hz);
+
+    if (!sim->card_ready || ((uintptr_t)data & 3) != 0) {
+        sim->stats.errors++;
+        return false;
+    }
+    return true;
+}
+
+bool busy(sdio_slave_sim_t *sim)
+{
+    while (!sim->rx_queue.empty() && sim->rx_queue.front() <= sim->stats.time_ns) {
+        sim->rx_queue.pop_front();
+    }
+    return !sim->rx_queue.empty();
+}
+
+void receive_packet(sdio_slave_sim_t *sim, const uint8_t *packet, size_t size)
+{
+    sim->stats.packets++;
+
+    if (busy(sim) && sim->rx_queue.size() >= sim->config.rx_buffers) {
+        sim->stats.overruns++;
+        return;
+    }
+    const uint64_t start = sim->rx_queue.empty() ? sim->stats.time_ns : sim->rx_queue.back();
+    sim->rx_queue.push_back(start + sim->config.packet_us * 1000ull + size * sim->config.copy_ns_per_byte);
+
+    const uint16_t length = packet[2] | packet[3] << 8;
+    if ((sim->regs[SLC_CONF1] & SLC_CONF1_STITCH) != SLC_CONF1_STITCH || sim->running ||
+            length != size || size % 4 != 0 || size < SIP_HEADER_SIZE + 8) {
+        sim->stats.errors++;
+        return;
+    }
+
+    const uint32_t command = read_u32(&packet[4]);
+    const uint8_t *body = &packet[SIP_HEADER_SIZE];
+
+    if (command == SIP_CMD_WRITE_MEMORY) {
+        const uint32_t address = read_u32(body);
+        const uint32_t data_size = read_u32(body + 4);
+        if (read_u32(&packet[8]) != sim->sequence || data_size > size - SIP_HEADER_SIZE - 8) {
+            sim->stats.errors++;
+            return;
+        }
+        sim->memory[address].assign(body + 8, body + 8 + data_size);
+        sim->stats.memory_bytes += data_size;
+        sim->sequence++;
+    } else if (command == SIP_CMD_BOOTUP && (packet[1] & SIP_HDR_F_SYNC) != 0) {
+        sim->entry = read_u32(body);
+        sim->running = true;
+    } else {
+        sim->stats.errors++;
+    }
+}
+
+esp_loader_error_t port_write(void *context, uint32_t function, uint32_t addr, const uint8_t *data,
+                              uint16_t size, uint32_t timeout)
+{
+    sdio_slave_sim_t *sim = (sdio_slave_sim_t *)context;
+
+    if (!transfer(sim, data, size)) {
+        return ESP_LOADER_ERROR_FAIL;
+    }
+
+    if (function == 0 && addr == CCCR_FN_ENABLE && size >= 1) {
+        sim->fn_enable = data[0];
+    } else if (function != 1 || (sim->fn_enable & FUNC1) == 0) {
+        sim->stats.errors++;
+    } else if (addr == SLCHOST_WIN_CMD && size >= 2 && data[1] == WINDOW_READ) {
+        sim->window = sim->regs[data[0] << 2];
+    } else if (addr == SLCHOST_CONF_W5 && size >= 6 && data[5] == WINDOW_WRITE) {
+        const uint32_t reg = data[4] << 2;
+        // The packet load enable starts sending and clears itself
+        sim->regs[reg] = read_u32(data) & (reg == SLC_LEN_CONF ? ~SLC_LEN_CONF_TX_PACKET_LOAD_EN : ~0u);
+    } else if (addr + size == PACKET_SPACE_END && size <= SIP_PACKET_SIZE) {
+        receive_packet(sim, data, size);
+    } else {
+        sim->stats.errors++;
+    }
+
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t port_read(void *context, uint32_t function, uint32_t addr, uint8_t *data,
+                             uint16_t size, uint32_t timeout)
+{
+    sdio_slave_sim_t *sim = (sdio_slave_sim_t *)context;
+
+    if (!transfer(sim, data, size)) {
+        return ESP_LOADER_ERROR_FAIL;
+    }
+
+    uint32_t value = 0;
+    if (function == 0 && addr == CCCR_FN_ENABLE) {
+        value = sim->fn_enable;
+    } else if (function == 0 && addr == CCCR_FN_READY) {
+        sim->stats.ready_polls++;
+        if (busy(sim)) {
+            sim->stats.idle_polls++;
+        } else {
+            value = FUNC1;
+        }
+    } else if (function != 1 || (sim->fn_enable & FUNC1) == 0) {
+        sim->stats.errors++;
+    } else if (addr == SLCHOST_DATE) {
+        value = SLCHOST_DATE_VALUE;
+    } else if (addr == SLCHOST_STATE_W0) {
+        value = sim->window;
+    } else {
+        sim->stats.errors++;
+    }
+
+    memset(data, 0, size);
+    memcpy(data, &value, min<size_t>(size, sizeof(value)));
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t port_sdio_card_init(void *context)
+{
+    sdio_slave_sim_t *sim = (sdio_slave_sim_t *)context;
+
+    sim->stats.time_ns += 100 * sim->config.command_ns;
+    sim->card_ready = true;
+    return ESP_LOADER_SUCCESS;
+}
+
+void port_delay_ms(void *context, uint32_t ms)
+{
+    ((sdio_slave_sim_t *)context)->stats.time_ns += ms * 1000000ull;
+}
+
+void port_start_timer(void *context, uint32_t ms)
+{
+    sdio_slave_sim_t *sim = (sdio_slave_sim_t *)context;
+    sim->timer_end_ns = sim->stats.time_ns + ms * 1000000ull;
+}
+
+uint32_t port_remaining_time(void *context)
+{
+    const sdio_slave_sim_t *sim = (const sdio_slave_sim_t *)context;
+    return sim->timer_end_ns > sim->stats.time_ns ? (sim->timer_end_ns - sim->stats.time_ns) / 1000000 : 0;
+}
+
+void port_reset(void *context)
+{
+    reset((sdio_slave_sim_t *)context);
+}
+
+uint32_t port_get_time_ms(void *context)
+{
+    return ((sdio_slave_sim_t *)context)->stats.time_ns / 1000000;
+}
+
+esp_loader_port_t make_port()
+{
+    esp_loader_port_t port = {};
+    port.write = port_write;
+    port.read = port_read;
+    port.sdio_card_init = port_sdio_card_init;
+    port.delay_ms = port_delay_ms;
+    port.start_timer = port_start_timer;
+    port.remaining_time = port_remaining_time;
+    port.enter_bootloader = port_reset;
+    port.reset_target = port_reset;
+    port.get_time_ms = port_get_time_ms;
+    return port;
+}
+
+}
+
+const esp_loader_port_t sdio_slave_sim_port = make_port();
+
+sdio_slave_sim_t *sdio_slave_sim_create(const sdio_slave_sim_config_t &config)
+{
+    sdio_slave_sim_t *sim = new sdio_slave_sim_t;
+    sim->config = config;
+    return sim;
+}
+
+void sdio_slave_sim_destroy(sdio_slave_sim_t *sim)
+{
+    if (s_bound == sim) {
+        s_bound = NULL;
+    }
+    delete sim;
+}
+
+vector<uint8_t> sdio_slave_sim_memory(const sdio_slave_sim_t *sim, uint32_t address, uint32_t size)
+{
+    vector<uint8_t> contents(size, 0);
+    for (const auto &segment : sim->memory) {
+        const uint64_t start = max<uint64_t>(segment.first, address);
+        const uint64_t end = min<uint64_t>((uint64_t)segment.first + segment.second.size(), (uint64_t)address + size);
+        for (uint64_t at = start; at < end; at++) {
+            contents[at - address] = segment.second[at - segment.first];
+        }
+    }
+    return contents;
+}
+
+uint32_t sdio_slave_sim_entry(const sdio_slave_sim_t *sim)
+{
+    return sim->entry;
+}
+
+sdio_slave_sim_stats_t sdio_slave_sim_stats(const sdio_slave_sim_t *sim)
+{
+    return sim->stats;
+}
+
+void sdio_slave_sim_bind(sdio_slave_sim_t *sim)
+{
+    s_bound = sim;
+}
+
+
+esp_loader_error_t loader_port_write(uint32_t function, uint32_t addr, const uint8_t *data,
+                                     uint16_t size, uint32_t timeout)
+{
+    return port_write(s_bound, function, addr, data, size, timeout);
+}
+
+esp_loader_error_t loader_port_read(uint32_t function, uint32_t addr, uint8_t *data,
+                                    uint16_t size, uint32_t timeout)
+{
+    return port_read(s_bound, function, addr, data, size, timeout);
+}
+
+esp_loader_error_t loader_port_sdio_card_init(void)
+{
+    return port_sdio_card_init(s_bound);
+}
+
+void loader_port_enter_bootloader(void)
+{
+    port_reset(s_bound);
+}
+
+void loader_port_reset_target(void)
+{
+    port_reset(s_bound);
+}
+
+void loader_port_delay_ms(uint32_t ms)
+{
+    port_delay_ms(s_bound, ms);
+}
+
+void loader_port_start_timer(uint32_t ms)
+{
+    port_start_timer(s_bound, ms);
+}
+
+uint32_t loader_port_remaining_time(void)
+{
+    return port_remaining_time(s_bound);
+}
+
+uint32_t loader_port_get_time_ms(void)
+{
+    return port_get_time_ms(s_bound);
+}
+
+void loader_port_debug_print(const char *str)
+{
+}
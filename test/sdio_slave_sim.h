@@ -0,0 +1,77 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Software ESP32 ROM loader in SDIO download mode, for builds with SERIAL_FLASHER_INTERFACE_SDIO.
+ *
+ * The slave has the function 0 CCCR registers to enable function 1 and to report it ready, and on
+ * function 1 the SLC host date register, the register window through which the SLC registers are
+ * read and written, and the packet space the host writes SIP packets to. Packets are accepted only
+ * once TX and RX stitching are enabled and must end at the end of the packet space, be word
+ * sized, and carry WRITE_MEMORY sequence numbers counting up from 0. BOOTUP runs the loaded
+ * program.
+ *
+ * Time is virtual. Every transaction takes its command overhead and its bits on the data lines.
+ * Each received packet occupies one of the slave receive buffers until it has been processed, the
+ * slave reports itself ready only with all of them free, and a packet arriving with all of them
+ * taken is dropped and counted as an overrun. Buffers passed by the host must be word aligned, as
+ * the DMA of the real ports requires. */
+
+#pragma once
+
+#include "esp_loader_io.h"
+#include <stdint.h>
+#include <vector>
+
+struct sdio_slave_sim_t;
+
+struct sdio_slave_sim_config_t {
+    uint32_t clock_hz = 50000000;       // SDIO clock
+    uint32_t bus_width = 4;             // Data lines
+    uint32_t command_ns = 2000;         // Command, response and host driver overhead of a transaction
+    uint32_t rx_buffers = 4;            // Packets the slave can hold before processing them
+    uint32_t packet_us = 10;            // Processing time of a packet
+    uint32_t copy_ns_per_byte = 2;      // Added to packet_us for the packet length
+};
+
+struct sdio_slave_sim_stats_t {
+    uint32_t transactions;      // CMD52 and CMD53 transactions
+    uint32_t ready_polls;       // Reads of the function ready register
+    uint32_t idle_polls;        // Ready reads that found the slave busy
+    uint32_t packets;           // SIP packets received
+    uint32_t overruns;          // Packets dropped as all receive buffers were taken
+    uint32_t errors;            // Malformed packets and protocol violations
+    uint64_t bus_bytes;         // Bytes transferred in either direction
+    uint64_t memory_bytes;      // Bytes loaded to RAM
+    uint64_t time_ns;           // Virtual time
+};
+
+sdio_slave_sim_t *sdio_slave_sim_create(const sdio_slave_sim_config_t &config = sdio_slave_sim_config_t());
+void sdio_slave_sim_destroy(sdio_slave_sim_t *sim);
+
+// Contents of RAM written with WRITE_MEMORY packets, zero where nothing was written
+std::vector<uint8_t> sdio_slave_sim_memory(const sdio_slave_sim_t *sim, uint32_t address, uint32_t size);
+
+// Entry point of the last BOOTUP packet, 0 if none was received
+uint32_t sdio_slave_sim_entry(const sdio_slave_sim_t *sim);
+
+sdio_slave_sim_stats_t sdio_slave_sim_stats(const sdio_slave_sim_t *sim);
+
+/* Port with the simulator as its context, for esp_loader_create(). Entering the bootloader
+   resets the slave, which then has to be initialized as a card again, delays and timers run on
+   the virtual time. */
+extern const esp_loader_port_t sdio_slave_sim_port;
+
+// Makes the loader_port_*() functions of the default loader act on the simulator
+void sdio_slave_sim_bind(sdio_slave_sim_t *sim);
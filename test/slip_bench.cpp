@@ -0,0 +1,152 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Micro-benchmark of the SLIP scan and escape kernels.
+ *
+ * Every kernel available on the CPU is timed scanning and escaping the same data, once with
+ * uniformly random bytes and once with data where a quarter of the bytes need escaping. The
+ * output of each kernel is checked to be identical to the frame SLIP_send() writes. */
+
+#include "slip.h"
+#include "slip_kernels.h"
+#include "esp_loader_io.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+
+vector<uint8_t> s_written;
+volatile size_t s_sink; // Keeps the timed work from being optimized out
+
+vector<uint8_t> make_data(size_t size, bool escape_heavy)
+{
+    mt19937 generator(1);
+    vector<uint8_t> data(size);
+    for (auto &byte : data) {
+        const uint32_t r = generator();
+        if (escape_heavy && r % 4 == 0) {
+            byte = (r & 0x100) ? 0xC0 : 0xDB;
+        } else {
+            byte = (r >> 16) & 0xFF;
+        }
+    }
+    return data;
+}
+
+size_t count_specials(slip_scan_fn_t scan, const vector<uint8_t> &data)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < data.size(); i++, count++) {
+        i += scan(&data[i], data.size() - i);
+        if (i == data.size()) {
+            break;
+        }
+    }
+    return count;
+}
+
+// Escapes all of the data in one call, the frame has room for the worst case
+size_t encode(slip_escape_fn_t escape, const vector<uint8_t> &data, vector<uint8_t> &frame)
+{
+    size_t len;
+    frame[0] = 0xC0;
+    escape(&data[0], data.size(), &frame[1], frame.size() - 2, &len);
+    frame[len + 1] = 0xC0;
+    return len + 2;
+}
+
+template <typename F>
+double mb_per_s(size_t bytes, unsigned rounds, F work)
+{
+    const auto start = chrono::steady_clock::now();
+    for (unsigned round = 0; round < rounds; round++) {
+        work();
+    }
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    return bytes * rounds / elapsed.count() / 1e6;
+}
+
+}
+
+esp_loader_error_t loader_port_write(const uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    s_written.insert(s_written.end(), data, data + size);
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t loader_port_read(uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    return ESP_LOADER_ERROR_TIMEOUT;
+}
+
+uint32_t loader_port_remaining_time(void)
+{
+    return 100;
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t size = 1024 * 1024;
+    const unsigned rounds = argc > 1 ? strtoul(argv[1], NULL, 0) : 8;
+
+    const slip_kernel_t *kernels;
+    const size_t kernel_count = SLIP_get_kernels(&kernels);
+    bool identical = true;
+
+    printf("%-14s %-8s %12s %12s\n", "data", "kernel", "scan MB/s", "encode MB/s");
+
+    for (bool escape_heavy : { false, true }) {
+        const auto data = make_data(size, escape_heavy);
+        const char *name = escape_heavy ? "escape-heavy" : "random";
+
+        s_written.clear();
+        SLIP_reset();
+        SLIP_send_delimiter();
+        SLIP_send(&data[0], data.size());
+        SLIP_send_delimiter();
+        SLIP_flush();
+
+        const size_t specials = count_specials(kernels[0].scan, data);
+        vector<uint8_t> frame(2 * size + 2);
+
+        for (size_t k = 0; k < kernel_count; k++) {
+            const slip_scan_fn_t scan = kernels[k].scan;
+            const slip_escape_fn_t escape = kernels[k].escape;
+            const size_t len = encode(escape, data, frame);
+            frame.resize(len);
+            if (count_specials(scan, data) != specials || frame != s_written) {
+                printf("%-14s %-8s output differs from SLIP_send()\n", name, kernels[k].name);
+                identical = false;
+            }
+            frame.resize(2 * size + 2);
+
+            const double scan_rate = mb_per_s(size, rounds, [&] {
+                s_sink = count_specials(scan, data);
+            });
+            const double encode_rate = mb_per_s(size, rounds, [&] {
+                s_sink = encode(escape, data, frame);
+            });
+            printf("%-14s %-8s %12.0f %12.0f\n", name, kernels[k].name, scan_rate, encode_rate);
+        }
+    }
+
+    return identical ? EXIT_SUCCESS : EXIT_FAILURE;
+}
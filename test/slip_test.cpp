@@ -0,0 +1,297 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "catch.hpp"
+#include "slip.h"
+#include "slip_kernels.h"
+#include "esp_loader_io.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+
+vector<uint8_t> s_written;
+vector<uint8_t> s_to_read;
+size_t s_read_pos;
+size_t s_read_chunk = 1;
+size_t s_read_calls;
+
+vector<uint8_t> encode(const vector<uint8_t> &payload)
+{
+    s_written.clear();
+    REQUIRE( SLIP_send_delimiter() == ESP_LOADER_SUCCESS );
+    REQUIRE( SLIP_send(&payload[0], payload.size()) == ESP_LOADER_SUCCESS );
+    REQUIRE( SLIP_send_delimiter() == ESP_LOADER_SUCCESS );
+    REQUIRE( SLIP_flush() == ESP_LOADER_SUCCESS );
+    return s_written;
+}
+
+void set_received(const vector<uint8_t> &data, size_t chunk)
+{
+    SLIP_reset();
+    s_to_read = data;
+    s_read_pos = 0;
+    s_read_chunk = chunk;
+    s_read_calls = 0;
+}
+
+vector<uint8_t> receive(size_t max_size, esp_loader_error_t expected = ESP_LOADER_SUCCESS)
+{
+    vector<uint8_t> packet(max_size);
+    size_t size = 0;
+    REQUIRE( SLIP_receive_packet(&packet[0], max_size, &size) == expected );
+    packet.resize(size);
+    return packet;
+}
+
+vector<uint8_t> reference_encode(const vector<uint8_t> &payload)
+{
+    vector<uint8_t> frame = { 0xC0 };
+    for (uint8_t byte : payload) {
+        if (byte == 0xC0) {
+            frame.insert(frame.end(), { 0xDB, 0xDC });
+        } else if (byte == 0xDB) {
+            frame.insert(frame.end(), { 0xDB, 0xDD });
+        } else {
+            frame.push_back(byte);
+        }
+    }
+    frame.push_back(0xC0);
+    return frame;
+}
+
+vector<uint8_t> payload_with_specials(size_t size)
+{
+    mt19937 generator(7);
+    vector<uint8_t> payload(size);
+    for (auto &byte : payload) {
+        // Plenty of bytes that need escaping, including at both ends
+        const uint32_t r = generator();
+        byte = (r % 4 == 0) ? 0xC0 : (r % 4 == 1) ? 0xDB : (r >> 8) & 0xFF;
+    }
+    payload.front() = 0xC0;
+    payload.back() = 0xDB;
+    return payload;
+}
+
+}
+
+esp_loader_error_t loader_port_write(const uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    s_written.insert(s_written.end(), data, data + size);
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t loader_port_read(uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    uint16_t received;
+    while (size > 0) {
+        RETURN_ON_ERROR( loader_port_read_some(data, size, timeout, &received) );
+        data += received;
+        size -= received;
+    }
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t loader_port_read_some(uint8_t *data, uint16_t size, uint32_t timeout,
+                                         uint16_t *received)
+{
+    if (s_read_pos == s_to_read.size()) {
+        return ESP_LOADER_ERROR_TIMEOUT;
+    }
+
+    *received = min({ (size_t)size, s_read_chunk, s_to_read.size() - s_read_pos });
+    copy_n(&s_to_read[s_read_pos], *received, data);
+    s_read_pos += *received;
+    s_read_calls++;
+    return ESP_LOADER_SUCCESS;
+}
+
+uint32_t loader_port_remaining_time(void)
+{
+    return 100;
+}
+
+
+TEST_CASE( "SLIP frames decode identically for any read chunking" )
+{
+    const auto payload = payload_with_specials(3000);
+    const auto frame = encode(payload);
+    REQUIRE( frame.size() > payload.size() + 2 );
+
+    for (size_t chunk : { 1, 2, 3, 7, 64, 256, 4096 }) {
+        INFO( "chunk " << chunk );
+        set_received(frame, chunk);
+        REQUIRE( receive(payload.size() + 10) == payload );
+        REQUIRE( s_read_pos == frame.size() );
+    }
+
+    // Bulk reads replace the byte-at-a-time port calls
+    set_received(frame, 4096);
+    receive(payload.size());
+    REQUIRE( s_read_calls < frame.size() / 100 );
+}
+
+TEST_CASE( "SLIP decoder keeps bytes of the next frame" )
+{
+    const vector<uint8_t> first = { 0x01, 0xC0, 0x02 };
+    const vector<uint8_t> second = { 0xDB, 0x03 };
+
+    // Garbage and the repeated delimiters sent after a baud rate change precede the frames
+    vector<uint8_t> stream = { 0x55, 0xAA, 0xC0, 0xC0 };
+    const auto first_frame = encode(first);
+    const auto second_frame = encode(second);
+    stream.insert(stream.end(), first_frame.begin(), first_frame.end());
+    stream.insert(stream.end(), second_frame.begin(), second_frame.end());
+
+    set_received(stream, stream.size());
+    REQUIRE( receive(16) == first );
+    REQUIRE( receive(16) == second );
+    REQUIRE( s_read_calls == 1 );
+
+    receive(16, ESP_LOADER_ERROR_TIMEOUT);
+}
+
+TEST_CASE( "SLIP decoder truncates long frames and rejects bad escapes" )
+{
+    const auto payload = payload_with_specials(100);
+    auto stream = encode(payload);
+    const auto next = encode({ 0x42 });
+    stream.insert(stream.end(), next.begin(), next.end());
+
+    set_received(stream, 5);
+    REQUIRE( receive(10) == vector<uint8_t>(payload.begin(), payload.begin() + 10) );
+    REQUIRE( receive(10) == vector<uint8_t>{ 0x42 } );
+
+    set_received({ 0xC0, 0x01, 0xDB, 0x01, 0xC0 }, 1);
+    receive(10, ESP_LOADER_ERROR_INVALID_RESPONSE);
+
+    slip_decoder_t decoder;
+    uint8_t buff[4];
+    const uint8_t data[] = { 0xC0, 0xDB, 0xDC, 0xDB };
+    size_t consumed;
+    bool complete;
+
+    SLIP_decoder_init(&decoder, buff, sizeof(buff));
+    REQUIRE( SLIP_decoder_feed(&decoder, data, sizeof(data), &consumed, &complete) == ESP_LOADER_SUCCESS );
+    REQUIRE( consumed == sizeof(data) );
+    REQUIRE( !complete );
+    REQUIRE( decoder.state == SLIP_STATE_ESCAPE );
+
+    const uint8_t end[] = { 0xDD, 0xC0, 0x77 };
+    REQUIRE( SLIP_decoder_feed(&decoder, end, sizeof(end), &consumed, &complete) == ESP_LOADER_SUCCESS );
+    REQUIRE( consumed == 2 );
+    REQUIRE( complete );
+    REQUIRE( decoder.size == 2 );
+    REQUIRE( buff[0] == 0xC0 );
+    REQUIRE( buff[1] == 0xDB );
+}
+
+TEST_CASE( "SLIP frames are assembled and written with one port call" )
+{
+    esp_loader_transfer_stats_t stats;
+
+    for (size_t size : { 1, 2, 100, SERIAL_FLASHER_TX_BUFFER_SIZE - 2, SERIAL_FLASHER_TX_BUFFER_SIZE,
+                         3 * SERIAL_FLASHER_TX_BUFFER_SIZE + 1 }) {
+        INFO( "size " << size );
+        const auto payload = payload_with_specials(size);
+        const auto expected = reference_encode(payload);
+
+        SLIP_reset();
+        SLIP_reset_stats();
+        REQUIRE( encode(payload) == expected );
+
+        SLIP_get_stats(&stats);
+        REQUIRE( stats.frames_sent == 1 );
+        REQUIRE( stats.bytes_written == expected.size() );
+        if (expected.size() <= SERIAL_FLASHER_TX_BUFFER_SIZE) {
+            REQUIRE( stats.port_writes == 1 );
+        } else {
+            // Every write but the last uses all of the buffer, save the byte an escape did not fit in
+            const size_t min_write = SERIAL_FLASHER_TX_BUFFER_SIZE - 1;
+            REQUIRE( stats.port_writes <= (expected.size() + min_write - 1) / min_write );
+        }
+    }
+
+    // Nothing reaches the port before the flush
+    SLIP_reset();
+    s_written.clear();
+    const uint8_t data[] = { 0x01, 0xC0 };
+    REQUIRE( SLIP_send_delimiter() == ESP_LOADER_SUCCESS );
+    REQUIRE( SLIP_send(data, sizeof(data)) == ESP_LOADER_SUCCESS );
+    REQUIRE( SLIP_send_delimiter() == ESP_LOADER_SUCCESS );
+    REQUIRE( s_written.empty() );
+    REQUIRE( SLIP_flush() == ESP_LOADER_SUCCESS );
+    REQUIRE( s_written == vector<uint8_t>({ 0xC0, 0x01, 0xDB, 0xDC, 0xC0 }) );
+}
+
+TEST_CASE( "SLIP kernels agree with the scalar kernel" )
+{
+    const slip_kernel_t *kernels;
+    const size_t kernel_count = SLIP_get_kernels(&kernels);
+    REQUIRE( string(kernels[0].name) == "scalar" );
+
+    for (size_t k = 0; k < kernel_count; k++) {
+        INFO( "kernel " << kernels[k].name );
+
+        // A special byte at every position of every block size and alignment, or none at all
+        vector<uint8_t> data(100, 0x55);
+        for (uint8_t special : { 0xC0, 0xDB }) {
+            for (size_t offset = 0; offset < 32; offset++) {
+                for (size_t position = offset; position <= data.size(); position++) {
+                    if (position < data.size()) {
+                        data[position] = special;
+                    }
+                    const size_t size = data.size() - offset;
+                    REQUIRE( kernels[k].scan(&data[offset], size) == position - offset );
+                    REQUIRE( kernels[k].scan(&data[offset], position - offset) == position - offset );
+                    if (position < data.size()) {
+                        data[position] = 0x55;
+                    }
+                }
+            }
+        }
+
+        // Output identical to the reference encoder for any data and output space
+        const auto payload = payload_with_specials(3000);
+        const auto expected = reference_encode(payload);
+        for (size_t out_size : { 2, 3, 31, 32, 33, 64, 100, 1024, 6002 }) {
+            INFO( "output size " << out_size );
+            vector<uint8_t> out(out_size);
+            vector<uint8_t> frame = { 0xC0 };
+            size_t consumed = 0;
+            while (consumed < payload.size()) {
+                size_t out_len;
+                const size_t used = kernels[k].escape(&payload[consumed], payload.size() - consumed,
+                                                      &out[0], out_size, &out_len);
+                REQUIRE( used > 0 );
+                REQUIRE( out_len <= out_size );
+                frame.insert(frame.end(), out.begin(), out.begin() + out_len);
+                consumed += used;
+            }
+            frame.push_back(0xC0);
+            REQUIRE( frame == expected );
+        }
+
+        for (size_t i = 0; i < payload.size(); i++) {
+            REQUIRE( kernels[k].scan(&payload[i], payload.size() - i) ==
+                     kernels[0].scan(&payload[i], payload.size() - i) );
+        }
+    }
+}
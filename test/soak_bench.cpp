@@ -0,0 +1,355 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Soak test of flash writes over a noisy link, against the software ESP32 target.
+ *
+ * Every scenario flashes an image again and again with esp_loader_flash_write(), through the
+ * fault injecting link on top of the serial link model, with the ROM loader and with the stub.
+ * Each round connects over a clean link, writes the image with faults injected, which
+ * SERIAL_FLASHER_WRITE_BLOCK_RETRIES retries, and verifies it over a clean link again.
+ *
+ * For every scenario it reports the goodput, meaning the verified image bytes per second of write
+ * time of all rounds, the retries, the writes that failed for good, the time a block took beyond
+ * a clean write when it had to be retried, and how many rounds wrote every block successfully but
+ * failed the MD5 verification. The link runs in virtual time, so the results are reproducible. */
+
+#include "esp_loader.h"
+#include "esp_loader_io.h"
+#include "target_sim.h"
+#include "link_model.h"
+#include "fault_link.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+
+const uint32_t FLASH_ADDRESS = 0x10000;
+const uint32_t INITIAL_BAUD = 115200;
+const uint32_t ROM_BLOCK_SIZE = 0x400;
+const uint32_t STUB_BLOCK_SIZE = 0x4000;
+
+struct {
+    target_sim_t *sim;
+    link_model_t *link;
+    fault_link_t *fault;
+} s_soak;
+
+struct scenario_t {
+    const char *name;
+    fault_link_config_t config;
+};
+
+struct report_t {
+    uint32_t rounds = 0;
+    uint32_t written = 0;           // Rounds with every block written successfully
+    uint32_t verified = 0;          // Rounds that passed the MD5 verification
+    uint32_t undetected = 0;        // Written rounds that failed the MD5 verification
+    uint32_t silent = 0;            // Verified rounds whose flash does not hold the image
+    uint32_t blocks = 0;
+    uint32_t retries = 0;
+    uint32_t failed_writes = 0;
+    uint32_t recovered = 0;         // Blocks written successfully after a retry
+    uint64_t recovery_us = 0;       // Their time beyond a clean write
+    uint64_t max_recovery_us = 0;
+    uint64_t write_us = 0;
+    uint64_t good_bytes = 0;
+};
+
+vector<scenario_t> make_scenarios(double rate, uint32_t stall_ms)
+{
+    vector<scenario_t> scenarios(7);
+    scenarios[0].name = "clean";
+    scenarios[1].name = "bit_flips";
+    scenarios[1].config.bit_flip_rate = rate;
+    scenarios[2].name = "drops";
+    scenarios[2].config.drop_rate = rate;
+    scenarios[3].name = "duplicates";
+    scenarios[3].config.duplicate_rate = rate;
+    scenarios[4].name = "spurious_ends";
+    scenarios[4].config.spurious_end_rate = rate;
+
+    // Few bytes reach the host during writes, so stalls are made more likely
+    scenarios[5].name = "stalls";
+    scenarios[5].config.stall_rate = rate * 100;
+    scenarios[6].name = "mixed";
+    scenarios[6].config.bit_flip_rate = rate / 4;
+    scenarios[6].config.drop_rate = rate / 4;
+    scenarios[6].config.duplicate_rate = rate / 4;
+    scenarios[6].config.spurious_end_rate = rate / 4;
+    scenarios[6].config.stall_rate = rate * 25;
+
+    for (scenario_t &scenario : scenarios) {
+        scenario.config.stall_ms = stall_ms;
+    }
+    return scenarios;
+}
+
+uint64_t now_us()
+{
+    return link_model_stats(s_soak.link).time_us;
+}
+
+bool connect(bool stub, uint32_t baud)
+{
+    esp_loader_reset_target();
+    loader_port_change_transmission_rate(INITIAL_BAUD);
+
+    esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+    if (stub) {
+        return esp_loader_connect_with_stub(&connect_config) == ESP_LOADER_SUCCESS &&
+               esp_loader_change_transmission_rate_stub(INITIAL_BAUD, baud) == ESP_LOADER_SUCCESS &&
+               loader_port_change_transmission_rate(baud) == ESP_LOADER_SUCCESS;
+    }
+
+    return esp_loader_connect(&connect_config) == ESP_LOADER_SUCCESS &&
+           esp_loader_change_transmission_rate(baud) == ESP_LOADER_SUCCESS &&
+           loader_port_change_transmission_rate(baud) == ESP_LOADER_SUCCESS;
+}
+
+/* Writes the image with faults injected, returns false if the round has to be given up.
+   clean_block_us is the time of a block on a clean link, 0 while it is being measured. */
+bool write_round(const vector<uint8_t> &image, uint32_t block_size, uint64_t &clean_block_us, report_t &report)
+{
+    const uint64_t start_us = now_us();
+    fault_link_enable(s_soak.fault, true);
+
+    bool written = esp_loader_flash_start(FLASH_ADDRESS, image.size(), block_size) == ESP_LOADER_SUCCESS;
+    for (size_t offset = 0; written && offset < image.size(); offset += block_size) {
+        const uint32_t frames = fault_link_stats(s_soak.fault).frames;
+        const uint64_t block_start_us = now_us();
+
+        const uint32_t size = min<size_t>(block_size, image.size() - offset);
+        written = esp_loader_flash_write((void *)&image[offset], size) == ESP_LOADER_SUCCESS;
+
+        const uint32_t attempts = fault_link_stats(s_soak.fault).frames - frames;
+        const uint64_t block_us = now_us() - block_start_us;
+        report.blocks++;
+        report.retries += attempts > 0 ? attempts - 1 : 0;
+        if (!written) {
+            report.failed_writes++;
+        } else if (attempts > 1) {
+            const uint64_t extra_us = block_us > clean_block_us ? block_us - clean_block_us : 0;
+            report.recovered++;
+            report.recovery_us += extra_us;
+            report.max_recovery_us = max(report.max_recovery_us, extra_us);
+        } else if (clean_block_us == 0) {
+            clean_block_us = block_us;
+        }
+    }
+
+    fault_link_enable(s_soak.fault, false);
+    report.write_us += now_us() - start_us;
+    return written;
+}
+
+report_t run_scenario(const scenario_t &scenario, bool stub, uint32_t baud, uint32_t rounds,
+                      const vector<uint8_t> &image, uint64_t &clean_block_us)
+{
+    const uint32_t block_size = stub ? STUB_BLOCK_SIZE : ROM_BLOCK_SIZE;
+    report_t report;
+
+    s_soak.fault = fault_link_create(&link_model_port, s_soak.link, scenario.config);
+
+    for (uint32_t round = 0; round < rounds; round++) {
+        report.rounds++;
+        if (!connect(stub, baud)) {
+            printf("%s: connecting failed in round %u\n", scenario.name, round);
+            continue;
+        }
+        if (!write_round(image, block_size, clean_block_us, report)) {
+            continue;
+        }
+        report.written++;
+
+        const esp_loader_error_t err = esp_loader_flash_verify();
+        if (err == ESP_LOADER_ERROR_INVALID_MD5) {
+            report.undetected++;
+        } else if (err == ESP_LOADER_SUCCESS) {
+            report.verified++;
+            report.good_bytes += image.size();
+
+            const vector<uint8_t> &flash = target_sim_flash(s_soak.sim);
+            report.silent += !equal(image.begin(), image.end(), flash.begin() + FLASH_ADDRESS);
+        } else {
+            printf("%s: verifying over a clean link failed with error %d\n", scenario.name, err);
+        }
+    }
+
+    fault_link_destroy(s_soak.fault);
+    s_soak.fault = NULL;
+    return report;
+}
+
+void print_report(const char *name, bool stub, const report_t &report)
+{
+    const double goodput = report.write_us > 0 ? report.good_bytes * 1e6 / report.write_us : 0;
+    const double mean_recovery_ms = report.recovered > 0 ? report.recovery_us / 1e3 / report.recovered : 0;
+    const double undetected_rate = report.written > 0 ? 100.0 * report.undetected / report.written : 0;
+
+    printf("%-14s %5s %6u/%-6u %10.0f %8u %8u %9.1f %9.1f %8u/%-3u %6.1f%%\n", name, stub ? "stub" : "rom",
+           report.verified, report.rounds, goodput, report.retries, report.failed_writes, mean_recovery_ms,
+           report.max_recovery_us / 1e3, report.undetected, report.written, undetected_rate);
+}
+
+void usage(const char *program)
+{
+    printf("Usage: %s [--rounds count] [--size bytes] [--baud rate] [--rate probability]\n"
+           "       [--stall-ms ms] [--seed number]\n", program);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t rounds = 20;
+    uint32_t image_size = 256 * 1024;
+    uint32_t baud = 921600;
+    double rate = 1e-4;
+    uint32_t stall_ms = 500;
+    uint32_t seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        const string arg = argv[i];
+        if (i + 1 == argc) {
+            usage(argv[0]);
+            return 1;
+        } else if (arg == "--rounds") {
+            rounds = strtoul(argv[++i], NULL, 0);
+        } else if (arg == "--size") {
+            image_size = strtoul(argv[++i], NULL, 0);
+        } else if (arg == "--baud") {
+            baud = strtoul(argv[++i], NULL, 0);
+        } else if (arg == "--rate") {
+            rate = strtod(argv[++i], NULL);
+        } else if (arg == "--stall-ms") {
+            stall_ms = strtoul(argv[++i], NULL, 0);
+        } else if (arg == "--seed") {
+            seed = strtoul(argv[++i], NULL, 0);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (image_size == 0 || image_size % 4096 != 0) {
+        printf("The image size has to be a multiple of 4096\n");
+        return 1;
+    }
+
+    vector<uint8_t> image(image_size);
+    mt19937 generator(seed);
+    for (auto &byte : image) {
+        byte = generator() & 0xFF;
+    }
+
+    s_soak.sim = target_sim_create();
+    s_soak.link = link_model_create(&target_sim_port, s_soak.sim);
+
+    printf("%u rounds of %u bytes at %u baud, fault rate %g per byte, stalls of %u ms, %u write attempts\n\n",
+           rounds, image_size, baud, rate, stall_ms, SERIAL_FLASHER_WRITE_BLOCK_RETRIES);
+    printf("%-14s %5s %13s %10s %8s %8s %9s %9s %12s %7s\n", "scenario", "mode", "verified", "goodput",
+           "retries", "failed", "recov ms", "max ms", "undetected", "rate");
+
+    bool failed = false;
+    for (bool stub : { false, true }) {
+        uint64_t clean_block_us = 0;
+        vector<scenario_t> scenarios = make_scenarios(rate, stall_ms);
+        for (scenario_t &scenario : scenarios) {
+            scenario.config.seed = seed++;
+            const report_t report = run_scenario(scenario, stub, baud, rounds, image, clean_block_us);
+            print_report(scenario.name, stub, report);
+
+            // A clean link has to work every time, and MD5 must not let corruption through
+            if (&scenario == &scenarios[0] && (report.verified != rounds || report.retries != 0)) {
+                printf("Flashing over the clean link failed\n");
+                failed = true;
+            }
+            if (report.silent != 0) {
+                printf("%u rounds passed the MD5 verification with corrupted flash\n", report.silent);
+                failed = true;
+            }
+        }
+    }
+
+    link_model_destroy(s_soak.link);
+    target_sim_destroy(s_soak.sim);
+
+    if (failed) {
+        printf("Benchmark failed\n");
+        return 1;
+    }
+    return 0;
+}
+
+
+esp_loader_error_t loader_port_write(const uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    return fault_link_port.write(s_soak.fault, data, size, timeout);
+}
+
+esp_loader_error_t loader_port_read_some(uint8_t *data, uint16_t size, uint32_t timeout, uint16_t *received)
+{
+    return fault_link_port.read_some(s_soak.fault, data, size, timeout, received);
+}
+
+esp_loader_error_t loader_port_read(uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    return fault_link_port.read(s_soak.fault, data, size, timeout);
+}
+
+esp_loader_error_t loader_port_change_transmission_rate(uint32_t transmission_rate)
+{
+    return fault_link_port.change_transmission_rate(s_soak.fault, transmission_rate);
+}
+
+void loader_port_enter_bootloader(void)
+{
+    fault_link_port.enter_bootloader(s_soak.fault);
+}
+
+void loader_port_reset_target(void)
+{
+    fault_link_port.reset_target(s_soak.fault);
+}
+
+void loader_port_delay_ms(uint32_t ms)
+{
+    fault_link_port.delay_ms(s_soak.fault, ms);
+}
+
+void loader_port_start_timer(uint32_t ms)
+{
+    fault_link_port.start_timer(s_soak.fault, ms);
+}
+
+uint32_t loader_port_remaining_time(void)
+{
+    return fault_link_port.remaining_time(s_soak.fault);
+}
+
+uint32_t loader_port_get_time_ms(void)
+{
+    return fault_link_port.get_time_ms(s_soak.fault);
+}
+
+void loader_port_debug_print(const char *str)
+{
+}
@@ -0,0 +1,527 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "spi_slave_sim.h"
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <map>
+
+using namespace std;
+
+namespace
+{
+
+const uint8_t TRANS_WRBUF = 0x01;
+const uint8_t TRANS_RDBUF = 0x02;
+const uint8_t TRANS_WRDMA = 0x03;
+const uint8_t TRANS_RDDMA = 0x04;
+const uint8_t TRANS_WR_DONE = 0x07;
+const uint8_t TRANS_CMD8 = 0x08;
+const size_t PREAMBLE_SIZE = 3;
+
+const uint32_t REG_RXSTA = 4;
+const uint32_t REG_TXSTA = 8;
+const uint32_t REG_CMD = 12;
+const uint32_t REG_SIZE = 64;
+const uint8_t SLAVE_CMD_IDLE = 0xAA;
+
+const uint32_t STA_TOGGLE = 1 << 0;
+const uint32_t STA_INIT = 1 << 1;
+const uint32_t STA_LENGTH_POS = 2;
+
+const uint8_t CMD_MEM_BEGIN = 0x05;
+const uint8_t CMD_MEM_END = 0x06;
+const uint8_t CMD_MEM_DATA = 0x07;
+const uint8_t CMD_WRITE_REG = 0x09;
+const uint8_t CMD_READ_REG = 0x0A;
+
+const uint8_t ERROR_INVALID_COMMAND = 0x05;
+const uint8_t ERROR_COMMAND_FAILED = 0x06;
+const uint8_t ERROR_INVALID_CRC = 0x07;
+
+const uint32_t CHIP_DETECT_MAGIC_REG = 0x40001000;
+const uint32_t CHIP_DETECT_MAGIC_ESP32S3 = 0x00000009;
+
+uint32_t read_u32(const uint8_t *data)
+{
+    return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+/* RXSTA or TXSTA. Each buffer the slave makes available is published at a point of the virtual
+   time, the register shows the ones whose time has come. The first one is announced with the
+   init bit, which the slave clears once the host has taken it, the following ones by toggling
+   the sequence bit. */
+struct status_t {
+    bool init = true;
+    uint32_t published = 0;
+    uint32_t taken = 0;
+    deque<uint64_t> pending;
+    uint32_t length = 0;
+    uint32_t last_read = 0;
+
+    void update(uint64_t now)
+    {
+        while (!pending.empty() && pending.front() <= now) {
+            pending.pop_front();
+            published++;
+        }
+    }
+
+    uint32_t value() const
+    {
+        uint32_t state;
+        if (init) {
+            state = STA_TOGGLE | STA_INIT;
+        } else if (published == 0) {
+            state = 0;
+        } else if (published == 1) {
+            state = taken == 0 ? STA_INIT : 0;
+        } else {
+            state = (published - 1) & STA_TOGGLE;
+        }
+        return length << STA_LENGTH_POS | state;
+    }
+};
+
+}
+
+struct spi_slave_sim_t {
+    spi_slave_sim_config_t config;
+    spi_slave_sim_stats_t stats = {};
+    uint64_t timer_end_ns = 0;
+
+    uint8_t command_reg = SLAVE_CMD_IDLE;
+    status_t rx;
+    status_t tx;
+    vector<uint8_t> response;
+
+    bool selected = false;
+    vector<uint8_t> transaction;
+    size_t read_offset = 0;
+    vector<uint8_t> command;
+
+    map<uint32_t, uint32_t> regs;
+    map<uint32_t, vector<uint8_t>> memory;
+    uint32_t mem_address = 0;
+    uint32_t mem_end = 0;
+    uint32_t mem_sequence = 0;
+    uint32_t entry = 0;
+    bool running = false;
+};
+
+namespace
+{
+
+spi_slave_sim_t *s_bound;
+
+void spend(spi_slave_sim_t *sim, uint64_t ns)
+{
+    sim->stats.time_ns += ns;
+}
+
+void clock_bytes(spi_slave_sim_t *sim, size_t size)
+{
+    sim->stats.bus_bytes += size;
+    spend(sim, size * 8 * 1000000000ull / sim->config.clock_hz);
+}
+
+void reset(spi_slave_sim_t *sim)
+{
+    sim->command_reg = SLAVE_CMD_IDLE;
+    sim->rx = status_t();
+    sim->tx = status_t();
+    sim->rx.length = sim->config.buffer_size;
+    sim->selected = false;
+    sim->transaction.clear();
+    sim->command.clear();
+    sim->regs.clear();
+    sim->memory.clear();
+    sim->entry = 0;
+    sim->running = false;
+}
+
+void respond(spi_slave_sim_t *sim, uint8_t command, uint32_t value, uint8_t error, uint64_t done)
+{
+    sim->response = {
+        0x01, command, 2, 0,
+        (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24),
+        (uint8_t)(error != 0 ? 1 : 0), error
+    };
+    sim->tx.length = sim->response.size();
+    sim->tx.pending.push_back(done);
+    sim->rx.pending.push_back(done + sim->config.ready_us * 1000ull);
+
+    if (error != 0) {
+        sim->stats.errors++;
+    }
+}
+
+// Executes the command received through WRDMA, returns the error code of the response
+uint8_t execute(spi_slave_sim_t *sim, const vector<uint8_t> &frame, uint32_t &value)
+{
+    const uint8_t command = frame[1];
+    const uint8_t *params = &frame[8];
+    const size_t params_size = frame.size() - 8;
+    value = 0;
+
+    if (command == CMD_READ_REG && params_size >= 4) {
+        const uint32_t address = read_u32(params);
+        value = address == CHIP_DETECT_MAGIC_REG ? CHIP_DETECT_MAGIC_ESP32S3 : sim->regs[address];
+    } else if (command == CMD_WRITE_REG && params_size >= 8) {
+        sim->regs[read_u32(params)] = read_u32(params + 4);
+    } else if (command == CMD_MEM_BEGIN && params_size >= 16) {
+        sim->mem_address = read_u32(params + 12);
+        sim->mem_end = sim->mem_address + read_u32(params);
+        sim->mem_sequence = 0;
+    } else if (command == CMD_MEM_DATA && params_size >= 16) {
+        const uint32_t size = read_u32(params);
+        const uint8_t *data = params + 16;
+        if (params_size < 16 + (size_t)size || read_u32(params + 4) != sim->mem_sequence) {
+            return ERROR_COMMAND_FAILED;
+        }
+
+        uint8_t checksum = 0xEF;
+        for (uint32_t i = 0; i < size; i++) {
+            checksum ^= data[i];
+        }
+        if (checksum != read_u32(&frame[4])) {
+            return ERROR_INVALID_CRC;
+        }
+        if (sim->mem_address + size > sim->mem_end) {
+            return ERROR_COMMAND_FAILED;
+        }
+
+        sim->memory[sim->mem_address].assign(data, data + size);
+        sim->mem_address += size;
+        sim->mem_sequence++;
+        sim->stats.memory_bytes += size;
+    } else if (command == CMD_MEM_END && params_size >= 8) {
+        if (read_u32(params) == 0) {
+            sim->entry = read_u32(params + 4);
+            sim->running = true;
+        }
+    } else {
+        return ERROR_INVALID_COMMAND;
+    }
+
+    return 0;
+}
+
+void write_register(spi_slave_sim_t *sim, uint32_t address, const uint8_t *data, size_t size)
+{
+    if (address == REG_CMD && size >= 1) {
+        sim->command_reg = data[0];
+    } else if ((address == REG_RXSTA || address == REG_TXSTA) && size >= 4 && read_u32(data) == 0) {
+        // The host acknowledges the init state, the slave announces its buffer after that
+        status_t &status = address == REG_RXSTA ? sim->rx : sim->tx;
+        if (!status.init) {
+            sim->stats.errors++;
+            return;
+        }
+        status.init = false;
+        if (address == REG_RXSTA) {
+            status.pending.push_back(sim->stats.time_ns + sim->config.ready_us * 1000ull);
+        }
+    } else {
+        sim->stats.errors++;
+    }
+}
+
+void end_transaction(spi_slave_sim_t *sim)
+{
+    const vector<uint8_t> &transaction = sim->transaction;
+    if (transaction.size() < PREAMBLE_SIZE) {
+        sim->stats.errors++;
+        return;
+    }
+
+    const uint8_t type = transaction[0];
+    const uint8_t address = transaction[1];
+    const uint8_t *payload = &transaction[PREAMBLE_SIZE];
+    const size_t payload_size = transaction.size() - PREAMBLE_SIZE;
+
+    sim->rx.update(sim->stats.time_ns);
+    sim->tx.update(sim->stats.time_ns);
+
+    if (type == TRANS_WRBUF) {
+        write_register(sim, address, payload, payload_size);
+    } else if (type == TRANS_WRDMA) {
+        // Writing without an announced buffer or beyond it overruns the slave
+        if (sim->rx.init || sim->rx.taken >= sim->rx.published || payload_size > sim->config.buffer_size) {
+            sim->stats.errors++;
+        }
+        sim->rx.taken = sim->rx.published;
+        sim->command.assign(payload, payload + payload_size);
+    } else if (type == TRANS_WR_DONE) {
+        /* Malformed commands are answered with an error rather than ignored, the host polls
+           TXSTA without a timeout and would wait for the response forever */
+        uint32_t value = 0;
+        uint8_t error = ERROR_INVALID_COMMAND;
+        if (sim->command.size() >= 8 && sim->command[0] == 0x00 && !sim->running) {
+            error = execute(sim, sim->command, value);
+        }
+
+        sim->stats.commands++;
+        const size_t data_size = sim->command.size() > 24 ? sim->command.size() - 24 : 0;
+        const uint64_t done = sim->stats.time_ns + sim->config.command_us * 1000ull +
+                              data_size * sim->config.copy_ns_per_byte;
+        respond(sim, sim->command.size() >= 2 ? sim->command[1] : 0, value, error, done);
+        sim->command.clear();
+    } else if (type == TRANS_CMD8) {
+        sim->tx.taken = sim->tx.published;
+    } else if (type != TRANS_RDBUF && type != TRANS_RDDMA) {
+        sim->stats.errors++;
+    }
+}
+
+esp_loader_error_t sim_read(spi_slave_sim_t *sim, uint8_t *data, uint16_t size)
+{
+    clock_bytes(sim, size);
+    if (!sim->selected || sim->transaction.size() < PREAMBLE_SIZE) {
+        sim->stats.errors++;
+        return ESP_LOADER_ERROR_FAIL;
+    }
+
+    const uint8_t type = sim->transaction[0];
+    const uint32_t address = sim->transaction[1];
+    memset(data, 0, size);
+
+    if (type == TRANS_RDBUF) {
+        sim->rx.update(sim->stats.time_ns);
+        sim->tx.update(sim->stats.time_ns);
+
+        uint8_t regs[REG_SIZE] = {};
+        const uint32_t rx = sim->rx.value();
+        const uint32_t tx = sim->tx.value();
+        memcpy(&regs[REG_RXSTA], &rx, sizeof(rx));
+        memcpy(&regs[REG_TXSTA], &tx, sizeof(tx));
+        regs[REG_CMD] = sim->command_reg;
+        if (address + size <= REG_SIZE) {
+            memcpy(data, &regs[address], size);
+        }
+
+        if (address == REG_RXSTA || address == REG_TXSTA) {
+            status_t &status = address == REG_RXSTA ? sim->rx : sim->tx;
+            const uint32_t value = status.value();
+            sim->stats.status_polls++;
+            if (value == status.last_read) {
+                sim->stats.idle_polls++;
+            }
+            status.last_read = value;
+        }
+    } else if (type == TRANS_RDDMA) {
+        // Only a published response that has not been read yet can be taken
+        sim->tx.update(sim->stats.time_ns);
+        if (sim->tx.taken >= sim->tx.published) {
+            sim->stats.errors++;
+            return ESP_LOADER_SUCCESS;
+        }
+        const size_t available = sim->response.size() > sim->read_offset ? sim->response.size() - sim->read_offset : 0;
+        memcpy(data, &sim->response[sim->read_offset], min<size_t>(size, available));
+        sim->read_offset += size;
+    } else {
+        sim->stats.errors++;
+    }
+
+    return ESP_LOADER_SUCCESS;
+}
+
+
+esp_loader_error_t port_write(void *context, const uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    spi_slave_sim_t *sim = (spi_slave_sim_t *)context;
+
+    clock_bytes(sim, size);
+    if (!sim->selected) {
+        sim->stats.errors++;
+        return ESP_LOADER_ERROR_FAIL;
+    }
+    sim->transaction.insert(sim->transaction.end(), data, data + size);
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t port_read(void *context, uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    return sim_read((spi_slave_sim_t *)context, data, size);
+}
+
+esp_loader_error_t port_change_transmission_rate(void *context, uint32_t transmission_rate)
+{
+    ((spi_slave_sim_t *)context)->config.clock_hz = transmission_rate;
+    return ESP_LOADER_SUCCESS;
+}
+
+void port_spi_set_cs(void *context, uint32_t level)
+{
+    spi_slave_sim_t *sim = (spi_slave_sim_t *)context;
+
+    if (level == 0 && !sim->selected) {
+        sim->selected = true;
+        sim->transaction.clear();
+        sim->read_offset = 0;
+        sim->stats.transactions++;
+        spend(sim, sim->config.transaction_ns);
+    } else if (level != 0 && sim->selected) {
+        sim->selected = false;
+        end_transaction(sim);
+    }
+}
+
+void port_delay_ms(void *context, uint32_t ms)
+{
+    spend((spi_slave_sim_t *)context, ms * 1000000ull);
+}
+
+void port_start_timer(void *context, uint32_t ms)
+{
+    spi_slave_sim_t *sim = (spi_slave_sim_t *)context;
+    sim->timer_end_ns = sim->stats.time_ns + ms * 1000000ull;
+}
+
+uint32_t port_remaining_time(void *context)
+{
+    const spi_slave_sim_t *sim = (const spi_slave_sim_t *)context;
+    return sim->timer_end_ns > sim->stats.time_ns ? (sim->timer_end_ns - sim->stats.time_ns) / 1000000 : 0;
+}
+
+void port_reset(void *context)
+{
+    reset((spi_slave_sim_t *)context);
+}
+
+uint32_t port_get_time_ms(void *context)
+{
+    return ((spi_slave_sim_t *)context)->stats.time_ns / 1000000;
+}
+
+esp_loader_port_t make_port()
+{
+    esp_loader_port_t port = {};
+    port.write = port_write;
+    port.read = port_read;
+    port.change_transmission_rate = port_change_transmission_rate;
+    port.spi_set_cs = port_spi_set_cs;
+    port.delay_ms = port_delay_ms;
+    port.start_timer = port_start_timer;
+    port.remaining_time = port_remaining_time;
+    port.enter_bootloader = port_reset;
+    port.reset_target = port_reset;
+    port.get_time_ms = port_get_time_ms;
+    return port;
+}
+
+}
+
+const esp_loader_port_t spi_slave_sim_port = make_port();
+
+spi_slave_sim_t *spi_slave_sim_create(const spi_slave_sim_config_t &config)
+{
+    spi_slave_sim_t *sim = new spi_slave_sim_t;
+    sim->config = config;
+    reset(sim);
+    return sim;
+}
+
+void spi_slave_sim_destroy(spi_slave_sim_t *sim)
+{
+    if (s_bound == sim) {
+        s_bound = NULL;
+    }
+    delete sim;
+}
+
+vector<uint8_t> spi_slave_sim_memory(const spi_slave_sim_t *sim, uint32_t address, uint32_t size)
+{
+    vector<uint8_t> contents(size, 0);
+    for (const auto &segment : sim->memory) {
+        const uint64_t start = max<uint64_t>(segment.first, address);
+        const uint64_t end = min<uint64_t>((uint64_t)segment.first + segment.second.size(), (uint64_t)address + size);
+        for (uint64_t at = start; at < end; at++) {
+            contents[at - address] = segment.second[at - segment.first];
+        }
+    }
+    return contents;
+}
+
+uint32_t spi_slave_sim_entry(const spi_slave_sim_t *sim)
+{
+    return sim->entry;
+}
+
+spi_slave_sim_stats_t spi_slave_sim_stats(const spi_slave_sim_t *sim)
+{
+    return sim->stats;
+}
+
+void spi_slave_sim_bind(spi_slave_sim_t *sim)
+{
+    s_bound = sim;
+}
+
+
+esp_loader_error_t loader_port_write(const uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    return port_write(s_bound, data, size, timeout);
+}
+
+esp_loader_error_t loader_port_read(uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    return port_read(s_bound, data, size, timeout);
+}
+
+void loader_port_spi_set_cs(uint32_t level)
+{
+    port_spi_set_cs(s_bound, level);
+}
+
+void loader_port_enter_bootloader(void)
+{
+    port_reset(s_bound);
+}
+
+void loader_port_reset_target(void)
+{
+    port_reset(s_bound);
+}
+
+void loader_port_delay_ms(uint32_t ms)
+{
+    port_delay_ms(s_bound, ms);
+}
+
+void loader_port_start_timer(uint32_t ms)
+{
+    port_start_timer(s_bound, ms);
+}
+
+uint32_t loader_port_remaining_time(void)
+{
+    return port_remaining_time(s_bound);
+}
+
+uint32_t loader_port_get_time_ms(void)
+{
+    return port_get_time_ms(s_bound);
+}
+
+void loader_port_debug_print(const char *str)
+{
+}
+
+esp_loader_error_t loader_port_change_transmission_rate(uint32_t transmission_rate)
+{
+    return port_change_transmission_rate(s_bound, transmission_rate);
+}
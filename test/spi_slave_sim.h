@@ -0,0 +1,74 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Software ESP32-S3 ROM loader in SPI slave download mode, for builds with
+ * SERIAL_FLASHER_INTERFACE_SPI.
+ *
+ * The slave decodes the half duplex transactions between chip select edges: register reads and
+ * writes of its shared buffer (WRBUF, RDBUF), command writes (WRDMA terminated by WR_DONE) and
+ * response reads (RDDMA terminated by CMD8). It announces its receive buffer and each response in
+ * the RXSTA and TXSTA registers, starting in the init state the host has to clear and then
+ * toggling a sequence bit, as the ROM does. It answers READ_REG with the chip magic value and
+ * executes MEM_BEGIN, MEM_DATA and MEM_END, checking data checksums and sequence numbers.
+ *
+ * Time is virtual. Every transaction takes its setup time and its bits at the SPI clock, and the
+ * slave publishes its status changes only after its processing times have passed, so the host
+ * polls the status registers as often as it would on hardware. */
+
+#pragma once
+
+#include "esp_loader_io.h"
+#include <stdint.h>
+#include <vector>
+
+struct spi_slave_sim_t;
+
+struct spi_slave_sim_config_t {
+    uint32_t clock_hz = 20000000;       // SPI clock
+    uint32_t transaction_ns = 2000;     // Chip select and host driver overhead of a transaction
+    uint32_t buffer_size = 8192;        // Receive buffer announced in RXSTA
+    uint32_t command_us = 15;           // From WR_DONE to the response being published in TXSTA
+    uint32_t copy_ns_per_byte = 2;      // Added to command_us for the data of MEM_DATA
+    uint32_t ready_us = 5;              // From a response to the next RXSTA toggle
+};
+
+struct spi_slave_sim_stats_t {
+    uint32_t transactions;      // Chip select assertions
+    uint32_t status_polls;      // RXSTA and TXSTA reads
+    uint32_t idle_polls;        // Status reads that found nothing new
+    uint32_t commands;          // Commands executed
+    uint32_t errors;            // Commands answered with an error and protocol violations
+    uint64_t bus_bytes;         // Bytes clocked in either direction, preambles included
+    uint64_t memory_bytes;      // Bytes loaded to RAM
+    uint64_t time_ns;           // Virtual time
+};
+
+spi_slave_sim_t *spi_slave_sim_create(const spi_slave_sim_config_t &config = spi_slave_sim_config_t());
+void spi_slave_sim_destroy(spi_slave_sim_t *sim);
+
+// Contents of RAM written with MEM_DATA, zero where nothing was written
+std::vector<uint8_t> spi_slave_sim_memory(const spi_slave_sim_t *sim, uint32_t address, uint32_t size);
+
+// Entry point of the last MEM_END that ran a program, 0 if none did
+uint32_t spi_slave_sim_entry(const spi_slave_sim_t *sim);
+
+spi_slave_sim_stats_t spi_slave_sim_stats(const spi_slave_sim_t *sim);
+
+/* Port with the simulator as its context, for esp_loader_create(). Entering the bootloader
+   resets the slave, delays and timers run on the virtual time. */
+extern const esp_loader_port_t spi_slave_sim_port;
+
+// Makes the loader_port_*() functions of the default loader act on the simulator
+void spi_slave_sim_bind(spi_slave_sim_t *sim);
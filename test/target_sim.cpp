@@ -0,0 +1,812 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "target_sim.h"
+#include "md5_hash.h"
+#include <zlib.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <thread>
+
+using namespace std;
+
+namespace
+{
+
+const uint8_t SLIP_END = 0xC0;
+const uint8_t SLIP_ESC = 0xDB;
+const uint8_t SLIP_ESC_END = 0xDC;
+const uint8_t SLIP_ESC_ESC = 0xDD;
+
+const uint8_t CMD_FLASH_BEGIN = 0x02;
+const uint8_t CMD_FLASH_DATA = 0x03;
+const uint8_t CMD_FLASH_END = 0x04;
+const uint8_t CMD_MEM_BEGIN = 0x05;
+const uint8_t CMD_MEM_END = 0x06;
+const uint8_t CMD_MEM_DATA = 0x07;
+const uint8_t CMD_SYNC = 0x08;
+const uint8_t CMD_WRITE_REG = 0x09;
+const uint8_t CMD_READ_REG = 0x0A;
+const uint8_t CMD_SPI_SET_PARAMS = 0x0B;
+const uint8_t CMD_SPI_ATTACH = 0x0D;
+const uint8_t CMD_READ_FLASH_ROM = 0x0E;
+const uint8_t CMD_CHANGE_BAUDRATE = 0x0F;
+const uint8_t CMD_FLASH_DEFL_BEGIN = 0x10;
+const uint8_t CMD_FLASH_DEFL_DATA = 0x11;
+const uint8_t CMD_FLASH_DEFL_END = 0x12;
+const uint8_t CMD_SPI_FLASH_MD5 = 0x13;
+const uint8_t CMD_GET_SECURITY_INFO = 0x14;
+const uint8_t CMD_ERASE_FLASH = 0xD0;
+const uint8_t CMD_ERASE_REGION = 0xD1;
+const uint8_t CMD_READ_FLASH_STUB = 0xD2;
+
+const uint8_t ERROR_INVALID_COMMAND = 0x05;
+const uint8_t ERROR_COMMAND_FAILED = 0x06;
+const uint8_t ERROR_INVALID_CRC = 0x07;
+const uint8_t ERROR_DEFLATE = 0x0B;
+
+const uint32_t SECTOR_SIZE = 4096;
+const uint32_t READ_FLASH_ROM_SIZE = 64;
+const uint32_t INITIAL_RATE = 115200;
+
+// ESP32 chip detection and SPI flash registers
+const uint32_t CHIP_DETECT_MAGIC_REG = 0x40001000;
+const uint32_t CHIP_DETECT_MAGIC_ESP32 = 0x00f01d83;
+const uint32_t SPI_CMD_REG = 0x3ff42000;
+const uint32_t SPI_W0_REG = 0x3ff42080;
+const uint32_t SPI_CMD_USR = 1 << 18;
+
+uint32_t read_u32(const uint8_t *data)
+{
+    return data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24;
+}
+
+// Flash ID with the JEDEC capacity code of the flash size
+uint32_t flash_id(uint32_t flash_size)
+{
+    uint32_t capacity = 0;
+    while ((1u << capacity) < flash_size) {
+        capacity++;
+    }
+    return capacity << 16 | 0x4020;
+}
+
+}
+
+struct target_sim_t {
+    vector<uint8_t> flash;
+    map<uint32_t, vector<uint8_t>> memory;   // RAM segments by start address
+    map<uint32_t, uint32_t> regs;
+    target_sim_stats_t stats = {};
+
+    bool stub = false;
+    bool app_running = false;
+    uint32_t rate = INITIAL_RATE;
+
+    vector<uint8_t> rx_frame;
+    bool rx_escape = false;
+    deque<uint8_t> tx;
+
+    // Transfer in progress
+    uint32_t mem_address = 0;
+    uint32_t mem_end = 0;
+    uint32_t write_address = 0;
+    uint32_t write_end = 0;
+    z_stream inflate = {};
+    bool inflating = false;
+
+    // Flash read of the stub, packets are sent while the acknowledged window allows
+    bool reading = false;
+    uint32_t read_address = 0;
+    uint32_t read_total = 0;
+    uint32_t read_sent = 0;
+    uint32_t read_acked = 0;
+    uint32_t read_packet_size = 0;
+    uint32_t read_max_inflight = 0;
+    struct MD5Context read_md5;
+
+    // In-process port
+    chrono::steady_clock::time_point timer_end;
+
+    // Pseudo-terminal
+    int master = -1;
+    int slave = -1;
+    thread server;
+    atomic<bool> stop{false};
+    atomic<bool> reset_requested{false};
+    bool paced = false;
+    chrono::steady_clock::time_point link_due;
+};
+
+namespace
+{
+
+void send_frame(target_sim_t *sim, const uint8_t *data, size_t size)
+{
+    const size_t queued = sim->tx.size();
+    sim->tx.push_back(SLIP_END);
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] == SLIP_END) {
+            sim->tx.push_back(SLIP_ESC);
+            sim->tx.push_back(SLIP_ESC_END);
+        } else if (data[i] == SLIP_ESC) {
+            sim->tx.push_back(SLIP_ESC);
+            sim->tx.push_back(SLIP_ESC_ESC);
+        } else {
+            sim->tx.push_back(data[i]);
+        }
+    }
+    sim->tx.push_back(SLIP_END);
+    sim->stats.sent_bytes += sim->tx.size() - queued;
+}
+
+void respond(target_sim_t *sim, uint8_t command, uint32_t value = 0, const uint8_t *data = NULL,
+             size_t size = 0, uint8_t error = 0)
+{
+    const size_t body_size = size + 2;
+    vector<uint8_t> response = {
+        0x01, command, (uint8_t)body_size, (uint8_t)(body_size >> 8),
+        (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)
+    };
+    response.insert(response.end(), data, data + size);
+    response.push_back(error != 0 ? 1 : 0);
+    response.push_back(error);
+    send_frame(sim, &response[0], response.size());
+
+    if (error != 0) {
+        sim->stats.failed_commands++;
+    }
+}
+
+void fail(target_sim_t *sim, uint8_t command, uint8_t error)
+{
+    respond(sim, command, 0, NULL, 0, error);
+}
+
+bool in_flash(const target_sim_t *sim, uint32_t address, uint32_t size)
+{
+    return (uint64_t)address + size <= sim->flash.size();
+}
+
+void flash_erase(target_sim_t *sim, uint32_t address, uint32_t size)
+{
+    const uint32_t start = address / SECTOR_SIZE * SECTOR_SIZE;
+    const uint32_t end = min<uint64_t>(((uint64_t)address + size + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE,
+                                       sim->flash.size());
+    fill(sim->flash.begin() + start, sim->flash.begin() + end, 0xFF);
+    sim->stats.erased_bytes += end - start;
+}
+
+// Programming only clears bits
+void flash_program(target_sim_t *sim, const uint8_t *data, uint32_t size)
+{
+    size = min(size, sim->write_end - sim->write_address);
+    for (uint32_t i = 0; i < size; i++) {
+        sim->flash[sim->write_address++] &= data[i];
+    }
+    sim->stats.written_bytes += size;
+}
+
+void end_inflate(target_sim_t *sim)
+{
+    if (sim->inflating) {
+        inflateEnd(&sim->inflate);
+        sim->inflating = false;
+    }
+}
+
+// Data commands carry the size, sequence number and two padding words before the data
+bool data_valid(target_sim_t *sim, const vector<uint8_t> &frame, uint32_t &size)
+{
+    if (frame.size() < 24) {
+        return false;
+    }
+
+    size = read_u32(&frame[8]);
+    if (frame.size() < 24 + (size_t)size) {
+        return false;
+    }
+
+    // The stub does not check data checksums
+    if (!sim->stub) {
+        uint8_t checksum = 0xEF;
+        for (uint32_t i = 0; i < size; i++) {
+            checksum ^= frame[24 + i];
+        }
+        return checksum == read_u32(&frame[4]);
+    }
+
+    return true;
+}
+
+void handle_flash_begin(target_sim_t *sim, uint8_t command, const vector<uint8_t> &frame)
+{
+    if (frame.size() < 24) {
+        fail(sim, command, ERROR_INVALID_COMMAND);
+        return;
+    }
+
+    const uint32_t erase_size = read_u32(&frame[8]);
+    const uint32_t offset = read_u32(&frame[20]);
+    if (!in_flash(sim, offset, erase_size)) {
+        fail(sim, command, ERROR_COMMAND_FAILED);
+        return;
+    }
+
+    /* The ROM erases the given size and writes the blocks that follow wherever they go. The stub
+       takes the size as the number of bytes to write and drops the padding of the last block. */
+    flash_erase(sim, offset, erase_size);
+    sim->write_address = offset;
+    sim->write_end = sim->stub ? offset + erase_size : sim->flash.size();
+
+    end_inflate(sim);
+    if (command == CMD_FLASH_DEFL_BEGIN) {
+        memset(&sim->inflate, 0, sizeof(sim->inflate));
+        sim->inflating = inflateInit(&sim->inflate) == Z_OK;
+    }
+
+    respond(sim, command);
+}
+
+void handle_flash_data(target_sim_t *sim, const vector<uint8_t> &frame)
+{
+    uint32_t size;
+    if (!data_valid(sim, frame, size)) {
+        fail(sim, CMD_FLASH_DATA, ERROR_INVALID_CRC);
+        return;
+    }
+
+    flash_program(sim, &frame[24], size);
+    respond(sim, CMD_FLASH_DATA);
+}
+
+void handle_flash_defl_data(target_sim_t *sim, const vector<uint8_t> &frame)
+{
+    uint32_t size;
+    if (!data_valid(sim, frame, size)) {
+        fail(sim, CMD_FLASH_DEFL_DATA, ERROR_INVALID_CRC);
+        return;
+    }
+    if (!sim->inflating) {
+        fail(sim, CMD_FLASH_DEFL_DATA, ERROR_COMMAND_FAILED);
+        return;
+    }
+
+    sim->inflate.next_in = (Bytef *)&frame[24];
+    sim->inflate.avail_in = size;
+
+    // Inflates until the output is not filled up, which means that all input has been consumed
+    int result;
+    uint8_t out[16384];
+    do {
+        sim->inflate.next_out = out;
+        sim->inflate.avail_out = sizeof(out);
+        result = inflate(&sim->inflate, Z_NO_FLUSH);
+        flash_program(sim, out, sizeof(out) - sim->inflate.avail_out);
+    } while (result == Z_OK && sim->inflate.avail_out == 0);
+
+    // Running out of output space exactly at the end of the input is no error
+    const bool failed = result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR;
+    respond(sim, CMD_FLASH_DEFL_DATA, 0, NULL, 0, failed ? ERROR_DEFLATE : 0);
+}
+
+void handle_flash_end(target_sim_t *sim, uint8_t command, const vector<uint8_t> &frame)
+{
+    end_inflate(sim);
+    respond(sim, command);
+
+    // A reboot starts the application, which does not speak the protocol
+    if (frame.size() >= 12 && read_u32(&frame[8]) == 0) {
+        sim->app_running = true;
+    }
+}
+
+void handle_mem_data(target_sim_t *sim, const vector<uint8_t> &frame)
+{
+    uint32_t size;
+    if (!data_valid(sim, frame, size)) {
+        fail(sim, CMD_MEM_DATA, ERROR_INVALID_CRC);
+        return;
+    }
+    if (sim->mem_address + size > sim->mem_end) {
+        fail(sim, CMD_MEM_DATA, ERROR_COMMAND_FAILED);
+        return;
+    }
+
+    vector<uint8_t> &segment = sim->memory[sim->mem_address];
+    segment.assign(frame.begin() + 24, frame.begin() + 24 + size);
+    sim->mem_address += size;
+    respond(sim, CMD_MEM_DATA);
+}
+
+void handle_mem_end(target_sim_t *sim, const vector<uint8_t> &frame)
+{
+    respond(sim, CMD_MEM_END);
+
+    // Whatever is started from RAM is taken for the flasher stub
+    if (frame.size() >= 16 && read_u32(&frame[8]) == 0) {
+        sim->stub = true;
+        send_frame(sim, (const uint8_t *)"OHAI", 4);
+    }
+}
+
+void handle_md5(target_sim_t *sim, const vector<uint8_t> &frame)
+{
+    if (frame.size() < 16) {
+        fail(sim, CMD_SPI_FLASH_MD5, ERROR_INVALID_COMMAND);
+        return;
+    }
+
+    const uint32_t address = read_u32(&frame[8]);
+    const uint32_t size = read_u32(&frame[12]);
+    if (!in_flash(sim, address, size)) {
+        fail(sim, CMD_SPI_FLASH_MD5, ERROR_COMMAND_FAILED);
+        return;
+    }
+
+    uint8_t digest[16];
+    struct MD5Context context;
+    MD5Init(&context);
+    MD5Update(&context, &sim->flash[address], size);
+    MD5Final(digest, &context);
+    sim->stats.read_bytes += size;
+
+    if (sim->stub) {
+        respond(sim, CMD_SPI_FLASH_MD5, 0, digest, sizeof(digest));
+    } else {
+        char hex[33];
+        for (int i = 0; i < 16; i++) {
+            snprintf(&hex[i * 2], 3, "%02x", digest[i]);
+        }
+        respond(sim, CMD_SPI_FLASH_MD5, 0, (const uint8_t *)hex, 32);
+    }
+}
+
+void handle_read_flash_stub(target_sim_t *sim, const vector<uint8_t> &frame)
+{
+    if (frame.size() < 24) {
+        fail(sim, CMD_READ_FLASH_STUB, ERROR_INVALID_COMMAND);
+        return;
+    }
+
+    sim->read_address = read_u32(&frame[8]);
+    sim->read_total = read_u32(&frame[12]);
+    sim->read_packet_size = read_u32(&frame[16]);
+    sim->read_max_inflight = read_u32(&frame[20]);
+    if (!in_flash(sim, sim->read_address, sim->read_total) || sim->read_packet_size == 0 ||
+            sim->read_max_inflight == 0) {
+        fail(sim, CMD_READ_FLASH_STUB, ERROR_COMMAND_FAILED);
+        return;
+    }
+
+    sim->reading = true;
+    sim->read_sent = 0;
+    sim->read_acked = 0;
+    MD5Init(&sim->read_md5);
+    respond(sim, CMD_READ_FLASH_STUB);
+}
+
+void handle_command(target_sim_t *sim, const vector<uint8_t> &frame)
+{
+    const uint8_t command = frame[1];
+    sim->stats.commands++;
+
+    if (command == CMD_SYNC) {
+        // The ROM answers a sync several times, the stub once
+        for (int i = 0; i < (sim->stub ? 1 : 8); i++) {
+            respond(sim, command);
+        }
+    } else if (command == CMD_READ_REG && frame.size() >= 12) {
+        const uint32_t address = read_u32(&frame[8]);
+        respond(sim, command, address == CHIP_DETECT_MAGIC_REG ? CHIP_DETECT_MAGIC_ESP32 : sim->regs[address]);
+    } else if (command == CMD_WRITE_REG && frame.size() >= 16) {
+        const uint32_t address = read_u32(&frame[8]);
+        const uint32_t value = read_u32(&frame[12]);
+        if (address == SPI_CMD_REG && (value & SPI_CMD_USR) != 0) {
+            // The only SPI command sent is reading the flash ID, which completes immediately
+            sim->regs[SPI_W0_REG] = flash_id(sim->flash.size());
+        } else {
+            sim->regs[address] = value;
+        }
+        respond(sim, command);
+    } else if (command == CMD_SPI_SET_PARAMS || command == CMD_SPI_ATTACH) {
+        respond(sim, command);
+    } else if (command == CMD_GET_SECURITY_INFO) {
+        // Not supported by the ESP32 ROM
+        fail(sim, command, ERROR_INVALID_COMMAND);
+    } else if (command == CMD_CHANGE_BAUDRATE && frame.size() >= 12) {
+        // Acknowledged at the old rate
+        respond(sim, command);
+        sim->rate = read_u32(&frame[8]);
+    } else if (command == CMD_MEM_BEGIN && frame.size() >= 24) {
+        sim->mem_address = read_u32(&frame[20]);
+        sim->mem_end = sim->mem_address + read_u32(&frame[8]);
+        respond(sim, command);
+    } else if (command == CMD_MEM_DATA) {
+        handle_mem_data(sim, frame);
+    } else if (command == CMD_MEM_END) {
+        handle_mem_end(sim, frame);
+    } else if (command == CMD_FLASH_BEGIN || command == CMD_FLASH_DEFL_BEGIN) {
+        handle_flash_begin(sim, command, frame);
+    } else if (command == CMD_FLASH_DATA) {
+        handle_flash_data(sim, frame);
+    } else if (command == CMD_FLASH_DEFL_DATA) {
+        handle_flash_defl_data(sim, frame);
+    } else if (command == CMD_FLASH_END || command == CMD_FLASH_DEFL_END) {
+        handle_flash_end(sim, command, frame);
+    } else if (command == CMD_SPI_FLASH_MD5) {
+        handle_md5(sim, frame);
+    } else if (command == CMD_READ_FLASH_ROM && !sim->stub && frame.size() >= 16) {
+        const uint32_t address = read_u32(&frame[8]);
+        if (!in_flash(sim, address, READ_FLASH_ROM_SIZE)) {
+            fail(sim, command, ERROR_COMMAND_FAILED);
+            return;
+        }
+        respond(sim, command, 0, &sim->flash[address], READ_FLASH_ROM_SIZE);
+        sim->stats.read_bytes += READ_FLASH_ROM_SIZE;
+    } else if (command == CMD_ERASE_FLASH && sim->stub) {
+        flash_erase(sim, 0, sim->flash.size());
+        respond(sim, command);
+    } else if (command == CMD_ERASE_REGION && sim->stub && frame.size() >= 16) {
+        const uint32_t address = read_u32(&frame[8]);
+        const uint32_t size = read_u32(&frame[12]);
+        if (address % SECTOR_SIZE != 0 || size % SECTOR_SIZE != 0 || !in_flash(sim, address, size)) {
+            fail(sim, command, ERROR_COMMAND_FAILED);
+            return;
+        }
+        flash_erase(sim, address, size);
+        respond(sim, command);
+    } else if (command == CMD_READ_FLASH_STUB && sim->stub) {
+        handle_read_flash_stub(sim, frame);
+    } else {
+        fail(sim, command, ERROR_INVALID_COMMAND);
+    }
+}
+
+void handle_frame(target_sim_t *sim, const vector<uint8_t> &frame)
+{
+    // While reading flash, the host only sends the acknowledged length
+    if (sim->reading) {
+        if (frame.size() == 4) {
+            sim->read_acked = read_u32(&frame[0]);
+        }
+        return;
+    }
+
+    if (sim->app_running || frame.size() < 8 || frame[0] != 0x00) {
+        return;
+    }
+
+    handle_command(sim, frame);
+}
+
+// Queues the next packet of a flash read if the window allows it, returns false otherwise
+bool read_step(target_sim_t *sim)
+{
+    if (!sim->reading) {
+        return false;
+    }
+
+    if (sim->read_sent < sim->read_total &&
+            sim->read_sent - sim->read_acked < sim->read_packet_size * sim->read_max_inflight) {
+        const uint32_t size = min(sim->read_packet_size, sim->read_total - sim->read_sent);
+        const uint8_t *data = &sim->flash[sim->read_address + sim->read_sent];
+        MD5Update(&sim->read_md5, data, size);
+        send_frame(sim, data, size);
+        sim->stats.read_bytes += size;
+        sim->read_sent += size;
+        return true;
+    }
+
+    if (sim->read_acked >= sim->read_total) {
+        uint8_t digest[16];
+        MD5Final(digest, &sim->read_md5);
+        send_frame(sim, digest, sizeof(digest));
+        sim->reading = false;
+        return true;
+    }
+
+    return false;
+}
+
+}
+
+target_sim_t *target_sim_create(uint32_t flash_size)
+{
+    target_sim_t *sim = new target_sim_t;
+    sim->flash.assign(flash_size, 0xFF);
+    return sim;
+}
+
+void target_sim_destroy(target_sim_t *sim)
+{
+    target_sim_pty_stop(sim);
+    end_inflate(sim);
+    delete sim;
+}
+
+void target_sim_reset(target_sim_t *sim)
+{
+    end_inflate(sim);
+    sim->stub = false;
+    sim->app_running = false;
+    sim->rate = INITIAL_RATE;
+    sim->reading = false;
+    sim->regs.clear();
+    sim->rx_frame.clear();
+    sim->rx_escape = false;
+    sim->tx.clear();
+    sim->stats.resets++;
+}
+
+void target_sim_receive(target_sim_t *sim, const uint8_t *data, size_t size)
+{
+    sim->stats.received_bytes += size;
+
+    for (size_t i = 0; i < size; i++) {
+        const uint8_t byte = data[i];
+        if (byte == SLIP_END) {
+            if (!sim->rx_frame.empty()) {
+                vector<uint8_t> frame;
+                frame.swap(sim->rx_frame);
+                handle_frame(sim, frame);
+            }
+        } else if (sim->rx_escape) {
+            sim->rx_frame.push_back(byte == SLIP_ESC_END ? SLIP_END : SLIP_ESC);
+            sim->rx_escape = false;
+        } else if (byte == SLIP_ESC) {
+            sim->rx_escape = true;
+        } else {
+            sim->rx_frame.push_back(byte);
+        }
+    }
+}
+
+size_t target_sim_transmit(target_sim_t *sim, uint8_t *data, size_t size)
+{
+    while (sim->tx.size() < size && read_step(sim)) {
+    }
+
+    const size_t taken = min(size, sim->tx.size());
+    copy(sim->tx.begin(), sim->tx.begin() + taken, data);
+    sim->tx.erase(sim->tx.begin(), sim->tx.begin() + taken);
+    return taken;
+}
+
+vector<uint8_t> &target_sim_flash(target_sim_t *sim)
+{
+    return sim->flash;
+}
+
+vector<uint8_t> target_sim_memory(const target_sim_t *sim, uint32_t address, uint32_t size)
+{
+    vector<uint8_t> contents(size, 0);
+    for (const auto &segment : sim->memory) {
+        const uint64_t start = max<uint64_t>(segment.first, address);
+        const uint64_t end = min<uint64_t>((uint64_t)segment.first + segment.second.size(), (uint64_t)address + size);
+        for (uint64_t at = start; at < end; at++) {
+            contents[at - address] = segment.second[at - segment.first];
+        }
+    }
+    return contents;
+}
+
+bool target_sim_stub_running(const target_sim_t *sim)
+{
+    return sim->stub;
+}
+
+uint32_t target_sim_transmission_rate(const target_sim_t *sim)
+{
+    return sim->rate;
+}
+
+target_sim_stats_t target_sim_stats(const target_sim_t *sim)
+{
+    return sim->stats;
+}
+
+
+namespace
+{
+
+esp_loader_error_t port_write(void *context, const uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    target_sim_receive((target_sim_t *)context, data, size);
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t port_read(void *context, uint8_t *data, uint16_t size, uint32_t timeout)
+{
+    target_sim_t *sim = (target_sim_t *)context;
+
+    while (sim->tx.size() < size && read_step(sim)) {
+    }
+    if (sim->tx.size() < size) {
+        return ESP_LOADER_ERROR_TIMEOUT;
+    }
+
+    target_sim_transmit(sim, data, size);
+    return ESP_LOADER_SUCCESS;
+}
+
+esp_loader_error_t port_read_some(void *context, uint8_t *data, uint16_t size, uint32_t timeout,
+                                  uint16_t *received)
+{
+    *received = target_sim_transmit((target_sim_t *)context, data, size);
+    return *received > 0 ? ESP_LOADER_SUCCESS : ESP_LOADER_ERROR_TIMEOUT;
+}
+
+esp_loader_error_t port_change_transmission_rate(void *context, uint32_t baudrate)
+{
+    return ESP_LOADER_SUCCESS;
+}
+
+void port_delay_ms(void *context, uint32_t ms)
+{
+}
+
+void port_start_timer(void *context, uint32_t ms)
+{
+    ((target_sim_t *)context)->timer_end = chrono::steady_clock::now() + chrono::milliseconds(ms);
+}
+
+uint32_t port_remaining_time(void *context)
+{
+    const auto remaining = ((target_sim_t *)context)->timer_end - chrono::steady_clock::now();
+    return max<int64_t>(chrono::duration_cast<chrono::milliseconds>(remaining).count(), 0);
+}
+
+void port_reset(void *context)
+{
+    target_sim_reset((target_sim_t *)context);
+}
+
+uint32_t port_get_time_ms(void *context)
+{
+    return chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+esp_loader_port_t make_port()
+{
+    esp_loader_port_t port = {};
+    port.write = port_write;
+    port.read = port_read;
+    port.change_transmission_rate = port_change_transmission_rate;
+    port.read_some = port_read_some;
+    port.delay_ms = port_delay_ms;
+    port.start_timer = port_start_timer;
+    port.remaining_time = port_remaining_time;
+    port.enter_bootloader = port_reset;
+    port.reset_target = port_reset;
+    port.get_time_ms = port_get_time_ms;
+    return port;
+}
+
+// Holds the serving thread until the bytes would have passed a serial link at the current rate
+void pace(target_sim_t *sim, size_t size)
+{
+    if (sim->paced) {
+        const chrono::duration<double> wire_time(size * 10.0 / sim->rate);
+        sim->link_due = max(sim->link_due, chrono::steady_clock::now()) +
+                        chrono::duration_cast<chrono::steady_clock::duration>(wire_time);
+        this_thread::sleep_until(sim->link_due);
+    }
+}
+
+void pty_serve(target_sim_t *sim)
+{
+    uint8_t buffer[4096];
+
+    while (!sim->stop) {
+        if (sim->reset_requested) {
+            target_sim_reset(sim);
+            sim->reset_requested = false;
+        }
+
+        pollfd request = { sim->master, POLLIN, 0 };
+        if (poll(&request, 1, 10) > 0) {
+            const ssize_t received = read(sim->master, buffer, sizeof(buffer));
+            if (received > 0) {
+                pace(sim, received);
+                target_sim_receive(sim, buffer, received);
+            }
+        }
+
+        for (size_t size; (size = target_sim_transmit(sim, buffer, sizeof(buffer))) > 0; ) {
+            pace(sim, size);
+            for (size_t written = 0; written < size; ) {
+                const ssize_t result = write(sim->master, &buffer[written], size - written);
+                if (result <= 0) {
+                    break;
+                }
+                written += result;
+            }
+        }
+    }
+}
+
+}
+
+const esp_loader_port_t target_sim_port = make_port();
+
+bool target_sim_pty_start(target_sim_t *sim, string &device, bool paced)
+{
+    sim->master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (sim->master < 0 || grantpt(sim->master) != 0 || unlockpt(sim->master) != 0) {
+        target_sim_pty_stop(sim);
+        return false;
+    }
+    device = ptsname(sim->master);
+
+    // Holding the slave side open keeps the master from seeing a hang up before the host opens it
+    sim->slave = open(device.c_str(), O_RDWR | O_NOCTTY);
+    if (sim->slave < 0) {
+        target_sim_pty_stop(sim);
+        return false;
+    }
+
+    struct termios options;
+    tcgetattr(sim->slave, &options);
+    cfmakeraw(&options);
+    tcsetattr(sim->slave, TCSANOW, &options);
+
+    target_sim_reset(sim);
+    sim->stop = false;
+    sim->reset_requested = false;
+    sim->paced = paced;
+    sim->link_due = chrono::steady_clock::now();
+    sim->server = thread(pty_serve, sim);
+    return true;
+}
+
+void target_sim_pty_reset(target_sim_t *sim)
+{
+    if (!sim->server.joinable()) {
+        target_sim_reset(sim);
+        return;
+    }
+
+    sim->reset_requested = true;
+    while (sim->reset_requested) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+}
+
+void target_sim_pty_stop(target_sim_t *sim)
+{
+    sim->stop = true;
+    if (sim->server.joinable()) {
+        sim->server.join();
+    }
+    if (sim->slave >= 0) {
+        close(sim->slave);
+        sim->slave = -1;
+    }
+    if (sim->master >= 0) {
+        close(sim->master);
+        sim->master = -1;
+    }
+}
@@ -0,0 +1,88 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Software ESP32 target for host tests and benchmarks.
+ *
+ * The simulator speaks the serial protocol of the ESP32 ROM loader and, once a program has been
+ * uploaded to RAM and started, of the flasher stub. Its flash is an array that writes only clear
+ * bits of, as on NOR flash, so regions written without being erased end up corrupted.
+ *
+ * ROM: SYNC, READ_REG, WRITE_REG with the SPI flash ID command, SPI_SET_PARAMS, SPI_ATTACH,
+ *      MEM_BEGIN/DATA/END, FLASH_BEGIN/DATA/END, FLASH_DEFL_BEGIN/DATA/END, SPI_FLASH_MD5 as a hex
+ *      string, READ_FLASH_ROM, CHANGE_BAUDRATE, and GET_SECURITY_INFO failing like on the ESP32.
+ * Stub: the above with raw MD5 digests and without data checksums, ERASE_FLASH, ERASE_REGION and
+ *       READ_FLASH_STUB with its acknowledged window, after sending OHAI. The size of a flash begin
+ *       is the number of bytes written, data beyond it is dropped.
+ *
+ * Bytes are exchanged either in-process, through the target_sim_port functions, or over a
+ * pseudo-terminal served by a thread, which the host opens like a serial adapter. */
+
+#pragma once
+
+#include "esp_loader_io.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+struct target_sim_t;
+
+struct target_sim_stats_t {
+    uint32_t commands;          // Commands handled
+    uint32_t failed_commands;   // Commands answered with an error
+    uint32_t resets;            // Resets into the ROM loader
+    uint64_t received_bytes;    // Bytes from the host, SLIP encoded
+    uint64_t sent_bytes;        // Bytes to the host, SLIP encoded
+    uint64_t erased_bytes;      // Flash erased, in whole sectors
+    uint64_t written_bytes;     // Flash written, after decompression
+    uint64_t read_bytes;        // Flash read, for the host or for MD5 digests
+};
+
+target_sim_t *target_sim_create(uint32_t flash_size = 4 * 1024 * 1024);
+void target_sim_destroy(target_sim_t *sim);
+
+// Resets the target into the ROM loader, the flash is kept
+void target_sim_reset(target_sim_t *sim);
+
+// Passes bytes sent by the host, responses are queued until taken by target_sim_transmit()
+void target_sim_receive(target_sim_t *sim, const uint8_t *data, size_t size);
+
+// Takes up to size bytes of queued responses and flash read packets, returns the number taken
+size_t target_sim_transmit(target_sim_t *sim, uint8_t *data, size_t size);
+
+std::vector<uint8_t> &target_sim_flash(target_sim_t *sim);
+
+// Contents of RAM written with MEM_DATA, zero where nothing was written
+std::vector<uint8_t> target_sim_memory(const target_sim_t *sim, uint32_t address, uint32_t size);
+
+bool target_sim_stub_running(const target_sim_t *sim);
+uint32_t target_sim_transmission_rate(const target_sim_t *sim);
+target_sim_stats_t target_sim_stats(const target_sim_t *sim);
+
+/* In-process port, with the simulator as the port context. Reads return a timeout at once when
+   nothing is queued, delays return at once and entering the bootloader resets the simulator.
+   Debug messages are dropped, as the tests provoke errors on purpose. */
+extern const esp_loader_port_t target_sim_port;
+
+/* Serves the simulator on a new pseudo-terminal from a thread and sets device to the path of its
+   slave side. The thread has the simulator to itself until target_sim_pty_stop(). With paced,
+   bytes pass in both directions no faster than over a serial link at the current rate of the
+   target, in real time. */
+bool target_sim_pty_start(target_sim_t *sim, std::string &device, bool paced = false);
+void target_sim_pty_stop(target_sim_t *sim);
+
+/* There are no modem lines on a pseudo-terminal, so the host resets a served target with this
+   instead. Returns once the serving thread has reset it. */
+void target_sim_pty_reset(target_sim_t *sim);
@@ -0,0 +1,377 @@
+/* Copyright 2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "catch.hpp"
+#include "target_sim.h"
+#include "linux_port.h"
+#include "esp_loader.h"
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+
+#define ESP_ERR_CHECK(exp) REQUIRE( (exp) == ESP_LOADER_SUCCESS )
+
+namespace
+{
+
+const uint32_t APP_ADDRESS = 0x10000;
+
+// Selects a loader driving the simulator for the lifetime of the object
+struct sim_loader_t {
+    esp_loader_t *loader;
+
+    sim_loader_t(const esp_loader_port_t *port, void *context)
+    {
+        loader = esp_loader_create(port, context);
+        REQUIRE( loader != NULL );
+        esp_loader_select(loader);
+    }
+
+    ~sim_loader_t()
+    {
+        esp_loader_select(NULL);
+        esp_loader_destroy(loader);
+    }
+};
+
+vector<uint8_t> make_image(uint32_t size)
+{
+    vector<uint8_t> image(size);
+    mt19937 generator(20);
+    for (auto &byte : image) {
+        // Half of the bytes repeat, so that the image compresses somewhat
+        byte = generator() % 2 ? generator() & 0xFF : 0x55;
+    }
+    return image;
+}
+
+bool flash_holds(target_sim_t *sim, const vector<uint8_t> &image, uint32_t address)
+{
+    const vector<uint8_t> &flash = target_sim_flash(sim);
+    return equal(image.begin(), image.end(), flash.begin() + address);
+}
+
+void flash_plain(const vector<uint8_t> &image, uint32_t address)
+{
+    const uint32_t block_size = 1024;
+
+    ESP_ERR_CHECK( esp_loader_flash_start(address, image.size(), block_size) );
+    for (size_t offset = 0; offset < image.size(); offset += block_size) {
+        ESP_ERR_CHECK( esp_loader_flash_write(&image[offset], min<size_t>(block_size, image.size() - offset)) );
+    }
+    ESP_ERR_CHECK( esp_loader_flash_verify() );
+}
+
+esp_loader_error_t read_image(void *context, uint32_t offset, void *buffer, uint32_t size)
+{
+    auto image = static_cast<const vector<uint8_t> *>(context);
+    copy_n(image->begin() + offset, size, static_cast<uint8_t *>(buffer));
+    return ESP_LOADER_SUCCESS;
+}
+
+void flash_deflated(const vector<uint8_t> &image, uint32_t address)
+{
+    ESP_ERR_CHECK( esp_loader_flash_deflate_start(address, image.size(), -1) );
+    for (size_t offset = 0; offset < image.size(); offset += 4096) {
+        ESP_ERR_CHECK( esp_loader_flash_deflate_write(&image[offset], min<size_t>(4096, image.size() - offset)) );
+    }
+    ESP_ERR_CHECK( esp_loader_flash_verify() );
+}
+
+}
+
+TEST_CASE( "Simulated ROM loader flashes and verifies without the stub" )
+{
+    target_sim_t *sim = target_sim_create();
+    const vector<uint8_t> image = make_image(50000);
+
+    {
+        sim_loader_t loader(&target_sim_port, sim);
+        esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+
+        ESP_ERR_CHECK( esp_loader_connect(&connect_config) );
+        REQUIRE( esp_loader_get_target() == ESP32_CHIP );
+        REQUIRE( !target_sim_stub_running(sim) );
+
+        flash_plain(image, APP_ADDRESS);
+
+        // The ROM reads flash in 64 byte commands, the read does not have to be aligned
+        vector<uint8_t> read_back(1000);
+        ESP_ERR_CHECK( esp_loader_flash_read(&read_back[0], APP_ADDRESS + 333, read_back.size()) );
+        REQUIRE( equal(read_back.begin(), read_back.end(), image.begin() + 333) );
+
+        // Erasing a region is for the stub only
+        REQUIRE( esp_loader_erase_region(APP_ADDRESS, 4096) != ESP_LOADER_SUCCESS );
+    }
+
+    REQUIRE( flash_holds(sim, image, APP_ADDRESS) );
+    REQUIRE( target_sim_stats(sim).written_bytes >= image.size() );
+    target_sim_destroy(sim);
+}
+
+TEST_CASE( "Simulated stub flashes compressed images, reads and erases" )
+{
+    target_sim_t *sim = target_sim_create();
+    const vector<uint8_t> image = make_image(200000);
+
+    {
+        sim_loader_t loader(&target_sim_port, sim);
+        esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+
+        ESP_ERR_CHECK( esp_loader_connect_with_stub(&connect_config) );
+        REQUIRE( target_sim_stub_running(sim) );
+
+        flash_deflated(image, APP_ADDRESS);
+        REQUIRE( target_sim_stats(sim).received_bytes < image.size() );
+
+        vector<uint8_t> read_back(image.size());
+        ESP_ERR_CHECK( esp_loader_flash_read(&read_back[0], APP_ADDRESS, read_back.size()) );
+        REQUIRE( read_back == image );
+
+        ESP_ERR_CHECK( esp_loader_erase_region(APP_ADDRESS, 4096) );
+    }
+
+    const vector<uint8_t> &flash = target_sim_flash(sim);
+    REQUIRE( all_of(flash.begin() + APP_ADDRESS, flash.begin() + APP_ADDRESS + 4096,
+    [](uint8_t byte) {
+        return byte == 0xFF;
+    }) );
+    REQUIRE( equal(image.begin() + 4096, image.end(), flash.begin() + APP_ADDRESS + 4096) );
+    target_sim_destroy(sim);
+}
+
+TEST_CASE( "Simulated stub writes no more than the size of the flash begin" )
+{
+    target_sim_t *sim = target_sim_create();
+
+    {
+        sim_loader_t loader(&target_sim_port, sim);
+        esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+
+        ESP_ERR_CHECK( esp_loader_connect_with_stub(&connect_config) );
+
+        // The rest of the block is dropped like the padding of a last block
+        const vector<uint8_t> block(1024, 0x00);
+        ESP_ERR_CHECK( esp_loader_flash_start(APP_ADDRESS, 8, block.size()) );
+        ESP_ERR_CHECK( esp_loader_flash_write(&block[0], block.size()) );
+    }
+
+    REQUIRE( flash_holds(sim, vector<uint8_t>(8, 0x00), APP_ADDRESS) );
+    REQUIRE( flash_holds(sim, vector<uint8_t>(1016, 0xFF), APP_ADDRESS + 8) );
+    REQUIRE( target_sim_stats(sim).written_bytes == 8 );
+    target_sim_destroy(sim);
+}
+
+TEST_CASE( "Images pulled from a source are flashed and verified compressed and uncompressed" )
+{
+    // Not a multiple of the block size or of 4, the last block is padded
+    const vector<uint8_t> image = make_image(50001);
+
+    for (const bool with_stub : { false, true }) {
+        for (const bool compress : { false, true }) {
+            INFO( "stub " << with_stub << ", compressed " << compress );
+            target_sim_t *sim = target_sim_create();
+
+            {
+                sim_loader_t loader(&target_sim_port, sim);
+                esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+
+                if (with_stub) {
+                    ESP_ERR_CHECK( esp_loader_connect_with_stub(&connect_config) );
+                } else {
+                    ESP_ERR_CHECK( esp_loader_connect(&connect_config) );
+                }
+
+                const target_sim_stats_t before = target_sim_stats(sim);
+                ESP_ERR_CHECK( esp_loader_flash_source(APP_ADDRESS, image.size(), compress, read_image,
+                                                       (void *)&image) );
+                const target_sim_stats_t after = target_sim_stats(sim);
+
+                if (compress) {
+                    REQUIRE( after.received_bytes - before.received_bytes < image.size() );
+                } else {
+                    REQUIRE( after.received_bytes - before.received_bytes > image.size() );
+                }
+                // The library checked the MD5 digest of the written image
+                REQUIRE( after.read_bytes - before.read_bytes >= image.size() );
+
+                // The target is still in the loader for the next image
+                flash_plain(vector<uint8_t>(4096, 0x00), APP_ADDRESS + 0x20000);
+            }
+
+            REQUIRE( flash_holds(sim, image, APP_ADDRESS) );
+            REQUIRE( flash_holds(sim, vector<uint8_t>(3, 0xFF), APP_ADDRESS + image.size()) );
+            REQUIRE( flash_holds(sim, vector<uint8_t>(4096, 0x00), APP_ADDRESS + 0x20000) );
+            target_sim_destroy(sim);
+        }
+    }
+}
+
+TEST_CASE( "Chip erase threshold never erases images written earlier in the session" )
+{
+    // The sim test is built with SERIAL_FLASHER_CHIP_ERASE_THRESHOLD=50, the app covers 57 % of the flash
+    const uint32_t flash_size = 1024 * 1024;
+    const uint32_t old_data_address = 0xF0000;
+    const vector<uint8_t> bootloader = make_image(20000);
+    const vector<uint8_t> partition_table = make_image(3072);
+    const vector<uint8_t> app = make_image(600000);
+
+    SECTION( "Bootloader and partition table survive the app" ) {
+        target_sim_t *sim = target_sim_create(flash_size);
+
+        {
+            sim_loader_t loader(&target_sim_port, sim);
+            esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+
+            ESP_ERR_CHECK( esp_loader_connect_with_stub(&connect_config) );
+            flash_deflated(bootloader, 0x1000);
+            flash_deflated(partition_table, 0x8000);
+            flash_deflated(app, APP_ADDRESS);
+        }
+
+        REQUIRE( flash_holds(sim, bootloader, 0x1000) );
+        REQUIRE( flash_holds(sim, partition_table, 0x8000) );
+        REQUIRE( flash_holds(sim, app, APP_ADDRESS) );
+        REQUIRE( target_sim_stats(sim).erased_bytes < flash_size );
+        target_sim_destroy(sim);
+    }
+
+    SECTION( "The first image of the session erases the chip" ) {
+        target_sim_t *sim = target_sim_create(flash_size);
+        fill_n(target_sim_flash(sim).begin() + old_data_address, 4096, 0x00);
+
+        {
+            sim_loader_t loader(&target_sim_port, sim);
+            esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+
+            ESP_ERR_CHECK( esp_loader_connect_with_stub(&connect_config) );
+            flash_deflated(app, APP_ADDRESS);
+            flash_deflated(bootloader, 0x1000);
+        }
+
+        REQUIRE( flash_holds(sim, app, APP_ADDRESS) );
+        REQUIRE( flash_holds(sim, bootloader, 0x1000) );
+        REQUIRE( flash_holds(sim, vector<uint8_t>(4096, 0xFF), old_data_address) );
+        REQUIRE( target_sim_stats(sim).erased_bytes >= flash_size );
+        target_sim_destroy(sim);
+    }
+}
+
+TEST_CASE( "Link autotuning only takes candidate rates in increasing order" )
+{
+    target_sim_t *sim = target_sim_create();
+
+    {
+        sim_loader_t loader(&target_sim_port, sim);
+        esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+        esp_loader_autotune_result_t result;
+
+        ESP_ERR_CHECK( esp_loader_connect(&connect_config) );
+
+        const uint32_t descending[] = { 921600, 460800 };
+        const uint32_t repeated[] = { 460800, 460800 };
+        REQUIRE( esp_loader_autotune_link(115200, descending, 2, &result) == ESP_LOADER_ERROR_INVALID_PARAM );
+        REQUIRE( esp_loader_autotune_link(115200, repeated, 2, &result) == ESP_LOADER_ERROR_INVALID_PARAM );
+        REQUIRE( esp_loader_autotune_link(115200, descending, 0, &result) == ESP_LOADER_ERROR_INVALID_PARAM );
+        REQUIRE( target_sim_transmission_rate(sim) == 115200 );
+
+        // Whether the rate is kept depends on the throughput measured in real time
+        const uint32_t ascending[] = { 230400, 460800 };
+        ESP_ERR_CHECK( esp_loader_autotune_link(115200, ascending, 2, &result) );
+        REQUIRE( target_sim_transmission_rate(sim) == result.transmission_rate );
+    }
+
+    target_sim_destroy(sim);
+}
+
+TEST_CASE( "Simulated flash only clears bits on writes" )
+{
+    target_sim_t *sim = target_sim_create();
+    const vector<uint8_t> image = make_image(4096);
+
+    {
+        sim_loader_t loader(&target_sim_port, sim);
+        esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+
+        ESP_ERR_CHECK( esp_loader_connect(&connect_config) );
+
+        // Zeroes the region, so that only an erase lets the image be written
+        vector<uint8_t> &flash = target_sim_flash(sim);
+        fill(flash.begin() + APP_ADDRESS, flash.begin() + APP_ADDRESS + image.size(), 0x00);
+        flash_plain(image, APP_ADDRESS);
+    }
+
+    REQUIRE( flash_holds(sim, image, APP_ADDRESS) );
+    target_sim_destroy(sim);
+}
+
+TEST_CASE( "Simulated ROM loader keeps what is loaded to RAM" )
+{
+    target_sim_t *sim = target_sim_create();
+    const vector<uint8_t> program = make_image(3000);
+    const uint32_t address = 0x3ffb0000;
+
+    {
+        sim_loader_t loader(&target_sim_port, sim);
+        esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+
+        ESP_ERR_CHECK( esp_loader_connect(&connect_config) );
+        ESP_ERR_CHECK( esp_loader_mem_start(address, program.size(), 1024) );
+        for (size_t offset = 0; offset < program.size(); offset += 1024) {
+            ESP_ERR_CHECK( esp_loader_mem_write(&program[offset], min<size_t>(1024, program.size() - offset)) );
+        }
+    }
+
+    REQUIRE( target_sim_memory(sim, address, program.size()) == program );
+    target_sim_destroy(sim);
+}
+
+TEST_CASE( "Simulated target is flashed over a pseudo-terminal" )
+{
+    target_sim_t *sim = target_sim_create();
+    const vector<uint8_t> image = make_image(100000);
+
+    string device;
+    REQUIRE( target_sim_pty_start(sim, device) );
+
+    loader_linux_port_t port;
+    const loader_linux_config_t config = { device.c_str(), 115200 };
+    ESP_ERR_CHECK( loader_port_linux_open(&port, &config) );
+
+    {
+        sim_loader_t loader(&loader_port_linux, &port);
+        esp_loader_connect_args_t connect_config = ESP_LOADER_CONNECT_DEFAULT();
+
+        ESP_ERR_CHECK( esp_loader_connect_with_stub(&connect_config) );
+        ESP_ERR_CHECK( esp_loader_change_transmission_rate_stub(115200, 921600) );
+        ESP_ERR_CHECK( loader_port_linux.change_transmission_rate(&port, 921600) );
+
+        flash_deflated(image, APP_ADDRESS);
+
+        vector<uint8_t> read_back(image.size());
+        ESP_ERR_CHECK( esp_loader_flash_read(&read_back[0], APP_ADDRESS, read_back.size()) );
+        REQUIRE( read_back == image );
+    }
+
+    loader_port_linux_close(&port);
+    target_sim_pty_stop(sim);
+
+    REQUIRE( target_sim_transmission_rate(sim) == 921600 );
+    REQUIRE( flash_holds(sim, image, APP_ADDRESS) );
+    target_sim_destroy(sim);
+}
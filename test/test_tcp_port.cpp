@@ -150,6 +150,44 @@ esp_loader_error_t loader_port_read(uint8_t *data, uint16_t size, uint32_t timeo
     return ESP_LOADER_SUCCESS;
 }
 
+esp_loader_error_t loader_port_read_some(uint8_t *data, uint16_t size, uint32_t timeout,
+                                         uint16_t *received)
+{
+    const struct timeval timeout_values = {
+        .tv_sec = timeout / 1000,
+        .tv_usec = (timeout % 1000) * 1000
+    };
+
+    if (setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO,
+                   (const char *)&timeout_values, sizeof(timeout_values)) != 0) {
+        cout << "Could not set socket read timeout\n";
+        return ESP_LOADER_ERROR_FAIL;
+    }
+
+    // Returns whatever the socket has buffered once the first byte is there
+    const int bytes_read = recv(sock, data, size, 0);
+
+    if (bytes_read <= 0) {
+        if (bytes_read < 0 && (errno == EWOULDBLOCK || errno == EAGAIN)) {
+            cout << "A socket read timeout occurred\n";
+            return ESP_LOADER_ERROR_TIMEOUT;
+        } else {
+            cout << "Socket connection lost\n";
+            return ESP_LOADER_ERROR_FAIL;
+        }
+    }
+
+#if SERIAL_FLASHER_DEBUG_TRACE
+    transfer_debug_print(data, bytes_read, false);
+#endif
+
+    file.write((const char *)data, bytes_read);
+    file.flush();
+
+    *received = bytes_read;
+    return ESP_LOADER_SUCCESS;
+}
+
 void loader_port_enter_bootloader()
 {
     // GPIO0 and GPIO2 must be LOW
@@ -180,3 +218,10 @@ uint32_t loader_port_remaining_time(void)
 
     return (remaining_ms > 0) ? (uint32_t)remaining_ms : 0;
 }
+
+
+uint32_t loader_port_get_time_ms(void)
+{
+    const auto now = chrono::steady_clock::now().time_since_epoch();
+    return (uint32_t)chrono::duration_cast<chrono::milliseconds>(now).count();
+}